@@ -12,4 +12,5 @@ bazel-bin/src/capnp/capnp_tool compile -Isrc --no-standard-import --src-prefix=s
     src/capnp/c++.capnp src/capnp/schema.capnp src/capnp/stream.capnp \
     src/capnp/compiler/lexer.capnp src/capnp/compiler/grammar.capnp \
     src/capnp/rpc.capnp src/capnp/rpc-twoparty.capnp src/capnp/persistent.capnp \
+    src/capnp/rpc-instrumentation.capnp \
     src/capnp/compat/json.capnp
@@ -93,7 +93,10 @@ public:
   static void handleRequest(SearchResultList::Reader request, SearchResultList::Builder response) {
     std::vector<ScoredResult> scoredResults;
 
-    for (auto result: request.getResults()) {
+    auto results = request.getResults();
+    if (prevalidateLists()) results = results.prevalidate();
+
+    for (auto result: results) {
       double score = result.getScore();
       if (strstr(result.getSnippet().cStr(), " cat ") != nullptr) {
         score *= 10000;
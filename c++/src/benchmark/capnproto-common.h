@@ -235,6 +235,47 @@ struct UseScratch {
   };
 };
 
+inline bool prevalidateLists() {
+  // Set by the runner's "prevalidate" option to compare List::Reader::prevalidate() against
+  // regular checked element access.
+  static const bool result = getenv("CAPNP_BENCHMARK_PREVALIDATE") != nullptr;
+  return result;
+}
+
+struct UsePool {
+  // Readers behave as with NoScratch; builders take their segments from a SegmentPool instead of
+  // calloc().
+
+  struct ScratchSpace {
+    // Each benchmark loop owns its ScratchSpaces and reuses them for every iteration, so a pool
+    // here lives as long as the loop, like the per-thread pool a real server would keep. Reader
+    // scratch spaces just leave theirs empty.
+    SegmentPool pool;
+  };
+
+  template <typename Compression>
+  class MessageReader: public Compression::MessageReader {
+  public:
+    inline MessageReader(typename Compression::BufferedInput& input, ScratchSpace& scratch)
+        : Compression::MessageReader(input) {}
+  };
+
+  template <typename Compression>
+  class ArrayMessageReader: public Compression::ArrayMessageReader {
+  public:
+    inline ArrayMessageReader(kj::ArrayPtr<const byte> input, ScratchSpace& scratch)
+        : Compression::ArrayMessageReader(input) {}
+  };
+
+  class MessageBuilder: public PooledMessageBuilder {
+  public:
+    inline MessageBuilder(ScratchSpace& scratch)
+        : PooledMessageBuilder(scratch.pool) {}
+  };
+
+  typedef NoScratch::ObjectSizeCounter ObjectSizeCounter;
+};
+
 // =======================================================================================
 
 template <typename TestCase, typename ReuseStrategy, typename Compression>
@@ -399,6 +440,64 @@ struct BenchmarkMethods {
 
     return throughput;
   }
+
+  static uint64_t passByPacking(bool decode, const std::string& kernelName, uint64_t iters) {
+    // Measures the packing codec alone by repeatedly packing (or unpacking) one serialized
+    // request. Returns the number of unpacked bytes processed, or zero if the CPU doesn't support
+    // the requested kernel.
+
+    _::PackedCodecKernel kernel;
+    if (kernelName == "scalar") {
+      kernel = _::PackedCodecKernel::SCALAR;
+    } else if (kernelName == "sse4.2") {
+      kernel = _::PackedCodecKernel::SSE4_2;
+    } else {
+      fprintf(stderr, "Unknown packing kernel: %s\n", kernelName.c_str());
+      exit(1);
+    }
+    if (!_::isPackedCodecKernelSupported(kernel)) {
+      return 0;
+    }
+
+    MallocMessageBuilder builder;
+    TestCase::setupRequest(builder.initRoot<typename TestCase::Request>());
+    kj::Array<word> flat = messageToFlatArray(builder);
+    kj::ArrayPtr<const byte> unpacked = flat.asBytes();
+
+    UseScratch::ScratchSpace packedScratch;
+    auto packedBuffer = kj::arrayPtr(
+        reinterpret_cast<byte*>(packedScratch.words), SCRATCH_SIZE * sizeof(word));
+    kj::ArrayOutputStream packedOutput(packedBuffer);
+    {
+      _::PackedOutputStream packer(packedOutput, kernel);
+      packer.write(unpacked);
+    }
+    kj::ArrayPtr<const byte> packed = packedOutput.getArray();
+
+    UseScratch::ScratchSpace unpackedScratch;
+    auto roundTrip = kj::arrayPtr(
+        reinterpret_cast<byte*>(unpackedScratch.words), unpacked.size());
+
+    uint64_t throughput = 0;
+    for (; iters > 0; --iters) {
+      if (decode) {
+        kj::ArrayInputStream input(packed);
+        _::PackedInputStream unpacker(input, kernel);
+        unpacker.InputStream::read(roundTrip);
+      } else {
+        kj::ArrayOutputStream output(packedBuffer);
+        _::PackedOutputStream packer(output, kernel);
+        packer.write(unpacked);
+      }
+      throughput += unpacked.size();
+    }
+
+    if (decode && roundTrip != unpacked) {
+      throw std::logic_error("Packing round trip failed.");
+    }
+
+    return throughput;
+  }
 };
 
 struct BenchmarkTypes {
@@ -410,6 +509,7 @@ struct BenchmarkTypes {
 
   typedef capnp::UseScratch ReusableResources;
   typedef capnp::NoScratch SingleUseResources;
+  typedef capnp::UsePool PooledResources;
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods: public capnp::BenchmarkMethods<TestCase, ReuseStrategy, Compression> {};
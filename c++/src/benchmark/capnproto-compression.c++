@@ -0,0 +1,210 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// Measures how well DeflateMessageStream compresses carsales traffic and what it costs in CPU.
+// Messages are passed through an in-memory pipe so that only serialization and zlib are timed.
+// Two workloads: whole parking lots (large messages, 0-200 cars each) and single cars (small
+// messages, where context persistence and a pre-shared dictionary matter most). Like
+// capnproto-shm, this is a standalone program rather than a test case for the runner.
+//
+//     capnproto-compression [<messages>]
+
+#include "carsales.capnp.h"
+#include "common.h"
+#include <capnp/compat/deflate-message-stream.h>
+#include <capnp/message.h>
+#include <capnp/serialize.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/vector.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+void randomCar(Car::Builder car) {
+  // Same generator as capnproto-carsales.c++.
+
+  static const char* const MAKES[] = { "Toyota", "GM", "Ford", "Honda", "Tesla" };
+  static const char* const MODELS[] = { "Camry", "Prius", "Volt", "Accord", "Leaf", "Model S" };
+
+  car.setMake(MAKES[fastRand(sizeof(MAKES) / sizeof(MAKES[0]))]);
+  car.setModel(MODELS[fastRand(sizeof(MODELS) / sizeof(MODELS[0]))]);
+
+  car.setColor((Color)fastRand((uint)Color::SILVER + 1));
+  car.setSeats(2 + fastRand(6));
+  car.setDoors(2 + fastRand(3));
+
+  for (auto wheel: car.initWheels(4)) {
+    wheel.setDiameter(25 + fastRand(15));
+    wheel.setAirPressure(30 + fastRandDouble(20));
+    wheel.setSnowTires(fastRand(16) == 0);
+  }
+
+  car.setLength(170 + fastRand(150));
+  car.setWidth(48 + fastRand(36));
+  car.setHeight(54 + fastRand(48));
+  car.setWeight(car.getLength() * car.getWidth() * car.getHeight() / 200);
+
+  auto engine = car.initEngine();
+  engine.setHorsepower(100 * fastRand(400));
+  engine.setCylinders(4 + 2 * fastRand(3));
+  engine.setCc(800 + fastRand(10000));
+  engine.setUsesGas(true);
+  engine.setUsesElectric(fastRand(2));
+
+  car.setFuelCapacity(10.0 + fastRandDouble(30.0));
+  car.setFuelLevel(fastRandDouble(car.getFuelCapacity()));
+  car.setHasPowerWindows(fastRand(2));
+  car.setHasPowerSteering(fastRand(2));
+  car.setHasCruiseControl(fastRand(2));
+  car.setCupHolders(fastRand(12));
+  car.setHasNavSystem(fastRand(2));
+}
+
+kj::Array<kj::Own<MallocMessageBuilder>> makeMessages(uint count, uint maxCars) {
+  auto messages = kj::heapArrayBuilder<kj::Own<MallocMessageBuilder>>(count);
+  for (uint i = 0; i < count; i++) {
+    auto message = kj::heap<MallocMessageBuilder>();
+    auto cars = message->initRoot<ParkingLot>().initCars(maxCars == 1 ? 1 : fastRand(maxCars));
+    for (auto car: cars) {
+      randomCar(car);
+    }
+    messages.add(kj::mv(message));
+  }
+  return messages.finish();
+}
+
+kj::Array<byte> makeDictionary() {
+  // A handful of representative messages, as an operator would capture from real traffic.
+  kj::Vector<byte> dictionary;
+  for (auto& message: makeMessages(16, 1)) {
+    auto flat = messageToFlatArray(*message);
+    dictionary.addAll(flat.asBytes());
+  }
+  return dictionary.releaseAsArray();
+}
+
+struct Result {
+  double ratio;
+  double compressNanosPerMessage;
+  double decompressNanosPerMessage;
+  double totalNanosPerMessage;
+};
+
+Result run(kj::ArrayPtr<kj::Own<MallocMessageBuilder>> messages,
+           DeflateMessageStream::Options options) {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  DeflateMessageStream sender(*pipe.ends[0], options);
+  DeflateMessageStream receiver(*pipe.ends[1], options);
+  sender.isCompressing().wait(waitScope);
+
+  uint64_t start = nowNanos();
+  for (auto& message: messages) {
+    auto write = sender.writeMessage(*message);
+    auto reader = receiver.readMessage().wait(waitScope);
+    write.wait(waitScope);
+    KJ_ASSERT(reader->getRoot<ParkingLot>().getCars().size() ==
+              message->getRoot<ParkingLot>().getCars().size());
+  }
+  uint64_t total = nowNanos() - start;
+
+  auto& sent = sender.getStats();
+  auto& received = receiver.getStats();
+  return {
+    (double)sent.bytesBeforeCompression / sent.bytesAfterCompression,
+    (double)sent.compressNanos / messages.size(),
+    (double)received.decompressNanos / messages.size(),
+    (double)total / messages.size(),
+  };
+}
+
+int main(int argc, char* argv[]) {
+  uint count = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000;
+  KJ_REQUIRE(count > 0);
+
+  auto dictionary = makeDictionary();
+
+  struct Config {
+    const char* name;
+    bool compress;
+    int level;
+    bool useDictionary;
+  };
+  static const Config CONFIGS[] = {
+    { "none",           false, 0, false },
+    { "level 1",        true,  1, false },
+    { "level 1 + dict", true,  1, true  },
+    { "level 6",        true,  6, false },
+    { "level 6 + dict", true,  6, true  },
+    { "level 9",        true,  9, false },
+  };
+
+  printf("%-12s %-16s %8s %12s %12s %12s\n",
+      "Workload", "Compression", "ratio", "deflate", "inflate", "total");
+  printf("===============================================================================\n");
+
+  struct Workload {
+    const char* name;
+    uint maxCars;
+    uint count;
+  };
+  // Parking lots average 100 cars, so send fewer of them.
+  Workload workloads[] = {
+    { "parking lot", 200, kj::max(count / 100, 1u) },
+    { "single car",  1,   count },
+  };
+
+  for (auto& workload: workloads) {
+    // Generate each workload once so that every configuration sees identical messages.
+    auto messages = makeMessages(workload.count, workload.maxCars);
+
+    for (auto& config: CONFIGS) {
+      DeflateMessageStream::Options options;
+      options.enableCompression = config.compress;
+      options.compressionLevel = config.level;
+      options.minCompressSize = 0;
+      if (config.useDictionary) options.dictionary = dictionary;
+
+      auto result = run(messages, options);
+      printf("%-12s %-16s %7.2fx %9.0f ns %9.0f ns %9.0f ns\n",
+          workload.name, config.name, result.ratio, result.compressNanosPerMessage,
+          result.decompressNanosPerMessage, result.totalNanosPerMessage);
+    }
+  }
+
+  return 0;
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
@@ -0,0 +1,134 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// Measures how fast a single very large message can be built and then traversed, with segments
+// from malloc() versus HugePageMessageBuilder. Unlike the other benchmarks, this is a standalone
+// program rather than a test case for the runner, since it's only about Cap'n Proto's own memory
+// layout.
+//
+//     capnproto-hugepage [<result count> [<passes>]]
+
+#include "catrank.capnp.h"
+#include "common.h"
+#include <capnp/message.h>
+#include <kj/debug.h>
+#include <kj/string.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+struct Result {
+  uint64_t buildNanos = 0;
+  uint64_t traverseNanos = 0;
+  uint64_t bytes = 0;
+};
+
+Result run(MessageBuilder& builder, uint count, uint passes) {
+  Result result;
+
+  uint64_t start = nowNanos();
+  auto results = builder.initRoot<SearchResultList>().initResults(count);
+  for (uint i = 0; i < count; i++) {
+    auto item = results[i];
+    item.setScore(i * 0.5);
+    item.setUrl(kj::str("http://example.com/", i));
+  }
+  result.buildNanos = nowNanos() - start;
+
+  for (auto segment: builder.getSegmentsForOutput()) {
+    result.bytes += segment.asBytes().size();
+  }
+
+  // Visit results in a scattered order, as a consumer following an index would, so that most
+  // accesses land on a different page than the last.
+  auto reader = builder.getRoot<SearchResultList>().asReader().getResults();
+  start = nowNanos();
+  double sum = 0;
+  for (uint pass = 0; pass < passes; pass++) {
+    uint index = pass;
+    for (uint i = 0; i < count; i++) {
+      auto item = reader[index];
+      sum += item.getScore() + item.getUrl().size();
+      index = (index + 7919) % count;
+    }
+  }
+  result.traverseNanos = nowNanos() - start;
+
+  // Keep the traversal from being optimized away.
+  KJ_ASSERT(sum > 0);
+
+  return result;
+}
+
+void report(const char* name, Result result, uint count, uint passes) {
+  printf("%-30s %10.1f %10.1f %12" PRIu64 "\n", name,
+      (double)result.buildNanos / count,
+      (double)result.traverseNanos / ((uint64_t)count * passes),
+      result.bytes >> 20);
+}
+
+int main(int argc, char* argv[]) {
+  uint count = argc > 1 ? strtoul(argv[1], nullptr, 0) : 10000000;
+  uint passes = argc > 2 ? strtoul(argv[2], nullptr, 0) : 4;
+  KJ_REQUIRE(count > 0 && passes > 0);
+
+  printf("%-30s %10s %10s %12s\n", "Allocator", "build ns", "visit ns", "message MiB");
+  printf("=================================================================\n");
+
+  {
+    MallocMessageBuilder builder;
+    report("malloc", run(builder, count, passes), count, passes);
+  }
+
+  {
+    HugePageMessageBuilder builder;
+    report("transparent huge pages", run(builder, count, passes), count, passes);
+  }
+
+  {
+    HugePageOptions options;
+    options.explicitHugePages = true;
+    HugePageMessageBuilder builder(options);
+    report("reserved huge pages", run(builder, count, passes), count, passes);
+  }
+
+  {
+    HugePageOptions options;
+    options.bindToLocalNode = true;
+    HugePageMessageBuilder builder(options);
+    report("huge pages, local NUMA node", run(builder, count, passes), count, passes);
+  }
+
+  return 0;
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
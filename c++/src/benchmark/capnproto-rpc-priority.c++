@@ -0,0 +1,165 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// Measures the latency of small RPC calls while the same connection is busy streaming bulk data
+// the other way, with TwoPartyVatNetwork writing queued streaming calls a quantum at a time versus
+// all at once. The server sends both the streaming calls and the small calls' returns, so the
+// returns compete with the stream for the server's write queue. Like capnproto-hugepage, this is a
+// standalone program rather than a test case for the runner.
+//
+//     capnproto-rpc-priority [<chunk bytes> [<chunk count>]]
+
+#include "rpc-priority.capnp.h"
+#include "common.h"
+#include <capnp/rpc-twoparty.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <algorithm>
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+class BulkSinkImpl final: public BulkSink::Server {
+public:
+  kj::Promise<void> write(WriteContext context) override {
+    bytes += context.getParams().getData().size();
+    return kj::READY_NOW;
+  }
+
+  uint64_t bytes = 0;
+};
+
+class PriorityBenchImpl final: public PriorityBench::Server {
+public:
+  kj::Promise<void> ping(PingContext context) override {
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> streamTo(StreamToContext context) override {
+    auto params = context.getParams();
+    auto sink = params.getSink();
+    auto chunk = kj::heapArray<byte>(params.getChunkBytes());
+    memset(chunk.begin(), 'x', chunk.size());
+
+    for (uint i = 0; i < params.getChunkCount(); i++) {
+      auto request = sink.writeRequest();
+      request.setData(chunk);
+      co_await request.send();
+    }
+  }
+};
+
+struct Result {
+  uint64_t p50Nanos;
+  uint64_t p99Nanos;
+  uint64_t maxNanos;
+  size_t pings;
+  double streamMiBPerSecond;
+};
+
+Result run(kj::AsyncIoContext& io, size_t quantum, uint chunkBytes, uint chunkCount) {
+  auto thread = io.provider->newPipeThread(
+      [quantum](kj::AsyncIoProvider& provider, kj::AsyncIoStream& stream,
+                kj::WaitScope& waitScope) {
+    TwoPartyVatNetwork network(stream, rpc::twoparty::Side::SERVER);
+    network.setBulkWriteQuantum(quantum);
+    auto server = makeRpcServer(network, kj::heap<PriorityBenchImpl>());
+    network.onDisconnect().wait(waitScope);
+  });
+
+  Result result;
+  kj::Vector<uint64_t> latencies;
+
+  {
+    TwoPartyClient client(*thread.pipe);
+    auto bench = client.bootstrap().castAs<PriorityBench>();
+
+    // Warm up the connection.
+    bench.pingRequest().send().wait(io.waitScope);
+
+    auto sink = kj::heap<BulkSinkImpl>();
+    auto& sinkRef = *sink;
+    auto request = bench.streamToRequest();
+    request.setSink(kj::mv(sink));
+    request.setChunkBytes(chunkBytes);
+    request.setChunkCount(chunkCount);
+
+    uint64_t streamStart = nowNanos();
+    auto streamPromise = request.send();
+
+    while (!streamPromise.poll(io.waitScope)) {
+      uint64_t start = nowNanos();
+      bench.pingRequest().send().wait(io.waitScope);
+      latencies.add(nowNanos() - start);
+    }
+    streamPromise.wait(io.waitScope);
+
+    KJ_ASSERT(sinkRef.bytes == (uint64_t)chunkBytes * chunkCount);
+    result.streamMiBPerSecond = sinkRef.bytes * 1e9 / (1 << 20) / (nowNanos() - streamStart);
+  }
+
+  KJ_REQUIRE(latencies.size() > 0, "stream finished before any pings; use more chunks");
+  std::sort(latencies.begin(), latencies.end());
+  result.p50Nanos = latencies[latencies.size() / 2];
+  result.p99Nanos = latencies[latencies.size() * 99 / 100];
+  result.maxNanos = latencies.back();
+  result.pings = latencies.size();
+  return result;
+}
+
+void report(const char* name, Result result) {
+  printf("%-24s %10" PRIu64 " %10" PRIu64 " %10" PRIu64 " %8zu %10.1f\n", name,
+      result.p50Nanos / 1000, result.p99Nanos / 1000, result.maxNanos / 1000,
+      result.pings, result.streamMiBPerSecond);
+}
+
+int main(int argc, char* argv[]) {
+  uint chunkBytes = argc > 1 ? strtoul(argv[1], nullptr, 0) : 16384;
+  uint chunkCount = argc > 2 ? strtoul(argv[2], nullptr, 0) : 16384;
+  KJ_REQUIRE(chunkBytes > 0 && chunkCount > 0);
+
+  auto io = kj::setupAsyncIo();
+
+  printf("%-24s %10s %10s %10s %8s %10s\n",
+      "Bulk write quantum", "p50 us", "p99 us", "max us", "pings", "MiB/s");
+  printf("=========================================================================\n");
+
+  report("unlimited", run(io, SIZE_MAX, chunkBytes, chunkCount));
+  report("64 KiB (default)", run(io, TwoPartyVatNetwork::DEFAULT_BULK_WRITE_QUANTUM,
+                                 chunkBytes, chunkCount));
+  report("16 KiB", run(io, 16384, chunkBytes, chunkCount));
+
+  return 0;
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
@@ -0,0 +1,182 @@
+// Copyright (c) 2013-2014 Sandstorm Development Group, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+// Measures message latency and throughput between two processes, through
+// SharedMemoryMessageStream versus the BufferedMessageStream over a socketpair that
+// TwoPartyVatNetwork uses by default. Each run forks an echo process. Like capnproto-hugepage, this
+// is a standalone program rather than a test case for the runner.
+//
+//     capnproto-shm [<round trips> [<streamed messages>]]
+
+#include "catrank.capnp.h"
+#include "common.h"
+#include <capnp/message.h>
+#include <capnp/serialize-shm.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/string.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace capnp {
+namespace benchmark {
+namespace capnp {
+
+enum class Transport {
+  SOCKETPAIR,
+  SHARED_MEMORY
+};
+
+kj::Promise<kj::Own<MessageStream>> openStream(
+    Transport transport, kj::AsyncIoContext& io, int fd) {
+  auto socket = io.lowLevelProvider->wrapUnixSocketFd(kj::OwnFd(fd));
+  auto isShortLived = [](MessageReader&) { return true; };
+  switch (transport) {
+    case Transport::SOCKETPAIR: {
+      kj::Own<MessageStream> stream = kj::heap<BufferedMessageStream>(*socket, isShortLived);
+      co_return stream.attach(kj::mv(socket));
+    }
+    case Transport::SHARED_MEMORY:
+      co_return co_await SharedMemoryMessageStream::connect(
+          *io.lowLevelProvider, kj::mv(socket), isShortLived);
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Promise<void> echo(MessageStream& stream) {
+  for (;;) {
+    MallocMessageBuilder reply;
+    KJ_IF_SOME(message, co_await stream.MessageStream::tryReadMessage()) {
+      reply.setRoot(message->getRoot<SearchResult>());
+    } else {
+      co_return;
+    }
+    co_await stream.writeMessage(reply);
+  }
+}
+
+kj::Promise<void> writeMany(MessageStream& stream, MessageBuilder& message, uint count) {
+  for (uint i = 0; i < count; i++) {
+    co_await stream.writeMessage(message);
+  }
+}
+
+struct Result {
+  double roundTripNanos;
+  double messagesPerSecond;
+};
+
+kj::Promise<Result> measure(MessageStream& stream, uint payloadBytes,
+                            uint roundTrips, uint streamed) {
+  MallocMessageBuilder message;
+  auto root = message.initRoot<SearchResult>();
+  root.setUrl("http://example.com/");
+  memset(root.initSnippet(payloadBytes).begin(), 'x', payloadBytes);
+
+  Result result;
+
+  uint64_t start = nowNanos();
+  for (uint i = 0; i < roundTrips; i++) {
+    co_await stream.writeMessage(message);
+    auto reply = co_await stream.readMessage();
+    KJ_ASSERT(reply->getRoot<SearchResult>().getSnippet().size() == payloadBytes);
+  }
+  result.roundTripNanos = (double)(nowNanos() - start) / roundTrips;
+
+  // Stream messages at the echo process while reading its replies, so that both directions are
+  // busy.
+  start = nowNanos();
+  auto writes = writeMany(stream, message, streamed).eagerlyEvaluate(nullptr);
+  for (uint i = 0; i < streamed; i++) {
+    co_await stream.readMessage();
+  }
+  co_await writes;
+  result.messagesPerSecond = streamed * 1e9 / (nowNanos() - start);
+
+  co_await stream.end();
+  co_return result;
+}
+
+Result run(Transport transport, uint payloadBytes, uint roundTrips, uint streamed) {
+  int fds[2];
+  KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+
+  pid_t child;
+  KJ_SYSCALL(child = fork());
+  if (child == 0) {
+    close(fds[0]);
+    auto io = kj::setupAsyncIo();
+    auto stream = openStream(transport, io, fds[1]).wait(io.waitScope);
+    echo(*stream).wait(io.waitScope);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  Result result;
+  {
+    auto io = kj::setupAsyncIo();
+    auto stream = openStream(transport, io, fds[0]).wait(io.waitScope);
+    result = measure(*stream, payloadBytes, roundTrips, streamed).wait(io.waitScope);
+  }
+
+  int status;
+  KJ_SYSCALL(waitpid(child, &status, 0));
+  KJ_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0, "echo process failed");
+  return result;
+}
+
+int main(int argc, char* argv[]) {
+  uint roundTrips = argc > 1 ? strtoul(argv[1], nullptr, 0) : 100000;
+  uint streamed = argc > 2 ? strtoul(argv[2], nullptr, 0) : 1000000;
+  KJ_REQUIRE(roundTrips > 0 && streamed > 0);
+
+  printf("%-16s %10s %12s %12s %10s\n",
+      "Transport", "payload", "round trip", "messages/s", "MiB/s");
+  printf("=================================================================\n");
+
+  for (uint payloadBytes: { 64u, 1024u, 16384u, 262144u }) {
+    for (auto transport: { Transport::SOCKETPAIR, Transport::SHARED_MEMORY }) {
+      // Fewer of the big messages, so that each row takes a similar amount of time.
+      uint scale = kj::max(payloadBytes / 1024, 1u);
+      auto result = run(transport, payloadBytes,
+          kj::max(roundTrips / scale, 1u), kj::max(streamed / scale, 1u));
+      printf("%-16s %10u %9.0f ns %12.0f %10.1f\n",
+          transport == Transport::SOCKETPAIR ? "socketpair" : "shared memory",
+          payloadBytes, result.roundTripNanos, result.messagesPerSecond,
+          result.messagesPerSecond * payloadBytes / (1 << 20));
+    }
+  }
+
+  return 0;
+}
+
+}  // namespace capnp
+}  // namespace benchmark
+}  // namespace capnp
+
+int main(int argc, char* argv[]) {
+  return capnp::benchmark::capnp::main(argc, argv);
+}
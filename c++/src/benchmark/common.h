@@ -32,6 +32,7 @@
 #include <sys/time.h>
 #include <sys/resource.h>
 #include <sys/wait.h>
+#include <time.h>
 #include <stdlib.h>
 #include <semaphore.h>
 #include <algorithm>
@@ -86,6 +87,12 @@ inline int32_t mod(int32_t a, int32_t b) {
   return a % b;
 }
 
+inline uint64_t nowNanos() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
 static const char* const WORDS[] = {
     "foo ", "bar ", "baz ", "qux ", "quux ", "corge ", "grault ", "garply ", "waldo ", "fred ",
     "plugh ", "xyzzy ", "thud "
@@ -234,6 +241,10 @@ uint64_t doBenchmark(const std::string& mode, uint64_t iters) {
     return passByPipe<BenchmarkMethods>(BenchmarkMethods::syncClient, iters);
   } else if (mode == "pipe-async") {
     return passByPipe<BenchmarkMethods>(BenchmarkMethods::asyncClient, iters);
+  } else if (mode.starts_with("pack-")) {
+    return BenchmarkMethods::passByPacking(false, mode.substr(strlen("pack-")), iters);
+  } else if (mode.starts_with("unpack-")) {
+    return BenchmarkMethods::passByPacking(true, mode.substr(strlen("unpack-")), iters);
   } else {
     fprintf(stderr, "Unknown mode: %s\n", mode.c_str());
     exit(1);
@@ -250,6 +261,10 @@ uint64_t doBenchmark2(const std::string& mode, const std::string& reuse, uint64_
     return doBenchmark<
         BenchmarkTypes, TestCase, typename BenchmarkTypes::SingleUseResources, Compression>(
             mode, iters);
+  } else if (reuse == "pool") {
+    return doBenchmark<
+        BenchmarkTypes, TestCase, typename BenchmarkTypes::PooledResources, Compression>(
+            mode, iters);
   } else {
     fprintf(stderr, "Unknown reuse mode: %s\n", reuse.c_str());
     exit(1);
@@ -153,6 +153,11 @@ struct BenchmarkMethods {
     fprintf(stderr, "Null benchmark doesn't do I/O.\n");
     exit(1);
   }
+
+  static uint64_t passByPacking(bool decode, const std::string& kernel, uint64_t iters) {
+    fprintf(stderr, "Null benchmark doesn't do packing.\n");
+    exit(1);
+  }
 };
 
 struct BenchmarkTypes {
@@ -164,6 +169,7 @@ struct BenchmarkTypes {
 
   typedef ReusableObjects ReusableResources;
   typedef SingleUseObjects SingleUseResources;
+  typedef SingleUseObjects PooledResources;  // Segment pooling is specific to Cap'n Proto.
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods: public null::BenchmarkMethods<TestCase, ReuseStrategy, Compression> {};
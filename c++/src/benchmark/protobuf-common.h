@@ -337,6 +337,11 @@ struct BenchmarkMethods {
 
     return throughput;
   }
+
+  static uint64_t passByPacking(bool decode, const std::string& kernel, uint64_t iters) {
+    fprintf(stderr, "Protobuf benchmark doesn't do Cap'n Proto packing.\n");
+    exit(1);
+  }
 };
 
 struct BenchmarkTypes {
@@ -348,6 +353,8 @@ struct BenchmarkTypes {
 
   typedef protobuf::ReusableMessages ReusableResources;
   typedef protobuf::SingleUseMessages SingleUseResources;
+  typedef protobuf::SingleUseMessages PooledResources;
+  // Segment pooling is specific to Cap'n Proto.
 
   template <typename TestCase, typename ReuseStrategy, typename Compression>
   struct BenchmarkMethods
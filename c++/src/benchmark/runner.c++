@@ -111,12 +111,15 @@ enum class Mode {
   OBJECT_SIZE,
   BYTES,
   PIPE_SYNC,
-  PIPE_ASYNC
+  PIPE_ASYNC,
+  PACK,
+  UNPACK
 };
 
 enum class Reuse {
   YES,
-  NO
+  NO,
+  POOL
 };
 
 enum class Compression {
@@ -126,7 +129,8 @@ enum class Compression {
 };
 
 TestResult runTest(Product product, TestCase testCase, Mode mode, Reuse reuse,
-                   Compression compression, uint64_t iters) {
+                   Compression compression, uint64_t iters,
+                   const char* packedKernel = "scalar") {
   char* argv[6];
 
   string progName;
@@ -162,6 +166,12 @@ TestResult runTest(Product product, TestCase testCase, Mode mode, Reuse reuse,
     case Mode::PIPE_ASYNC:
       argv[1] = strdup("pipe-async");
       break;
+    case Mode::PACK:
+      argv[1] = strdup((string("pack-") + packedKernel).c_str());
+      break;
+    case Mode::UNPACK:
+      argv[1] = strdup((string("unpack-") + packedKernel).c_str());
+      break;
   }
 
   switch (reuse) {
@@ -171,6 +181,9 @@ TestResult runTest(Product product, TestCase testCase, Mode mode, Reuse reuse,
     case Reuse::NO:
       argv[2] = strdup("no-reuse");
       break;
+    case Reuse::POOL:
+      argv[2] = strdup("pool");
+      break;
   }
 
   switch (compression) {
@@ -284,6 +297,15 @@ void reportOldNewComparisonHeader() {
   cout << setfill('=') << setw(85) << "" << setfill(' ') << endl;
 }
 
+void reportMallocPoolComparisonHeader() {
+  cout << setw(40) << left << "Measure"
+       << setw(15) << right << "Malloc"
+       << setw(15) << right << "Pool"
+       << setw(15) << right << "Improvement"
+       << endl;
+  cout << setfill('=') << setw(85) << "" << setfill(' ') << endl;
+}
+
 class Gain {
 public:
   Gain(double oldValue, double newValue)
@@ -337,6 +359,26 @@ void reportIntComparison(const char* name, const char* unit, uint64_t protobuf,
   cout << setw(14) << right << Gain(capnproto, protobuf) << endl;
 }
 
+void reportPackingHeader() {
+  cout << setw(40) << left << "Packed codec (ISA level)"
+       << setw(15) << right << "encode GB/s"
+       << setw(15) << right << "decode GB/s"
+       << endl;
+  cout << setfill('=') << setw(70) << "" << setfill(' ') << endl;
+}
+
+void reportPacking(const char* name, TestResult encode, TestResult decode) {
+  // The child reports unpacked bytes processed, so bytes per nanosecond is exactly GB/s.
+  cout << setw(40) << left << name << fixed << setprecision(2);
+  if (encode.messageSize == 0 || decode.messageSize == 0) {
+    cout << setw(15) << right << "n/a" << setw(15) << right << "n/a" << endl;
+  } else {
+    cout << setw(15) << right << (double)encode.messageSize / encode.time.real
+         << setw(15) << right << (double)decode.messageSize / decode.time.real
+         << endl;
+  }
+}
+
 size_t fileSize(const std::string& name) {
   struct stat stats;
   if (stat(name.c_str(), &stats) < 0) {
@@ -369,6 +411,8 @@ int main(int argc, char* argv[]) {
   Compression compression = Compression::NONE;
   uint64_t iters = 1;
   const char* oldDir = nullptr;
+  bool packing = false;
+  bool prevalidate = false;
 
   for (int i = 1; i < argc; i++) {
     string arg = argv[i];
@@ -384,6 +428,10 @@ int main(int argc, char* argv[]) {
       testCase = TestCase::CARSALES;
     } else if (arg == "snappy") {
       compression = Compression::SNAPPY;
+    } else if (arg == "packing") {
+      packing = true;
+    } else if (arg == "prevalidate") {
+      prevalidate = true;
     } else if (arg == "-c") {
       ++i;
       if (i == argc) {
@@ -428,6 +476,8 @@ int main(int argc, char* argv[]) {
   switch (mode) {
     case Mode::OBJECTS:
     case Mode::OBJECT_SIZE:
+    case Mode::PACK:
+    case Mode::UNPACK:
       // Can't happen.
       break;
     case Mode::BYTES:
@@ -494,6 +544,10 @@ int main(int argc, char* argv[]) {
       Product::CAPNPROTO, testCase, Mode::OBJECT_SIZE, Reuse::NO, compression, iters).objectSize;
   reportResults("Cap'n Proto w/o object reuse", iters, capnpNoReuse);
 
+  TestResult capnpPooled = runTest(
+      Product::CAPNPROTO, testCase, Mode::OBJECTS, Reuse::POOL, compression, iters);
+  reportResults("Cap'n Proto w/ segment pool", iters, capnpPooled);
+
   TestResult protobuf = runTest(
       Product::PROTOBUF, testCase, mode, Reuse::YES, compression, iters);
   protobuf.objectSize = protobufBase.objectSize;
@@ -603,6 +657,12 @@ int main(int argc, char* argv[]) {
   reportComparison("generated obj size (KiB)", "",
       protobufObjSize / 1024.0, capnpObjSize / 1024.0, 1);
 
+  cout << endl;
+  reportMallocPoolComparisonHeader();
+  reportComparison("object manipulation time w/o reuse (us)", "",
+      ((int64_t)capnpNoReuse.time.user - (int64_t)nullCaseNoReuse.time.user) / 1000.0,
+      ((int64_t)capnpPooled.time.user - (int64_t)nullCaseNoReuse.time.user) / 1000.0, iters);
+
   if (oldDir != nullptr) {
     cout << endl;
     reportOldNewComparisonHeader();
@@ -636,6 +696,36 @@ int main(int argc, char* argv[]) {
         oldCapnpObjSize / 1024.0, capnpObjSize / 1024.0, 1);
   }
 
+  if (packing) {
+    cout << endl;
+    reportPackingHeader();
+
+    for (const char* kernel: {"scalar", "sse4.2"}) {
+      TestResult encode = runTest(
+          Product::CAPNPROTO, testCase, Mode::PACK, Reuse::YES, Compression::PACKED, iters, kernel);
+      TestResult decode = runTest(
+          Product::CAPNPROTO, testCase, Mode::UNPACK, Reuse::YES, Compression::PACKED, iters,
+          kernel);
+      reportPacking(kernel, encode, decode);
+    }
+  }
+
+  if (prevalidate) {
+    // The Cap'n Proto benchmark binaries check this variable to decide whether to prevalidate
+    // big lists before scanning them. The children inherit our environment.
+    TestResult checked = runTest(
+        Product::CAPNPROTO, testCase, Mode::BYTES, Reuse::YES, compression, iters);
+    setenv("CAPNP_BENCHMARK_PREVALIDATE", "1", 1);
+    TestResult prevalidated = runTest(
+        Product::CAPNPROTO, testCase, Mode::BYTES, Reuse::YES, compression, iters);
+    unsetenv("CAPNP_BENCHMARK_PREVALIDATE");
+
+    cout << endl;
+    reportOldNewComparisonHeader();
+    reportComparison("in-memory time, prevalidated lists (us)", "",
+        checked.time.user / 1000.0, prevalidated.time.user / 1000.0, iters);
+  }
+
   return 0;
 }
 
@@ -0,0 +1,91 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmarks for calls on local (in-process) capabilities.
+
+#include <benchmark/benchmark.h>
+
+#include "capability.h"
+#include <capnp/test.capnp.h>
+#include <kj/debug.h>
+#include <kj/vector.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+namespace test = capnproto_test::capnp::test;
+
+class FooImpl final: public test::TestInterface::Server {
+  // A minimal version of test-util.h's TestInterfaceImpl, which would pull in the kj test
+  // runner's main().
+
+protected:
+  kj::Promise<void> foo(FooContext context) override {
+    context.getResults().setX("foo");
+    return kj::READY_NOW;
+  }
+};
+
+static void bm_LocalCall(benchmark::State& state) {
+  // Benchmark a simple call and return on a local capability, which is dominated by the
+  // allocation of the request, call context, and params and results messages.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  test::TestInterface::Client client = kj::heap<FooImpl>();
+
+  for (auto _: state) {
+    auto req = client.fooRequest();
+    req.setI(123);
+    req.setJ(true);
+    auto response = req.send().wait(waitScope);
+    benchmark::DoNotOptimize(response.getX());
+  }
+}
+
+BENCHMARK(bm_LocalCall);
+
+static void bm_LocalCall_Batch(benchmark::State& state) {
+  // Benchmark N local calls in flight at once, so that more than one set of messages is live at
+  // a time.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  test::TestInterface::Client client = kj::heap<FooImpl>();
+
+  for (auto _: state) {
+    kj::Vector<kj::Promise<void>> calls(state.range(0));
+    for (auto i KJ_UNUSED: kj::zeroTo(state.range(0))) {
+      auto req = client.fooRequest();
+      req.setI(123);
+      req.setJ(true);
+      calls.add(req.send().ignoreResult());
+    }
+    kj::joinPromises(calls.releaseAsArray()).wait(waitScope);
+  }
+}
+
+BENCHMARK(bm_LocalCall_Batch)->Arg(4)->Arg(64);
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
+
+BENCHMARK_MAIN();
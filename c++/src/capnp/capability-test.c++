@@ -114,6 +114,33 @@ TEST(Capability, CapabilityList) {
   EXPECT_EQ(1, callCount1);
 }
 
+KJ_TEST("local call messages can outlive their EventLoop") {
+  // Params and results of local calls are recycled through a pool owned by the EventLoop. One
+  // that's still held when the loop goes away must still be cleaned up properly.
+
+  kj::Maybe<Response<test::TestInterface::FooResults>> response;
+  kj::Maybe<Request<test::TestInterface::FooParams, test::TestInterface::FooResults>> request;
+
+  {
+    kj::EventLoop loop;
+    kj::WaitScope waitScope(loop);
+
+    int callCount = 0;
+    test::TestInterface::Client client(kj::heap<TestInterfaceImpl>(callCount));
+
+    auto request1 = client.fooRequest();
+    request1.setI(123);
+    request1.setJ(true);
+    response = request1.send().wait(waitScope);
+
+    request = client.fooRequest();
+  }
+
+  KJ_EXPECT(KJ_ASSERT_NONNULL(response).getX() == "foo");
+  response = kj::none;
+  request = kj::none;
+}
+
 TEST(Capability, Inheritance) {
   kj::EventLoop loop;
   kj::WaitScope waitScope(loop);
@@ -1228,6 +1255,33 @@ KJ_TEST("clone() with caps") {
   KJ_EXPECT(ClientHook::from(copy[2]).get() != ClientHook::from(root[0]).get());
 }
 
+KJ_TEST("MessageBuilder::compact() preserves cap table indexes") {
+  int dummy = 0;
+  MallocMessageBuilder builder(1, AllocationStrategy::FIXED_SIZE);
+  auto root = builder.getRoot<AnyPointer>().initAs<List<test::TestInterface>>(3);
+
+  // Fill out of order so that cap table indexes don't match list positions.
+  root.set(2, kj::heap<TestInterfaceImpl>(dummy));
+  root.set(0, kj::heap<TestInterfaceImpl>(dummy));
+  root.set(1, kj::heap<TestInterfaceImpl>(dummy));
+  KJ_ASSERT(builder.getSegmentsForOutput().size() > 1);
+
+  ClientHook* expected[3];
+  for (uint i = 0; i < 3; i++) {
+    expected[i] = ClientHook::from(root[i]).get();
+  }
+
+  auto compacted = builder.compact();
+  auto capTable = _::CloneImpl::releaseBuiltinCapTable(builder);
+  auto copy = AnyPointer::Reader(_::PointerReader::getRootUnchecked(compacted.begin())
+      .imbue(capTable)).getAs<List<test::TestInterface>>();
+
+  KJ_ASSERT(copy.size() == 3);
+  for (uint i = 0; i < 3; i++) {
+    KJ_EXPECT(ClientHook::from(copy[i]).get() == expected[i]);
+  }
+}
+
 KJ_TEST("Streaming calls block subsequent calls") {
   kj::EventLoop loop;
   kj::WaitScope waitScope(loop);
@@ -0,0 +1,226 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if KJ_HAS_ZLIB
+
+#include "deflate-message-stream.h"
+#include <capnp/rpc-twoparty.h>
+#include <capnp/serialize.h>
+#include <capnp/test-util.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+kj::Own<MessageReader> roundTrip(DeflateMessageStream& from, DeflateMessageStream& to,
+                                 MessageBuilder& builder, kj::WaitScope& waitScope) {
+  auto writePromise = from.writeMessage(builder);
+  auto reader = to.readMessage().wait(waitScope);
+  writePromise.wait(waitScope);
+  return reader;
+}
+
+KJ_TEST("DeflateMessageStream round trip") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  DeflateMessageStream a(*pipe.ends[0], { .minCompressSize = 0 });
+  DeflateMessageStream b(*pipe.ends[1], { .minCompressSize = 0 });
+
+  KJ_EXPECT(a.isCompressing().wait(waitScope));
+  KJ_EXPECT(b.isCompressing().wait(waitScope));
+
+  // The same message several times: the context persists, so repeats should be nearly free.
+  for (uint i = 0; i < 4; i++) {
+    MallocMessageBuilder builder;
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    auto reader = roundTrip(a, b, builder, waitScope);
+    checkTestMessage(reader->getRoot<TestAllTypes>());
+  }
+
+  auto& stats = a.getStats();
+  KJ_EXPECT(stats.messagesSent == 4);
+  KJ_EXPECT(stats.messagesCompressed == 4);
+  KJ_EXPECT(stats.bytesAfterCompression < stats.bytesBeforeCompression / 4,
+            stats.bytesAfterCompression, stats.bytesBeforeCompression);
+
+  // And the other direction, batched, with a multi-segment message in the mix.
+  MallocMessageBuilder small(1, AllocationStrategy::FIXED_SIZE);
+  initTestMessage(small.initRoot<TestAllTypes>());
+  KJ_ASSERT(small.getSegmentsForOutput().size() > 1);
+  MallocMessageBuilder other;
+  other.initRoot<TestAllTypes>().setTextField("hello");
+
+  MessageBuilder* builders[] = { &small, &other };
+  auto writePromise = b.writeMessages(kj::arrayPtr(builders));
+  checkTestMessage(a.readMessage().wait(waitScope)->getRoot<TestAllTypes>());
+  KJ_EXPECT(a.readMessage().wait(waitScope)->getRoot<TestAllTypes>().getTextField() == "hello");
+  writePromise.wait(waitScope);
+
+  // EOF is reported after the last frame.
+  a.end().wait(waitScope);
+  KJ_EXPECT(b.tryReadMessage().wait(waitScope) == kj::none);
+}
+
+KJ_TEST("DeflateMessageStream skips small messages") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  DeflateMessageStream a(*pipe.ends[0], { .minCompressSize = 1024 });
+  DeflateMessageStream b(*pipe.ends[1]);
+
+  MallocMessageBuilder tiny;
+  tiny.initRoot<TestAllTypes>().setInt32Field(123);
+  KJ_EXPECT(roundTrip(a, b, tiny, waitScope)->getRoot<TestAllTypes>().getInt32Field() == 123);
+  KJ_EXPECT(a.getStats().messagesCompressed == 0);
+
+  MallocMessageBuilder big;
+  initTestMessage(big.initRoot<TestAllTypes>());
+  checkTestMessage(roundTrip(a, b, big, waitScope)->getRoot<TestAllTypes>());
+  KJ_EXPECT(a.getStats().messagesCompressed == 1);
+}
+
+KJ_TEST("DeflateMessageStream falls back when either side declines") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  DeflateMessageStream a(*pipe.ends[0], { .minCompressSize = 0 });
+  DeflateMessageStream b(*pipe.ends[1], { .enableCompression = false });
+
+  KJ_EXPECT(!a.isCompressing().wait(waitScope));
+  KJ_EXPECT(!b.isCompressing().wait(waitScope));
+
+  MallocMessageBuilder builder;
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  checkTestMessage(roundTrip(a, b, builder, waitScope)->getRoot<TestAllTypes>());
+  checkTestMessage(roundTrip(b, a, builder, waitScope)->getRoot<TestAllTypes>());
+  KJ_EXPECT(a.getStats().messagesCompressed == 0);
+}
+
+KJ_TEST("DeflateMessageStream pre-shared dictionary") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  MallocMessageBuilder builder;
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto dictionary = messageToFlatArray(builder);
+
+  auto firstMessageSize = [&](kj::ArrayPtr<const byte> dictA, kj::ArrayPtr<const byte> dictB) {
+    auto pipe = kj::newTwoWayPipe();
+    DeflateMessageStream a(*pipe.ends[0], { .minCompressSize = 0, .dictionary = dictA });
+    DeflateMessageStream b(*pipe.ends[1], { .minCompressSize = 0, .dictionary = dictB });
+    checkTestMessage(roundTrip(a, b, builder, waitScope)->getRoot<TestAllTypes>());
+    return a.getStats().bytesAfterCompression;
+  };
+
+  auto withoutDictionary = firstMessageSize(nullptr, nullptr);
+  auto withDictionary = firstMessageSize(dictionary.asBytes(), dictionary.asBytes());
+  KJ_EXPECT(withDictionary < withoutDictionary / 4, withDictionary, withoutDictionary);
+
+  // A mismatched dictionary is ignored rather than corrupting messages.
+  auto otherDictionary = kj::heapArray<byte>(1024);
+  otherDictionary.asPtr().fill(0x5a);
+  KJ_EXPECT(firstMessageSize(dictionary.asBytes(), otherDictionary) == withoutDictionary);
+}
+
+#if KJ_HAS_BROTLI
+
+KJ_TEST("DeflateMessageStream brotli") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  MallocMessageBuilder builder;
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto dictionary = messageToFlatArray(builder);
+
+  using Codec = DeflateMessageStream::Codec;
+  auto check = [&](Codec codecA, Codec codecB, Codec expected,
+                   kj::ArrayPtr<const byte> dict = nullptr) {
+    auto pipe = kj::newTwoWayPipe();
+    DeflateMessageStream a(*pipe.ends[0],
+        { .codec = codecA, .minCompressSize = 0, .dictionary = dict });
+    DeflateMessageStream b(*pipe.ends[1],
+        { .codec = codecB, .minCompressSize = 0, .dictionary = dict });
+
+    KJ_EXPECT(a.isCompressing().wait(waitScope));
+    KJ_EXPECT(b.isCompressing().wait(waitScope));
+    KJ_EXPECT(a.getCodec() == expected);
+    KJ_EXPECT(b.getCodec() == expected);
+
+    for (uint i = 0; i < 4; i++) {
+      checkTestMessage(roundTrip(a, b, builder, waitScope)->getRoot<TestAllTypes>());
+      checkTestMessage(roundTrip(b, a, builder, waitScope)->getRoot<TestAllTypes>());
+    }
+    KJ_EXPECT(a.getStats().messagesCompressed == 4);
+    return a.getStats().bytesAfterCompression;
+  };
+
+  auto withoutDictionary = check(Codec::BROTLI, Codec::BROTLI, Codec::BROTLI);
+  auto withDictionary = check(Codec::BROTLI, Codec::BROTLI, Codec::BROTLI, dictionary.asBytes());
+  KJ_EXPECT(withDictionary < withoutDictionary, withDictionary, withoutDictionary);
+
+  // Brotli is only used if both sides ask for it.
+  check(Codec::BROTLI, Codec::DEFLATE, Codec::DEFLATE);
+  check(Codec::DEFLATE, Codec::BROTLI, Codec::DEFLATE);
+}
+
+#endif  // KJ_HAS_BROTLI
+
+KJ_TEST("DeflateMessageStream carries RPC") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+  DeflateMessageStream serverStream(*pipe.ends[0], { .minCompressSize = 0 });
+  DeflateMessageStream clientStream(*pipe.ends[1], { .minCompressSize = 0 });
+
+  int callCount = 0;
+  TwoPartyVatNetwork serverNetwork(serverStream, rpc::twoparty::Side::SERVER);
+  auto server = makeRpcServer(serverNetwork, kj::heap<TestInterfaceImpl>(callCount));
+
+  TwoPartyVatNetwork clientNetwork(clientStream, rpc::twoparty::Side::CLIENT);
+  auto client = makeRpcClient(clientNetwork);
+
+  MallocMessageBuilder hostIdBuilder;
+  auto hostId = hostIdBuilder.initRoot<rpc::twoparty::VatId>();
+  hostId.setSide(rpc::twoparty::Side::SERVER);
+  auto cap = client.bootstrap(hostId).castAs<test::TestInterface>();
+
+  for (uint i = 0; i < 3; i++) {
+    auto request = cap.fooRequest();
+    request.setI(123);
+    request.setJ(true);
+    KJ_EXPECT(request.send().wait(waitScope).getX() == "foo");
+  }
+  KJ_EXPECT(callCount == 3);
+  KJ_EXPECT(clientStream.getStats().messagesCompressed > 0);
+  KJ_EXPECT(serverStream.getStats().messagesCompressed > 0);
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
+
+#endif  // KJ_HAS_ZLIB
@@ -0,0 +1,568 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "deflate-message-stream.h"
+#include <capnp/serialize.h>
+#include <kj/debug.h>
+#include <kj/time.h>
+
+#if KJ_HAS_BROTLI
+#include <brotli/decode.h>
+#include <brotli/encode.h>
+#endif
+
+namespace capnp {
+
+namespace {
+
+constexpr uint32_t HELLO_MAGIC = 0x9d2f64c1;
+constexpr uint32_t HELLO_WANTS_COMPRESSION = 1;
+constexpr uint32_t HELLO_CODEC_SHIFT = 8;
+constexpr uint32_t HELLO_CODEC_MASK = 0xff << HELLO_CODEC_SHIFT;
+// The hello is four little-endian 32-bit words: magic, flags, and the dictionary ID (low word
+// first), which is zero if there is no dictionary. The flags word carries the sender's preferred
+// Codec in bits 8-15; peers that predate brotli support leave it zero, meaning DEFLATE.
+
+constexpr uint32_t FRAME_COMPRESSED = 1u << 31;
+// A frame header is two little-endian 32-bit words: the size of the payload on the wire, with
+// FRAME_COMPRESSED set if it is deflated, and the size of the standard serialization it encodes.
+
+constexpr byte SYNC_FLUSH_MARKER[4] = { 0x00, 0x00, 0xff, 0xff };
+// Z_SYNC_FLUSH always ends with an empty stored block. The sender drops it and the receiver puts
+// it back, as permessage-deflate does (RFC 7692, section 7.2.1).
+
+#if KJ_HAS_BROTLI
+constexpr int DEFAULT_BROTLI_QUALITY = 5;
+// Used when Options::compressionLevel is Z_DEFAULT_COMPRESSION. Same as kj/compat/brotli.h.
+
+constexpr int BROTLI_WINDOW_BITS = 19;
+// 512 KiB. Every connection keeps a window this size in each direction, so this is a compromise
+// between memory and how far back a message can refer; brotli's default is 4 MiB.
+#endif
+
+uint64_t dictionaryId(kj::ArrayPtr<const byte> dictionary) {
+  // FNV-1a. This only detects misconfiguration; it is not meant to resist a malicious peer, which
+  // can't do anything with a mismatched dictionary other than garble its own messages.
+
+  if (dictionary.size() == 0) return 0;
+
+  uint64_t hash = 0xcbf29ce484222325ull;
+  for (byte b: dictionary) {
+    hash ^= b;
+    hash *= 0x100000001b3ull;
+  }
+  return hash;
+}
+
+uint64_t nanosSince(kj::TimePoint start) {
+  return (kj::systemPreciseMonotonicClock().now() - start) / kj::NANOSECONDS;
+}
+
+[[noreturn]] void failZlib(const char* what, const z_stream& ctx, int result) {
+  if (ctx.msg == nullptr) {
+    KJ_FAIL_REQUIRE(what, result);
+  } else {
+    KJ_FAIL_REQUIRE(what, ctx.msg);
+  }
+}
+
+}  // namespace
+
+DeflateMessageStream::DeflateMessageStream(kj::AsyncIoStream& stream)
+    : DeflateMessageStream(stream, Options()) {}
+
+DeflateMessageStream::DeflateMessageStream(kj::AsyncIoStream& stream, Options options)
+    : stream(stream), options(options), negotiation(negotiate().fork()) {}
+
+DeflateMessageStream::~DeflateMessageStream() noexcept(false) {
+  // Both are no-ops returning Z_STREAM_ERROR if the context was never initialized.
+  deflateEnd(&deflater);
+  inflateEnd(&inflater);
+
+#if KJ_HAS_BROTLI
+  // The encoder refers to the prepared dictionary, so it goes first. All three accept null.
+  BrotliEncoderDestroyInstance(brotliEncoder);
+  BrotliEncoderDestroyPreparedDictionary(brotliDictionary);
+  BrotliDecoderDestroyInstance(brotliDecoder);
+#endif
+}
+
+kj::Promise<void> DeflateMessageStream::negotiate() {
+#if !KJ_HAS_BROTLI
+  KJ_REQUIRE(options.codec != Codec::BROTLI,
+      "DeflateMessageStream was built without brotli support (KJ_HAS_BROTLI)");
+#endif
+
+  uint64_t localDictionary = dictionaryId(options.dictionary);
+  localHello[0].set(HELLO_MAGIC);
+  localHello[1].set(options.enableCompression
+      ? HELLO_WANTS_COMPRESSION | static_cast<uint32_t>(options.codec) << HELLO_CODEC_SHIFT
+      : 0);
+  localHello[2].set(static_cast<uint32_t>(localDictionary));
+  localHello[3].set(static_cast<uint32_t>(localDictionary >> 32));
+
+  auto sendHello = stream.write(kj::arrayPtr(localHello).asBytes());
+  auto receiveHello = stream.tryRead(peerHello, sizeof(peerHello), sizeof(peerHello))
+      .then([this, localDictionary](size_t n) {
+    if (n == 0) {
+      // Peer went away before saying anything; tryReadMessage() will report EOF.
+      peerDisconnected = true;
+      return;
+    }
+    KJ_REQUIRE(n == sizeof(peerHello), "premature EOF in DeflateMessageStream hello");
+    KJ_REQUIRE(peerHello[0].get() == HELLO_MAGIC,
+        "peer is not using DeflateMessageStream", peerHello[0].get());
+
+    uint64_t peerDictionary =
+        (static_cast<uint64_t>(peerHello[3].get()) << 32) | peerHello[2].get();
+    uint32_t peerFlags = peerHello[1].get();
+    if (options.enableCompression && (peerFlags & HELLO_WANTS_COMPRESSION)) {
+      auto peerCodec = static_cast<Codec>((peerFlags & HELLO_CODEC_MASK) >> HELLO_CODEC_SHIFT);
+      codec = peerCodec == options.codec ? options.codec : Codec::DEFLATE;
+      initContexts(localDictionary != 0 && localDictionary == peerDictionary);
+      compressing = true;
+    }
+  });
+
+  return kj::joinPromises(kj::arr(kj::mv(sendHello), kj::mv(receiveHello)))
+      .then([this]() { negotiated = true; });
+}
+
+void DeflateMessageStream::initContexts(bool useDictionary) {
+  auto& dict = options.dictionary;
+
+  if (codec == Codec::BROTLI) {
+#if KJ_HAS_BROTLI
+    int quality = options.compressionLevel == Z_DEFAULT_COMPRESSION
+        ? DEFAULT_BROTLI_QUALITY : options.compressionLevel;
+
+    brotliEncoder = BrotliEncoderCreateInstance(nullptr, nullptr, nullptr);
+    brotliDecoder = BrotliDecoderCreateInstance(nullptr, nullptr, nullptr);
+    KJ_ASSERT(brotliEncoder != nullptr && brotliDecoder != nullptr,
+        "brotli initialization failed");
+    KJ_REQUIRE(BrotliEncoderSetParameter(brotliEncoder, BROTLI_PARAM_QUALITY, quality),
+        "invalid brotli quality", quality);
+    KJ_ASSERT(BrotliEncoderSetParameter(brotliEncoder, BROTLI_PARAM_LGWIN, BROTLI_WINDOW_BITS));
+
+    if (useDictionary) {
+      brotliDictionary = BrotliEncoderPrepareDictionary(BROTLI_SHARED_DICTIONARY_RAW,
+          dict.size(), dict.begin(), BROTLI_MAX_QUALITY, nullptr, nullptr, nullptr);
+      KJ_ASSERT(brotliDictionary != nullptr, "BrotliEncoderPrepareDictionary() failed");
+      KJ_ASSERT(BrotliEncoderAttachPreparedDictionary(brotliEncoder, brotliDictionary),
+          "BrotliEncoderAttachPreparedDictionary() failed");
+      KJ_ASSERT(BrotliDecoderAttachDictionary(brotliDecoder, BROTLI_SHARED_DICTIONARY_RAW,
+                                              dict.size(), dict.begin()),
+          "BrotliDecoderAttachDictionary() failed");
+    }
+    return;
+#else
+    KJ_UNREACHABLE;
+#endif
+  }
+
+  // Negative windowBits selects raw deflate: the frame header already carries sizes, and the
+  // transport is responsible for integrity, so zlib's header and checksum would be pure overhead.
+  int result = deflateInit2(&deflater, options.compressionLevel, Z_DEFLATED,
+                            -15,  // windowBits = 15 (maximum), raw
+                            8,    // memLevel = 8 (the default)
+                            Z_DEFAULT_STRATEGY);
+  if (result != Z_OK) failZlib("deflate initialization failed", deflater, result);
+
+  result = inflateInit2(&inflater, -15);
+  if (result != Z_OK) failZlib("inflate initialization failed", inflater, result);
+
+  if (useDictionary) {
+    result = deflateSetDictionary(&deflater, dict.begin(), dict.size());
+    if (result != Z_OK) failZlib("deflateSetDictionary() failed", deflater, result);
+    result = inflateSetDictionary(&inflater, dict.begin(), dict.size());
+    if (result != Z_OK) failZlib("inflateSetDictionary() failed", inflater, result);
+  }
+}
+
+kj::Promise<bool> DeflateMessageStream::isCompressing() {
+  return negotiation.addBranch().then([this]() { return compressing; });
+}
+
+// =======================================================================================
+// Writing
+
+kj::Promise<void> DeflateMessageStream::writeMessage(
+    kj::ArrayPtr<const int> fds,
+    kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_REQUIRE(fds.size() == 0, "DeflateMessageStream does not support FD passing");
+
+  if (negotiated) {
+    return writeFrames(kj::arrayPtr(&segments, 1));
+  } else {
+    return negotiation.addBranch().then([this, segments]() mutable {
+      return writeFrames(kj::arrayPtr(&segments, 1));
+    });
+  }
+}
+
+kj::Promise<void> DeflateMessageStream::writeMessages(
+    kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) {
+  if (negotiated) {
+    return writeFrames(messages);
+  } else {
+    return negotiation.addBranch().then([this, messages]() mutable {
+      return writeFrames(messages);
+    });
+  }
+}
+
+kj::Promise<void> DeflateMessageStream::writeFrames(
+    kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) {
+  // Each frame is a header followed by either the standard serialization of the message (segment
+  // table, then segments, written straight from the builder without copying) or that same byte
+  // sequence deflated into `compressBuffer`. All frames in the batch go out in a single write.
+
+  size_t tableWords = 0;
+  size_t pieceCount = 0;
+  for (auto& segments: messages) {
+    tableWords += 2 + ((segments.size() + 2) & ~size_t(1));
+    pieceCount += 2 + segments.size();
+  }
+
+  auto tables = kj::heapArray<_::WireValue<uint32_t>>(tableWords);
+  compressBuffer.clear();
+
+  // First pass: build headers and segment tables, and compress whatever should be compressed.
+  // Compressed frames are appended to `compressBuffer`, which may reallocate, so pieces can't
+  // point into it until all messages have been compressed.
+  auto pos = tables.begin();
+  for (auto& segments: messages) {
+    auto header = kj::arrayPtr(pos, 2);
+    auto table = kj::arrayPtr(pos + 2, (segments.size() + 2) & ~size_t(1));
+    pos = table.end();
+
+    // Segment count - 1, then each segment's size, padded to a word; see serialize.c++.
+    table[0].set(segments.size() - 1);
+    size_t rawSize = table.size() * sizeof(uint32_t);
+    for (auto i: kj::indices(segments)) {
+      table[i + 1].set(segments[i].size());
+      rawSize += segments[i].size() * sizeof(word);
+    }
+    if (segments.size() % 2 == 0) {
+      table[segments.size() + 1].set(0);
+    }
+
+    KJ_REQUIRE(rawSize < FRAME_COMPRESSED, "message too large for DeflateMessageStream", rawSize);
+    header[1].set(rawSize);
+
+    ++stats.messagesSent;
+    stats.bytesBeforeCompression += rawSize;
+
+    if (compressing && rawSize >= options.minCompressSize) {
+      size_t before = compressBuffer.size();
+      compress(table.asBytes(), segments);
+      size_t wireSize = compressBuffer.size() - before;
+      header[0].set(wireSize | FRAME_COMPRESSED);
+      ++stats.messagesCompressed;
+      stats.bytesAfterCompression += header.asBytes().size() + wireSize;
+    } else {
+      header[0].set(rawSize);
+      stats.bytesAfterCompression += header.asBytes().size() + rawSize;
+    }
+  }
+
+  // Second pass: gather the pieces.
+  kj::Vector<kj::ArrayPtr<const byte>> pieces(pieceCount);
+  auto compressed = compressBuffer.asPtr();
+  pos = tables.begin();
+  for (auto& segments: messages) {
+    auto header = kj::arrayPtr(pos, 2);
+    auto table = kj::arrayPtr(pos + 2, (segments.size() + 2) & ~size_t(1));
+    pos = table.end();
+
+    pieces.add(header.asBytes());
+    uint32_t wireSize = header[0].get();
+    if (wireSize & FRAME_COMPRESSED) {
+      wireSize &= ~FRAME_COMPRESSED;
+      pieces.add(compressed.first(wireSize));
+      compressed = compressed.slice(wireSize, compressed.size());
+    } else {
+      pieces.add(table.asBytes());
+      for (auto& segment: segments) {
+        pieces.add(segment.asBytes());
+      }
+    }
+  }
+  KJ_DASSERT(compressed.size() == 0);
+
+  // `compressBuffer` is reused by the next write, which can't start until this one completes.
+  auto piecesArray = pieces.releaseAsArray();
+  auto promise = stream.write(piecesArray);
+  return promise.attach(kj::mv(piecesArray), kj::mv(tables));
+}
+
+void DeflateMessageStream::compress(kj::ArrayPtr<const byte> table,
+                                    kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  auto start = kj::systemPreciseMonotonicClock().now();
+  size_t begin = compressBuffer.size();
+
+  // Feed the pieces one at a time rather than flattening the message first. Only the last one is
+  // flushed, so this compresses exactly as well as a contiguous buffer would.
+  if (codec == Codec::BROTLI) {
+    brotliPiece(table, false);
+    for (auto i: kj::indices(segments)) {
+      brotliPiece(segments[i].asBytes(), i + 1 == segments.size());
+    }
+  } else {
+    deflatePiece(table, Z_NO_FLUSH);
+    for (auto i: kj::indices(segments)) {
+      deflatePiece(segments[i].asBytes(), i + 1 == segments.size() ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+    }
+
+    auto output = compressBuffer.asPtr().slice(begin, compressBuffer.size());
+    KJ_ASSERT(output.size() >= sizeof(SYNC_FLUSH_MARKER) &&
+              output.slice(output.size() - sizeof(SYNC_FLUSH_MARKER), output.size()) ==
+                  kj::arrayPtr(SYNC_FLUSH_MARKER),
+              "zlib did not end the message with a sync flush marker");
+    compressBuffer.resize(compressBuffer.size() - sizeof(SYNC_FLUSH_MARKER));
+  }
+
+  stats.compressNanos += nanosSince(start);
+}
+
+void DeflateMessageStream::deflatePiece(kj::ArrayPtr<const byte> input, int flush) {
+  deflater.next_in = const_cast<byte*>(input.begin());
+  deflater.avail_in = input.size();
+
+  for (;;) {
+    size_t used = compressBuffer.size();
+    size_t spare = kj::max(deflateBound(&deflater, deflater.avail_in), size_t(4096));
+    compressBuffer.resize(used + spare);
+
+    deflater.next_out = compressBuffer.begin() + used;
+    deflater.avail_out = spare;
+    int result = deflate(&deflater, flush);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      // Z_BUF_ERROR just means there was nothing to do, e.g. an empty segment.
+      failZlib("deflate compression failed", deflater, result);
+    }
+    compressBuffer.resize(compressBuffer.size() - deflater.avail_out);
+
+    // deflate() only stops early when it runs out of output space.
+    if (deflater.avail_out != 0) break;
+  }
+
+  KJ_DASSERT(deflater.avail_in == 0);
+}
+
+void DeflateMessageStream::brotliPiece(kj::ArrayPtr<const byte> input, bool flush) {
+#if KJ_HAS_BROTLI
+  auto op = flush ? BROTLI_OPERATION_FLUSH : BROTLI_OPERATION_PROCESS;
+  const uint8_t* nextIn = input.begin();
+  size_t availIn = input.size();
+
+  // Unlike deflate(), the encoder can hold output back even when it has room, so keep calling it
+  // until it has consumed everything and has nothing more to emit.
+  do {
+    size_t used = compressBuffer.size();
+    size_t spare = kj::max(BrotliEncoderMaxCompressedSize(availIn), size_t(4096));
+    compressBuffer.resize(used + spare);
+
+    uint8_t* nextOut = compressBuffer.begin() + used;
+    size_t availOut = spare;
+    KJ_ASSERT(BrotliEncoderCompressStream(brotliEncoder, op, &availIn, &nextIn,
+                                          &availOut, &nextOut, nullptr),
+        "brotli compression failed");
+    compressBuffer.resize(compressBuffer.size() - availOut);
+  } while (availIn > 0 || BrotliEncoderHasMoreOutput(brotliEncoder));
+#else
+  KJ_UNREACHABLE;
+#endif
+}
+
+// =======================================================================================
+// Reading
+
+kj::Promise<kj::Maybe<MessageReaderAndFds>> DeflateMessageStream::tryReadMessage(
+    kj::ArrayPtr<kj::OwnFd> fdSpace,
+    ReaderOptions readerOptions, kj::ArrayPtr<word> scratchSpace) {
+  if (negotiated) {
+    return readFrame(readerOptions, scratchSpace);
+  } else {
+    return negotiation.addBranch().then([this, readerOptions, scratchSpace]() mutable {
+      return readFrame(readerOptions, scratchSpace);
+    });
+  }
+}
+
+kj::Promise<kj::Maybe<MessageReaderAndFds>> DeflateMessageStream::readFrame(
+    ReaderOptions readerOptions, kj::ArrayPtr<word> scratchSpace) {
+  if (peerDisconnected) {
+    return kj::Maybe<MessageReaderAndFds>(kj::none);
+  }
+
+  return stream.tryRead(frameHeader, sizeof(frameHeader), sizeof(frameHeader))
+      .then([this, readerOptions, scratchSpace](size_t n) mutable
+          -> kj::Promise<kj::Maybe<MessageReaderAndFds>> {
+    if (n == 0) {
+      return kj::Maybe<MessageReaderAndFds>(kj::none);
+    }
+    KJ_REQUIRE(n == sizeof(frameHeader), "premature EOF in DeflateMessageStream frame header");
+
+    uint32_t wireSize = frameHeader[0].get();
+    uint32_t rawSize = frameHeader[1].get();
+    bool isCompressed = wireSize & FRAME_COMPRESSED;
+    wireSize &= ~FRAME_COMPRESSED;
+
+    KJ_REQUIRE(rawSize >= sizeof(word) && rawSize % sizeof(word) == 0,
+        "DeflateMessageStream frame has invalid size", rawSize);
+    KJ_REQUIRE(rawSize / sizeof(word) <= readerOptions.traversalLimitInWords,
+        "Message is too large.  To increase the limit on the receiving end, see "
+        "capnp::ReaderOptions.", rawSize);
+
+    // The message is decompressed (or read) straight into the caller's scratch space if it fits.
+    kj::Array<word> ownWords;
+    kj::ArrayPtr<word> words;
+    if (scratchSpace.size() >= rawSize / sizeof(word)) {
+      words = scratchSpace.first(rawSize / sizeof(word));
+    } else {
+      ownWords = kj::heapArray<word>(rawSize / sizeof(word));
+      words = ownWords;
+    }
+    kj::Promise<void> payload = nullptr;
+
+    if (isCompressed) {
+      KJ_REQUIRE(compressing, "peer sent a compressed frame, but compression was not negotiated");
+      // Neither codec expands incompressible input by more than a few bytes per 16k block.
+      KJ_REQUIRE(wireSize <= rawSize + rawSize / 1024 + 64,
+          "DeflateMessageStream frame has invalid size", wireSize, rawSize);
+
+      // Deflate needs room after the payload to put back the sync flush marker.
+      decompressBuffer.resize(
+          wireSize + (codec == Codec::DEFLATE ? sizeof(SYNC_FLUSH_MARKER) : 0));
+      payload = stream.read(decompressBuffer.asPtr().first(wireSize), wireSize)
+          .then([this, output = words.asBytes()](size_t) mutable {
+        decompress(output);
+      });
+    } else {
+      KJ_REQUIRE(wireSize == rawSize, "DeflateMessageStream frame has invalid size",
+          wireSize, rawSize);
+      payload = stream.read(words.asBytes(), rawSize).ignoreResult();
+    }
+
+    return payload.then([words, ownWords = kj::mv(ownWords), readerOptions]() mutable
+        -> kj::Maybe<MessageReaderAndFds> {
+      kj::Own<MessageReader> reader =
+          kj::heap<FlatArrayMessageReader>(words, readerOptions).attach(kj::mv(ownWords));
+      return MessageReaderAndFds { kj::mv(reader), nullptr };
+    });
+  });
+}
+
+void DeflateMessageStream::decompress(kj::ArrayPtr<byte> output) {
+  auto start = kj::systemPreciseMonotonicClock().now();
+
+  if (codec == Codec::BROTLI) {
+    decompressBrotli(output);
+  } else {
+    decompressDeflate(output);
+  }
+
+  stats.decompressNanos += nanosSince(start);
+}
+
+void DeflateMessageStream::decompressDeflate(kj::ArrayPtr<byte> output) {
+  auto input = decompressBuffer.asPtr();
+  input.slice(input.size() - sizeof(SYNC_FLUSH_MARKER), input.size())
+       .copyFrom(kj::arrayPtr(SYNC_FLUSH_MARKER));
+
+  inflater.next_in = input.begin();
+  inflater.avail_in = input.size();
+  inflater.next_out = output.begin();
+  inflater.avail_out = output.size();
+
+  // Z_STREAM_END is an error too: the peer must never finish the stream.
+  int result = inflate(&inflater, Z_SYNC_FLUSH);
+  if (result != Z_OK && result != Z_BUF_ERROR) {
+    failZlib("deflate decompression failed", inflater, result);
+  }
+  KJ_REQUIRE(inflater.avail_out == 0,
+      "compressed message is smaller than its frame header claims");
+
+  if (inflater.avail_in > 0) {
+    // The output is full. What's left should be just the sync flush marker, which produces no
+    // output, but inflate() may have stopped before consuming it.
+    byte extra;
+    inflater.next_out = &extra;
+    inflater.avail_out = 1;
+    result = inflate(&inflater, Z_SYNC_FLUSH);
+    if (result != Z_OK && result != Z_BUF_ERROR) {
+      failZlib("deflate decompression failed", inflater, result);
+    }
+    KJ_REQUIRE(inflater.avail_out == 1 && inflater.avail_in == 0,
+        "compressed message is larger than its frame header claims");
+  }
+}
+
+void DeflateMessageStream::decompressBrotli(kj::ArrayPtr<byte> output) {
+#if KJ_HAS_BROTLI
+  const uint8_t* nextIn = decompressBuffer.begin();
+  size_t availIn = decompressBuffer.size();
+  uint8_t* nextOut = output.begin();
+  size_t availOut = output.size();
+
+  auto result = BrotliDecoderDecompressStream(brotliDecoder, &availIn, &nextIn,
+                                              &availOut, &nextOut, nullptr);
+  if (result == BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT) {
+    // As with inflate(), the output is full, but the decoder may have stopped before consuming
+    // the empty metadata block that ends a flush.
+    byte extra;
+    uint8_t* extraOut = &extra;
+    size_t extraAvail = 1;
+    result = BrotliDecoderDecompressStream(brotliDecoder, &availIn, &nextIn,
+                                           &extraAvail, &extraOut, nullptr);
+    KJ_REQUIRE(extraAvail == 1, "compressed message is larger than its frame header claims");
+  }
+
+  // BROTLI_DECODER_RESULT_SUCCESS is an error too: the peer must never finish the stream.
+  KJ_REQUIRE(result != BROTLI_DECODER_RESULT_ERROR, "brotli decompression failed",
+      BrotliDecoderErrorString(BrotliDecoderGetErrorCode(brotliDecoder)));
+  KJ_REQUIRE(result == BROTLI_DECODER_RESULT_NEEDS_MORE_INPUT,
+      "brotli stream ended unexpectedly", (int)result);
+  KJ_REQUIRE(availOut == 0, "compressed message is smaller than its frame header claims");
+#else
+  KJ_UNREACHABLE;
+#endif
+}
+
+// =======================================================================================
+
+kj::Maybe<int> DeflateMessageStream::getSendBufferSize() {
+  // The socket's send buffer holds compressed bytes, so its size says little about how many
+  // bytes of messages are in flight. Let the RPC system use its default window.
+  return kj::none;
+}
+
+kj::Promise<void> DeflateMessageStream::end() {
+  if (negotiated) {
+    stream.shutdownWrite();
+    return kj::READY_NOW;
+  } else {
+    return negotiation.addBranch().then([this]() { stream.shutdownWrite(); });
+  }
+}
+
+}  // namespace capnp
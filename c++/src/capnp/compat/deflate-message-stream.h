@@ -0,0 +1,199 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <capnp/serialize-async.h>
+#include <capnp/endian.h>
+#include <kj/async-io.h>
+#include <kj/vector.h>
+#include <zlib.h>
+
+CAPNP_BEGIN_HEADER
+
+struct BrotliEncoderStateStruct;
+struct BrotliEncoderPreparedDictionaryStruct;
+struct BrotliDecoderStateStruct;
+// From <brotli/encode.h> and <brotli/decode.h>, which only the implementation includes, and only
+// when built with KJ_HAS_BROTLI.
+
+namespace capnp {
+
+class DeflateMessageStream final: public MessageStream {
+  // A MessageStream that wraps an AsyncIoStream and compresses messages with raw deflate
+  // (RFC 1951) or, if both sides ask for it, brotli (RFC 7932). Intended for RPC connections whose
+  // traffic is highly repetitive, e.g. between datacenters:
+  //
+  //     DeflateMessageStream stream(connection, { .dictionary = sharedDictionary });
+  //     TwoPartyVatNetwork network(stream, rpc::twoparty::Side::CLIENT);
+  //
+  // Deflate is the codec every DeflateMessageStream speaks, hence the name: zlib is always
+  // available, while brotli is an optional dependency (see Codec::BROTLI). Brotli is an upgrade
+  // that the two sides negotiate on top, using the same framing, hello, and dictionary handling,
+  // so it doesn't warrant a separate class. Prefer it where both ends are built with it and
+  // bandwidth matters more than CPU; stick with the default deflate otherwise.
+  //
+  // Both ends must use a DeflateMessageStream. When the stream is created, each side sends a
+  // short hello declaring whether it is willing to compress, which codec it would like, and which
+  // dictionary (if any) it holds. Compression is enabled only if both sides offer it, brotli is
+  // used only if both sides ask for it, and the dictionary is used only if both sides hold the
+  // same one. Otherwise messages are compressed with deflate, or sent uncompressed, framed the
+  // same way.
+  // Writes wait for the peer's hello, so the first message on a connection is delayed by up to
+  // half a round trip.
+  //
+  // Each direction uses a single compression context for the life of the connection, flushed (but
+  // not reset) at the end of every message, so later messages can refer back to earlier ones. This
+  // is the same "context takeover" scheme used by permessage-deflate WebSockets, and matters a lot
+  // for RPC: small calls to the same method mostly repeat the previous call's structure.
+  //
+  // Messages smaller than `Options::minCompressSize` are sent uncompressed. Once a message has
+  // been fed to the compressor it must be sent compressed (the peer's decompressor has to see the
+  // same stream), even if that turns out larger than the original.
+  //
+  // FD passing is not supported. Like AsyncIoMessageStream, only one write may be in flight at a
+  // time; TwoPartyVatNetwork already guarantees this.
+
+public:
+  enum class Codec: uint8_t {
+    DEFLATE = 0,
+    BROTLI = 1,
+    // Only available when built with brotli (KJ_HAS_BROTLI), which currently means Bazel. Brotli
+    // generally trades more CPU for a better ratio than deflate.
+  };
+
+  struct Options {
+    bool enableCompression = true;
+    // Whether this side offers to compress. Set false to interoperate with a peer that uses a
+    // DeflateMessageStream without paying the CPU cost.
+
+    Codec codec = Codec::DEFLATE;
+    // The codec this side would like to use. Brotli is used only if the peer asks for it too;
+    // otherwise both sides fall back to deflate, which every DeflateMessageStream supports.
+
+    int compressionLevel = Z_DEFAULT_COMPRESSION;
+    // Passed to deflateInit2(), or used as the brotli quality (0-11), where
+    // Z_DEFAULT_COMPRESSION selects quality 5. Lower levels trade ratio for CPU; see
+    // benchmark/capnproto-compression.c++ for numbers on representative traffic.
+
+    size_t minCompressSize = 256;
+    // Messages whose serialized size is below this many bytes are sent uncompressed.
+
+    kj::ArrayPtr<const byte> dictionary;
+    // Pre-shared dictionary for either codec, e.g. a few representative serialized messages
+    // concatenated. Must remain valid for the lifetime of the stream. Peers agree on a dictionary
+    // by comparing a hash of its content, so a mismatched dictionary silently falls back to none.
+  };
+
+  struct Stats {
+    uint64_t messagesSent = 0;
+    uint64_t messagesCompressed = 0;
+    // Number of messages written, and how many of those were compressed.
+
+    uint64_t bytesBeforeCompression = 0;
+    uint64_t bytesAfterCompression = 0;
+    // Serialized size of all messages written, and the number of bytes actually written to the
+    // underlying stream for them, including framing.
+
+    uint64_t compressNanos = 0;
+    uint64_t decompressNanos = 0;
+    // Time spent inside zlib or brotli.
+  };
+
+  explicit DeflateMessageStream(kj::AsyncIoStream& stream);
+  DeflateMessageStream(kj::AsyncIoStream& stream, Options options);
+  ~DeflateMessageStream() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(DeflateMessageStream);
+
+  kj::Promise<bool> isCompressing();
+  // Resolves once the hello exchange completes, indicating whether messages will be compressed.
+
+  Codec getCodec() const { return codec; }
+  // The codec negotiated by the hello. Only meaningful once isCompressing() has resolved to true.
+
+  const Stats& getStats() const { return stats; }
+
+  // Implements MessageStream
+  kj::Promise<kj::Maybe<MessageReaderAndFds>> tryReadMessage(
+      kj::ArrayPtr<kj::OwnFd> fdSpace,
+      ReaderOptions options = ReaderOptions(), kj::ArrayPtr<word> scratchSpace = nullptr) override;
+  kj::Promise<void> writeMessage(
+      kj::ArrayPtr<const int> fds,
+      kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) override
+    KJ_WARN_UNUSED_RESULT;
+  kj::Promise<void> writeMessages(
+      kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) override
+    KJ_WARN_UNUSED_RESULT;
+  kj::Maybe<int> getSendBufferSize() override;
+  kj::Promise<void> end() override;
+
+  // Make sure the overridden virtual methods don't hide the non-virtual methods.
+  using MessageStream::tryReadMessage;
+  using MessageStream::writeMessage;
+  using MessageStream::writeMessages;
+
+private:
+  kj::AsyncIoStream& stream;
+  Options options;
+  Stats stats;
+
+  bool negotiated = false;
+  bool compressing = false;
+  bool peerDisconnected = false;
+  Codec codec = Codec::DEFLATE;
+
+  z_stream deflater = {};
+  z_stream inflater = {};
+
+  BrotliEncoderStateStruct* brotliEncoder = nullptr;
+  BrotliEncoderPreparedDictionaryStruct* brotliDictionary = nullptr;
+  BrotliDecoderStateStruct* brotliDecoder = nullptr;
+  // Only used if `codec` is BROTLI.
+
+  _::WireValue<uint32_t> localHello[4];
+  _::WireValue<uint32_t> peerHello[4];
+  _::WireValue<uint32_t> frameHeader[2];
+  kj::Vector<byte> compressBuffer;
+  kj::Vector<byte> decompressBuffer;
+
+  kj::ForkedPromise<void> negotiation;
+  // Declared last: it refers to the buffers above.
+
+  kj::Promise<void> negotiate();
+  void initContexts(bool useDictionary);
+
+  kj::Promise<void> writeFrames(
+      kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages);
+  void compress(kj::ArrayPtr<const byte> table,
+                kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+  void deflatePiece(kj::ArrayPtr<const byte> input, int flush);
+  void brotliPiece(kj::ArrayPtr<const byte> input, bool flush);
+
+  kj::Promise<kj::Maybe<MessageReaderAndFds>> readFrame(ReaderOptions options,
+                                                        kj::ArrayPtr<word> scratchSpace);
+  void decompress(kj::ArrayPtr<byte> output);
+  void decompressDeflate(kj::ArrayPtr<byte> output);
+  void decompressBrotli(kj::ArrayPtr<byte> output);
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
@@ -50,6 +50,7 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <capnp/serialize.h>
+#include <capnp/serialize-log.h>
 #include <capnp/serialize-packed.h>
 #include <capnp/serialize-text.h>
 #include <capnp/compat/json.h>
@@ -108,7 +109,9 @@ public:
              .addSubCommand("encode", KJ_BIND_METHOD(*this, getEncodeMain),
                             "DEPRECATED (use `convert`)")
              .addSubCommand("eval", KJ_BIND_METHOD(*this, getEvalMain),
-                            "Evaluate a const from a schema file.");
+                            "Evaluate a const from a schema file.")
+             .addSubCommand("log", KJ_BIND_METHOD(*this, getLogMain),
+                            "Index a log of messages and extract messages by number.");
       addGlobalOptions(builder);
       return builder.build();
     }
@@ -295,6 +298,49 @@ public:
     return builder.build();
   }
 
+  kj::MainFunc getLogMain() {
+    // Only parse the schemas we actually need for decoding.
+    compileEagerness = Compiler::NODE;
+
+    // Drop annotations since we don't need them.  This avoids importing files like c++.capnp.
+    annotationFlag = Compiler::DROP_ANNOTATIONS;
+
+    kj::MainBuilder builder(context, VERSION_STRING,
+          "Indexes <log-file>, a file containing a sequence of messages in standard binary "
+          "format (as written by calling capnp::writeMessage() repeatedly), and writes the "
+          "messages selected with --seek to stdout.  Messages are numbered from zero.  Without "
+          "--seek or --check, prints the number of complete messages in the log.  For example:\n"
+          "    capnp log --index=events.idx --seek=1000000 events.log schema.capnp Event\n"
+          "The <schema-file> and <type> are needed only for text or JSON output.",
+
+          "Building the index requires reading the segment table of every message, so for "
+          "large logs, use --index to keep it in a sidecar file.  The index file is updated "
+          "each time the command runs, at which point only messages appended since the last "
+          "run are scanned.");
+    addGlobalOptions(builder);
+    builder.addOptionWithArg({"index"}, KJ_BIND_METHOD(*this, setLogIndex), "<file>",
+                      "Load the index from <file> if it exists, then save the updated index back "
+                      "to it.")
+           .addOptionWithArg({'s', "seek"}, KJ_BIND_METHOD(*this, addLogSeek), "<n>",
+                      "Write message number <n> to stdout.  May be repeated.")
+           .addOptionWithArg({'o', "output"}, KJ_BIND_METHOD(*this, setEvalOutputFormat),
+                      "<format>", "Encode the output in the given format. See `capnp help convert` "
+                      "for a list of formats. Defaults to \"binary\", which copies the message "
+                      "exactly as it appears in the log.")
+           .addOption({"short"}, KJ_BIND_METHOD(*this, printShort),
+                      "If output format is text or JSON, write in short (non-pretty) format.")
+           .addOption({"check"}, KJ_BIND_METHOD(*this, setLogCheck),
+                      "Read every message in the log in full, reporting the first one which is "
+                      "malformed.")
+           .addOptionWithArg({'j', "threads"}, KJ_BIND_METHOD(*this, setLogThreads), "<n>",
+                      "Use <n> threads for --check.  Defaults to 1.")
+           .expectArg("<log-file>", KJ_BIND_METHOD(*this, setLogFile))
+           .expectOptionalArg("<schema-file>", KJ_BIND_METHOD(*this, addSource))
+           .expectOptionalArg("<type>", KJ_BIND_METHOD(*this, setRootType))
+           .callAfterParsing(KJ_BIND_METHOD(*this, readLog));
+    return builder.build();
+  }
+
   void addGlobalOptions(kj::MainBuilder& builder) {
     builder.addOptionWithArg({'I', "import-path"}, KJ_BIND_METHOD(*this, addImportPath), "<dir>",
                              "Add <dir> to the list of directories searched for non-relative "
@@ -1822,6 +1868,96 @@ public:
     KJ_CLANG_KNOWS_THIS_IS_UNREACHABLE_BUT_GCC_DOESNT;
   }
 
+public:
+  // -----------------------------------------------------------------
+
+  kj::MainBuilder::Validity setLogFile(kj::StringPtr file) {
+    logFile = kj::str(file);
+    return true;
+  }
+
+  kj::MainBuilder::Validity setLogIndex(kj::StringPtr file) {
+    logIndexFile = kj::str(file);
+    return true;
+  }
+
+  kj::MainBuilder::Validity addLogSeek(kj::StringPtr n) {
+    KJ_IF_SOME(i, n.tryParseAs<uint64_t>()) {
+      logSeeks.add(i);
+      return true;
+    } else {
+      return "not an integer";
+    }
+  }
+
+  kj::MainBuilder::Validity setLogCheck() {
+    logCheck = true;
+    return true;
+  }
+
+  kj::MainBuilder::Validity setLogThreads(kj::StringPtr n) {
+    KJ_IF_SOME(i, n.tryParseAs<uint>()) {
+      if (i == 0) return "must be at least 1";
+      logThreads = i;
+      return true;
+    } else {
+      return "not an integer";
+    }
+  }
+
+  kj::MainBuilder::Validity readLog() {
+    {
+      auto result = verifyRequirements(convertTo);
+      if (result.getError() != kj::none) return result;
+    }
+
+    // Since this is a debug tool, lift the usual security limits.  Worse case is the process
+    // crashes or has to be killed.
+    ReaderOptions options;
+    options.nestingLimit = kj::maxValue;
+    options.traversalLimitInWords = kj::maxValue;
+
+    auto cwd = disk->getCurrentPath();
+    auto file = disk->getRoot().openFile(cwd.evalNative(logFile));
+
+    kj::Own<MappedMessageLog> log;
+    KJ_IF_SOME(indexFile, logIndexFile) {
+      auto index = disk->getRoot().openFile(cwd.evalNative(indexFile),
+                                            kj::WriteMode::CREATE | kj::WriteMode::MODIFY);
+      log = kj::heap<MappedMessageLog>(*file, *index, options);
+      log->writeIndex(*index);
+    } else {
+      log = kj::heap<MappedMessageLog>(*file, options);
+    }
+
+    if (logCheck) {
+      log->forEach(logThreads, [](size_t index, MessageReader& message) {
+        KJ_CONTEXT("malformed message in log", index);
+        message.getRoot<AnyPointer>().targetSize();
+      });
+    }
+
+    kj::FdOutputStream output(STDOUT_FILENO);
+    for (auto i: logSeeks) {
+      if (i >= log->size()) {
+        return kj::str("no message ", i, "; the log contains ", log->size(), " messages");
+      }
+
+      if (convertTo == Format::BINARY) {
+        output.write(log->getWords(i).asBytes());
+      } else {
+        writeConversion(log->get(i)->getRoot<AnyStruct>(), output);
+      }
+    }
+
+    if (logSeeks.size() == 0 && !logCheck) {
+      context.exitInfo(kj::str(log->size()));
+    } else {
+      context.exit();
+    }
+    KJ_CLANG_KNOWS_THIS_IS_UNREACHABLE_BUT_GCC_DOESNT;
+  }
+
 public:
   // =====================================================================================
 
@@ -1900,6 +2036,13 @@ private:
   StructSchema rootType;
   // For the "decode" and "encode" commands.
 
+  kj::String logFile;
+  kj::Maybe<kj::String> logIndexFile;
+  kj::Vector<uint64_t> logSeeks;
+  bool logCheck = false;
+  uint logThreads = 1;
+  // For the "log" command.
+
   struct SourceFile {
     uint64_t id;
     Compiler::ModuleScope compiled;
@@ -2096,6 +2096,99 @@ KJ_TEST("Copying ListList downgraded from ListStruct does not get corrupted") {
   // out-of-bounds 0xbb bytes from `data` above, which should be impossible.
 }
 
+KJ_TEST("List::Reader::prevalidate()") {
+  MallocMessageBuilder builder(1u << 16);
+  auto list = builder.initRoot<TestAllTypes>().initStructList(100);
+  for (uint i = 0; i < list.size(); i++) {
+    list[i].setInt32Field(int32_t(i));
+    list[i].setTextField(kj::str("element ", i));
+    list[i].initStructField().setUInt8Field(i);
+  }
+  ASSERT_EQ(builder.getSegmentsForOutput().size(), 1);
+
+  SegmentArrayMessageReader reader(builder.getSegmentsForOutput());
+  auto prevalidated = reader.getRoot<TestAllTypes>().getStructList().prevalidate();
+  ASSERT_EQ(prevalidated.size(), 100);
+  for (uint i = 0; i < prevalidated.size(); i++) {
+    KJ_EXPECT(prevalidated[i].getInt32Field() == int32_t(i));
+    KJ_EXPECT(prevalidated[i].getTextField() == kj::str("element ", i));
+    KJ_EXPECT(prevalidated[i].getStructField().getUInt8Field() == uint8_t(i));
+  }
+
+  // Messages with far pointers fall back to the regular checks, which still work.
+  MallocMessageBuilder multiSegment(1, AllocationStrategy::FIXED_SIZE);
+  multiSegment.setRoot(builder.getRoot<TestAllTypes>().asReader());
+  ASSERT_GT(multiSegment.getSegmentsForOutput().size(), 1);
+
+  SegmentArrayMessageReader reader2(multiSegment.getSegmentsForOutput());
+  auto fallback = reader2.getRoot<TestAllTypes>().getStructList().prevalidate();
+  for (uint i = 0; i < fallback.size(); i++) {
+    KJ_EXPECT(fallback[i].getTextField() == kj::str("element ", i));
+  }
+}
+
+KJ_TEST("List::Reader::prevalidate() leaves errors to element access") {
+  AlignedData<5> data = {{
+    // struct, 1 pointer
+    0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00,
+
+    // list of 2 pointers
+    0x01, 0x00, 0x00, 0x00, 0x16, 0x00, 0x00, 0x00,
+
+    // list of 2 uint32s, skipping one word
+    0x05, 0x00, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+
+    // list of 2 uint32s, way out of bounds
+    0x91, 0x01, 0x00, 0x00, 0x14, 0x00, 0x00, 0x00,
+
+    // content of the first list
+    0x01, 0x00, 0x00, 0x00, 0x02, 0x00, 0x00, 0x00,
+  }};
+
+  kj::ArrayPtr<const word> segments[1] = { kj::arrayPtr(data.words, 5) };
+  SegmentArrayMessageReader reader(kj::arrayPtr(segments, 1));
+  auto listList = reader.getRoot<test::TestAnyPointer>().getAnyPointerField()
+      .getAs<List<List<uint32_t>>>().prevalidate();
+
+  ASSERT_EQ(listList.size(), 2);
+  checkList(listList[0], {1u, 2u});
+  EXPECT_NONFATAL_FAILURE(listList[1]);
+}
+
+KJ_TEST("List::Reader::prevalidate() charges the read limit as it goes") {
+  // A chain of lists of two pointers, each pointing twice at the next list in the chain. The
+  // message is a few words per list, but walking everything reachable from the first list visits
+  // 2^DEPTH lists, so prevalidate() must give up when it reaches the read limit rather than only
+  // checking the limit at the end.
+  constexpr uint DEPTH = 40;
+  auto words = kj::heapArray<word>(2 + DEPTH * 2 + 2);
+  auto bytes = words.asBytes();
+  auto setPointer = [&](uint index, uint32_t offsetAndKind, uint32_t sizeAndCount) {
+    for (uint i = 0; i < 4; i++) {
+      bytes[index * 8 + i] = offsetAndKind >> (i * 8);
+      bytes[index * 8 + 4 + i] = sizeAndCount >> (i * 8);
+    }
+  };
+
+  setPointer(0, 0x00000000, 0x00010000);   // root: struct, 1 pointer
+  setPointer(1, 0x00000001, 0x00000016);   // list of 2 pointers, right after
+  for (uint i = 0; i < DEPTH; i++) {
+    setPointer(2 + i * 2, 0x00000005, 0x00000016);  // list of 2 pointers, skipping one word
+    setPointer(3 + i * 2, 0x00000001, 0x00000016);  // the same list
+  }
+  setPointer(2 + DEPTH * 2, 0x00000001, 0x00000000);  // empty list of void
+  setPointer(3 + DEPTH * 2, 0x00000001, 0x00000000);  // empty list of void
+
+  ReaderOptions options;
+  options.traversalLimitInWords = 1024;
+  kj::ArrayPtr<const word> segments[1] = { words };
+  SegmentArrayMessageReader reader(kj::arrayPtr(segments, 1), options);
+  auto list = reader.getRoot<test::TestAnyPointer>().getAnyPointerField()
+      .getAs<List<List<uint32_t>>>();
+
+  KJ_EXPECT_THROW_MESSAGE("Exceeded message traversal limit", list.prevalidate());
+}
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
@@ -930,6 +930,135 @@ struct WireHelpers {
     return result;
   }
 
+  // -----------------------------------------------------------------
+  // Batch validation for ListReader::prevalidate().
+
+  static KJ_ALWAYS_INLINE(bool prevalidateBounds(
+      SegmentReader* segment, const word* start, uint64_t size)) {
+    // Like boundsCheck(), but doesn't touch the read limiter.  `start` must come from
+    // WirePointer::target(segment), which guarantees it's within [begin, end].
+    return size <= uint64_t(segment->getArray().end() - start);
+  }
+
+  static KJ_ALWAYS_INLINE(bool prevalidateCharge(
+      SegmentReader* segment, uint64_t size, uint64_t& words)) {
+    // Charge `size` words to the read limiter as the traversal visits each object, the same way
+    // boundsCheck() does, so that a message whose pointers alias the same objects can't make the
+    // traversal do more work than the limit allows.  `words` accumulates the total charged so
+    // far, for ListReader::prevalidate() to give back if it ends up falling back to the regular
+    // path.  `size` is always small enough for a WordCount: it's bounded by an element count.
+    if (!segment->amplifiedRead(bounded(static_cast<uint>(size)) * WORDS)) return false;
+    words += size;
+    return true;
+  }
+
+  static bool prevalidate(SegmentReader* segment, const WirePointer* ref, int nestingLimit,
+                          uint64_t& words) {
+    // Check that the object `ref` points at, and everything it points at in turn, lies within
+    // `segment`, charging its size (plus any amplification the readers would charge for) to the
+    // read limiter via prevalidateCharge().  Returns false if anything would need the regular
+    // checked path, or if the read limit is reached.  This mirrors totalSize() and the
+    // read*Pointer() functions.
+    //
+    // Not always-inline because it's recursive.
+
+    if (ref->isNull()) return true;
+    if (nestingLimit <= 0) return false;
+    --nestingLimit;
+
+    const word* ptr = ref->target(segment);
+
+    switch (ref->kind()) {
+      case WirePointer::STRUCT: {
+        uint dataWords = unbound(ref->structRef.dataSize.get() / WORDS);
+        uint pointerCount = unbound(ref->structRef.ptrCount.get() / POINTERS);
+        if (!prevalidateBounds(segment, ptr, dataWords + pointerCount)) return false;
+        if (!prevalidateCharge(segment, dataWords + pointerCount, words)) return false;
+
+        const WirePointer* pointers = reinterpret_cast<const WirePointer*>(ptr + dataWords);
+        for (uint i = 0; i < pointerCount; i++) {
+          if (!prevalidate(segment, pointers + i, nestingLimit, words)) return false;
+        }
+        return true;
+      }
+
+      case WirePointer::LIST: {
+        uint64_t count = unbound(ref->listRef.elementCount() / ELEMENTS);
+        switch (ref->listRef.elementSize()) {
+          case ElementSize::VOID:
+            // Readers charge for void lists as if each element were a word.
+            return prevalidateCharge(segment, count, words);
+
+          case ElementSize::BIT:
+          case ElementSize::BYTE:
+          case ElementSize::TWO_BYTES:
+          case ElementSize::FOUR_BYTES:
+          case ElementSize::EIGHT_BYTES: {
+            uint64_t wordCount = unbound(roundBitsUpToWords(
+                upgradeBound<uint64_t>(ref->listRef.elementCount()) *
+                dataBitsPerElement(ref->listRef.elementSize())) / WORDS);
+            if (!prevalidateBounds(segment, ptr, wordCount)) return false;
+            return prevalidateCharge(segment, wordCount, words);
+          }
+
+          case ElementSize::POINTER: {
+            if (!prevalidateBounds(segment, ptr, count)) return false;
+            if (!prevalidateCharge(segment, count, words)) return false;
+
+            const WirePointer* pointers = reinterpret_cast<const WirePointer*>(ptr);
+            for (uint64_t i = 0; i < count; i++) {
+              if (!prevalidate(segment, pointers + i, nestingLimit, words)) return false;
+            }
+            return true;
+          }
+
+          case ElementSize::INLINE_COMPOSITE: {
+            uint64_t wordCount = unbound(ref->listRef.inlineCompositeWordCount() / WORDS);
+            if (!prevalidateBounds(segment, ptr, wordCount + 1)) return false;
+
+            const WirePointer* tag = reinterpret_cast<const WirePointer*>(ptr);
+            if (tag->kind() != WirePointer::STRUCT) return false;
+
+            uint dataWords = unbound(tag->structRef.dataSize.get() / WORDS);
+            uint pointerCount = unbound(tag->structRef.ptrCount.get() / POINTERS);
+            uint64_t elementCount = unbound(tag->inlineCompositeListElementCount() / ELEMENTS);
+            uint64_t wordsPerElement = dataWords + pointerCount;
+            if (elementCount * wordsPerElement > wordCount) return false;
+
+            // Lists of zero-sized structs are charged as if each element were a word.
+            if (!prevalidateCharge(
+                segment, wordCount + 1 + (wordsPerElement == 0 ? elementCount : 0), words)) {
+              return false;
+            }
+
+            if (pointerCount > 0) {
+              const word* element = ptr + 1;
+              for (uint64_t i = 0; i < elementCount; i++) {
+                const WirePointer* pointers =
+                    reinterpret_cast<const WirePointer*>(element + dataWords);
+                for (uint j = 0; j < pointerCount; j++) {
+                  if (!prevalidate(segment, pointers + j, nestingLimit, words)) return false;
+                }
+                element += wordsPerElement;
+              }
+            }
+            return true;
+          }
+        }
+        return false;
+      }
+
+      case WirePointer::FAR:
+        // Unchecked readers don't follow far pointers, so we can't vouch for these.
+        return false;
+
+      case WirePointer::OTHER:
+        return ref->isCapability();
+    }
+
+    return false;
+  }
+
   // -----------------------------------------------------------------
   // Copy from an unchecked message.
 
@@ -1048,6 +1177,137 @@ struct WireHelpers {
     return nullptr;
   }
 
+  // -----------------------------------------------------------------
+  // Compact a built message into a single flat segment.
+
+  static KJ_ALWAYS_INLINE(word* compactAllocate(word*& pos, word* end, uint64_t amount)) {
+    KJ_ASSERT(amount <= uint64_t(end - pos), "compaction buffer too small");
+    word* result = pos;
+    pos += amount;
+    return result;
+  }
+
+  static KJ_ALWAYS_INLINE(void setCompactedPointer(
+      WirePointer* dst, const WirePointer* tag, word* target)) {
+    // `dst` lives in the output buffer, not in a segment, so we can't use setKindAndTarget().
+    dst->offsetAndKind.set(
+        (static_cast<uint32_t>(target - reinterpret_cast<word*>(dst) - 1) << 2) | tag->kind());
+    copyMemory(&dst->upper32Bits, &tag->upper32Bits);
+  }
+
+  static KJ_ALWAYS_INLINE(void compactStruct(
+      SegmentBuilder* segment, word* src, word* dst, uint dataWords, uint pointerCount,
+      word*& pos, word* end)) {
+    memcpy(dst, src, dataWords * sizeof(word));
+
+    WirePointer* srcRefs = reinterpret_cast<WirePointer*>(src + dataWords);
+    WirePointer* dstRefs = reinterpret_cast<WirePointer*>(dst + dataWords);
+    for (uint i = 0; i < pointerCount; i++) {
+      compactPointer(segment, srcRefs + i, dstRefs + i, pos, end);
+    }
+  }
+
+  static void compactPointer(SegmentBuilder* segment, WirePointer* src, WirePointer* dst,
+                             word*& pos, word* end) {
+    // Copy the object `src` points at to `pos`, following far pointers, and point `dst` at the
+    // copy.  Objects are laid out in pre-order, the same as in canonical form.  Unlike
+    // copyMessage(), this reads straight from builder segments without any validation, and
+    // copies capability pointers verbatim so that their cap table indexes remain valid.
+    //
+    // Not always-inline because it's recursive.
+
+    if (src->isNull()) {
+      zeroMemory(dst);
+      return;
+    }
+
+    WirePointer* tag = src;
+    word* srcPtr = followFarsNoWritableCheck(tag, src->target(), segment);
+
+    switch (tag->kind()) {
+      case WirePointer::STRUCT: {
+        uint dataWords = unbound(tag->structRef.dataSize.get() / WORDS);
+        uint pointerCount = unbound(tag->structRef.ptrCount.get() / POINTERS);
+        if (dataWords + pointerCount == 0) {
+          dst->setKindAndTargetForEmptyStruct();
+          copyMemory(&dst->upper32Bits, &tag->upper32Bits);
+          return;
+        }
+
+        word* dstPtr = compactAllocate(pos, end, dataWords + pointerCount);
+        setCompactedPointer(dst, tag, dstPtr);
+        compactStruct(segment, srcPtr, dstPtr, dataWords, pointerCount, pos, end);
+        return;
+      }
+
+      case WirePointer::LIST: {
+        switch (tag->listRef.elementSize()) {
+          case ElementSize::VOID:
+          case ElementSize::BIT:
+          case ElementSize::BYTE:
+          case ElementSize::TWO_BYTES:
+          case ElementSize::FOUR_BYTES:
+          case ElementSize::EIGHT_BYTES: {
+            uint64_t wordCount = unbound(roundBitsUpToWords(
+                upgradeBound<uint64_t>(tag->listRef.elementCount()) *
+                dataBitsPerElement(tag->listRef.elementSize())) / WORDS);
+            word* dstPtr = compactAllocate(pos, end, wordCount);
+            setCompactedPointer(dst, tag, dstPtr);
+            memcpy(dstPtr, srcPtr, wordCount * sizeof(word));
+            return;
+          }
+
+          case ElementSize::POINTER: {
+            uint count = unbound(tag->listRef.elementCount() / ELEMENTS);
+            word* dstPtr = compactAllocate(pos, end, count);
+            setCompactedPointer(dst, tag, dstPtr);
+
+            WirePointer* srcRefs = reinterpret_cast<WirePointer*>(srcPtr);
+            WirePointer* dstRefs = reinterpret_cast<WirePointer*>(dstPtr);
+            for (uint i = 0; i < count; i++) {
+              compactPointer(segment, srcRefs + i, dstRefs + i, pos, end);
+            }
+            return;
+          }
+
+          case ElementSize::INLINE_COMPOSITE: {
+            uint64_t wordCount = unbound(tag->listRef.inlineCompositeWordCount() / WORDS);
+            word* dstPtr = compactAllocate(pos, end, wordCount + 1);
+            setCompactedPointer(dst, tag, dstPtr);
+
+            WirePointer* elementTag = reinterpret_cast<WirePointer*>(srcPtr);
+            copyMemory(reinterpret_cast<WirePointer*>(dstPtr), elementTag);
+
+            uint dataWords = unbound(elementTag->structRef.dataSize.get() / WORDS);
+            uint pointerCount = unbound(elementTag->structRef.ptrCount.get() / POINTERS);
+            uint elementCount = unbound(elementTag->inlineCompositeListElementCount() / ELEMENTS);
+            word* srcElement = srcPtr + 1;
+            word* dstElement = dstPtr + 1;
+            for (uint i = 0; i < elementCount; i++) {
+              compactStruct(segment, srcElement, dstElement, dataWords, pointerCount, pos, end);
+              srcElement += dataWords + pointerCount;
+              dstElement += dataWords + pointerCount;
+            }
+            return;
+          }
+        }
+        break;
+      }
+
+      case WirePointer::OTHER:
+        // Capability pointers don't encode a position, and keeping the index as-is means the
+        // compacted message still refers to the same cap table.
+        KJ_REQUIRE(tag->isCapability(), "Unknown pointer type.");
+        copyMemory(dst, tag);
+        return;
+
+      case WirePointer::FAR:
+        KJ_FAIL_ASSERT("far pointer not followed?");
+    }
+
+    KJ_UNREACHABLE;
+  }
+
   static void transferPointer(SegmentBuilder* dstSegment, WirePointer* dst,
                               SegmentBuilder* srcSegment, WirePointer* src) {
     // Make *dst point to the same object as *src.  Both must reside in the same message, but can
@@ -2701,6 +2961,14 @@ PointerReader PointerBuilder::asReader() const {
   return PointerReader(segment, capTable, pointer, kj::maxValue);
 }
 
+kj::ArrayPtr<word> PointerBuilder::compactInto(kj::ArrayPtr<word> buffer) {
+  KJ_REQUIRE(buffer.size() > 0, "compaction buffer too small");
+  word* pos = buffer.begin() + 1;
+  WireHelpers::compactPointer(segment, pointer, reinterpret_cast<WirePointer*>(buffer.begin()),
+                              pos, buffer.end());
+  return buffer.first(pos - buffer.begin());
+}
+
 BuilderArena* PointerBuilder::getArena() const {
   return segment->getArena();
 }
@@ -3195,6 +3463,39 @@ StructReader ListReader::getStructElement(ElementCount index) const {
       nestingLimit - 1);
 }
 
+ListReader ListReader::prevalidate() const {
+  if (segment == nullptr || structPointerCount == ZERO * POINTERS) {
+    // Already unchecked, or no pointers whose targets would need checking.
+    return *this;
+  }
+  if (nestingLimit <= 1) return *this;
+
+  uint dataBytes = unbound(structDataSize / BITS_PER_BYTE / BYTES);
+  uint pointerCount = unbound(structPointerCount / POINTERS);
+  uint64_t stepBytes = unbound(step * (ONE * ELEMENTS) / BITS_PER_BYTE / BYTES);
+  uint64_t count = unbound(elementCount / ELEMENTS);
+
+  uint64_t words = 0;
+  const byte* element = ptr;
+  for (uint64_t i = 0; i < count; i++) {
+    const WirePointer* pointers = reinterpret_cast<const WirePointer*>(element + dataBytes);
+    for (uint j = 0; j < pointerCount; j++) {
+      // Elements are read with nestingLimit - 1, and their pointers are followed from there.
+      if (!WireHelpers::prevalidate(segment, pointers + j, nestingLimit - 1, words)) {
+        // Leave it to the regular path, which will charge for whatever it reads itself.  If we
+        // hit the read limit, the limiter has already reported it.
+        segment->unread(bounded(words) * WORDS);
+        return *this;
+      }
+    }
+    element += stepBytes;
+  }
+
+  ListReader result = *this;
+  result.segment = nullptr;
+  return result;
+}
+
 MessageSizeCounts ListReader::totalSize() const {
   // TODO(cleanup): This is kind of a lot of logic duplicated from WireHelpers::totalSize(), but
   //   it's unclear how to share it effectively.
@@ -389,6 +389,13 @@ public:
 
   PointerReader asReader() const;
 
+  kj::ArrayPtr<word> compactInto(kj::ArrayPtr<word> buffer);
+  // Copy this pointer to `buffer[0]` and the object it points at into the rest of `buffer`, laid
+  // out contiguously with no far pointers, so that the result is a valid single-segment message.
+  // Capability pointers are copied verbatim, so their indexes still refer to this builder's cap
+  // table.  Returns the prefix of `buffer` that was used.  `buffer` need not be zeroed, but must
+  // be big enough; the total size of the segments containing the object is always enough.
+
   BuilderArena* getArena() const;
   // Get the arena containing this pointer.
 
@@ -786,6 +793,23 @@ public:
   MessageSizeCounts totalSize() const;
   // Like StructReader::totalSize(). Note that for struct lists, the size includes the list tag.
 
+  ListReader prevalidate() const;
+  // Bounds-check every object reachable from the list's elements in one traversal, charging each
+  // to the read limiter as it goes, and return a copy of this reader which treats the list as
+  // an unchecked message, so that reading elements and their children skips per-pointer bounds
+  // checks and read limiter updates.  Structural checks (pointer kinds, element sizes, nesting
+  // limit) still happen on access.
+  //
+  // Anything that the traversal can't vouch for -- far pointers, out-of-bounds or otherwise
+  // malformed pointers, excessive nesting -- makes this return the list unchanged, so that
+  // errors are reported in the usual way if and when the offending element is read.  The same
+  // goes for lists of data, which have no per-element checks to save.  Reaching the read limit
+  // mid-traversal is reported right away, as it would be by the getters, since a message whose
+  // pointers alias one another could otherwise make the traversal take exponential time.
+  //
+  // Note that the limiter is charged for the whole subtree up front, but not again if elements
+  // are read more than once.
+
   CapTableReader* getCapTable();
   // Gets the capability context in which this object is operating.
 
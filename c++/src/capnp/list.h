@@ -223,6 +223,11 @@ struct List<T, Kind::STRUCT> {
       return reader.totalSize().asPublic();
     }
 
+    inline Reader prevalidate() const { return Reader(reader.prevalidate()); }
+    // Bounds-check everything reachable from this list in one pass, charging it to the read
+    // limit up front, and return a reader whose element accessors skip those checks.  Worthwhile
+    // when scanning every element of a large list.  See _::ListReader::prevalidate().
+
   private:
     _::ListReader reader;
     template <typename U, Kind K>
@@ -350,6 +355,9 @@ struct List<List<T>, Kind::LIST> {
       return reader.totalSize().asPublic();
     }
 
+    inline Reader prevalidate() const { return Reader(reader.prevalidate()); }
+    // Same as for List<T, Kind::STRUCT>.
+
   private:
     _::ListReader reader;
     template <typename U, Kind K>
@@ -463,6 +471,9 @@ struct List<T, Kind::BLOB> {
       return reader.totalSize().asPublic();
     }
 
+    inline Reader prevalidate() const { return Reader(reader.prevalidate()); }
+    // Same as for List<T, Kind::STRUCT>.
+
   private:
     _::ListReader reader;
     template <typename U, Kind K>
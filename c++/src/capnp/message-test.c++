@@ -213,6 +213,226 @@ KJ_TEST("MessageBuilder::sizeInWords()") {
   KJ_EXPECT(reader.sizeInWords() == expected);
 }
 
+KJ_TEST("PooledMessageBuilder reuses segments") {
+  SegmentPool pool;
+
+  for (uint i = 0; i < 3; i++) {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>().asReader());
+  }
+
+  auto stats = pool.getStats();
+  KJ_EXPECT(stats.misses == 1, stats.misses);
+  KJ_EXPECT(stats.hits == 2, stats.hits);
+  KJ_EXPECT(stats.bytesRetained == 1024 * sizeof(word), stats.bytesRetained);
+}
+
+KJ_TEST("PooledMessageBuilder segments come back zeroed") {
+  SegmentPool pool;
+
+  {
+    PooledMessageBuilder builder(pool, 0, AllocationStrategy::FIXED_SIZE);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+  }
+
+  // Every small segment the message dirtied must be fully zero when handed out again.
+  KJ_EXPECT(pool.getStats().bytesRetained > 0);
+  kj::Vector<kj::ArrayPtr<word>> reused;
+  for (;;) {
+    auto hitsBefore = pool.getStats().hits;
+    auto segment = pool.allocate(1);
+    reused.add(segment);
+    if (pool.getStats().hits == hitsBefore) break;
+
+    for (auto b: segment.asBytes()) {
+      KJ_ASSERT(b == 0);
+    }
+  }
+  KJ_EXPECT(reused.size() > 1);
+  for (auto segment: reused) {
+    pool.release(segment, 0);
+  }
+
+  {
+    PooledMessageBuilder builder(pool);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    checkTestMessage(builder.getRoot<TestAllTypes>().asReader());
+  }
+}
+
+KJ_TEST("SegmentPool respects its cap") {
+  SegmentPool pool(2048 * sizeof(word));
+
+  auto a = pool.allocate(1024);
+  auto b = pool.allocate(1024);
+  auto c = pool.allocate(1024);
+  KJ_EXPECT(a.size() == 1024);
+  KJ_EXPECT(pool.getStats().misses == 3);
+
+  pool.release(a, 10);
+  pool.release(b, 10);
+  pool.release(c, 10);  // Over the cap, so freed rather than retained.
+  KJ_EXPECT(pool.getStats().bytesRetained == 2048 * sizeof(word));
+
+  pool.setMaxRetainedBytes(0);
+  KJ_EXPECT(pool.getStats().bytesRetained == 0);
+
+  // Requests too large to pool bypass it entirely.
+  auto huge = pool.allocate(4u << 20);
+  KJ_EXPECT(huge.size() == 4u << 20);
+  pool.release(huge, 0);
+  KJ_EXPECT(pool.getStats().bytesRetained == 0);
+}
+
+KJ_TEST("MessageBuilder::compact()") {
+  MallocMessageBuilder builder(1, AllocationStrategy::FIXED_SIZE);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  size_t expected = builder.getRoot<TestAllTypes>().totalSize().wordCount + 1;
+
+  // Leave some garbage behind, which compaction should drop.
+  builder.getRoot<TestAllTypes>().disownTextField();
+  builder.getRoot<TestAllTypes>().setTextField("foo");
+
+  KJ_ASSERT(builder.getSegmentsForOutput().size() > 1);
+  KJ_ASSERT(builder.sizeInWords() > expected);
+
+  auto compacted = builder.compact();
+  KJ_EXPECT(compacted.size() == expected, compacted.size(), expected);
+
+  kj::ArrayPtr<const word> segments[1] = { compacted };
+  SegmentArrayMessageReader reader(segments);
+  checkTestMessage(reader.getRoot<TestAllTypes>());
+  KJ_EXPECT(reader.getRoot<TestAllTypes>().totalSize().wordCount + 1 == compacted.size());
+
+  // The builder itself is untouched.
+  checkTestMessage(builder.getRoot<TestAllTypes>().asReader());
+  KJ_EXPECT(builder.getSegmentsForOutput().size() > 1);
+
+  // compactInto() works on a dirty buffer.
+  auto buffer = kj::heapArray<word>(builder.sizeInWords());
+  buffer.asBytes().fill(0xcc);
+  auto used = builder.compactInto(buffer);
+  KJ_EXPECT(used.asBytes() == compacted.asBytes());
+}
+
+KJ_TEST("MessageBuilder::compact() on an empty builder") {
+  MallocMessageBuilder builder;
+
+  auto compacted = builder.compact();
+  KJ_ASSERT(compacted.size() == 1);
+  kj::ArrayPtr<const word> segments[1] = { compacted };
+  SegmentArrayMessageReader reader(segments);
+  KJ_EXPECT(reader.getRoot<AnyPointer>().isNull());
+
+  // Compacting didn't allocate anything.
+  KJ_EXPECT(builder.getSegmentsForOutput().size() == 0);
+}
+
+KJ_TEST("MessageSizeHint sizes first segments from experience") {
+  MessageSizeHint hint(1);
+  KJ_EXPECT(hint.getFirstSegmentWords() == 1);
+
+  {
+    MallocMessageBuilder builder(hint);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    KJ_EXPECT(builder.getSegmentsForOutput().size() > 1);
+  }
+  KJ_EXPECT(hint.getRecordCount() == 1);
+
+  for (uint i = 0; i < 4; i++) {
+    MallocMessageBuilder builder(hint);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    KJ_EXPECT(builder.getSegmentsForOutput().size() == 1);
+  }
+
+  SegmentPool pool;
+  {
+    PooledMessageBuilder builder(pool, hint);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+    KJ_EXPECT(builder.getSegmentsForOutput().size() == 1);
+  }
+  KJ_EXPECT(hint.getRecordCount() == 6);
+}
+
+KJ_TEST("MessageSizeHint tracks changing sizes") {
+  MessageSizeHint hint;
+
+  for (uint i = 0; i < 100; i++) hint.record(100);
+  uint small = hint.getFirstSegmentWords();
+  KJ_EXPECT(small >= 100 && small < 128, small);
+
+  for (uint i = 0; i < 100; i++) hint.record(5000);
+  uint large = hint.getFirstSegmentWords();
+  KJ_EXPECT(large >= 5000 && large < 6000, large);
+
+  // Sizes that alternate get enough headroom to cover the larger ones.
+  for (uint i = 0; i < 100; i++) hint.record(i % 2 == 0 ? 1000 : 2000);
+  KJ_EXPECT(hint.getFirstSegmentWords() >= 2000, hint.getFirstSegmentWords());
+}
+
+KJ_TEST("HugePageMessageBuilder rounds segments to huge pages") {
+  HugePageOptions options;
+  options.explicitHugePages = true;  // falls back quietly if no pages are reserved
+  options.bindToLocalNode = true;    // likewise if mbind() is unavailable
+  HugePageMessageBuilder builder(options, 1);
+
+  auto root = builder.initRoot<TestAllTypes>();
+  initTestMessage(root);
+
+  // A list big enough to need a second segment.
+  auto list = root.initUInt64List(HugePageMessageBuilder::HUGE_PAGE_WORDS + 1);
+  for (uint i = 0; i < list.size(); i++) {
+    list.set(i, i);
+  }
+
+  auto segments = builder.getSegmentsForOutput();
+  KJ_ASSERT(segments.size() == 2);
+#if __linux__
+  for (auto segment: segments) {
+    KJ_EXPECT(reinterpret_cast<uintptr_t>(segment.begin()) %
+              (HugePageMessageBuilder::HUGE_PAGE_WORDS * sizeof(word)) == 0);
+  }
+#endif
+
+  SegmentArrayMessageReader reader(segments);
+  auto readRoot = reader.getRoot<TestAllTypes>();
+  auto readList = readRoot.getUInt64List();
+  KJ_ASSERT(readList.size() == HugePageMessageBuilder::HUGE_PAGE_WORDS + 1);
+  for (uint i = 0; i < readList.size(); i++) {
+    KJ_ASSERT(readList[i] == i);
+  }
+}
+
+KJ_TEST("HugePageMessageBuilder segment at the size cap") {
+  // A cap that isn't a multiple of HUGE_PAGE_WORDS, like MAX_SEGMENT_WORDS itself, so the last
+  // page of each mapping extends past the end of its segment.
+  constexpr uint CAP = HugePageMessageBuilder::HUGE_PAGE_WORDS + 100;
+  HugePageOptions options;
+  options.maxSegmentWords = CAP;
+  HugePageMessageBuilder builder(options, CAP * 4);
+
+  auto root = builder.initRoot<TestAllTypes>();
+  root.setUInt64Field(123);
+  auto list = root.initUInt64List(CAP);  // too big for what's left of the first segment
+  list.set(CAP - 1, 456);
+
+  auto segments = builder.getSegmentsForOutput();
+  KJ_ASSERT(segments.size() == 2);
+  KJ_EXPECT(segments[0].size() == CAP, segments[0].size());
+  KJ_EXPECT(segments[1].size() == CAP + 1, segments[1].size());  // the list and its landing pad
+#if __linux__
+  for (auto segment: segments) {
+    KJ_EXPECT(reinterpret_cast<uintptr_t>(segment.begin()) %
+              (HugePageMessageBuilder::HUGE_PAGE_WORDS * sizeof(word)) == 0);
+  }
+#endif
+
+  SegmentArrayMessageReader reader(segments);
+  KJ_EXPECT(reader.getRoot<TestAllTypes>().getUInt64Field() == 123);
+  KJ_EXPECT(reader.getRoot<TestAllTypes>().getUInt64List()[CAP - 1] == 456);
+}
+
 // TODO(test):  More tests.
 
 }  // namespace
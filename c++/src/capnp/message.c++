@@ -25,8 +25,15 @@
 #include "arena.h"
 #include "orphan.h"
 #include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 
+#if __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 namespace capnp {
 
 namespace {
@@ -187,6 +194,40 @@ size_t MessageBuilder::sizeInWords() {
   return arena()->sizeInWords();
 }
 
+kj::ArrayPtr<word> MessageBuilder::compactInto(kj::ArrayPtr<word> buffer) {
+  if (!allocatedArena) {
+    // Nothing has been built yet, so the message is just a null root pointer.  Don't allocate
+    // the arena to find that out.
+    KJ_REQUIRE(buffer.size() >= 1, "compactInto() buffer too small");
+    memset(buffer.begin(), 0, sizeof(word));
+    return buffer.first(1);
+  }
+
+  _::SegmentBuilder* rootSegment = getRootSegment();
+  return _::PointerBuilder::getRoot(
+      rootSegment, arena()->getLocalCapTable(), rootSegment->getPtrUnchecked(ZERO * WORDS))
+      .compactInto(buffer);
+}
+
+kj::Array<word> MessageBuilder::compact() {
+  if (!allocatedArena) {
+    auto result = kj::heapArray<word>(1);
+    compactInto(result);
+    return result;
+  }
+
+  // sizeInWords() is an upper bound, loose only by the far pointer landing pads and orphaned
+  // garbage we skip.  Rather than traverse twice to find the exact size, compact into a scratch
+  // buffer of that size and copy out the used prefix if it came up short.
+  auto buffer = kj::heapArray<word>(sizeInWords());
+  auto used = compactInto(buffer);
+  if (used.size() == buffer.size()) {
+    return buffer;
+  } else {
+    return kj::heapArray<word>(used);
+  }
+}
+
 kj::Own<_::CapTableBuilder> MessageBuilder::releaseBuiltinCapTable() {
   return arena()->releaseLocalCapTable();
 }
@@ -209,11 +250,55 @@ kj::ArrayPtr<const word> SegmentArrayMessageReader::getSegment(uint id) {
 
 // -------------------------------------------------------------------
 
+MessageSizeHint::MessageSizeHint(uint initialWords): initialWords(initialWords) {}
+
+uint MessageSizeHint::getFirstSegmentWords() const {
+  if (count == 0) return initialWords;
+
+  // Leave room for two deviations above the mean, plus an eighth of the mean so that a run of
+  // identically-sized messages (zero deviation) doesn't get a segment with no slack at all.
+  uint64_t suggestion = (mean + mean / 8 + 2 * deviation + (1u << FRACTION_BITS) - 1)
+      >> FRACTION_BITS;
+  return kj::max<uint64_t>(1, kj::min(suggestion, uint64_t(unbound(MAX_SEGMENT_WORDS / WORDS))));
+}
+
+void MessageSizeHint::record(size_t messageWords) {
+  // Weight of each new sample in the moving averages is 1 / (1 << WEIGHT_BITS).
+  constexpr uint WEIGHT_BITS = 3;
+
+  uint64_t sample = kj::min(uint64_t(messageWords), uint64_t(unbound(MAX_SEGMENT_WORDS / WORDS)))
+      << FRACTION_BITS;
+
+  if (count++ == 0) {
+    mean = sample;
+    deviation = 0;
+    return;
+  }
+
+  uint64_t diff;
+  if (sample >= mean) {
+    diff = sample - mean;
+    mean += diff >> WEIGHT_BITS;
+  } else {
+    diff = mean - sample;
+    mean -= diff >> WEIGHT_BITS;
+  }
+  deviation = deviation - (deviation >> WEIGHT_BITS) + (diff >> WEIGHT_BITS);
+}
+
+// -------------------------------------------------------------------
+
 MallocMessageBuilder::MallocMessageBuilder(
     uint firstSegmentWords, AllocationStrategy allocationStrategy)
     : nextSize(firstSegmentWords), allocationStrategy(allocationStrategy),
       ownFirstSegment(true), returnedFirstSegment(false), firstSegment(nullptr) {}
 
+MallocMessageBuilder::MallocMessageBuilder(
+    MessageSizeHint& sizeHint, AllocationStrategy allocationStrategy)
+    : nextSize(sizeHint.getFirstSegmentWords()), allocationStrategy(allocationStrategy),
+      sizeHint(sizeHint), ownFirstSegment(true), returnedFirstSegment(false),
+      firstSegment(nullptr) {}
+
 MallocMessageBuilder::MallocMessageBuilder(
     kj::ArrayPtr<word> firstSegment, AllocationStrategy allocationStrategy)
     : nextSize(firstSegment.size()), allocationStrategy(allocationStrategy),
@@ -227,6 +312,10 @@ MallocMessageBuilder::MallocMessageBuilder(
 
 MallocMessageBuilder::~MallocMessageBuilder() noexcept(false) {
   if (returnedFirstSegment) {
+    KJ_IF_SOME(hint, sizeHint) {
+      hint.record(sizeInWords());
+    }
+
     if (ownFirstSegment) {
       free(firstSegment);
     } else {
@@ -291,6 +380,309 @@ kj::ArrayPtr<word> MallocMessageBuilder::allocateSegment(uint minimumSize) {
 
 // -------------------------------------------------------------------
 
+struct SegmentPool::FreeSegment {
+  // Header written over the start of each segment sitting in a free list.
+
+  FreeSegment* next;
+
+  size_t dirtyWords;
+  // Number of words at the start of the segment which must be zeroed before reuse. Always covers
+  // this header.
+};
+
+SegmentPool::SegmentPool(size_t maxRetainedBytes): maxRetainedBytes(maxRetainedBytes) {
+  static_assert(sizeof(FreeSegment) % sizeof(word) == 0 &&
+                sizeof(FreeSegment) < MIN_CLASS_WORDS * sizeof(word),
+                "FreeSegment header must be a whole number of words and fit in every size class");
+}
+
+SegmentPool::~SegmentPool() noexcept(false) {
+  clear();
+}
+
+uint SegmentPool::sizeClassFor(uint words) {
+  // Returns CLASS_COUNT if `words` is too big to pool.
+  uint sizeClass = 0;
+  while (sizeClass < CLASS_COUNT && (MIN_CLASS_WORDS << sizeClass) < words) {
+    ++sizeClass;
+  }
+  return sizeClass;
+}
+
+void SegmentPool::freeClass(uint sizeClass) {
+  FreeSegment* segment = freeLists[sizeClass];
+  freeLists[sizeClass] = nullptr;
+  while (segment != nullptr) {
+    FreeSegment* next = segment->next;
+    free(segment);
+    stats.bytesRetained -= (MIN_CLASS_WORDS << sizeClass) * sizeof(word);
+    segment = next;
+  }
+}
+
+void SegmentPool::clear() {
+  for (uint i = 0; i < CLASS_COUNT; i++) {
+    freeClass(i);
+  }
+}
+
+void SegmentPool::setMaxRetainedBytes(size_t bytes) {
+  maxRetainedBytes = bytes;
+  for (uint i = CLASS_COUNT; i > 0 && stats.bytesRetained > maxRetainedBytes; i--) {
+    freeClass(i - 1);
+  }
+}
+
+kj::ArrayPtr<word> SegmentPool::allocate(uint minimumSize) {
+  uint sizeClass = sizeClassFor(minimumSize);
+  uint size = sizeClass < CLASS_COUNT ? MIN_CLASS_WORDS << sizeClass : minimumSize;
+
+  if (sizeClass < CLASS_COUNT && freeLists[sizeClass] != nullptr) {
+    FreeSegment* segment = freeLists[sizeClass];
+    freeLists[sizeClass] = segment->next;
+    stats.bytesRetained -= size * sizeof(word);
+    ++stats.hits;
+
+    // This is the lazy half of release(): only the part the last message touched needs zeroing.
+    word* result = reinterpret_cast<word*>(segment);
+    memset(result, 0, segment->dirtyWords * sizeof(word));
+    return kj::arrayPtr(result, size);
+  }
+
+  ++stats.misses;
+  word* result = reinterpret_cast<word*>(calloc(size, sizeof(word)));
+  if (result == nullptr) {
+    KJ_FAIL_SYSCALL("calloc(size, sizeof(word))", ENOMEM, size);
+  }
+  return kj::arrayPtr(result, size);
+}
+
+void SegmentPool::release(kj::ArrayPtr<word> segment, size_t wordsUsed) {
+  uint sizeClass = sizeClassFor(segment.size());
+  size_t bytes = segment.size() * sizeof(word);
+
+  if (sizeClass == CLASS_COUNT || (MIN_CLASS_WORDS << sizeClass) != segment.size() ||
+      stats.bytesRetained + bytes > maxRetainedBytes) {
+    free(segment.begin());
+    return;
+  }
+
+  auto freeSegment = reinterpret_cast<FreeSegment*>(segment.begin());
+  freeSegment->next = freeLists[sizeClass];
+  freeSegment->dirtyWords = kj::max(wordsUsed, sizeof(FreeSegment) / sizeof(word));
+  freeLists[sizeClass] = freeSegment;
+  stats.bytesRetained += bytes;
+}
+
+PooledMessageBuilder::PooledMessageBuilder(
+    SegmentPool& pool, uint firstSegmentWords, AllocationStrategy allocationStrategy)
+    : pool(pool), nextSize(firstSegmentWords), allocationStrategy(allocationStrategy) {}
+
+PooledMessageBuilder::PooledMessageBuilder(
+    SegmentPool& pool, MessageSizeHint& sizeHint, AllocationStrategy allocationStrategy)
+    : pool(pool), nextSize(sizeHint.getFirstSegmentWords()),
+      allocationStrategy(allocationStrategy), sizeHint(sizeHint) {}
+
+PooledMessageBuilder::~PooledMessageBuilder() noexcept(false) {
+  if (firstSegment == nullptr) return;
+
+  KJ_IF_SOME(hint, sizeHint) {
+    hint.record(sizeInWords());
+  }
+
+  // The arena lists segments in the order they were allocated, and each one's size there is the
+  // portion the message has written to, i.e. all that needs zeroing when the pool reuses it.
+  kj::ArrayPtr<const kj::ArrayPtr<const word>> used = getSegmentsForOutput();
+  auto wordsUsed = [&](uint i, kj::ArrayPtr<word> segment) -> size_t {
+    if (i < used.size() && used[i].begin() == segment.begin()) {
+      return used[i].size();
+    } else {
+      // Shouldn't happen, but if it does, play it safe and assume the whole segment is dirty.
+      return segment.size();
+    }
+  };
+
+  pool.release(firstSegment, wordsUsed(0, firstSegment));
+  for (uint i = 0; i < moreSegments.size(); i++) {
+    pool.release(moreSegments[i], wordsUsed(i + 1, moreSegments[i]));
+  }
+}
+
+kj::ArrayPtr<word> PooledMessageBuilder::allocateSegment(uint minimumSize) {
+  KJ_REQUIRE(bounded(minimumSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "PooledMessageBuilder asked to allocate segment above maximum serializable size.");
+  KJ_ASSERT(bounded(nextSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "PooledMessageBuilder nextSize out of bounds.");
+
+  // Pooled size classes are far smaller than MAX_SEGMENT_WORDS, and bigger requests are
+  // allocated at exactly the requested size, so the result is always serializable.
+  kj::ArrayPtr<word> result = pool.allocate(kj::max(minimumSize, nextSize));
+  uint size = result.size();
+
+  if (firstSegment == nullptr) {
+    firstSegment = result;
+
+    // After the first segment, we want nextSize to equal the total size allocated so far.
+    if (allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) nextSize = size;
+  } else {
+    moreSegments.add(result);
+    if (allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) {
+      // set nextSize = min(nextSize+size, MAX_SEGMENT_WORDS)
+      // while protecting against possible overflow of (nextSize+size)
+      nextSize = (size <= unbound(MAX_SEGMENT_WORDS / WORDS) - nextSize)
+          ? nextSize + size : unbound(MAX_SEGMENT_WORDS / WORDS);
+    }
+  }
+
+  return result;
+}
+
+// -------------------------------------------------------------------
+
+namespace {
+
+#if __linux__
+
+constexpr size_t HUGE_PAGE_BYTES = HugePageMessageBuilder::HUGE_PAGE_WORDS * sizeof(word);
+
+size_t mappingSize(size_t bytes) {
+  // The segment itself may end mid-page when it's clamped to MAX_SEGMENT_WORDS, but munmap() wants
+  // page-aligned ranges (huge-page-aligned for MAP_HUGETLB), so we always map whole huge pages.
+  return (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+}
+
+void bindToCurrentNode(void* ptr, size_t size) {
+#if defined(SYS_mbind) && defined(SYS_getcpu)
+  constexpr int MPOL_BIND_MODE = 2;  // MPOL_BIND, from <linux/mempolicy.h>
+  constexpr size_t BITS_PER_LONG = sizeof(unsigned long) * 8;
+
+  unsigned cpu, node;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) < 0) return;
+
+  unsigned long nodeMask[4] = {};
+  if (node >= kj::size(nodeMask) * BITS_PER_LONG) return;
+  nodeMask[node / BITS_PER_LONG] |= 1ul << (node % BITS_PER_LONG);
+
+  // The kernel reads one bit fewer than `maxnode` says. If mbind() is unavailable, e.g. because a
+  // seccomp filter blocks it, the memory just keeps the default policy.
+  syscall(SYS_mbind, ptr, size, MPOL_BIND_MODE, nodeMask, kj::size(nodeMask) * BITS_PER_LONG + 1,
+          0);
+#endif
+}
+
+word* mapSegment(size_t segmentBytes, const HugePageOptions& options) {
+  size_t bytes = mappingSize(segmentBytes);
+  void* result = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+  if (options.explicitHugePages) {
+    // Fails immediately if the reserved pool can't cover the whole segment.
+    result = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+  }
+#endif
+
+  if (result == MAP_FAILED) {
+    // Over-allocate by one huge page so that we can trim the mapping to a huge page boundary.
+    // Transparent huge pages can only back aligned 2 MiB ranges.
+    size_t mapBytes = bytes + HUGE_PAGE_BYTES;
+    void* mapping = mmap(nullptr, mapBytes, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+      KJ_FAIL_SYSCALL("mmap(segment)", errno, bytes);
+    }
+
+    byte* begin = reinterpret_cast<byte*>(mapping);
+    byte* aligned = reinterpret_cast<byte*>(
+        (reinterpret_cast<uintptr_t>(begin) + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1));
+    byte* end = begin + mapBytes;
+    if (aligned > begin) {
+      KJ_SYSCALL(munmap(begin, aligned - begin));
+    }
+    if (end > aligned + bytes) {
+      KJ_SYSCALL(munmap(aligned + bytes, end - (aligned + bytes)));
+    }
+    result = aligned;
+
+#ifdef MADV_HUGEPAGE
+    // Fails if transparent huge pages are compiled out of the kernel, in which case we're stuck
+    // with small pages.
+    madvise(result, bytes, MADV_HUGEPAGE);
+#endif
+  }
+
+  if (options.bindToLocalNode) {
+    // Nothing has touched the pages yet, so the policy applies to all of them.
+    bindToCurrentNode(result, bytes);
+  }
+
+  return reinterpret_cast<word*>(result);
+}
+
+void unmapSegment(kj::ArrayPtr<word> segment) {
+  KJ_SYSCALL(munmap(segment.begin(), mappingSize(segment.size() * sizeof(word)))) { break; }
+}
+
+#else  // __linux__
+
+word* mapSegment(size_t bytes, const HugePageOptions&) {
+  word* result = reinterpret_cast<word*>(calloc(bytes, 1));
+  if (result == nullptr) {
+    KJ_FAIL_SYSCALL("calloc(bytes, 1)", ENOMEM, bytes);
+  }
+  return result;
+}
+
+void unmapSegment(kj::ArrayPtr<word> segment) {
+  free(segment.begin());
+}
+
+#endif  // __linux__, else
+
+}  // namespace
+
+HugePageMessageBuilder::HugePageMessageBuilder(
+    HugePageOptions options, uint firstSegmentWords, AllocationStrategy allocationStrategy)
+    : options(options), nextSize(firstSegmentWords), allocationStrategy(allocationStrategy) {}
+
+HugePageMessageBuilder::~HugePageMessageBuilder() noexcept(false) {
+  for (auto segment: segments) {
+    unmapSegment(segment);
+  }
+}
+
+kj::ArrayPtr<word> HugePageMessageBuilder::allocateSegment(uint minimumSize) {
+  KJ_REQUIRE(bounded(minimumSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "HugePageMessageBuilder asked to allocate segment above maximum serializable size.");
+  KJ_ASSERT(bounded(nextSize) * WORDS <= MAX_SEGMENT_WORDS,
+      "HugePageMessageBuilder nextSize out of bounds.");
+
+  uint64_t maxSize = kj::min(kj::max(options.maxSegmentWords, minimumSize),
+                             uint64_t(unbound(MAX_SEGMENT_WORDS / WORDS)));
+  uint64_t size = kj::max(minimumSize, nextSize);
+  size = kj::min((size + HUGE_PAGE_WORDS - 1) / HUGE_PAGE_WORDS * HUGE_PAGE_WORDS, maxSize);
+
+  auto result = kj::arrayPtr(mapSegment(size * sizeof(word), options), size);
+  bool first = segments.empty();
+  segments.add(result);
+
+  if (allocationStrategy == AllocationStrategy::GROW_HEURISTICALLY) {
+    if (first) {
+      // After the first segment, we want nextSize to equal the total size allocated so far.
+      nextSize = size;
+    } else {
+      // set nextSize = min(nextSize+size, MAX_SEGMENT_WORDS)
+      // while protecting against possible overflow of (nextSize+size)
+      nextSize = (size <= unbound(MAX_SEGMENT_WORDS / WORDS) - nextSize)
+          ? nextSize + size : unbound(MAX_SEGMENT_WORDS / WORDS);
+    }
+  }
+
+  return result;
+}
+
+// -------------------------------------------------------------------
+
 FlatMessageBuilder::FlatMessageBuilder(kj::ArrayPtr<word> array): array(array), allocated(false) {}
 FlatMessageBuilder::~FlatMessageBuilder() noexcept(false) {}
 
@@ -241,6 +241,24 @@ public:
   size_t sizeInWords();
   // Add up the allocated space from all segments.
 
+  kj::ArrayPtr<word> compactInto(kj::ArrayPtr<word> buffer);
+  // Write a copy of the message into `buffer` as a single segment, with no far pointers and no
+  // space lost to orphaned objects, in a single pass over the message.  Returns the prefix of
+  // `buffer` that was used, which can be passed to readers or writers as a one-segment message.
+  // `buffer` must be at least sizeInWords() words long (one word if nothing has been built yet),
+  // and need not be zeroed.
+  //
+  // Unlike copying the root into a new builder, this copies capability pointers verbatim, so the
+  // result refers to this builder's cap table with the same indexes.  The RPC system relies on
+  // that when compacting a message just before sending it.
+  //
+  // The builder itself is not modified.
+
+  kj::Array<word> compact();
+  // Like compactInto(), but returns a newly-allocated buffer of exactly the right size.  When
+  // the builder has far pointers or orphaned space to drop, this costs a copy of the compacted
+  // message on top of the traversal.
+
 private:
   alignas(8) void* arenaSpace[22];
   // Space in which we can construct a BuilderArena.  We don't use BuilderArena directly here
@@ -372,6 +390,52 @@ enum class AllocationStrategy: uint8_t {
 constexpr uint SUGGESTED_FIRST_SEGMENT_WORDS = 1024;
 constexpr AllocationStrategy SUGGESTED_ALLOCATION_STRATEGY = AllocationStrategy::GROW_HEURISTICALLY;
 
+class MessageSizeHint {
+  // Learns how large the messages built at one call site tend to be, and suggests a first segment
+  // size that most of them will fit in. Messages that outgrow their first segment pay for extra
+  // allocations, and end up with multi-segment framing and far pointers on the wire, so for
+  // call sites whose messages are larger than SUGGESTED_FIRST_SEGMENT_WORDS it's worth sizing
+  // the first segment from experience.
+  //
+  // Typical usage is one hint per call site or per interface method, passed to each builder:
+  //
+  //     MallocMessageBuilder message(fooRequestSizeHint);
+  //
+  // The builder reads the suggestion when constructed and reports the message's final size when
+  // destroyed. The hint keeps exponentially-weighted moving averages of the size and of its
+  // deviation, and suggests enough room to cover sizes a couple deviations above the mean.
+  //
+  // A MessageSizeHint is not thread-safe. It must outlive any builder using it.
+
+public:
+  explicit MessageSizeHint(uint initialWords = SUGGESTED_FIRST_SEGMENT_WORDS);
+  // `initialWords` is the suggestion given before any message has been recorded.
+
+  KJ_DISALLOW_COPY_AND_MOVE(MessageSizeHint);
+
+  uint getFirstSegmentWords() const;
+  // Get the suggested first segment size.
+
+  void record(size_t messageWords);
+  // Record the total size of a finished message. Builders constructed with this hint call this
+  // automatically.
+
+  inline uint64_t getRecordCount() const { return count; }
+  inline uint64_t getMeanWords() const { return mean >> FRACTION_BITS; }
+  inline uint64_t getDeviationWords() const { return deviation >> FRACTION_BITS; }
+  // The current moving averages, rounded down to whole words. Zero until something is recorded.
+
+private:
+  static constexpr uint FRACTION_BITS = 4;
+
+  uint initialWords;
+  uint64_t count = 0;
+
+  uint64_t mean = 0;
+  uint64_t deviation = 0;
+  // Fixed-point averages, scaled by 1 << FRACTION_BITS.
+};
+
 class MallocMessageBuilder: public MessageBuilder {
   // A simple MessageBuilder that uses malloc() (actually, calloc()) to allocate segments.  This
   // implementation should be reasonable for any case that doesn't require writing the message to
@@ -401,6 +465,11 @@ public:
   // firstSegment MUST be zero-initialized.  MallocMessageBuilder's destructor will write new zeros
   // over any space that was used so that it can be reused.
 
+  explicit MallocMessageBuilder(MessageSizeHint& sizeHint,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // Sizes the first segment according to `sizeHint`, and reports the message's final size back to
+  // it on destruction.
+
   KJ_DISALLOW_COPY_AND_MOVE(MallocMessageBuilder);
   virtual ~MallocMessageBuilder() noexcept(false);
 
@@ -409,6 +478,7 @@ public:
 private:
   uint nextSize;
   AllocationStrategy allocationStrategy;
+  kj::Maybe<MessageSizeHint&> sizeHint;
 
   bool ownFirstSegment;
   bool returnedFirstSegment;
@@ -417,6 +487,159 @@ private:
   kj::Vector<word*> moreSegments;
 };
 
+class SegmentPool {
+  // A cache of message segments for reuse by PooledMessageBuilder, grouped into power-of-two size
+  // classes.
+  //
+  // When a builder is destroyed, its segments go back to the pool without being zeroed. The pool
+  // records how much of each segment the message actually used, and clears only that prefix when
+  // the segment is handed out again. Most messages use a small fraction of their first segment, so
+  // this is much cheaper than calloc()ing a fresh segment for every message.
+  //
+  // A SegmentPool is not thread-safe. The intended pattern is one pool per thread, owned by
+  // whatever owns the thread's main loop, with every builder that uses it created and destroyed on
+  // that thread.
+
+public:
+  explicit SegmentPool(size_t maxRetainedBytes = 16u << 20);
+  // `maxRetainedBytes` caps the total size of segments held in the pool. Segments released when
+  // the pool is full are freed instead.
+
+  KJ_DISALLOW_COPY_AND_MOVE(SegmentPool);
+  ~SegmentPool() noexcept(false);
+
+  struct Stats {
+    uint64_t hits = 0;
+    // Allocations served from the pool.
+
+    uint64_t misses = 0;
+    // Allocations which had to call calloc(), because the pool had no segment of the right size
+    // class or the request was too large to pool.
+
+    size_t bytesRetained = 0;
+    // Total size of the segments currently held in the pool.
+  };
+
+  Stats getStats() const { return stats; }
+
+  void setMaxRetainedBytes(size_t bytes);
+  // Change the cap, immediately freeing segments (largest first) if the pool is now over it.
+
+  void clear();
+  // Free all retained segments.
+
+  kj::ArrayPtr<word> allocate(uint minimumSize);
+  // Returns a zeroed segment of at least `minimumSize` words. The segment's size is rounded up to
+  // its size class.
+
+  void release(kj::ArrayPtr<word> segment, size_t wordsUsed);
+  // Gives back a segment previously returned by allocate(). Only the first `wordsUsed` words of
+  // the segment may be nonzero.
+
+private:
+  struct FreeSegment;
+
+  static constexpr uint MIN_CLASS_WORDS = 128;
+  static constexpr uint CLASS_COUNT = 14;
+  // Size classes run from 128 words (1 KiB) to 1M words (8 MiB). Bigger segments bypass the pool.
+
+  FreeSegment* freeLists[CLASS_COUNT] = {};
+  size_t maxRetainedBytes;
+  Stats stats;
+
+  static uint sizeClassFor(uint words);
+  void freeClass(uint sizeClass);
+};
+
+class PooledMessageBuilder: public MessageBuilder {
+  // Like MallocMessageBuilder, but takes segments from a SegmentPool and returns them to it on
+  // destruction. Use this when building many short-lived messages on one thread, e.g. RPC calls.
+  //
+  // The pool must outlive the builder, and the builder must be destroyed on the pool's thread.
+
+public:
+  explicit PooledMessageBuilder(SegmentPool& pool,
+      uint firstSegmentWords = SUGGESTED_FIRST_SEGMENT_WORDS,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // `firstSegmentWords` and `allocationStrategy` mean the same as for MallocMessageBuilder.
+
+  PooledMessageBuilder(SegmentPool& pool, MessageSizeHint& sizeHint,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // Sizes the first segment according to `sizeHint`, like the equivalent MallocMessageBuilder
+  // constructor.
+
+  KJ_DISALLOW_COPY_AND_MOVE(PooledMessageBuilder);
+  virtual ~PooledMessageBuilder() noexcept(false);
+
+  virtual kj::ArrayPtr<word> allocateSegment(uint minimumSize) override;
+
+private:
+  SegmentPool& pool;
+  uint nextSize;
+  AllocationStrategy allocationStrategy;
+  kj::Maybe<MessageSizeHint&> sizeHint;
+
+  kj::ArrayPtr<word> firstSegment;
+  kj::Vector<kj::ArrayPtr<word>> moreSegments;
+};
+
+struct HugePageOptions {
+  // Options for HugePageMessageBuilder.
+
+  bool explicitHugePages = false;
+  // Try to allocate from the kernel's reserved huge page pool (MAP_HUGETLB) before falling back
+  // to transparent huge pages. The pool is empty unless the administrator has reserved pages,
+  // e.g. via /proc/sys/vm/nr_hugepages.
+
+  bool bindToLocalNode = false;
+  // Bind each segment's memory to the NUMA node of the CPU the builder is running on at the time
+  // the segment is allocated (mbind(MPOL_BIND)). Only useful if the thread building the message,
+  // and ideally the threads reading it, are pinned to that node.
+
+  uint maxSegmentWords = unbound(MAX_SEGMENT_WORDS / WORDS);
+  // Largest segment to allocate, except where a single object needs more. Segments are clamped to
+  // this before the mapping is rounded up to whole huge pages, so a limit that isn't a multiple of
+  // HUGE_PAGE_WORDS leaves the tail of the last page unused. Values above MAX_SEGMENT_WORDS are
+  // ignored.
+};
+
+class HugePageMessageBuilder: public MessageBuilder {
+  // A MessageBuilder for very large messages (hundreds of megabytes or more), which allocates its
+  // segments directly with mmap(), in multiples of HUGE_PAGE_WORDS and aligned to huge page
+  // boundaries, and asks the kernel to back them with huge pages. Traversing a multi-gigabyte
+  // message made of 4 KiB pages spends much of its time on TLB misses, which 2 MiB pages mostly
+  // avoid.
+  //
+  // Everything here is advisory: if the kernel can't provide huge pages or refuses the NUMA
+  // binding, the builder still works, with ordinary pages. On platforms other than Linux it simply
+  // uses calloc().
+  //
+  // Since every segment is at least HUGE_PAGE_WORDS, this builder is a poor choice for small
+  // messages. Untouched pages of a segment are never faulted in, however, so the waste is address
+  // space rather than memory.
+
+public:
+  static constexpr uint HUGE_PAGE_WORDS = (2u << 20) / sizeof(word);
+
+  explicit HugePageMessageBuilder(HugePageOptions options = HugePageOptions(),
+      uint firstSegmentWords = HUGE_PAGE_WORDS,
+      AllocationStrategy allocationStrategy = SUGGESTED_ALLOCATION_STRATEGY);
+  // `firstSegmentWords` and `allocationStrategy` mean the same as for MallocMessageBuilder, except
+  // that every segment size is rounded up to a multiple of HUGE_PAGE_WORDS.
+
+  KJ_DISALLOW_COPY_AND_MOVE(HugePageMessageBuilder);
+  virtual ~HugePageMessageBuilder() noexcept(false);
+
+  virtual kj::ArrayPtr<word> allocateSegment(uint minimumSize) override;
+
+private:
+  HugePageOptions options;
+  uint nextSize;
+  AllocationStrategy allocationStrategy;
+
+  kj::Vector<kj::ArrayPtr<word>> segments;
+};
+
 class FlatMessageBuilder: public MessageBuilder {
   // THIS IS NOT THE CLASS YOU'RE LOOKING FOR.
   //
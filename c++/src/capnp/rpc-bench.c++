@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmarks for the RPC system.
+
+#include <benchmark/benchmark.h>
+
+#include "rpc-instrumentation.h"
+#include "rpc-twoparty.h"
+#include <capnp/test.capnp.h>
+#include <kj/async-io.h>
+#include <kj/debug.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+namespace test = capnproto_test::capnp::test;
+
+// Minimal versions of the test-util.h implementations, which would pull in the kj test runner's
+// main().
+
+class CallOrderImpl final: public test::TestCallOrder::Server {
+protected:
+  kj::Promise<void> getCallSequence(GetCallSequenceContext context) override {
+    context.getResults().setN(count++);
+    return kj::READY_NOW;
+  }
+
+private:
+  uint count = 0;
+};
+
+class TailCalleeImpl final: public test::TestTailCallee::Server {
+protected:
+  kj::Promise<void> foo(FooContext context) override {
+    auto params = context.getParams();
+    auto results = context.getResults();
+    results.setI(params.getI());
+    results.setT(params.getT());
+    results.setC(kj::heap<CallOrderImpl>());
+    return kj::READY_NOW;
+  }
+};
+
+struct TwoPartyFixture {
+  // A client and server talking over an in-process pipe on one event loop.
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope{loop};
+  kj::TwoWayPipe pipe = kj::newTwoWayPipe();
+  TwoPartyClient client{*pipe.ends[0]};
+  TwoPartyClient server{*pipe.ends[1], kj::heap<TailCalleeImpl>(), rpc::twoparty::Side::SERVER};
+
+  test::TestTailCallee::Client getBootstrap() {
+    return client.bootstrap().castAs<test::TestTailCallee>();
+  }
+};
+
+static void bm_Rpc_RepeatedPipelinedCap(benchmark::State& state) {
+  // Benchmark getting the same pipelined capability from one promise over and over, before the
+  // call returns. Only the first lookup should have to create a client.
+  TwoPartyFixture fixture;
+  auto client = fixture.getBootstrap();
+
+  auto promise = client.fooRequest().send();
+  for (auto _: state) {
+    for (auto i KJ_UNUSED: kj::zeroTo(state.range(0))) {
+      auto cap = promise.getC();
+      benchmark::DoNotOptimize(cap);
+    }
+  }
+}
+
+BENCHMARK(bm_Rpc_RepeatedPipelinedCap)->Arg(1)->Arg(16)->Arg(256);
+
+static void bm_Rpc_RepeatedPipelinedCall(benchmark::State& state) {
+  // Benchmark making N pipelined calls through the same path on one promise and waiting for them
+  // all.
+  TwoPartyFixture fixture;
+  auto client = fixture.getBootstrap();
+
+  for (auto _: state) {
+    auto promise = client.fooRequest().send();
+    kj::Vector<kj::Promise<void>> calls(state.range(0));
+    for (auto i: kj::zeroTo(state.range(0))) {
+      auto req = promise.getC().getCallSequenceRequest();
+      req.setExpected(static_cast<uint32_t>(i));
+      calls.add(req.send().ignoreResult());
+    }
+    kj::joinPromises(calls.releaseAsArray()).wait(fixture.waitScope);
+    promise.wait(fixture.waitScope);
+  }
+}
+
+BENCHMARK(bm_Rpc_RepeatedPipelinedCall)->Arg(1)->Arg(16)->Arg(256);
+
+static void bm_Rpc_Call(benchmark::State& state) {
+  // Benchmark a simple call and return, with instrumentation disabled (0) or recording into
+  // RpcMethodHistograms on both sides (1). The disabled case should cost the same as before
+  // instrumentation existed.
+  RpcMethodHistograms clientStats;
+  RpcMethodHistograms serverStats;
+  TwoPartyFixture fixture;
+  if (state.range(0)) {
+    fixture.client.getRpcSystem().setInstrumentation(clientStats);
+    fixture.server.getRpcSystem().setInstrumentation(serverStats);
+  }
+  auto client = fixture.getBootstrap();
+
+  for (auto _: state) {
+    auto req = client.fooRequest();
+    req.setI(123);
+    req.setT("foo");
+    req.send().wait(fixture.waitScope);
+  }
+}
+
+BENCHMARK(bm_Rpc_Call)->Arg(0)->Arg(1);
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
+
+BENCHMARK_MAIN();
@@ -0,0 +1,169 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-client-pool.h"
+#include "rpc-twoparty.h"
+#include "test-util.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+kj::Promise<void> callFoo(test::TestInterface::Client cap) {
+  auto request = cap.fooRequest();
+  request.setI(123);
+  request.setJ(true);
+  return request.send().then([](auto&& response) {
+    KJ_EXPECT(response.getX() == "foo");
+  });
+}
+
+KJ_TEST("RpcClientPool shares one warm connection per address") {
+  auto io = kj::setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  int callCount = 0;
+  TwoPartyServer server(kj::heap<TestInterfaceImpl>(callCount));
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto listenPromise = server.listen(*listener);
+  auto address = kj::str("127.0.0.1:", listener->getPort());
+
+  RpcClientPool pool(network, io.provider->getTimer());
+  kj::StringPtr addresses[] = { address };
+  pool.warm(addresses).wait(io.waitScope);
+
+  auto status = pool.getStatus();
+  KJ_ASSERT(status.size() == 1);
+  KJ_EXPECT(status[0].address == address);
+  KJ_EXPECT(status[0].state == RpcClientPool::State::CONNECTED);
+  KJ_EXPECT(status[0].connects == 1);
+  KJ_EXPECT(pool.getConnectNanos().getCount() == 1);
+  KJ_EXPECT(pool.getFirstResponseNanos().getCount() == 1);
+  KJ_EXPECT(pool.getFirstResponseNanos().getPercentile(99) >=
+            pool.getConnectNanos().getPercentile(50));
+
+  auto a = pool.get<test::TestInterface>(address);
+  auto b = pool.get<test::TestInterface>(address);
+  callFoo(a).wait(io.waitScope);
+  callFoo(b).wait(io.waitScope);
+  KJ_EXPECT(callCount == 2);
+  KJ_EXPECT(pool.getStatus()[0].connects == 1);
+}
+
+KJ_TEST("RpcClientPool reconnects when the server drops the connection") {
+  auto io = kj::setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  int callCount = 0;
+  TwoPartyServer server(kj::heap<TestInterfaceImpl>(callCount));
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto address = kj::str("127.0.0.1:", listener->getPort());
+
+  RpcClientPool pool(network, io.provider->getTimer());
+  auto cap = pool.get<test::TestInterface>(address);
+
+  // Accept connections by hand so that we can drop one.
+  auto stream = listener->accept().wait(io.waitScope);
+  auto serving = server.accept(*stream);
+  callFoo(cap).wait(io.waitScope);
+
+  auto nextConnection = listener->accept();
+  serving = nullptr;
+  stream = nullptr;
+
+  // With keepWarm, the pool reconnects on its own, and the next call uses the new connection
+  // without failing first.
+  auto stream2 = nextConnection.wait(io.waitScope);
+  auto serving2 = server.accept(*stream2);
+  callFoo(cap).wait(io.waitScope);
+  KJ_EXPECT(callCount == 2);
+
+  auto status = pool.getStatus();
+  KJ_EXPECT(status[0].state == RpcClientPool::State::CONNECTED);
+  KJ_EXPECT(status[0].connects == 2);
+  KJ_EXPECT(status[0].disconnects == 1);
+  KJ_EXPECT(status[0].failures == 0);
+}
+
+KJ_TEST("RpcClientPool backs off from a server that drops connections right away") {
+  auto io = kj::setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  int callCount = 0;
+  TwoPartyServer server(kj::heap<TestInterfaceImpl>(callCount));
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto address = kj::str("127.0.0.1:", listener->getPort());
+
+  RpcClientPool pool(network, io.provider->getTimer(), {
+    .minRetryDelay = 10 * kj::SECONDS,
+  });
+  auto cap = pool.get<test::TestInterface>(address);
+
+  auto stream = listener->accept().wait(io.waitScope);
+  auto serving = server.accept(*stream);
+  callFoo(cap).wait(io.waitScope);
+  serving = nullptr;
+  stream = nullptr;
+
+  // The connection was up for much less than minHealthyTime, so the pool waits before trying
+  // again, as it would after a failed attempt.
+  io.provider->getTimer().afterDelay(50 * kj::MILLISECONDS).wait(io.waitScope);
+  auto status = pool.getStatus();
+  KJ_EXPECT(status[0].state == RpcClientPool::State::BACKING_OFF);
+  KJ_EXPECT(status[0].connects == 1);
+  KJ_EXPECT(status[0].disconnects == 1);
+}
+
+KJ_TEST("RpcClientPool backs off from an unreachable address") {
+  auto io = kj::setupAsyncIo();
+  auto& network = io.provider->getNetwork();
+
+  // Find a port nobody is listening on.
+  auto listener = network.parseAddress("127.0.0.1").wait(io.waitScope)->listen();
+  auto address = kj::str("127.0.0.1:", listener->getPort());
+  listener = nullptr;
+
+  RpcClientPool pool(network, io.provider->getTimer(), {
+    .minRetryDelay = 10 * kj::MILLISECONDS,
+    .maxRetryDelay = 20 * kj::MILLISECONDS,
+  });
+  kj::StringPtr addresses[] = { address };
+  pool.warm(addresses).wait(io.waitScope);
+
+  auto status = pool.getStatus();
+  KJ_EXPECT(status[0].state != RpcClientPool::State::CONNECTED);
+  KJ_EXPECT(status[0].failures >= 1);
+  KJ_EXPECT(status[0].lastError != kj::none);
+  KJ_EXPECT(pool.getFirstResponseNanos().getCount() == 0);
+
+  auto cap = pool.get<test::TestInterface>(address);
+  KJ_EXPECT_THROW(DISCONNECTED, callFoo(cap).wait(io.waitScope));
+
+  // Retries keep happening in the background.
+  io.provider->getTimer().afterDelay(100 * kj::MILLISECONDS).wait(io.waitScope);
+  KJ_EXPECT(pool.getStatus()[0].connects > status[0].connects);
+}
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
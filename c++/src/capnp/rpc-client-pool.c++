@@ -0,0 +1,311 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-client-pool.h"
+#include "reconnect.h"
+#include "rpc-twoparty.h"
+#include <kj/debug.h>
+
+namespace capnp {
+
+namespace {
+
+uint64_t nanosSince(kj::TimePoint start) {
+  return (kj::systemPreciseMonotonicClock().now() - start) / kj::NANOSECONDS;
+}
+
+}  // namespace
+
+struct RpcClientPool::Connection {
+  uint generation;
+  kj::TimePoint startTime;
+
+  kj::Own<kj::AsyncIoStream> stream;
+  kj::Own<TwoPartyClient> client;
+  // Declared after `stream`, which it uses, so that it's destroyed first.
+
+  kj::Own<kj::PromiseFulfiller<Capability::Client>> bootstrapFulfiller;
+  Capability::Client bootstrap;
+  // Resolves to the server's bootstrap capability once connected. Calls made on it before then
+  // are queued.
+
+  bool handedOut = false;
+  // Whether the reconnecting capability has been given this connection yet.
+
+  bool responded = false;
+  kj::TimePoint respondedTime = kj::origin<kj::TimePoint>();
+  // Whether, and when (on the pool's timer), the server returned its bootstrap capability.
+
+  kj::Canceler canceler;
+  // Cancels runConnection() to close the connection early.
+
+  Connection(uint generation, kj::TimePoint startTime,
+             kj::PromiseFulfillerPair<Capability::Client> paf)
+      : generation(generation), startTime(startTime),
+        bootstrapFulfiller(kj::mv(paf.fulfiller)), bootstrap(kj::mv(paf.promise)) {}
+};
+
+class RpcClientPool::Endpoint final: public kj::Refcounted {
+  // All state for one address. Refcounted because the capability handed out by get() calls back
+  // into it to reconnect, and may outlive the pool.
+
+public:
+  Endpoint(RpcClientPool& pool, kj::StringPtr address)
+      : pool(pool), address(kj::heapString(address)), retryDelay(pool.options.minRetryDelay) {}
+
+  void init(kj::Own<Endpoint> self) {
+    client = lazyAutoReconnectWithController(kj::Function<Capability::Client()>(
+        [self = kj::mv(self)]() mutable { return self->connect(); }));
+    startConnection();
+  }
+
+  void detach() {
+    // The pool is going away. The capability we handed out now holds the last reference to us,
+    // and dropping `client` breaks that cycle.
+    pool = kj::none;
+    current = kj::none;
+    client = kj::none;
+  }
+
+  Capability::Client getClient() {
+    return KJ_ASSERT_NONNULL(client).cap;
+  }
+
+  kj::Promise<void> whenReady() {
+    KJ_IF_SOME(c, current) {
+      if (!c.responded) {
+        return c.bootstrap.whenResolved().catch_([](kj::Exception&&) {});
+      }
+    }
+    return kj::READY_NOW;
+  }
+
+  Status getStatus() {
+    State state;
+    KJ_IF_SOME(c, current) {
+      state = c.responded ? State::CONNECTED : State::CONNECTING;
+    } else {
+      state = backingOff ? State::BACKING_OFF : State::IDLE;
+    }
+
+    Status result { address, state, connects, failures, disconnects, kj::none };
+    KJ_IF_SOME(e, lastError) {
+      result.lastError = e;
+    }
+    return result;
+  }
+
+private:
+  kj::Maybe<RpcClientPool&> pool;
+  kj::String address;
+  kj::Maybe<AutoReconnectClient<Capability::Client>> client;
+
+  kj::Maybe<Connection&> current;
+  // The newest connection, if any. It's owned by the pool's TaskSet.
+
+  uint nextGeneration = 1;
+  uint handedOutGeneration = 0;
+  // Generation of the connection the capability is using, or zero if none.
+
+  bool backingOff = false;
+  uint backoffGeneration = 0;
+  kj::Duration retryDelay;
+
+  uint64_t connects = 0;
+  uint64_t failures = 0;
+  uint64_t disconnects = 0;
+  kj::Maybe<kj::Exception> lastError;
+
+  RpcClientPool& getPool() {
+    return KJ_ASSERT_NONNULL(pool);
+  }
+
+  Capability::Client connect() {
+    // Called by the reconnecting capability the first time it's used, after we reset() it, and
+    // whenever a call through it fails with DISCONNECTED.
+
+    if (pool == kj::none) {
+      return Capability::Client(
+          newBrokenCap(KJ_EXCEPTION(DISCONNECTED, "RpcClientPool was destroyed")));
+    }
+
+    KJ_IF_SOME(c, current) {
+      if (!c.handedOut) {
+        // A connection we started ahead of time is being put to use.
+        return handOut(c);
+      }
+      // The capability already has this connection, so it's asking because a call on it failed.
+      // onDisconnect() will tell us so shortly, but don't make the caller wait for that.
+    }
+
+    startConnection();
+    return handOut(KJ_ASSERT_NONNULL(current));
+  }
+
+  Capability::Client handOut(Connection& connection) {
+    connection.handedOut = true;
+    handedOutGeneration = connection.generation;
+    return connection.bootstrap;
+  }
+
+  void startConnection() {
+    auto& p = getPool();
+
+    // Cancel any pending retry.
+    ++backoffGeneration;
+    backingOff = false;
+
+    KJ_IF_SOME(old, current) {
+      // The capability is done with the old connection, so don't leave it open.
+      old.canceler.cancel(KJ_EXCEPTION(DISCONNECTED, "RpcClientPool replaced the connection"));
+    }
+
+    ++connects;
+    auto connection = kj::heap<Connection>(nextGeneration++,
+        kj::systemPreciseMonotonicClock().now(), kj::newPromiseAndFulfiller<Capability::Client>());
+    auto& ref = *connection;
+    current = ref;
+
+    p.tasks.add(ref.canceler.wrap(runConnection(ref))
+        .then([this, &ref]() { connectionEnded(ref, kj::none); },
+              [this, &ref](kj::Exception&& e) { connectionEnded(ref, kj::mv(e)); })
+        .attach(kj::mv(connection)));
+  }
+
+  kj::Promise<void> runConnection(Connection& connection) {
+    auto& p = getPool();
+
+    auto addr = co_await p.network.parseAddress(address);
+    connection.stream = co_await addr->connect();
+    p.connectNanos.record(nanosSince(connection.startTime));
+
+    connection.client = kj::heap<TwoPartyClient>(*connection.stream);
+    connection.bootstrapFulfiller->fulfill(connection.client->bootstrap());
+
+    co_await connection.bootstrap.whenResolved();
+    p.firstResponseNanos.record(nanosSince(connection.startTime));
+    connection.responded = true;
+    connection.respondedTime = p.timer.now();
+
+    co_await connection.client->onDisconnect();
+  }
+
+  void connectionEnded(Connection& connection, kj::Maybe<kj::Exception> error) {
+    auto& p = getPool();
+
+    if (connection.bootstrapFulfiller->isWaiting()) {
+      // We never got as far as connecting. Fail queued calls as DISCONNECTED, as a lost
+      // connection would, so that the reconnecting capability tries again.
+      KJ_IF_SOME(e, error) {
+        connection.bootstrapFulfiller->reject(KJ_EXCEPTION(DISCONNECTED,
+            "RpcClientPool couldn't connect", address, e.getDescription()));
+      } else {
+        connection.bootstrapFulfiller->reject(KJ_EXCEPTION(DISCONNECTED,
+            "RpcClientPool couldn't connect", address));
+      }
+    }
+
+    if (connection.responded) {
+      ++disconnects;
+    } else {
+      ++failures;
+    }
+
+    // If this isn't the current connection, the capability has already moved on to a newer one.
+    KJ_IF_SOME(c, current) {
+      if (&c != &connection) return;
+    } else {
+      return;
+    }
+    current = kj::none;
+    lastError = kj::mv(error);
+
+    if (handedOutGeneration == connection.generation) {
+      // Make the next call start a new connection rather than fail on this one.
+      KJ_ASSERT_NONNULL(client).controller->reset();
+      handedOutGeneration = 0;
+    }
+
+    if (!p.options.keepWarm) return;
+
+    if (connection.responded &&
+        p.timer.now() - connection.respondedTime >= p.options.minHealthyTime) {
+      // The server was healthy until now, so try again right away.
+      retryDelay = p.options.minRetryDelay;
+      startConnection();
+    } else {
+      backingOff = true;
+      auto delay = retryDelay;
+      retryDelay = kj::min(retryDelay * 2, p.options.maxRetryDelay);
+      p.tasks.add(p.timer.afterDelay(delay).then([this, generation = backoffGeneration]() {
+        if (generation == backoffGeneration) startConnection();
+      }));
+    }
+  }
+};
+
+RpcClientPool::RpcClientPool(kj::Network& network, kj::Timer& timer)
+    : RpcClientPool(network, timer, Options()) {}
+
+RpcClientPool::RpcClientPool(kj::Network& network, kj::Timer& timer, Options options)
+    : network(network), timer(timer), options(options), tasks(*this) {}
+
+RpcClientPool::~RpcClientPool() noexcept(false) {
+  for (auto endpoint: endpointOrder) {
+    endpoint->detach();
+  }
+}
+
+RpcClientPool::Endpoint& RpcClientPool::findOrCreate(kj::StringPtr address) {
+  KJ_IF_SOME(existing, endpoints.find(address)) {
+    return *existing;
+  }
+
+  auto endpoint = kj::refcounted<Endpoint>(*this, address);
+  auto& ref = *endpoint;
+  endpoints.insert(kj::heapString(address), kj::mv(endpoint));
+  endpointOrder.add(&ref);
+  ref.init(kj::addRef(ref));
+  return ref;
+}
+
+Capability::Client RpcClientPool::get(kj::StringPtr address) {
+  return findOrCreate(address).getClient();
+}
+
+kj::Promise<void> RpcClientPool::warm(kj::ArrayPtr<const kj::StringPtr> addresses) {
+  auto promises = kj::heapArrayBuilder<kj::Promise<void>>(addresses.size());
+  for (auto address: addresses) {
+    promises.add(findOrCreate(address).whenReady());
+  }
+  return kj::joinPromises(promises.finish());
+}
+
+kj::Array<RpcClientPool::Status> RpcClientPool::getStatus() {
+  return KJ_MAP(endpoint, endpointOrder) { return endpoint->getStatus(); };
+}
+
+void RpcClientPool::taskFailed(kj::Exception&& exception) {
+  // Connections handle their own failures, so this would be a bug.
+  KJ_LOG(ERROR, "RpcClientPool task failed", exception);
+}
+
+}  // namespace capnp
@@ -0,0 +1,155 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <capnp/capability.h>
+#include <capnp/rpc-instrumentation.h>
+#include <kj/async-io.h>
+#include <kj/map.h>
+#include <kj/timer.h>
+#include <kj/vector.h>
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+
+class RpcClientPool: private kj::TaskSet::ErrorHandler {
+  // Keeps one two-party RPC connection open to each of many servers, for clients that fan out
+  // calls to a large set of backends.
+  //
+  // get() returns the server's bootstrap capability. The first get() for an address starts
+  // connecting and bootstrapping right away, and later ones share that connection, so a caller
+  // that knows its backends up front can warm() them all and pay for the connection handshakes
+  // before the first request rather than on it.
+  //
+  // Capabilities returned by get() are built with lazyAutoReconnectWithController() (see
+  // reconnect.h), so they survive the connection being lost. The pool watches each connection's
+  // onDisconnect(): when one drops, it resets the capability, so the next call goes to a new
+  // connection rather than failing first. With `Options::keepWarm`, the pool also reconnects
+  // immediately, backing off exponentially while the server is unreachable. Calls in flight when
+  // a connection drops still fail with DISCONNECTED, as with autoReconnect().
+  //
+  // The pool, and the capabilities it hands out, may only be used from the thread that created
+  // the pool. Capabilities that outlive the pool throw DISCONNECTED.
+
+public:
+  struct Options {
+    bool keepWarm = true;
+    // Reconnect as soon as a connection is lost, rather than on the next call.
+
+    kj::Duration minRetryDelay = 100 * kj::MILLISECONDS;
+    kj::Duration maxRetryDelay = 30 * kj::SECONDS;
+    // With keepWarm, how long to wait before retrying an address whose last connection attempt
+    // failed. The delay doubles with each consecutive failure.
+
+    kj::Duration minHealthyTime = 10 * kj::SECONDS;
+    // With keepWarm, a connection that the server responded on and that then stayed up at least
+    // this long is retried right away when it drops. One that dropped sooner is retried after the
+    // retry delay, as a failed attempt would be, so that a server which accepts connections and
+    // then immediately drops them isn't hammered with reconnects.
+  };
+
+  RpcClientPool(kj::Network& network, kj::Timer& timer);
+  RpcClientPool(kj::Network& network, kj::Timer& timer, Options options);
+  ~RpcClientPool() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(RpcClientPool);
+
+  Capability::Client get(kj::StringPtr address);
+  template <typename T>
+  typename T::Client get(kj::StringPtr address) { return get(address).castAs<T>(); }
+  // Returns the bootstrap capability of the server at `address`, which is passed to
+  // kj::Network::parseAddress(). Calls made before the connection is up are queued and sent as
+  // soon as it is, pipelined on the bootstrap.
+
+  kj::Promise<void> warm(kj::ArrayPtr<const kj::StringPtr> addresses);
+  // Starts connecting to all of `addresses` at once. Resolves when each has either returned its
+  // bootstrap capability or failed; failures are reported through getStatus(), not thrown.
+
+  enum class State {
+    CONNECTING,
+    // A connection attempt is in progress, or connected but the bootstrap hasn't returned yet.
+
+    CONNECTED,
+    // The server has responded on the current connection.
+
+    BACKING_OFF,
+    // The last attempt failed; the pool will retry after a delay, or sooner if the capability is
+    // used.
+
+    IDLE
+    // Not connected, and won't connect until the capability is next used (keepWarm is off).
+  };
+
+  struct Status {
+    kj::StringPtr address;
+    State state;
+
+    uint64_t connects;
+    // Connection attempts started.
+
+    uint64_t failures;
+    // Attempts that failed before the server responded.
+
+    uint64_t disconnects;
+    // Connections lost after the server had responded.
+
+    kj::Maybe<const kj::Exception&> lastError;
+    // Why the most recent connection ended, unless it was closed cleanly by the server.
+  };
+
+  kj::Array<Status> getStatus();
+  // One entry per address, in the order each was first requested.
+
+  const RpcHistogram& getConnectNanos() const { return connectNanos; }
+  // Time from starting each connection attempt until the transport was established, including
+  // address resolution.
+
+  const RpcHistogram& getFirstResponseNanos() const { return firstResponseNanos; }
+  // Time from starting each connection attempt until the server's bootstrap capability was
+  // returned, i.e. the first response on the connection. Use getPercentile(50) and
+  // getPercentile(99) for p50 and p99.
+
+private:
+  class Endpoint;
+  struct Connection;
+
+  kj::Network& network;
+  kj::Timer& timer;
+  Options options;
+
+  RpcHistogram connectNanos;
+  RpcHistogram firstResponseNanos;
+
+  kj::HashMap<kj::String, kj::Own<Endpoint>> endpoints;
+  kj::Vector<Endpoint*> endpointOrder;
+
+  kj::TaskSet tasks;
+  // Runs connections and retry timers. Declared after `endpoints`, so it's destroyed first.
+
+  Endpoint& findOrCreate(kj::StringPtr address);
+
+  void taskFailed(kj::Exception&& exception) override;
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
@@ -0,0 +1,226 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-instrumentation.h"
+#include "rpc-twoparty.h"
+#include "test-util.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+KJ_TEST("RpcHistogram buckets cover the whole range with bounded error") {
+  uint64_t expectedLower = 0;
+  for (auto i: kj::zeroTo(RpcHistogram::BUCKET_COUNT)) {
+    auto bucket = RpcHistogram::bucketRange(i);
+    KJ_ASSERT(bucket.lowerBound == expectedLower, i, bucket.lowerBound, expectedLower);
+    KJ_ASSERT(RpcHistogram::bucketIndex(bucket.lowerBound) == i);
+    KJ_ASSERT(RpcHistogram::bucketIndex(bucket.upperBound) == i);
+    KJ_ASSERT((bucket.upperBound - bucket.lowerBound) <= bucket.lowerBound / 16, i);
+    expectedLower = bucket.upperBound + 1;
+  }
+
+  // The last bucket ends exactly at the top of the range.
+  KJ_EXPECT(expectedLower == 0);
+  KJ_EXPECT(RpcHistogram::bucketIndex(kj::maxValue) == RpcHistogram::BUCKET_COUNT - 1);
+}
+
+KJ_TEST("RpcHistogram percentiles") {
+  RpcHistogram histogram;
+  KJ_EXPECT(histogram.getPercentile(50) == 0);
+
+  for (uint64_t i = 1; i <= 1000; i++) {
+    histogram.record(i);
+  }
+
+  KJ_EXPECT(histogram.getCount() == 1000);
+  KJ_EXPECT(histogram.getSum() == 500500);
+  KJ_EXPECT(histogram.getMax() == 1000);
+
+  auto expectNear = [](uint64_t actual, uint64_t expected) {
+    KJ_EXPECT(actual >= expected && actual <= expected + expected / 16, actual, expected);
+  };
+  expectNear(histogram.getPercentile(50), 500);
+  expectNear(histogram.getPercentile(90), 900);
+  expectNear(histogram.getPercentile(99), 990);
+  KJ_EXPECT(histogram.getPercentile(100) == 1000);
+
+  uint64_t total = 0;
+  for (auto& bucket: histogram.getBuckets()) {
+    KJ_EXPECT(bucket.count > 0);
+    total += bucket.count;
+  }
+  KJ_EXPECT(total == 1000);
+
+  KJ_EXPECT(histogram.toString().startsWith("count=1000 mean=500 p50="), histogram.toString());
+}
+
+KJ_TEST("RpcMethodHistograms records calls on both sides") {
+  RpcMethodHistograms clientStats;
+  RpcMethodHistograms serverStats;
+  // Declared first, since instrumentation must outlive the RpcSystems using it.
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+
+  int callCount = 0;
+  int handleCount = 0;
+  TwoPartyClient tpClient(*pipe.ends[0]);
+  TwoPartyClient tpServer(*pipe.ends[1], kj::heap<TestInterfaceImpl>(callCount, handleCount),
+                          rpc::twoparty::Side::SERVER);
+  auto& rpcClient = tpClient.getRpcSystem();
+  auto& rpcServer = tpServer.getRpcSystem();
+
+  rpcClient.setInstrumentation(clientStats);
+  rpcServer.setInstrumentation(serverStats);
+
+  auto client = tpClient.bootstrap().castAs<test::TestInterface>();
+
+  constexpr uint CALL_COUNT = 5;
+  for (uint i = 0; i < CALL_COUNT; i++) {
+    auto req = client.fooRequest();
+    req.setI(123);
+    req.setJ(true);
+    req.send().wait(waitScope);
+  }
+
+  // bar() isn't implemented by TestInterfaceImpl, so it throws.
+  KJ_EXPECT(client.barRequest().send().then([](auto&&) { return false; },
+      [](kj::Exception&&) { return true; }).wait(waitScope));
+
+  // Calls made once instrumentation is turned off aren't counted.
+  rpcClient.setInstrumentation(kj::none);
+  rpcServer.setInstrumentation(kj::none);
+  {
+    auto req = client.fooRequest();
+    req.setI(123);
+    req.setJ(true);
+    req.send().wait(waitScope);
+  }
+
+  auto findMethod = [](RpcMethodHistograms& histograms, uint16_t methodId)
+      -> const RpcMethodHistograms::Stats& {
+    for (auto& entry: histograms.getStats()) {
+      if (entry.method.interfaceId == typeId<test::TestInterface>() &&
+          entry.method.methodId == methodId) {
+        return entry.stats;
+      }
+    }
+    KJ_FAIL_ASSERT("method not recorded", methodId);
+  };
+
+  {
+    auto& foo = findMethod(clientStats, 0);
+    KJ_EXPECT(foo.callWords.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.returnWords.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.latencyNanos.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.latencyNanos.getMax() > 0);
+    KJ_EXPECT(foo.dispatchNanos.getCount() == 0);
+    KJ_EXPECT(foo.exceptions == 0);
+
+    auto& bar = findMethod(clientStats, 1);
+    KJ_EXPECT(bar.latencyNanos.getCount() == 1);
+    KJ_EXPECT(bar.exceptions == 1);
+  }
+
+  {
+    auto& foo = findMethod(serverStats, 0);
+    KJ_EXPECT(foo.callWords.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.returnWords.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.dispatchNanos.getCount() == CALL_COUNT);
+    KJ_EXPECT(foo.latencyNanos.getCount() == 0);
+
+    auto& bar = findMethod(serverStats, 1);
+    KJ_EXPECT(bar.dispatchNanos.getCount() == 1);
+    KJ_EXPECT(bar.exceptions == 1);
+  }
+
+  auto text = clientStats.toString();
+  KJ_EXPECT(text.startsWith(kj::str(kj::hex(typeId<test::TestInterface>()), ".0: latencyNanos{")),
+            text);
+}
+
+KJ_TEST("RpcMethodHistograms caps the number of methods") {
+  RpcMethodHistograms stats;
+  constexpr uint EXTRA = 5;
+  for (auto i: kj::zeroTo(RpcMethodHistograms::MAX_METHODS + EXTRA)) {
+    RpcInstrumentation::Method method { 0x1234, static_cast<uint16_t>(i) };
+    stats.dispatchStarted(method, 10);
+    stats.dispatchFinished(method, 5, 1 * kj::MICROSECONDS,
+                           RpcInstrumentation::Outcome::RESULTS);
+  }
+
+  auto methods = stats.getStats();
+  KJ_EXPECT(methods.size() == RpcMethodHistograms::MAX_METHODS);
+  KJ_EXPECT(methods[0].stats.dispatchNanos.getCount() == 1);
+  KJ_EXPECT(stats.getOtherStats().callWords.getCount() == EXTRA);
+  KJ_EXPECT(stats.getOtherStats().dispatchNanos.getCount() == EXTRA);
+  KJ_EXPECT(stats.toString().endsWith(
+      kj::str("other: ", "latencyNanos{count=0 mean=0 p50=0 p90=0 p99=0 p999=0 max=0}",
+              " dispatchNanos{count=5 mean=1000 p50=1000 p90=1000 p99=1000 p999=1000 max=1000}",
+              " callWords{count=5 mean=10 p50=10 p90=10 p99=10 p999=10 max=10}",
+              " returnWords{count=5 mean=5 p50=5 p90=5 p99=5 p999=5 max=5}",
+              " exceptions=0 canceled=0\n")));
+}
+
+KJ_TEST("RpcMethodHistograms::toMessage()") {
+  RpcMethodHistograms stats;
+  RpcInstrumentation::Method method { 0x1234, 5 };
+  for (uint64_t size: { 10, 10, 1000 }) {
+    stats.callSent(method, size);
+    stats.returnReceived(method, 3, 1 * kj::MICROSECONDS, RpcInstrumentation::Outcome::EXCEPTION);
+  }
+
+  MallocMessageBuilder message;
+  stats.toMessage(message.initRoot<rpc::instrumentation::RpcStats>());
+  auto root = message.getRoot<rpc::instrumentation::RpcStats>().asReader();
+
+  KJ_ASSERT(root.getMethods().size() == 1);
+  auto entry = root.getMethods()[0];
+  KJ_EXPECT(entry.getInterfaceId() == 0x1234);
+  KJ_EXPECT(entry.getMethodId() == 5);
+  KJ_EXPECT(entry.getExceptions() == 3);
+  KJ_EXPECT(entry.getCanceled() == 0);
+  KJ_EXPECT(entry.getLatencyNanos().getCount() == 3);
+  KJ_EXPECT(entry.getDispatchNanos().getCount() == 0);
+  KJ_EXPECT(entry.getDispatchNanos().getBuckets().size() == 0);
+
+  auto callWords = entry.getCallWords();
+  KJ_EXPECT(callWords.getCount() == 3);
+  KJ_EXPECT(callWords.getSum() == 1020);
+  KJ_EXPECT(callWords.getMax() == 1000);
+  KJ_ASSERT(callWords.getBuckets().size() == 2);
+  KJ_EXPECT(callWords.getBuckets()[0].getLowerBound() == 10);
+  KJ_EXPECT(callWords.getBuckets()[0].getCount() == 2);
+  KJ_EXPECT(callWords.getBuckets()[1].getLowerBound() <= 1000);
+  KJ_EXPECT(callWords.getBuckets()[1].getUpperBound() >= 1000);
+  KJ_EXPECT(callWords.getBuckets()[1].getCount() == 1);
+
+  KJ_EXPECT(!root.hasOtherMethods());
+}
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
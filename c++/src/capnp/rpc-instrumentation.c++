@@ -0,0 +1,257 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "rpc-instrumentation.h"
+#include <kj/debug.h>
+#include <kj/vector.h>
+#include <algorithm>
+
+#if _MSC_VER && !defined(__clang__)
+#include <intrin.h>
+#endif
+
+namespace capnp {
+
+// =======================================================================================
+// RpcHistogram
+
+static inline uint lg(uint64_t value) {
+  // Compute floor(log2(value)).
+  //
+  // Undefined for value = 0.
+#if _MSC_VER && !defined(__clang__)
+  unsigned long i;
+  auto found = _BitScanReverse64(&i, value);
+  KJ_DASSERT(found);  // !found means value = 0
+  return i;
+#else
+  return sizeof(uint64_t) * 8 - 1 - __builtin_clzll(value);
+#endif
+}
+
+uint RpcHistogram::bucketIndex(uint64_t value) {
+  if (value < SUB_BUCKET_COUNT) return value;
+
+  // Keep the top SUB_BUCKET_BITS + 1 significant bits: the leading one picks the power of two,
+  // the rest pick a linear sub-bucket within it.
+  uint shift = lg(value) - SUB_BUCKET_BITS;
+  return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) - SUB_BUCKET_COUNT);
+}
+
+RpcHistogram::Bucket RpcHistogram::bucketRange(uint index) {
+  if (index < SUB_BUCKET_COUNT) return { index, index, 0 };
+
+  uint shift = index / SUB_BUCKET_COUNT - 1;
+  uint64_t mantissa = index % SUB_BUCKET_COUNT + SUB_BUCKET_COUNT;
+  uint64_t lower = mantissa << shift;
+  return { lower, lower + ((uint64_t(1) << shift) - 1), 0 };
+}
+
+void RpcHistogram::record(uint64_t value) {
+  counts[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+  count.fetch_add(1, std::memory_order_relaxed);
+  sum.fetch_add(value, std::memory_order_relaxed);
+
+  uint64_t oldMax = max.load(std::memory_order_relaxed);
+  while (value > oldMax &&
+         !max.compare_exchange_weak(oldMax, value, std::memory_order_relaxed)) {}
+}
+
+uint64_t RpcHistogram::getPercentile(double percentile) const {
+  uint64_t total = 0;
+  uint64_t snapshot[BUCKET_COUNT];
+  for (auto i: kj::zeroTo(BUCKET_COUNT)) {
+    snapshot[i] = counts[i].load(std::memory_order_relaxed);
+    total += snapshot[i];
+  }
+  if (total == 0) return 0;
+
+  // The rank of the value we want, counting from 1.
+  uint64_t rank = kj::max(uint64_t(1), uint64_t(percentile / 100 * total + 0.5));
+  rank = kj::min(rank, total);
+
+  uint64_t seen = 0;
+  for (auto i: kj::zeroTo(BUCKET_COUNT)) {
+    seen += snapshot[i];
+    if (seen >= rank) {
+      // The top bucket's upper bound may be far beyond anything actually recorded.
+      return kj::min(bucketRange(i).upperBound, getMax());
+    }
+  }
+  KJ_UNREACHABLE;
+}
+
+kj::Array<RpcHistogram::Bucket> RpcHistogram::getBuckets() const {
+  kj::Vector<Bucket> result;
+  for (auto i: kj::zeroTo(BUCKET_COUNT)) {
+    uint64_t n = counts[i].load(std::memory_order_relaxed);
+    if (n > 0) {
+      auto bucket = bucketRange(i);
+      bucket.count = n;
+      result.add(bucket);
+    }
+  }
+  return result.releaseAsArray();
+}
+
+kj::String RpcHistogram::toString() const {
+  uint64_t n = getCount();
+  return kj::str(
+      "count=", n, " mean=", n == 0 ? 0 : getSum() / n,
+      " p50=", getPercentile(50), " p90=", getPercentile(90), " p99=", getPercentile(99),
+      " p999=", getPercentile(99.9), " max=", getMax());
+}
+
+void RpcHistogram::toMessage(rpc::instrumentation::Histogram::Builder builder) const {
+  builder.setCount(getCount());
+  builder.setSum(getSum());
+  builder.setMax(getMax());
+
+  auto buckets = getBuckets();
+  auto list = builder.initBuckets(buckets.size());
+  for (auto i: kj::indices(buckets)) {
+    list[i].setLowerBound(buckets[i].lowerBound);
+    list[i].setUpperBound(buckets[i].upperBound);
+    list[i].setCount(buckets[i].count);
+  }
+}
+
+// =======================================================================================
+// RpcMethodHistograms
+
+RpcMethodHistograms::Stats& RpcMethodHistograms::find(Method method) {
+  Key key { method.interfaceId, method.methodId };
+  KJ_IF_SOME(stats, methods.lockShared()->find(key)) {
+    // The shared lock only protects the map. Stats is all atomics, so it's safe to update from
+    // several threads.
+    return const_cast<Stats&>(*stats);
+  }
+
+  auto lock = methods.lockExclusive();
+  KJ_IF_SOME(stats, lock->find(key)) {
+    // Another thread added it while we were unlocked.
+    return *stats;
+  }
+  if (lock->size() >= MAX_METHODS) return otherMethods;
+  return *lock->insert(key, kj::heap<Stats>()).value;
+}
+
+void RpcMethodHistograms::recordOutcome(Stats& stats, Outcome outcome) {
+  switch (outcome) {
+    case Outcome::RESULTS:
+      break;
+    case Outcome::EXCEPTION:
+      stats.exceptions.fetch_add(1, std::memory_order_relaxed);
+      break;
+    case Outcome::CANCELED:
+      stats.canceled.fetch_add(1, std::memory_order_relaxed);
+      break;
+  }
+}
+
+void RpcMethodHistograms::callSent(Method method, size_t sizeInWords) {
+  find(method).callWords.record(sizeInWords);
+}
+
+void RpcMethodHistograms::returnReceived(
+    Method method, size_t sizeInWords, kj::Duration latency, Outcome outcome) {
+  auto& stats = find(method);
+  stats.returnWords.record(sizeInWords);
+  stats.latencyNanos.record(latency / kj::NANOSECONDS);
+  recordOutcome(stats, outcome);
+}
+
+void RpcMethodHistograms::dispatchStarted(Method method, size_t sizeInWords) {
+  find(method).callWords.record(sizeInWords);
+}
+
+void RpcMethodHistograms::dispatchFinished(
+    Method method, size_t sizeInWords, kj::Duration duration, Outcome outcome) {
+  auto& stats = find(method);
+  if (sizeInWords > 0) stats.returnWords.record(sizeInWords);
+  stats.dispatchNanos.record(duration / kj::NANOSECONDS);
+  recordOutcome(stats, outcome);
+}
+
+kj::Array<RpcMethodHistograms::MethodStats> RpcMethodHistograms::getStats() const {
+  auto lock = methods.lockShared();
+
+  kj::Vector<const kj::HashMap<Key, kj::Own<Stats>>::Entry*> entries(lock->size());
+  for (auto& entry: *lock) {
+    entries.add(&entry);
+  }
+  std::sort(entries.begin(), entries.end(), [](auto a, auto b) {
+    return a->key.interfaceId < b->key.interfaceId ||
+        (a->key.interfaceId == b->key.interfaceId && a->key.methodId < b->key.methodId);
+  });
+
+  auto builder = kj::heapArrayBuilder<MethodStats>(entries.size());
+  for (auto entry: entries) {
+    builder.add(MethodStats {
+      { entry->key.interfaceId, entry->key.methodId }, *entry->value });
+  }
+  return builder.finish();
+}
+
+static kj::String statsToString(const RpcMethodHistograms::Stats& stats) {
+  return kj::str(
+      "latencyNanos{", stats.latencyNanos, "} dispatchNanos{", stats.dispatchNanos,
+      "} callWords{", stats.callWords, "} returnWords{", stats.returnWords,
+      "} exceptions=", stats.exceptions.load(std::memory_order_relaxed),
+      " canceled=", stats.canceled.load(std::memory_order_relaxed));
+}
+
+kj::String RpcMethodHistograms::toString() const {
+  kj::Vector<kj::String> lines;
+  for (auto& entry: getStats()) {
+    lines.add(kj::str(kj::hex(entry.method.interfaceId), '.', entry.method.methodId, ": ",
+                      statsToString(entry.stats), '\n'));
+  }
+  if (otherMethods.callWords.getCount() > 0) {
+    lines.add(kj::str("other: ", statsToString(otherMethods), '\n'));
+  }
+  return kj::strArray(lines, "");
+}
+
+static void statsToMessage(const RpcMethodHistograms::Stats& stats,
+                           rpc::instrumentation::MethodStats::Builder builder) {
+  stats.latencyNanos.toMessage(builder.initLatencyNanos());
+  stats.dispatchNanos.toMessage(builder.initDispatchNanos());
+  stats.callWords.toMessage(builder.initCallWords());
+  stats.returnWords.toMessage(builder.initReturnWords());
+  builder.setExceptions(stats.exceptions.load(std::memory_order_relaxed));
+  builder.setCanceled(stats.canceled.load(std::memory_order_relaxed));
+}
+
+void RpcMethodHistograms::toMessage(rpc::instrumentation::RpcStats::Builder builder) const {
+  auto stats = getStats();
+  auto list = builder.initMethods(stats.size());
+  for (auto i: kj::indices(stats)) {
+    list[i].setInterfaceId(stats[i].method.interfaceId);
+    list[i].setMethodId(stats[i].method.methodId);
+    statsToMessage(stats[i].stats, list[i]);
+  }
+  if (otherMethods.callWords.getCount() > 0) {
+    statsToMessage(otherMethods, builder.initOtherMethods());
+  }
+}
+
+}  // namespace capnp
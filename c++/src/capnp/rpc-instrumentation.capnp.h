@@ -0,0 +1,915 @@
+// Generated by Cap'n Proto compiler, DO NOT EDIT
+// source: rpc-instrumentation.capnp
+
+#pragma once
+
+#include <capnp/generated-header-support.h>
+#include <kj/windows-sanity.h>
+
+#ifndef CAPNP_VERSION
+#error "CAPNP_VERSION is not defined, is capnp/generated-header-support.h missing?"
+#elif CAPNP_VERSION != 2000000
+#error "Version mismatch between generated code and library headers.  You must use the same version of the Cap'n Proto compiler and library."
+#endif
+
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+namespace schemas {
+
+CAPNP_DECLARE_SCHEMA(b6a629c80ba6d3bc);
+CAPNP_DECLARE_SCHEMA(b5defde86cfc68f8);
+CAPNP_DECLARE_SCHEMA(e1d8005f02fd0e93);
+CAPNP_DECLARE_SCHEMA(b4983b3db0071b4f);
+
+}  // namespace schemas
+}  // namespace capnp
+
+namespace capnp {
+namespace rpc {
+namespace instrumentation {
+
+struct Histogram {
+  Histogram() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+  struct Bucket;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(b6a629c80ba6d3bc, 3, 1)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand() { return &schema->defaultBrand; }
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct Histogram::Bucket {
+  Bucket() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(b5defde86cfc68f8, 3, 0)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand() { return &schema->defaultBrand; }
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct MethodStats {
+  MethodStats() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(e1d8005f02fd0e93, 4, 4)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand() { return &schema->defaultBrand; }
+    #endif  // !CAPNP_LITE
+  };
+};
+
+struct RpcStats {
+  RpcStats() = delete;
+
+  class Reader;
+  class Builder;
+  class Pipeline;
+
+  struct _capnpPrivate {
+    CAPNP_DECLARE_STRUCT_HEADER(b4983b3db0071b4f, 0, 2)
+    #if !CAPNP_LITE
+    static constexpr ::capnp::_::RawBrandedSchema const* brand() { return &schema->defaultBrand; }
+    #endif  // !CAPNP_LITE
+  };
+};
+
+// =======================================================================================
+
+class Histogram::Reader {
+public:
+  typedef Histogram Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand());
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getCount() const;
+
+  inline  ::uint64_t getSum() const;
+
+  inline  ::uint64_t getMax() const;
+
+  inline bool hasBuckets() const;
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Reader getBuckets() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Histogram::Builder {
+public:
+  typedef Histogram Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getCount();
+  inline void setCount( ::uint64_t value);
+
+  inline  ::uint64_t getSum();
+  inline void setSum( ::uint64_t value);
+
+  inline  ::uint64_t getMax();
+  inline void setMax( ::uint64_t value);
+
+  inline bool hasBuckets();
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Builder getBuckets();
+  inline void setBuckets( ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Reader value);
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Builder initBuckets(unsigned int size);
+  inline void adoptBuckets(::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>> disownBuckets();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Histogram::Pipeline {
+public:
+  typedef Histogram Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class Histogram::Bucket::Reader {
+public:
+  typedef Bucket Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand());
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getLowerBound() const;
+
+  inline  ::uint64_t getUpperBound() const;
+
+  inline  ::uint64_t getCount() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class Histogram::Bucket::Builder {
+public:
+  typedef Bucket Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getLowerBound();
+  inline void setLowerBound( ::uint64_t value);
+
+  inline  ::uint64_t getUpperBound();
+  inline void setUpperBound( ::uint64_t value);
+
+  inline  ::uint64_t getCount();
+  inline void setCount( ::uint64_t value);
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class Histogram::Bucket::Pipeline {
+public:
+  typedef Bucket Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class MethodStats::Reader {
+public:
+  typedef MethodStats Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand());
+  }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getInterfaceId() const;
+
+  inline  ::uint16_t getMethodId() const;
+
+  inline bool hasLatencyNanos() const;
+  inline  ::capnp::rpc::instrumentation::Histogram::Reader getLatencyNanos() const;
+
+  inline bool hasDispatchNanos() const;
+  inline  ::capnp::rpc::instrumentation::Histogram::Reader getDispatchNanos() const;
+
+  inline bool hasCallWords() const;
+  inline  ::capnp::rpc::instrumentation::Histogram::Reader getCallWords() const;
+
+  inline bool hasReturnWords() const;
+  inline  ::capnp::rpc::instrumentation::Histogram::Reader getReturnWords() const;
+
+  inline  ::uint64_t getExceptions() const;
+
+  inline  ::uint64_t getCanceled() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class MethodStats::Builder {
+public:
+  typedef MethodStats Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline  ::uint64_t getInterfaceId();
+  inline void setInterfaceId( ::uint64_t value);
+
+  inline  ::uint16_t getMethodId();
+  inline void setMethodId( ::uint16_t value);
+
+  inline bool hasLatencyNanos();
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder getLatencyNanos();
+  inline void setLatencyNanos( ::capnp::rpc::instrumentation::Histogram::Reader value);
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder initLatencyNanos();
+  inline void adoptLatencyNanos(::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value);
+  inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> disownLatencyNanos();
+
+  inline bool hasDispatchNanos();
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder getDispatchNanos();
+  inline void setDispatchNanos( ::capnp::rpc::instrumentation::Histogram::Reader value);
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder initDispatchNanos();
+  inline void adoptDispatchNanos(::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value);
+  inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> disownDispatchNanos();
+
+  inline bool hasCallWords();
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder getCallWords();
+  inline void setCallWords( ::capnp::rpc::instrumentation::Histogram::Reader value);
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder initCallWords();
+  inline void adoptCallWords(::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value);
+  inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> disownCallWords();
+
+  inline bool hasReturnWords();
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder getReturnWords();
+  inline void setReturnWords( ::capnp::rpc::instrumentation::Histogram::Reader value);
+  inline  ::capnp::rpc::instrumentation::Histogram::Builder initReturnWords();
+  inline void adoptReturnWords(::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value);
+  inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> disownReturnWords();
+
+  inline  ::uint64_t getExceptions();
+  inline void setExceptions( ::uint64_t value);
+
+  inline  ::uint64_t getCanceled();
+  inline void setCanceled( ::uint64_t value);
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class MethodStats::Pipeline {
+public:
+  typedef MethodStats Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+  inline  ::capnp::rpc::instrumentation::Histogram::Pipeline getLatencyNanos();
+  inline  ::capnp::rpc::instrumentation::Histogram::Pipeline getDispatchNanos();
+  inline  ::capnp::rpc::instrumentation::Histogram::Pipeline getCallWords();
+  inline  ::capnp::rpc::instrumentation::Histogram::Pipeline getReturnWords();
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+class RpcStats::Reader {
+public:
+  typedef RpcStats Reads;
+
+  Reader() = default;
+  inline explicit Reader(::capnp::_::StructReader base): _reader(base) {}
+
+  inline ::capnp::MessageSize totalSize() const {
+    return _reader.totalSize().asPublic();
+  }
+
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const {
+    return ::capnp::_::structString(_reader, *_capnpPrivate::brand());
+  }
+#endif  // !CAPNP_LITE
+
+  inline bool hasMethods() const;
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Reader getMethods() const;
+
+  inline bool hasOtherMethods() const;
+  inline  ::capnp::rpc::instrumentation::MethodStats::Reader getOtherMethods() const;
+
+private:
+  ::capnp::_::StructReader _reader;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::List;
+  friend class ::capnp::MessageBuilder;
+  friend class ::capnp::Orphanage;
+};
+
+class RpcStats::Builder {
+public:
+  typedef RpcStats Builds;
+
+  Builder() = delete;  // Deleted to discourage incorrect usage.
+                       // You can explicitly initialize to nullptr instead.
+  inline Builder(decltype(nullptr)) {}
+  inline explicit Builder(::capnp::_::StructBuilder base): _builder(base) {}
+  inline operator Reader() const { return Reader(_builder.asReader()); }
+  inline Reader asReader() const { return *this; }
+
+  inline ::capnp::MessageSize totalSize() const { return asReader().totalSize(); }
+#if !CAPNP_LITE
+  inline ::kj::StringTree toString() const { return asReader().toString(); }
+#endif  // !CAPNP_LITE
+
+  inline bool hasMethods();
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Builder getMethods();
+  inline void setMethods( ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Reader value);
+  inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Builder initMethods(unsigned int size);
+  inline void adoptMethods(::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>&& value);
+  inline ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>> disownMethods();
+
+  inline bool hasOtherMethods();
+  inline  ::capnp::rpc::instrumentation::MethodStats::Builder getOtherMethods();
+  inline void setOtherMethods( ::capnp::rpc::instrumentation::MethodStats::Reader value);
+  inline  ::capnp::rpc::instrumentation::MethodStats::Builder initOtherMethods();
+  inline void adoptOtherMethods(::capnp::Orphan< ::capnp::rpc::instrumentation::MethodStats>&& value);
+  inline ::capnp::Orphan< ::capnp::rpc::instrumentation::MethodStats> disownOtherMethods();
+
+private:
+  ::capnp::_::StructBuilder _builder;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+  friend class ::capnp::Orphanage;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::_::PointerHelpers;
+};
+
+#if !CAPNP_LITE
+class RpcStats::Pipeline {
+public:
+  typedef RpcStats Pipelines;
+
+  inline Pipeline(decltype(nullptr)): _typeless(nullptr) {}
+  inline explicit Pipeline(::capnp::AnyPointer::Pipeline&& typeless)
+      : _typeless(kj::mv(typeless)) {}
+
+  inline  ::capnp::rpc::instrumentation::MethodStats::Pipeline getOtherMethods();
+private:
+  ::capnp::AnyPointer::Pipeline _typeless;
+  friend class ::capnp::PipelineHook;
+  template <typename, ::capnp::Kind>
+  friend struct ::capnp::ToDynamic_;
+};
+#endif  // !CAPNP_LITE
+
+// =======================================================================================
+
+inline  ::uint64_t Histogram::Reader::getCount() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Builder::getCount() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Builder::setCount( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t Histogram::Reader::getSum() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Builder::getSum() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Builder::setSum( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t Histogram::Reader::getMax() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Builder::getMax() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Builder::setMax( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS, value);
+}
+
+inline bool Histogram::Reader::hasBuckets() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline bool Histogram::Builder::hasBuckets() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Reader Histogram::Reader::getBuckets() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::get(_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Builder Histogram::Builder::getBuckets() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::get(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline void Histogram::Builder::setBuckets( ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::set(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>::Builder Histogram::Builder::initBuckets(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::init(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), size);
+}
+inline void Histogram::Builder::adoptBuckets(
+    ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::adopt(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>> Histogram::Builder::disownBuckets() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::Histogram::Bucket,  ::capnp::Kind::STRUCT>>::disown(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+
+inline  ::uint64_t Histogram::Bucket::Reader::getLowerBound() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Bucket::Builder::getLowerBound() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Bucket::Builder::setLowerBound( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t Histogram::Bucket::Reader::getUpperBound() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Bucket::Builder::getUpperBound() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Bucket::Builder::setUpperBound( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<1>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t Histogram::Bucket::Reader::getCount() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t Histogram::Bucket::Builder::getCount() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+inline void Histogram::Bucket::Builder::setCount( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t MethodStats::Reader::getInterfaceId() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t MethodStats::Builder::getInterfaceId() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS);
+}
+inline void MethodStats::Builder::setInterfaceId( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<0>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint16_t MethodStats::Reader::getMethodId() const {
+  return _reader.getDataField< ::uint16_t>(
+      ::capnp::bounded<4>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint16_t MethodStats::Builder::getMethodId() {
+  return _builder.getDataField< ::uint16_t>(
+      ::capnp::bounded<4>() * ::capnp::ELEMENTS);
+}
+inline void MethodStats::Builder::setMethodId( ::uint16_t value) {
+  _builder.setDataField< ::uint16_t>(
+      ::capnp::bounded<4>() * ::capnp::ELEMENTS, value);
+}
+
+inline bool MethodStats::Reader::hasLatencyNanos() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline bool MethodStats::Builder::hasLatencyNanos() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Reader MethodStats::Reader::getLatencyNanos() const {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::getLatencyNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::rpc::instrumentation::Histogram::Pipeline MethodStats::Pipeline::getLatencyNanos() {
+  return  ::capnp::rpc::instrumentation::Histogram::Pipeline(_typeless.getPointerField(0));
+}
+#endif  // !CAPNP_LITE
+inline void MethodStats::Builder::setLatencyNanos( ::capnp::rpc::instrumentation::Histogram::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::set(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::initLatencyNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::init(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline void MethodStats::Builder::adoptLatencyNanos(
+    ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::adopt(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> MethodStats::Builder::disownLatencyNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::disown(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+
+inline bool MethodStats::Reader::hasDispatchNanos() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS).isNull();
+}
+inline bool MethodStats::Builder::hasDispatchNanos() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Reader MethodStats::Reader::getDispatchNanos() const {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_reader.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::getDispatchNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::rpc::instrumentation::Histogram::Pipeline MethodStats::Pipeline::getDispatchNanos() {
+  return  ::capnp::rpc::instrumentation::Histogram::Pipeline(_typeless.getPointerField(1));
+}
+#endif  // !CAPNP_LITE
+inline void MethodStats::Builder::setDispatchNanos( ::capnp::rpc::instrumentation::Histogram::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::set(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::initDispatchNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::init(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+inline void MethodStats::Builder::adoptDispatchNanos(
+    ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::adopt(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> MethodStats::Builder::disownDispatchNanos() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::disown(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+
+inline bool MethodStats::Reader::hasCallWords() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS).isNull();
+}
+inline bool MethodStats::Builder::hasCallWords() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Reader MethodStats::Reader::getCallWords() const {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_reader.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS));
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::getCallWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::rpc::instrumentation::Histogram::Pipeline MethodStats::Pipeline::getCallWords() {
+  return  ::capnp::rpc::instrumentation::Histogram::Pipeline(_typeless.getPointerField(2));
+}
+#endif  // !CAPNP_LITE
+inline void MethodStats::Builder::setCallWords( ::capnp::rpc::instrumentation::Histogram::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::set(_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::initCallWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::init(_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS));
+}
+inline void MethodStats::Builder::adoptCallWords(
+    ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::adopt(_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> MethodStats::Builder::disownCallWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::disown(_builder.getPointerField(
+      ::capnp::bounded<2>() * ::capnp::POINTERS));
+}
+
+inline bool MethodStats::Reader::hasReturnWords() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS).isNull();
+}
+inline bool MethodStats::Builder::hasReturnWords() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Reader MethodStats::Reader::getReturnWords() const {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_reader.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS));
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::getReturnWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::get(_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::rpc::instrumentation::Histogram::Pipeline MethodStats::Pipeline::getReturnWords() {
+  return  ::capnp::rpc::instrumentation::Histogram::Pipeline(_typeless.getPointerField(3));
+}
+#endif  // !CAPNP_LITE
+inline void MethodStats::Builder::setReturnWords( ::capnp::rpc::instrumentation::Histogram::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::set(_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::rpc::instrumentation::Histogram::Builder MethodStats::Builder::initReturnWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::init(_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS));
+}
+inline void MethodStats::Builder::adoptReturnWords(
+    ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::adopt(_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::rpc::instrumentation::Histogram> MethodStats::Builder::disownReturnWords() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::Histogram>::disown(_builder.getPointerField(
+      ::capnp::bounded<3>() * ::capnp::POINTERS));
+}
+
+inline  ::uint64_t MethodStats::Reader::getExceptions() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t MethodStats::Builder::getExceptions() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS);
+}
+inline void MethodStats::Builder::setExceptions( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<2>() * ::capnp::ELEMENTS, value);
+}
+
+inline  ::uint64_t MethodStats::Reader::getCanceled() const {
+  return _reader.getDataField< ::uint64_t>(
+      ::capnp::bounded<3>() * ::capnp::ELEMENTS);
+}
+
+inline  ::uint64_t MethodStats::Builder::getCanceled() {
+  return _builder.getDataField< ::uint64_t>(
+      ::capnp::bounded<3>() * ::capnp::ELEMENTS);
+}
+inline void MethodStats::Builder::setCanceled( ::uint64_t value) {
+  _builder.setDataField< ::uint64_t>(
+      ::capnp::bounded<3>() * ::capnp::ELEMENTS, value);
+}
+
+inline bool RpcStats::Reader::hasMethods() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline bool RpcStats::Builder::hasMethods() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Reader RpcStats::Reader::getMethods() const {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::get(_reader.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Builder RpcStats::Builder::getMethods() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::get(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+inline void RpcStats::Builder::setMethods( ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::set(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>::Builder RpcStats::Builder::initMethods(unsigned int size) {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::init(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), size);
+}
+inline void RpcStats::Builder::adoptMethods(
+    ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::adopt(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>> RpcStats::Builder::disownMethods() {
+  return ::capnp::_::PointerHelpers< ::capnp::List< ::capnp::rpc::instrumentation::MethodStats,  ::capnp::Kind::STRUCT>>::disown(_builder.getPointerField(
+      ::capnp::bounded<0>() * ::capnp::POINTERS));
+}
+
+inline bool RpcStats::Reader::hasOtherMethods() const {
+  return !_reader.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS).isNull();
+}
+inline bool RpcStats::Builder::hasOtherMethods() {
+  return !_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS).isNull();
+}
+inline  ::capnp::rpc::instrumentation::MethodStats::Reader RpcStats::Reader::getOtherMethods() const {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::get(_reader.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+inline  ::capnp::rpc::instrumentation::MethodStats::Builder RpcStats::Builder::getOtherMethods() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::get(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+#if !CAPNP_LITE
+inline  ::capnp::rpc::instrumentation::MethodStats::Pipeline RpcStats::Pipeline::getOtherMethods() {
+  return  ::capnp::rpc::instrumentation::MethodStats::Pipeline(_typeless.getPointerField(1));
+}
+#endif  // !CAPNP_LITE
+inline void RpcStats::Builder::setOtherMethods( ::capnp::rpc::instrumentation::MethodStats::Reader value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::set(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS), value);
+}
+inline  ::capnp::rpc::instrumentation::MethodStats::Builder RpcStats::Builder::initOtherMethods() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::init(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+inline void RpcStats::Builder::adoptOtherMethods(
+    ::capnp::Orphan< ::capnp::rpc::instrumentation::MethodStats>&& value) {
+  ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::adopt(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS), kj::mv(value));
+}
+inline ::capnp::Orphan< ::capnp::rpc::instrumentation::MethodStats> RpcStats::Builder::disownOtherMethods() {
+  return ::capnp::_::PointerHelpers< ::capnp::rpc::instrumentation::MethodStats>::disown(_builder.getPointerField(
+      ::capnp::bounded<1>() * ::capnp::POINTERS));
+}
+
+}  // namespace
+}  // namespace
+}  // namespace
+
+CAPNP_END_HEADER
+
@@ -0,0 +1,211 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <capnp/common.h>
+#include <capnp/rpc-instrumentation.capnp.h>
+#include <kj/map.h>
+#include <kj/mutex.h>
+#include <kj/string.h>
+#include <kj/time.h>
+#include <atomic>
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+
+class RpcInstrumentation {
+  // Callbacks an RpcSystem makes as calls pass through it, for collecting per-method latency and
+  // size statistics. See RpcSystem::setInstrumentation(). RpcMethodHistograms, below, is a
+  // ready-made implementation.
+  //
+  // Callbacks are made on the RpcSystem's thread, in the middle of handling messages, so they
+  // should be quick and must not throw. When no instrumentation is set, the RpcSystem doesn't
+  // even read the clock.
+
+public:
+  virtual ~RpcInstrumentation() noexcept(false) = default;
+
+  struct Method {
+    uint64_t interfaceId;
+    uint16_t methodId;
+  };
+
+  enum class Outcome {
+    RESULTS,
+    // The call returned results (or, for a tail call, sent them elsewhere).
+
+    EXCEPTION,
+    // The call threw an exception.
+
+    CANCELED
+    // The caller canceled the call before it returned.
+  };
+
+  virtual void callSent(Method method, size_t sizeInWords) {}
+  // A Call message was handed to the VatNetwork to be sent. The network may queue it before
+  // writing it.
+
+  virtual void returnReceived(Method method, size_t sizeInWords, kj::Duration latency,
+                              Outcome outcome) {}
+  // The Return for a call sent earlier arrived, `latency` after callSent(). Not called for calls
+  // made with `sendForPipeline()`, which get no Return, nor for calls still outstanding when the
+  // connection fails.
+
+  virtual void dispatchStarted(Method method, size_t sizeInWords) {}
+  // A Call message was received and is about to be delivered to the target capability.
+
+  virtual void dispatchFinished(Method method, size_t sizeInWords, kj::Duration duration,
+                                Outcome outcome) {}
+  // The call received in the matching dispatchStarted() finished, `duration` later.
+  // `sizeInWords` is the size of the Return sent, or zero if none was sent. Neither this nor
+  // dispatchStarted() is called for calls made with `sendForPipeline()`, which want no Return.
+};
+
+class RpcHistogram {
+  // A log-linear ("HDR-style") histogram of unsigned 64-bit values. Values are counted in
+  // buckets whose width is 1/16 of their magnitude, so any percentile read back is within 6.25%
+  // of the true value, across the whole 64-bit range, in fixed space.
+  //
+  // record() is lock-free and may be called from any thread at the same time as any other
+  // method. Readers see a snapshot that may be slightly inconsistent while writes are in flight.
+
+public:
+  static constexpr uint SUB_BUCKET_BITS = 4;
+  static constexpr uint SUB_BUCKET_COUNT = 1u << SUB_BUCKET_BITS;
+  static constexpr uint BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+  void record(uint64_t value);
+
+  uint64_t getCount() const { return count.load(std::memory_order_relaxed); }
+  uint64_t getSum() const { return sum.load(std::memory_order_relaxed); }
+  uint64_t getMax() const { return max.load(std::memory_order_relaxed); }
+
+  uint64_t getPercentile(double percentile) const;
+  // Returns the upper bound of the bucket holding the value at the given percentile (0-100), or
+  // zero if nothing has been recorded.
+
+  struct Bucket {
+    uint64_t lowerBound;
+    uint64_t upperBound;
+    // Inclusive range of values counted in this bucket.
+
+    uint64_t count;
+  };
+
+  kj::Array<Bucket> getBuckets() const;
+  // Returns the non-empty buckets in increasing order, e.g. for copying into a message of your
+  // own schema.
+
+  kj::String toString() const;
+  // Summarizes as "count=... mean=... p50=... p90=... p99=... p999=... max=...".
+
+  void toMessage(rpc::instrumentation::Histogram::Builder builder) const;
+  // Copies the counts and non-empty buckets into `builder`.
+
+  static uint bucketIndex(uint64_t value);
+  static Bucket bucketRange(uint index);
+
+private:
+  std::atomic<uint64_t> counts[BUCKET_COUNT] = {};
+  std::atomic<uint64_t> count{0};
+  std::atomic<uint64_t> sum{0};
+  std::atomic<uint64_t> max{0};
+};
+
+class RpcMethodHistograms final: public RpcInstrumentation {
+  // RpcInstrumentation which keeps histograms of latency and message sizes for each method.
+  //
+  // A single instance may be shared by several RpcSystems, including ones on different threads,
+  // and read from any thread while they run.
+
+public:
+  struct Stats {
+    RpcHistogram latencyNanos;
+    // Time from sending each Call to receiving its Return (client side).
+
+    RpcHistogram dispatchNanos;
+    // Time from receiving each Call to sending its Return (server side).
+
+    RpcHistogram callWords;
+    RpcHistogram returnWords;
+    // Sizes of the Call and Return messages, whether sent or received.
+
+    std::atomic<uint64_t> exceptions{0};
+    std::atomic<uint64_t> canceled{0};
+    // Calls that ended other than by returning results, on either side.
+  };
+
+  struct MethodStats {
+    Method method;
+    const Stats& stats;
+  };
+
+  static constexpr size_t MAX_METHODS = 1024;
+  // Each Stats is about 31 KiB, and a peer chooses which method IDs it calls, so only this many
+  // methods get their own Stats. Calls to any further methods are counted in getOtherStats().
+
+  kj::Array<MethodStats> getStats() const;
+  // Returns every method seen so far, up to MAX_METHODS, sorted by interface and method ID. The
+  // Stats live as long as this object.
+
+  const Stats& getOtherStats() const { return otherMethods; }
+  // Combined stats for calls to methods seen after MAX_METHODS others.
+
+  kj::String toString() const;
+  // Dumps every method's histograms as text, one line each.
+
+  void toMessage(rpc::instrumentation::RpcStats::Builder builder) const;
+  // Dumps every method's histograms in full into `builder`. Write the message to a file to
+  // inspect it with `capnp decode capnp/rpc-instrumentation.capnp RpcStats`.
+
+  void callSent(Method method, size_t sizeInWords) override;
+  void returnReceived(Method method, size_t sizeInWords, kj::Duration latency,
+                      Outcome outcome) override;
+  void dispatchStarted(Method method, size_t sizeInWords) override;
+  void dispatchFinished(Method method, size_t sizeInWords, kj::Duration duration,
+                        Outcome outcome) override;
+
+private:
+  struct Key {
+    uint64_t interfaceId;
+    uint16_t methodId;
+
+    inline bool operator==(const Key& other) const {
+      return interfaceId == other.interfaceId && methodId == other.methodId;
+    }
+    inline uint hashCode() const { return kj::hashCode(interfaceId, methodId); }
+  };
+
+  kj::MutexGuarded<kj::HashMap<Key, kj::Own<Stats>>> methods;
+  // Entries are never removed, so a Stats may be used outside the lock once found. Lookups take
+  // a shared lock; only a method's first call takes an exclusive one.
+
+  Stats otherMethods;
+
+  Stats& find(Method method);
+  void recordOutcome(Stats& stats, Outcome outcome);
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
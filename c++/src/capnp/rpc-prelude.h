@@ -38,6 +38,62 @@ class RpcFlowController;
 template <typename SturdyRefHostId>
 class RpcSystem;
 
+struct RpcMethodMessageSizes {
+  // What an RpcSystem has learned about the size of one interface method's messages. See
+  // RpcSystem::getLearnedMessageSizes().
+
+  uint64_t interfaceId;
+  uint16_t methodId;
+
+  struct Direction {
+    uint64_t count;
+    // Number of messages recorded.
+
+    uint64_t meanWords;
+    uint64_t deviationWords;
+    // Moving averages of the message size and of its deviation from the mean.
+
+    uint firstSegmentWords;
+    // First segment size suggested for the next message.
+  };
+
+  Direction calls;
+  // Call messages sent to this method.
+
+  Direction returns;
+  // Return messages sent in response to calls to this method.
+};
+
+class RpcInstrumentation;
+
+struct RpcConnectionStats {
+  // Memory used by one RPC connection's tables. See RpcSystem::getConnectionStats().
+
+  AnyStruct::Reader peerVatId;
+  // The peer's VatId, or null if the connection has already failed. Only valid until the
+  // connection is dropped.
+
+  struct Table {
+    size_t entries;
+    // Entries currently in use.
+
+    size_t highWaterMark;
+    // Most entries ever in use at once.
+
+    size_t capacity;
+    // Entries the table has room for without allocating.
+
+    size_t bytes;
+    // Approximate heap memory held by the table itself, not counting what the entries point to.
+  };
+
+  Table questions;
+  Table answers;
+  Table exports;
+  Table imports;
+  Table embargoes;
+};
+
 namespace _ {  // private
 
 [[noreturn]] void throwNo3ph();
@@ -102,6 +158,11 @@ public:
   ~RpcSystemBase() noexcept(false);
 
   void setTraceEncoder(kj::Function<kj::String(const kj::Exception&)> func);
+  void setInstrumentation(kj::Maybe<RpcInstrumentation&> instrumentation);
+  void setStreamFlowController(Capability::Client cap, kj::Own<RpcFlowController> controller);
+
+  kj::Array<RpcMethodMessageSizes> getLearnedMessageSizes();
+  kj::Array<RpcConnectionStats> getConnectionStats();
 
   kj::Promise<void> run();
 
@@ -592,6 +592,113 @@ KJ_TEST("FD per message limit") {
   KJ_EXPECT(io.lowLevelProvider->wrapInputFd(kj::mv(in2))->readAllText().wait(io.waitScope)
             == "foo");
 }
+
+#if __linux__
+class TestLargeDataImpl final: public test::TestInterface::Server {
+public:
+  size_t dataSize = 0;
+  bool dataIntact = false;
+  bool dataPageAligned = false;
+
+  kj::Promise<void> baz(BazContext context) override {
+    auto data = context.getParams().getS().getDataField();
+    dataSize = data.size();
+    dataIntact = true;
+    for (auto i: kj::indices(data)) {
+      if (data[i] != byte(i * 7)) {
+        dataIntact = false;
+        break;
+      }
+    }
+    // An in-place mapping of an out-of-band segment starts on a page boundary, and the blob
+    // starts its segment. A copy into a socket read buffer essentially never would.
+    dataPageAligned = reinterpret_cast<uintptr_t>(data.begin()) % 4096 == 0;
+    return kj::READY_NOW;
+  }
+};
+
+KJ_TEST("large Data is passed out-of-band in a sealed memfd") {
+  auto io = kj::setupAsyncIo();
+
+  auto pipe = io.provider->newCapabilityPipe();
+  auto ownServer = kj::heap<TestLargeDataImpl>();
+  auto& server = *ownServer;
+  TwoPartyClient client(*pipe.ends[0], 1);
+  TwoPartyClient tpServer(*pipe.ends[1], 1, kj::mv(ownServer), rpc::twoparty::Side::SERVER);
+  client.getNetwork().setOutOfBandThreshold(65536);
+
+  auto cap = client.bootstrap().castAs<test::TestInterface>();
+
+  constexpr size_t DATA_SIZE = 4 << 20;
+  {
+    auto req = cap.bazRequest();
+    auto data = req.initS().initDataField(DATA_SIZE);
+    for (auto i: kj::indices(data)) {
+      data[i] = byte(i * 7);
+    }
+    req.send().wait(io.waitScope);
+  }
+  KJ_EXPECT(server.dataSize == DATA_SIZE);
+  KJ_EXPECT(server.dataIntact);
+  KJ_EXPECT(server.dataPageAligned);
+
+  // Small messages still go in-band, and the connection keeps working.
+  {
+    auto req = cap.bazRequest();
+    req.initS().initDataField(16);
+    req.send().wait(io.waitScope);
+  }
+  KJ_EXPECT(server.dataSize == 16);
+}
+
+class TestDataListImpl final: public test::TestInterface::Server {
+public:
+  size_t blobCount = 0;
+  bool blobsIntact = false;
+
+  kj::Promise<void> baz(BazContext context) override {
+    auto list = context.getParams().getS().getDataList();
+    blobCount = list.size();
+    blobsIntact = true;
+    for (auto i: kj::indices(list)) {
+      for (auto b: list[i]) {
+        if (b != byte(i)) blobsIntact = false;
+      }
+    }
+    return kj::READY_NOW;
+  }
+};
+
+KJ_TEST("out-of-band segments stop at the per-message FD limit") {
+  auto io = kj::setupAsyncIo();
+
+  auto pipe = io.provider->newCapabilityPipe();
+  auto ownServer = kj::heap<TestDataListImpl>();
+  auto& server = *ownServer;
+  TwoPartyClient client(*pipe.ends[0], 300);
+  TwoPartyClient tpServer(*pipe.ends[1], 300, kj::mv(ownServer), rpc::twoparty::Side::SERVER);
+  client.getNetwork().setOutOfBandThreshold(4096);
+
+  auto cap = client.bootstrap().castAs<test::TestInterface>();
+
+  // Each external blob gets a segment of its own, so this is more large segments than can be
+  // passed as FDs at once. The rest have to go in-band.
+  constexpr uint BLOB_COUNT = 300;
+  kj::Vector<kj::Array<word>> blobs;
+  auto req = cap.bazRequest();
+  auto orphanage = Orphanage::getForMessageContaining(req.initS());
+  auto list = req.getS().initDataList(BLOB_COUNT);
+  for (auto i: kj::zeroTo(BLOB_COUNT)) {
+    auto& blob = blobs.add(kj::heapArray<word>(4096 / sizeof(word)));
+    memset(blob.begin(), i, blob.asBytes().size());
+    list.adopt(i, orphanage.referenceExternalData(Data::Reader(blob.asBytes())));
+  }
+  req.send().wait(io.waitScope);
+
+  KJ_EXPECT(server.blobCount == BLOB_COUNT);
+  KJ_EXPECT(server.blobsIntact);
+}
+#endif  // __linux__
 #endif  // !_WIN32 && !__CYGWIN__
 
 // =======================================================================================
@@ -879,6 +986,138 @@ KJ_TEST("Streaming over RPC then unwrap with CapabilitySet") {
   promise.wait(waitScope);
 }
 
+// =======================================================================================
+
+class SimulatedLink final: public kj::AsyncIoStream {
+  // Wraps one end of a pipe so that data written to it crosses a simulated link with the given
+  // bandwidth and one-way delay, as measured by `timer`. Writes complete once the link has
+  // finished transmitting them, so a sender that writes faster than the link builds a queue on
+  // its side, as it would in front of a real bottleneck.
+
+public:
+  SimulatedLink(kj::AsyncIoStream& inner, kj::TimerImpl& timer,
+                uint64_t bytesPerSecond, kj::Duration delay)
+      : inner(inner), timer(timer), bytesPerSecond(bytesPerSecond), delay(delay),
+        linkFreeAt(timer.now()) {}
+
+  kj::Promise<size_t> tryRead(void* buffer, size_t minBytes, size_t maxBytes) override {
+    return inner.tryRead(buffer, minBytes, maxBytes);
+  }
+  kj::Promise<void> write(kj::ArrayPtr<const byte> buffer) override {
+    return write(kj::arrayPtr(&buffer, 1));
+  }
+  kj::Promise<void> write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    size_t size = 0;
+    for (auto& piece: pieces) size += piece.size();
+    auto data = kj::heapArray<byte>(size);
+    byte* pos = data.begin();
+    for (auto& piece: pieces) {
+      memcpy(pos, piece.begin(), piece.size());
+      pos += piece.size();
+    }
+
+    int64_t transmitNanos = size * uint64_t(1000000000) / bytesPerSecond;
+    linkFreeAt = kj::max(timer.now(), linkFreeAt) + transmitNanos * kj::NANOSECONDS;
+    auto arrival = linkFreeAt + delay;
+
+    // Deliver in order, each write no earlier than its arrival time.
+    delivery = delivery.then([this, arrival]() {
+      return timer.atTime(arrival);
+    }).then([this, data = kj::mv(data)]() mutable {
+      return inner.write(data).attach(kj::mv(data));
+    }).eagerlyEvaluate([](kj::Exception&& e) { KJ_LOG(ERROR, e); });
+
+    return timer.atTime(linkFreeAt);
+  }
+  kj::Promise<void> whenWriteDisconnected() override { return inner.whenWriteDisconnected(); }
+  void shutdownWrite() override {
+    delivery = delivery.then([this]() { inner.shutdownWrite(); }).eagerlyEvaluate(nullptr);
+  }
+  void abortRead() override { inner.abortRead(); }
+
+private:
+  kj::AsyncIoStream& inner;
+  kj::TimerImpl& timer;
+  uint64_t bytesPerSecond;
+  kj::Duration delay;
+  kj::TimePoint linkFreeAt;
+  kj::Promise<void> delivery = kj::READY_NOW;
+};
+
+class TestDataStreamImpl final: public test::TestStreaming::Server {
+public:
+  uint64_t received = 0;
+
+  kj::Promise<void> doStreamData(DoStreamDataContext context) override {
+    received += context.getParams().getData().size();
+    return kj::READY_NOW;
+  }
+};
+
+uint64_t streamOverSimulatedLink(
+    kj::Maybe<kj::Function<kj::Own<RpcFlowController>(kj::Timer&)>> makeController,
+    uint64_t bytesPerSecond, kj::Duration delay, kj::Duration duration) {
+  // Streams 16kB chunks as fast as flow control allows across a simulated link for `duration` of
+  // simulated time, and returns how many bytes of chunk data the server received.
+
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>());
+
+  auto pipe = kj::newTwoWayPipe();
+  SimulatedLink clientLink(*pipe.ends[0], timer, bytesPerSecond, delay);
+  SimulatedLink serverLink(*pipe.ends[1], timer, bytesPerSecond, delay);
+
+  auto ownServer = kj::heap<TestDataStreamImpl>();
+  auto& server = *ownServer;
+
+  TwoPartyClient client(clientLink);
+  TwoPartyClient tpServer(serverLink, kj::mv(ownServer), rpc::twoparty::Side::SERVER);
+
+  auto cap = client.bootstrap().castAs<test::TestStreaming>();
+
+  KJ_IF_SOME(f, makeController) {
+    client.getRpcSystem().setStreamFlowController(cap, f(timer));
+  }
+
+  auto chunk = kj::heapArray<byte>(16384);
+  chunk.asPtr().fill(0);
+
+  auto end = timer.now() + duration;
+  kj::Promise<void> promise = kj::READY_NOW;
+  while (timer.now() < end) {
+    if (promise.poll(waitScope)) {
+      promise.wait(waitScope);
+      auto req = cap.doStreamDataRequest();
+      req.setData(chunk);
+      promise = req.send();
+    } else {
+      // Nothing more can happen until simulated time passes.
+      timer.advanceTo(KJ_ASSERT_NONNULL(timer.nextEvent()));
+    }
+  }
+
+  return server.received;
+}
+
+KJ_TEST("paced flow controller fills a long fat link") {
+  // 10MB/s with 50ms each way: the bandwidth-delay product is 1MB, far beyond the 64kB window
+  // the default controller falls back to when the socket can't report its send buffer size.
+  constexpr uint64_t BYTES_PER_SECOND = 10 * 1000 * 1000;
+  constexpr kj::Duration DELAY = 50 * kj::MILLISECONDS;
+  constexpr kj::Duration DURATION = 3 * kj::SECONDS;
+  constexpr uint64_t CAPACITY = BYTES_PER_SECOND * (DURATION / kj::MILLISECONDS) / 1000;
+
+  auto defaultBytes = streamOverSimulatedLink(kj::none, BYTES_PER_SECOND, DELAY, DURATION);
+  auto pacedBytes = streamOverSimulatedLink(
+      kj::Function<kj::Own<RpcFlowController>(kj::Timer&)>([](kj::Timer& timer) {
+        return RpcFlowController::newPacedController(timer);
+      }), BYTES_PER_SECOND, DELAY, DURATION);
+
+  KJ_EXPECT(pacedBytes > CAPACITY / 2, pacedBytes, CAPACITY);
+  KJ_EXPECT(pacedBytes > defaultBytes * 4, pacedBytes, defaultBytes);
+}
+
 KJ_TEST("promise cap resolves between starting request and sending it") {
   kj::EventLoop loop;
   kj::WaitScope waitScope(loop);
@@ -957,6 +1196,63 @@ KJ_TEST("write error propagates to read error") {
   }
 }
 
+KJ_TEST("TwoPartyVatNetwork sends URGENT messages ahead of queued BULK messages") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  auto pipe = kj::newTwoWayPipe();
+
+  TwoPartyVatNetwork network(*pipe.ends[0], rpc::twoparty::Side::CLIENT);
+  network.setBulkWriteQuantum(64 * 1024);
+
+  MallocMessageBuilder refMessage(128);
+  auto hostId = refMessage.initRoot<rpc::twoparty::VatId>();
+  hostId.setSide(rpc::twoparty::Side::SERVER);
+  auto conn = KJ_ASSERT_NONNULL(network.connect(hostId));
+  conn->setIdle(false);
+
+  auto send = [&](uint id, MessagePriority priority) {
+    // BULK messages are 40k, so only one fits in a 64k quantum.
+    size_t dataBytes = priority == MessagePriority::BULK ? 40 * 1024 : 0;
+    auto msg = conn->newOutgoingMessage(dataBytes / sizeof(word) + 64);
+    auto body = msg->getBody().initAs<TestAllTypes>();
+    body.setUInt32Field(id);
+    body.initDataField(dataBytes);
+    msg->setPriority(priority);
+    msg->send();
+  };
+  auto expectReceived = [&](std::initializer_list<uint> ids) {
+    for (uint id: ids) {
+      auto message = readMessage(*pipe.ends[1]).wait(waitScope);
+      KJ_EXPECT(message->getRoot<TestAllTypes>().getUInt32Field() == id);
+    }
+  };
+
+  // URGENT messages skip over BULK messages at the end of the queue, but not over NORMAL ones.
+  send(1, MessagePriority::NORMAL);
+  send(2, MessagePriority::BULK);
+  send(3, MessagePriority::BULK);
+  send(4, MessagePriority::URGENT);
+  send(5, MessagePriority::BULK);
+  send(6, MessagePriority::URGENT);
+  send(7, MessagePriority::NORMAL);
+  send(8, MessagePriority::URGENT);
+  expectReceived({1, 4, 6, 2, 3, 5, 7, 8});
+
+  // Only one quantum of BULK messages is written at a time, so an URGENT message sent while
+  // they're being written only waits for the current one.
+  send(9, MessagePriority::BULK);
+  send(10, MessagePriority::BULK);
+  send(11, MessagePriority::BULK);
+  waitScope.poll();
+  KJ_EXPECT(network.getCurrentQueueCount() == 2);
+  send(12, MessagePriority::URGENT);
+  expectReceived({9, 12, 10, 11});
+
+  waitScope.poll();
+  KJ_EXPECT(network.getCurrentQueueCount() == 0);
+  KJ_EXPECT(network.getCurrentQueueSize() == 0);
+}
+
 class TestStreamingCancellationBug final: public test::TestStreaming::Server {
 public:
   uint iSum = 0;
@@ -978,6 +1274,148 @@ public:
   }
 };
 
+KJ_TEST("RpcSystem learns per-method message sizes") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+
+  int callCount = 0;
+  TwoPartyClient tpClient(*pipe.ends[0]);
+  TwoPartyClient tpServer(*pipe.ends[1], kj::heap<TestTailCalleeImpl>(callCount),
+                          rpc::twoparty::Side::SERVER);
+  auto& rpcClient = tpClient.getRpcSystem();
+  auto& rpcServer = tpServer.getRpcSystem();
+
+  auto client = tpClient.bootstrap().castAs<test::TestTailCallee>();
+
+  // Send calls without size hints whose params and results are both bigger than a default first
+  // segment.
+  auto text = kj::heapString(SUGGESTED_FIRST_SEGMENT_WORDS * sizeof(word) * 2);
+  for (char& c: text) c = 'x';
+
+  constexpr uint CALL_COUNT = 8;
+  for (uint i = 0; i < CALL_COUNT; i++) {
+    auto req = client.fooRequest();
+    req.setI(i);
+    req.setT(text);
+    auto response = req.send().wait(waitScope);
+    KJ_EXPECT(response.getT().size() == text.size());
+  }
+  KJ_EXPECT(callCount == CALL_COUNT);
+
+  auto expectLearned = [&](kj::ArrayPtr<const RpcMethodMessageSizes> sizes, bool calls) {
+    KJ_ASSERT(sizes.size() == 1);
+    KJ_EXPECT(sizes[0].interfaceId == typeId<test::TestTailCallee>());
+    KJ_EXPECT(sizes[0].methodId == 0);
+
+    auto& learned = calls ? sizes[0].calls : sizes[0].returns;
+    auto& other = calls ? sizes[0].returns : sizes[0].calls;
+    KJ_EXPECT(learned.count == CALL_COUNT);
+    KJ_EXPECT(learned.meanWords >= text.size() / sizeof(word), learned.meanWords);
+    KJ_EXPECT(learned.firstSegmentWords >= learned.meanWords, learned.firstSegmentWords);
+    KJ_EXPECT(other.count == 0);
+  };
+
+  // The client only learned about calls; the server only about returns.
+  expectLearned(rpcClient.getLearnedMessageSizes(), true);
+  expectLearned(rpcServer.getLearnedMessageSizes(), false);
+}
+
+KJ_TEST("RpcSystem doesn't learn sizes for methods the server doesn't implement") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+
+  int callCount = 0;
+  TwoPartyClient tpClient(*pipe.ends[0]);
+  TwoPartyClient tpServer(*pipe.ends[1], kj::heap<TestTailCalleeImpl>(callCount),
+                          rpc::twoparty::Side::SERVER);
+  auto& rpcClient = tpClient.getRpcSystem();
+  auto& rpcServer = tpServer.getRpcSystem();
+
+  auto client = tpClient.bootstrap();
+
+  // Call lots of made-up methods, as a hostile peer might to fill up the server's table.
+  constexpr uint JUNK_COUNT = 300;
+  for (uint i = 0; i < JUNK_COUNT; i++) {
+    auto promise = client.typelessRequest(0x1234567890abcdefull, i, kj::none, {}).send();
+    KJ_EXPECT(promise.then([](auto&&) { return false; }, [](kj::Exception&& e) {
+      return e.getType() == kj::Exception::Type::UNIMPLEMENTED;
+    }).wait(waitScope));
+  }
+
+  KJ_EXPECT(rpcServer.getLearnedMessageSizes().size() == 0);
+  KJ_EXPECT(rpcClient.getLearnedMessageSizes().size() < JUNK_COUNT);
+
+  // The server still learns about methods that it does implement.
+  auto req = client.castAs<test::TestTailCallee>().fooRequest();
+  req.setT("foo");
+  req.send().wait(waitScope);
+
+  auto learned = rpcServer.getLearnedMessageSizes();
+  KJ_ASSERT(learned.size() == 1);
+  KJ_EXPECT(learned[0].interfaceId == typeId<test::TestTailCallee>());
+  KJ_EXPECT(learned[0].returns.count == 1);
+}
+
+KJ_TEST("RpcSystem compacts connection tables after a burst of calls") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  auto pipe = kj::newTwoWayPipe();
+
+  int callCount = 0;
+  TwoPartyClient tpClient(*pipe.ends[0]);
+  TwoPartyClient tpServer(*pipe.ends[1], kj::heap<TestTailCalleeImpl>(callCount),
+                          rpc::twoparty::Side::SERVER);
+  auto& rpcClient = tpClient.getRpcSystem();
+  auto& rpcServer = tpServer.getRpcSystem();
+
+  auto client = tpClient.bootstrap().castAs<test::TestTailCallee>();
+
+  auto call = [&](uint i) {
+    auto req = client.fooRequest();
+    req.setI(i);
+    req.setT("foo");
+    return req.send();
+  };
+
+  // Make a lot of calls at once, and hold on to the responses so that no Finish is sent until
+  // all have returned. The client's question table and the server's answer table both grow.
+  constexpr uint CALL_COUNT = 200;
+  {
+    kj::Vector<RemotePromise<test::TestTailCallee::TailResult>> promises;
+    for (uint i = 0; i < CALL_COUNT; i++) {
+      promises.add(call(i));
+    }
+    kj::Vector<Response<test::TestTailCallee::TailResult>> responses;
+    for (auto& promise: promises) {
+      responses.add(promise.wait(waitScope));
+    }
+  }
+
+  // One more call gives each side a chance to compact once the burst's entries are released.
+  call(CALL_COUNT).wait(waitScope);
+  KJ_EXPECT(callCount == CALL_COUNT + 1);
+
+  auto clientStats = rpcClient.getConnectionStats();
+  KJ_ASSERT(clientStats.size() == 1);
+  auto& questions = clientStats[0].questions;
+  KJ_EXPECT(questions.highWaterMark >= CALL_COUNT, questions.highWaterMark);
+  KJ_EXPECT(questions.entries < 4, questions.entries);
+  KJ_EXPECT(questions.capacity < CALL_COUNT / 2, questions.capacity);
+  KJ_EXPECT(clientStats[0].peerVatId.as<rpc::twoparty::VatId>().getSide() ==
+            rpc::twoparty::Side::SERVER);
+
+  auto serverStats = rpcServer.getConnectionStats();
+  KJ_ASSERT(serverStats.size() == 1);
+  auto& answers = serverStats[0].answers;
+  KJ_EXPECT(answers.highWaterMark >= CALL_COUNT, answers.highWaterMark);
+  KJ_EXPECT(answers.capacity < CALL_COUNT / 2, answers.capacity);
+}
+
 KJ_TEST("Streaming over RPC no premature cancellation when client dropped") {
   kj::EventLoop loop;
   kj::WaitScope waitScope(loop);
@@ -24,8 +24,107 @@
 #include <kj/debug.h>
 #include <kj/io.h>
 
+#if __linux__
+#include <kj/filesystem.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#endif
+
 namespace capnp {
 
+#if __linux__
+namespace {
+
+// An out-of-band segment is sent as an empty segment in the stream framing, and its contents as a
+// sealed memfd. The memfds are the last FDs attached to the message, after any FDs the RPC system
+// attached, in the same order as the empty segments. A Cap'n Proto builder never produces an
+// empty segment, so a message with FDs and an empty segment can only be one of these.
+constexpr int OUT_OF_BAND_SEALS = F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE;
+
+constexpr size_t MAX_FDS_PER_SENDMSG = 253;
+// The kernel's SCM_MAX_FD, which isn't exported to userspace. sendmsg() fails with EINVAL if a
+// message carries more FDs than this.
+
+class OutOfBandMessageReader final: public MessageReader {
+  // Presents a received message with its out-of-band segments replaced by read-only mappings of
+  // the memfds that carried them.
+
+public:
+  OutOfBandMessageReader(kj::Own<MessageReader> inner,
+                         kj::Array<kj::ArrayPtr<const word>> segments,
+                         kj::Array<kj::Array<const byte>> mappings,
+                         ReaderOptions options)
+      : MessageReader(options), inner(kj::mv(inner)), segments(kj::mv(segments)),
+        mappings(kj::mv(mappings)) {}
+
+  kj::ArrayPtr<const word> getSegment(uint id) override {
+    if (id < segments.size()) {
+      return segments[id];
+    } else {
+      return nullptr;
+    }
+  }
+
+private:
+  kj::Own<MessageReader> inner;
+  kj::Array<kj::ArrayPtr<const word>> segments;
+  kj::Array<kj::Array<const byte>> mappings;
+};
+
+void mapOutOfBandSegments(MessageReaderAndFds& message, ReaderOptions options) {
+  // If `message` has out-of-band segments, replaces `message.reader` with a reader that maps them,
+  // and removes their FDs from `message.fds`.
+
+  constexpr uint MAX_SEGMENTS = 512;  // same limit as the stream readers apply
+
+  kj::Vector<kj::ArrayPtr<const word>> segments;
+  size_t outOfBandCount = 0;
+  for (uint id = 0; id < MAX_SEGMENTS; id++) {
+    auto segment = message.reader->getSegment(id);
+    if (segment.begin() == nullptr) break;
+    segments.add(segment);
+    if (segment.size() == 0) ++outOfBandCount;
+  }
+  if (outOfBandCount == 0) return;
+
+  KJ_REQUIRE(outOfBandCount <= message.fds.size(),
+      "peer sent more out-of-band message segments than file descriptors");
+  size_t firstOutOfBandFd = message.fds.size() - outOfBandCount;
+
+  auto mappings = kj::heapArrayBuilder<kj::Array<const byte>>(outOfBandCount);
+  for (auto& segment: segments) {
+    if (segment.size() > 0) continue;
+
+    auto& fd = message.fds[firstOutOfBandFd + mappings.size()];
+    KJ_REQUIRE(fd != nullptr,
+        "peer sent an out-of-band message segment without a matching file descriptor");
+
+    // The receiver reads the segment in place, so the sender must not be able to change it
+    // afterwards.
+    int seals;
+    KJ_SYSCALL(seals = fcntl(fd, F_GET_SEALS));
+    KJ_REQUIRE((seals & OUT_OF_BAND_SEALS) == OUT_OF_BAND_SEALS,
+        "peer sent an out-of-band message segment in a memfd that isn't sealed");
+
+    auto file = kj::newDiskReadableFile(kj::mv(fd));
+    uint64_t bytes = file->stat().size;
+    size_t wordCount = bytes / sizeof(word);
+    KJ_REQUIRE(bytes % sizeof(word) == 0 && wordCount > 0 &&
+               wordCount <= options.traversalLimitInWords,
+        "peer sent an out-of-band message segment of unreasonable size", bytes);
+    auto mapping = file->mmap(0, bytes);
+    segment = kj::arrayPtr(reinterpret_cast<const word*>(mapping.begin()), wordCount);
+    mappings.add(kj::mv(mapping));
+  }
+
+  message.reader = kj::heap<OutOfBandMessageReader>(
+      kj::mv(message.reader), segments.releaseAsArray(), mappings.finish(), options);
+  message.fds = message.fds.first(firstOutOfBandFd);
+}
+
+}  // namespace
+#endif  // __linux__
+
 TwoPartyVatNetwork::TwoPartyVatNetwork(
     kj::OneOf<MessageStream*, kj::Own<MessageStream>>&& stream,
     uint maxFdsPerMessage,
@@ -162,6 +261,12 @@ public:
       return;
     }
 
+#if __linux__
+    if (network.outOfBandThreshold > 0 && network.maxFdsPerMessage > 0) {
+      moveLargeSegmentsOutOfBand();
+    }
+#endif
+
     auto sendTime = network.clock.now();
     if (network.queuedMessages.size() == 0) {
       // Optimistically set sendTime when there's no messages in the queue. Without this, sending
@@ -177,8 +282,9 @@ public:
     // related small messages, reducing the number of syscalls we make.
     auto& previousWrite = KJ_ASSERT_NONNULL(network.previousWrite, "already shut down");
     bool alreadyPendingSend = !network.queuedMessages.empty();
+    this->sendTime = sendTime;
     network.currentQueueSize += message.sizeInWords() * sizeof(word);
-    network.queuedMessages.add(addRefToThis());
+    enqueue(network.queuedMessages, addRefToThis());
     if (alreadyPendingSend) {
       // The first send sets up an evalLast that will clear out pendingMessages when it's sent.
       // If pendingMessages is non-empty, then there must already be a callback waiting to send
@@ -187,19 +293,9 @@ public:
     }
 
     // On the other hand, if pendingMessages was empty, then we should set up the delayed write.
-    network.previousWrite = previousWrite.then([&network = network, sendTime]() {
-      return kj::evalLast([&network, sendTime]() -> kj::Promise<void> {
-        network.currentOutgoingMessageSendTime = sendTime;
-        // Swap out the connection's pending messages and write all of them together.
-        auto ownMessages = kj::mv(network.queuedMessages);
-        network.currentQueueSize = 0;
-        auto messages =
-          kj::heapArray<MessageAndFds>(ownMessages.size());
-        for (int i = 0; i < messages.size(); ++i) {
-          messages[i].segments = ownMessages[i]->message.getSegmentsForOutput();
-          messages[i].fds = ownMessages[i]->fds;
-        }
-        return network.getStream().writeMessages(messages).attach(kj::mv(ownMessages), kj::mv(messages));
+    network.previousWrite = previousWrite.then([&network = network]() {
+      return kj::evalLast([&network]() -> kj::Promise<void> {
+        return writeQueue(network);
       }).catch_([&network](kj::Exception&& e) {
         // Since no one checks write failures, we need to propagate them into read failures,
         // otherwise we might get stuck sending all messages into a black hole and wondering why
@@ -213,6 +309,10 @@ public:
     }).eagerlyEvaluate(nullptr);
   }
 
+  void setPriority(MessagePriority priority) override {
+    this->priority = priority;
+  }
+
   size_t sizeInWords() override {
     return message.sizeInWords();
   }
@@ -221,6 +321,129 @@ private:
   TwoPartyVatNetwork& network;
   MallocMessageBuilder message;
   kj::Array<int> fds;
+  kj::Array<kj::ArrayPtr<const word>> outputSegments;
+  kj::Array<kj::Own<const kj::File>> outOfBandFiles;
+  // Set if any segments are sent out-of-band, in which case `outputSegments` replaces
+  // `message.getSegmentsForOutput()` and `fds` has the memfds appended.
+  MessagePriority priority = MessagePriority::NORMAL;
+  kj::TimePoint sendTime = kj::origin<kj::TimePoint>();
+
+  kj::ArrayPtr<const kj::ArrayPtr<const word>> getSegmentsForOutput() {
+    if (outputSegments != nullptr) {
+      return outputSegments;
+    } else {
+      return message.getSegmentsForOutput();
+    }
+  }
+
+#if __linux__
+  void moveLargeSegmentsOutOfBand() {
+    auto segments = message.getSegmentsForOutput();
+    size_t thresholdWords = kj::max(network.outOfBandThreshold / sizeof(word), size_t(1));
+
+    // Segments past the FD limit stay in-band.
+    size_t maxCount = MAX_FDS_PER_SENDMSG - kj::min(fds.size(), MAX_FDS_PER_SENDMSG);
+    size_t count = 0;
+    for (auto& segment: segments) {
+      if (segment.size() >= thresholdWords && count < maxCount) ++count;
+    }
+    if (count == 0) return;
+
+    outputSegments = kj::heapArray<kj::ArrayPtr<const word>>(segments.size());
+    auto newFds = kj::heapArrayBuilder<int>(fds.size() + count);
+    newFds.addAll(fds);
+    auto files = kj::heapArrayBuilder<kj::Own<const kj::File>>(count);
+
+    for (auto i: kj::indices(segments)) {
+      auto segment = segments[i];
+      if (segment.size() < thresholdWords || files.size() == count) {
+        outputSegments[i] = segment;
+        continue;
+      }
+
+      auto file = kj::newMemfdFile(MFD_ALLOW_SEALING);
+      file->write(0, segment.asBytes());
+      int fd = KJ_ASSERT_NONNULL(file->getFd());
+      KJ_SYSCALL(fcntl(fd, F_ADD_SEALS, OUT_OF_BAND_SEALS | F_SEAL_SEAL));
+
+      outputSegments[i] = segment.first(0);
+      newFds.add(fd);
+      files.add(kj::mv(file));
+    }
+
+    fds = newFds.finish();
+    outOfBandFiles = files.finish();
+  }
+#endif
+
+  static void enqueue(kj::Vector<kj::Rc<OutgoingMessageImpl>>& queue,
+                      kj::Rc<OutgoingMessageImpl> message) {
+    // Append to the queue, except that an URGENT message goes ahead of any BULK messages at the
+    // end of the queue.
+
+    size_t pos = queue.size();
+    if (message->priority == MessagePriority::URGENT) {
+      while (pos > 0 && queue[pos - 1]->priority == MessagePriority::BULK) --pos;
+    }
+
+    queue.add();
+    for (size_t i = queue.size() - 1; i > pos; i--) {
+      queue[i] = kj::mv(queue[i - 1]);
+    }
+    queue[pos] = kj::mv(message);
+  }
+
+  static kj::Promise<void> writeQueue(TwoPartyVatNetwork& network) {
+    // Write the queued messages. BULK messages are written at most `bulkWriteQuantum` bytes at a
+    // time, so that URGENT messages queued in the meantime don't have to wait for all of them.
+
+    auto& queue = network.queuedMessages;
+    network.currentOutgoingMessageSendTime = queue.front()->sendTime;
+
+    size_t count = 0;
+    size_t bulkBytes = 0;
+    size_t batchBytes = 0;
+    for (auto& queued: queue) {
+      size_t bytes = queued->message.sizeInWords() * sizeof(word);
+      if (queued->priority == MessagePriority::BULK) {
+        if (count > 0 && bulkBytes + bytes > network.bulkWriteQuantum) break;
+        bulkBytes += bytes;
+      }
+      batchBytes += bytes;
+      ++count;
+    }
+
+    // Take the batch out of the queue.
+    kj::Vector<kj::Rc<OutgoingMessageImpl>> ownMessages;
+    if (count == queue.size()) {
+      ownMessages = kj::mv(queue);
+    } else {
+      kj::Vector<kj::Rc<OutgoingMessageImpl>> rest(queue.size() - count);
+      for (auto& queued: queue.slice(count, queue.size())) {
+        rest.add(kj::mv(queued));
+      }
+      queue.truncate(count);
+      ownMessages = kj::mv(queue);
+      queue = kj::mv(rest);
+    }
+    network.currentQueueSize -= batchBytes;
+    bool more = !queue.empty();
+
+    auto messages = kj::heapArray<MessageAndFds>(ownMessages.size());
+    for (int i = 0; i < messages.size(); ++i) {
+      messages[i].segments = ownMessages[i]->getSegmentsForOutput();
+      messages[i].fds = ownMessages[i]->fds;
+    }
+    auto promise = network.getStream().writeMessages(messages)
+        .attach(kj::mv(ownMessages), kj::mv(messages));
+    if (more) {
+      // Messages left behind in the queue are ours to write; send() won't schedule another
+      // write while the queue is non-empty.
+      return promise.then([&network]() { return writeQueue(network); });
+    } else {
+      return promise;
+    }
+  }
 };
 
 kj::Duration TwoPartyVatNetwork::getOutgoingMessageWaitTime() {
@@ -289,6 +512,8 @@ size_t TwoPartyVatNetwork::getWindow() {
   //      that. This seems complicated, but avoids the need for any changes to the RPC protocol.
   //      In theory it solves both underutilization and buffer bloat. Note that this approach would
   //      require the RPC system to use a clock, which feels dirty and adds non-determinism.
+  //   Applications that can supply a timer may opt into (2) per stream, using
+  //   RpcFlowController::newPacedController() with RpcSystem::setStreamFlowController().
 
   if (solSndbufUnimplemented) {
     return RpcFlowController::DEFAULT_WINDOW_SIZE;
@@ -323,10 +548,15 @@ kj::Promise<kj::Maybe<kj::Own<IncomingRpcMessage>>> TwoPartyVatNetwork::receiveI
       fdSpace = kj::heapArray<kj::OwnFd>(maxFdsPerMessage);
     }
     auto promise = readCanceler.wrap(getStream().tryReadMessage(fdSpace, receiveOptions));
-    return promise.then([fdSpace = kj::mv(fdSpace)]
+    return promise.then([this, fdSpace = kj::mv(fdSpace)]
                         (kj::Maybe<MessageReaderAndFds>&& messageAndFds) mutable
                       -> kj::Maybe<kj::Own<IncomingRpcMessage>> {
       KJ_IF_SOME(m, messageAndFds) {
+#if __linux__
+        if (m.fds.size() > 0) {
+          mapOutOfBandSegments(m, receiveOptions);
+        }
+#endif
         if (m.fds.size() > 0) {
           return kj::Own<IncomingRpcMessage>(
               kj::heap<IncomingMessageImpl>(kj::mv(m), kj::mv(fdSpace)));
@@ -101,6 +101,30 @@ public:
   // Get how long the current outgoing message has been waiting to be sent on this connection.
   // Returns 0 if the queue is empty. This may be useful for backpressure.
 
+  static constexpr size_t DEFAULT_BULK_WRITE_QUANTUM = 65536;
+
+  void setBulkWriteQuantum(size_t bytes) { bulkWriteQuantum = bytes; }
+  // Queued messages with MessagePriority::BULK (calls to streaming methods) are written at most
+  // this many bytes at a time, and URGENT messages (returns) sent in the meantime go ahead of the
+  // rest. So a return waits behind roughly this much streaming data, rather than behind the whole
+  // queue. A single message is never split, so one larger than this is written on its own.
+
+  void setOutOfBandThreshold(size_t bytes) { outOfBandThreshold = bytes; }
+  // (Linux only.) Outgoing message segments of at least `bytes` are not copied into the stream.
+  // Instead each one is written to a sealed memfd that is passed alongside the message, and the
+  // receiver maps it read-only and reads the segment in place. A large `Data` (or `Text`) field
+  // normally gets a segment of its own, so this moves large blobs between local processes without
+  // pushing them through the socket. Blobs added with `Orphanage::referenceExternalData()` are
+  // copied only once, into the memfd. Zero (the default) disables this.
+  //
+  // This requires FD passing: the network must have been constructed with a non-zero
+  // `maxFdsPerMessage`, and the peer's `maxFdsPerMessage` must leave room for one FD per
+  // out-of-band segment on top of any capability FDs. A message never carries more FDs than the
+  // kernel allows in one sendmsg() (253); any further large segments are sent in-band. The peer
+  // must also be a TwoPartyVatNetwork that understands out-of-band segments (any version that has
+  // this method does, on Linux); other peers will fail to read the message. The peer's
+  // `ReaderOptions::traversalLimitInWords` still bounds the total size of a message.
+
   // implements VatNetwork -----------------------------------------------------
 
   kj::Maybe<kj::Own<TwoPartyVatNetworkBase::Connection>> connect(
@@ -143,7 +167,12 @@ private:
   kj::ForkedPromise<void> disconnectPromise = nullptr;
 
   kj::Vector<kj::Rc<OutgoingMessageImpl>> queuedMessages;
+  // Messages waiting to be written, in order, except that URGENT messages are placed ahead of
+  // BULK messages at the end of the queue.
+
   size_t currentQueueSize = 0;
+  size_t bulkWriteQuantum = DEFAULT_BULK_WRITE_QUANTUM;
+  size_t outOfBandThreshold = 0;
   const kj::MonotonicClock& clock;
   kj::TimePoint currentOutgoingMessageSendTime;
 
@@ -262,6 +291,10 @@ public:
   size_t getCurrentQueueCount() { return network.getCurrentQueueCount(); }
   kj::Duration getOutgoingMessageWaitTime() { return network.getOutgoingMessageWaitTime(); }
 
+  inline TwoPartyVatNetwork& getNetwork() { return network; }
+  inline RpcSystem<rpc::twoparty::VatId>& getRpcSystem() { return rpcSystem; }
+  // For settings that aren't forwarded above.
+
 private:
   TwoPartyVatNetwork network;
   RpcSystem<rpc::twoparty::VatId> rpcSystem;
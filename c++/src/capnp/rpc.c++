@@ -20,6 +20,7 @@
 // THE SOFTWARE.
 
 #include "rpc.h"
+#include "rpc-instrumentation.h"
 #include "message.h"
 #include <kj/debug.h>
 #include <kj/vector.h>
@@ -68,11 +69,12 @@ uint copySizeHint(MessageSize size) {
   return kj::min(MAX_SIZE_HINT, sizeHint);
 }
 
-uint firstSegmentSize(kj::Maybe<MessageSize> sizeHint, uint additional) {
+uint firstSegmentSize(kj::Maybe<MessageSize> sizeHint, uint additional, uint learned = 0) {
+  // `learned` is used when the caller gave no hint; see RpcMethodSizeTable.
   KJ_IF_SOME(s, sizeHint) {
     return copySizeHint(s) + additional;
   } else {
-    return 0;
+    return learned;
   }
 }
 
@@ -206,6 +208,92 @@ class RpcSystemBrand: public kj::Refcounted {
   // since it can actually be destroyed while the ClientHooks still exist.
 };
 
+class RpcMethodSizeTable: public kj::Refcounted {
+  // Learns how large the Call and Return messages for each interface method tend to be, so that
+  // calls made without an explicit size hint can still get a first segment big enough to hold
+  // them. Shared by all of an RpcSystem's connections, since a method's message sizes depend on
+  // the method, not on the peer, and a fresh connection can then benefit immediately. Refcounted
+  // for the same reason as RpcSystemBrand.
+
+public:
+  struct Method {
+    Method(): calls(0), returns(0) {}
+    MessageSizeHint calls;
+    MessageSizeHint returns;
+  };
+
+  static constexpr uint MAX_METHODS_PER_CONNECTION = 256;
+  // How many methods any one connection may start tracking, so that a single peer can't use up
+  // the table for everyone else.
+
+  kj::Maybe<Method&> find(uint64_t interfaceId, uint16_t methodId) {
+    // Find the given method, if it's tracked.
+    KJ_IF_SOME(method, methods.find(Key { interfaceId, methodId })) {
+      return *method;
+    }
+    return kj::none;
+  }
+
+  kj::Maybe<Method&> findOrAdd(uint64_t interfaceId, uint16_t methodId, uint& connectionBudget) {
+    // Find or start tracking the given method. Starting to track a method uses up one of the
+    // calling connection's `connectionBudget`, which starts at MAX_METHODS_PER_CONNECTION.
+    // Returns none once the budget or the table itself (MAX_METHODS) is exhausted, so that a peer
+    // causing calls to made-up method IDs can't grow the table without bound, nor fill it.
+    Key key { interfaceId, methodId };
+    KJ_IF_SOME(method, methods.find(key)) {
+      return *method;
+    }
+    if (connectionBudget == 0 || methods.size() >= MAX_METHODS) return kj::none;
+    --connectionBudget;
+    return *methods.insert(key, kj::heap<Method>()).value;
+  }
+
+  static uint firstSegmentWords(kj::Maybe<Method&> method,
+                                MessageSizeHint Method::*direction) {
+    // The learned first segment size, or zero (letting the network choose) if nothing has been
+    // learned or the method's messages fit in a default-sized first segment anyway.
+    KJ_IF_SOME(m, method) {
+      uint words = (m.*direction).getFirstSegmentWords();
+      if (words > SUGGESTED_FIRST_SEGMENT_WORDS) return words;
+    }
+    return 0;
+  }
+
+  kj::Array<RpcMethodMessageSizes> getSizes() {
+    auto describe = [](const MessageSizeHint& hint) {
+      return RpcMethodMessageSizes::Direction {
+        hint.getRecordCount(), hint.getMeanWords(), hint.getDeviationWords(),
+        hint.getFirstSegmentWords()
+      };
+    };
+
+    auto builder = kj::heapArrayBuilder<RpcMethodMessageSizes>(methods.size());
+    for (auto& entry: methods) {
+      builder.add(RpcMethodMessageSizes {
+        entry.key.interfaceId, entry.key.methodId,
+        describe(entry.value->calls), describe(entry.value->returns)
+      });
+    }
+    return builder.finish();
+  }
+
+private:
+  static constexpr size_t MAX_METHODS = 4096;
+
+  struct Key {
+    uint64_t interfaceId;
+    uint16_t methodId;
+
+    inline bool operator==(const Key& other) const {
+      return interfaceId == other.interfaceId && methodId == other.methodId;
+    }
+    inline uint hashCode() const { return kj::hashCode(interfaceId, methodId); }
+  };
+
+  kj::HashMap<Key, kj::Own<Method>> methods;
+  // Methods are heap-allocated so that references stay valid as the map grows.
+};
+
 // =======================================================================================
 
 template <typename Id>
@@ -213,6 +301,56 @@ static constexpr Id highBit() {
   return 1u << (sizeof(Id) * 8 - 1);
 }
 
+constexpr size_t MIN_COMPACT_CAPACITY = 64;
+// Tables smaller than this aren't worth compacting.
+
+template <typename Key, typename Value>
+size_t hashMapBytes(const kj::HashMap<Key, Value>& map) {
+  // Rows, plus an estimate for the hash index, which keeps two to three 8-byte buckets per row.
+  return map.capacity() * (sizeof(typename kj::HashMap<Key, Value>::Entry) + 24);
+}
+
+template <typename Key, typename Value>
+void compactHashMap(kj::HashMap<Key, Value>& map) {
+  // A HashMap never gives back memory as entries are erased, so rebuild it if it's mostly empty.
+  // This moves the entries.
+  if (map.capacity() >= MIN_COMPACT_CAPACITY && map.size() * 8 < map.capacity()) {
+    kj::HashMap<Key, Value> replacement;
+    replacement.reserve(map.size());
+    for (auto& entry: map) {
+      replacement.insert(entry.key, kj::mv(entry.value));
+    }
+    map = kj::mv(replacement);
+  }
+}
+
+class PipelinePath {
+  // A promise pipelining transform path, as a hash map key. Paths are rarely more than a few ops
+  // long, so short ones are stored inline rather than in a heap array.
+
+public:
+  explicit PipelinePath(kj::ArrayPtr<const PipelineOp> ops): size(ops.size()) {
+    if (size <= kj::size(inlineOps)) {
+      for (auto i: kj::indices(ops)) inlineOps[i] = ops[i];
+    } else {
+      heapOps = kj::heapArray(ops);
+    }
+  }
+
+  kj::ArrayPtr<const PipelineOp> asPtr() const {
+    return size <= kj::size(inlineOps) ? kj::arrayPtr(inlineOps, size) : heapOps.asPtr();
+  }
+
+  inline bool operator==(const PipelinePath& other) const { return asPtr() == other.asPtr(); }
+  inline bool operator==(kj::ArrayPtr<const PipelineOp> other) const { return asPtr() == other; }
+  inline uint hashCode() const { return kj::hashCode(asPtr()); }
+
+private:
+  size_t size;
+  PipelineOp inlineOps[4];
+  kj::Array<PipelineOp> heapOps;
+};
+
 template <typename Id, typename T>
 class ExportTable {
   // Table mapping integers to T, where the integers are chosen locally.
@@ -251,16 +389,20 @@ public:
       T toRelease = kj::mv(slots[id]);
       slots[id] = T();
       freeIds.push(id);
+      ++erasedSinceCompact;
       return toRelease;
     }
   }
 
   T& next(Id& id) {
+    KJ_DEFER(highWaterMark = kj::max(highWaterMark, size()));
     if (freeIds.empty()) {
       id = slots.size();
       KJ_ASSERT(!isHigh(id), "2^31 concurrent questions?!!?!");
       return slots.add();
     } else {
+      // Always reuse the lowest free ID. This keeps live entries packed at the bottom of `slots`
+      // so that compact() can give back the top.
       id = freeIds.top();
       freeIds.pop();
       return slots[id];
@@ -283,9 +425,67 @@ public:
       });
     }
 
+    highWaterMark = kj::max(highWaterMark, size());
     return *slot;
   }
 
+  size_t size() {
+    // Number of entries in use.
+    return slots.size() - freeIds.size() + highSlots.size();
+  }
+
+  void compact() {
+    // Give back memory left over from a burst of activity, once most of it is unused. This moves
+    // entries, so it may only be called when no references into the table are held.
+    //
+    // IDs are known to the peer, so live entries can't be renumbered; only free slots at the top
+    // of `slots` can be released. Scanning for them is O(slots), so we only look after at least
+    // half that many erasures.
+
+    compactHashMap(highSlots);
+
+    if (slots.capacity() < MIN_COMPACT_CAPACITY || erasedSinceCompact < slots.size() / 2) return;
+    erasedSinceCompact = 0;
+
+    if ((slots.size() - freeIds.size()) * 4 > slots.size()) return;
+
+    auto isFree = kj::heapArray<bool>(slots.size());
+    for (auto& flag: isFree) flag = false;
+    while (!freeIds.empty()) {
+      isFree[freeIds.top()] = true;
+      freeIds.pop();
+    }
+
+    size_t newSize = slots.size();
+    while (newSize > 0 && isFree[newSize - 1]) --newSize;
+    if (newSize * 2 > slots.size()) {
+      // Not enough to gain; keep everything. (The heap itself is still rebuilt tightly.)
+      newSize = slots.size();
+    }
+
+    decltype(freeIds) newFreeIds;
+    for (Id i = 0; i < newSize; i++) {
+      if (isFree[i]) newFreeIds.push(i);
+    }
+    freeIds = kj::mv(newFreeIds);
+
+    if (newSize == slots.size() && slots.capacity() <= newSize * 2) return;
+
+    kj::Vector<T> newSlots(newSize);
+    for (auto i: kj::zeroTo(newSize)) {
+      newSlots.add(kj::mv(slots[i]));
+    }
+    slots = kj::mv(newSlots);
+  }
+
+  RpcConnectionStats::Table getStats() {
+    return {
+      size(), highWaterMark,
+      slots.capacity() + highSlots.capacity(),
+      slots.capacity() * sizeof(T) + freeIds.size() * sizeof(Id) + hashMapBytes(highSlots)
+    };
+  }
+
   template <typename Func>
   void forEach(Func&& func) {
     for (Id i = 0; i < slots.size(); i++) {
@@ -311,6 +511,9 @@ private:
 
   kj::HashMap<Id, T> highSlots;
   Id highCounter = 0;
+
+  size_t highWaterMark = 0;
+  size_t erasedSinceCompact = 0;
 };
 
 template <typename Id, typename T>
@@ -324,6 +527,7 @@ public:
 
   T& findOrCreate(Id id) {
     // Get an entry, creating it if it doesn't exist.
+    KJ_DEFER(highWaterMark = kj::max(highWaterMark, size()));
     if (id < kj::size(low)) {
       presenceBits |= 1 << id;
       return low[id];
@@ -347,6 +551,7 @@ public:
 
   kj::Maybe<T&> create(Id id) {
     // Strictly create a new entry; return null if it already exists.
+    KJ_DEFER(highWaterMark = kj::max(highWaterMark, size()));
     if (id < kj::size(low)) {
       if (presenceBits & (1 << id)) {
         return kj::none;
@@ -396,10 +601,33 @@ public:
     }
   }
 
+  size_t size() {
+    // Number of entries in use.
+    size_t result = high.size();
+    for (uint bits = presenceBits; bits != 0; bits &= bits - 1) ++result;
+    return result;
+  }
+
+  void compact() {
+    // Give back memory left over from a burst of activity; see ExportTable::compact(). The IDs
+    // here are chosen by the peer, which normally reuses them the way ExportTable does.
+    compactHashMap(high);
+  }
+
+  RpcConnectionStats::Table getStats() {
+    return {
+      size(), highWaterMark,
+      kj::size(low) + high.capacity(),
+      sizeof(low) + hashMapBytes(high)
+    };
+  }
+
 private:
   T low[16];
   uint presenceBits = 0;
   kj::HashMap<Id, T> high;
+
+  size_t highWaterMark = 0;
 };
 
 }  // namespace
@@ -414,9 +642,11 @@ public:
                      kj::Own<VatNetworkBase::Connection>&& connectionParam,
                      size_t flowLimit,
                      kj::Maybe<kj::Function<kj::String(const kj::Exception&)>&> traceEncoder,
-                     RpcSystemBrand& brand)
+                     kj::Maybe<RpcInstrumentation&> instrumentation,
+                     RpcSystemBrand& brand, RpcMethodSizeTable& methodSizes)
       : bootstrapFactory(bootstrapFactory), flowLimit(flowLimit),
-        traceEncoder(traceEncoder), brand(kj::addRef(brand)), tasks(*this) {
+        traceEncoder(traceEncoder), instrumentation(instrumentation), brand(kj::addRef(brand)),
+        methodSizes(kj::addRef(methodSizes)), tasks(*this) {
     connection.init<Connected>(
         Connected { rpcSystem, kj::mv(connectionParam), kj::heap<kj::Canceler>() });
     tasks.add(messageLoop());
@@ -447,6 +677,7 @@ public:
 
       auto builder = message->getBody().initAs<rpc::Message>().initBootstrap();
       builder.setQuestionId(questionId);
+      message->setPriority(MessagePriority::URGENT);
       message->send();
     }
 
@@ -466,10 +697,10 @@ public:
     // `tasks.add(exception)` to schedule a shutdown, since any error thrown by a task will be
     // passed to `disconnect()` later.
 
-    // After disconnect(), the RpcSystem could be destroyed, making `traceEncoder` a dangling
-    // reference, so null it out before we return from here. We don't need it anymore once
-    // disconnected anyway.
-    KJ_DEFER(traceEncoder = kj::none);
+    // After disconnect(), the RpcSystem could be destroyed, making `traceEncoder` and
+    // `instrumentation` dangling references, so null them out before we return from here. We
+    // don't need them anymore once disconnected anyway.
+    KJ_DEFER(traceEncoder = kj::none; instrumentation = kj::none);
 
     if (!connection.is<Connected>()) {
       // Already disconnected.
@@ -624,6 +855,31 @@ public:
     maybeUnblockFlow();
   }
 
+  void setInstrumentation(kj::Maybe<RpcInstrumentation&> newInstrumentation) {
+    if (connection.is<Connected>()) {
+      instrumentation = newInstrumentation;
+    }
+  }
+
+  static void setStreamFlowController(ClientHook& hook, kj::Own<RpcFlowController> controller) {
+    // `hook` must carry the RpcSystem's brand, i.e. be one of our RpcClients.
+    kj::downcast<RpcClient>(hook).replaceFlowController(kj::mv(controller));
+  }
+
+  RpcConnectionStats getStats() {
+    RpcConnectionStats result;
+    KJ_IF_SOME(c, connection.tryGet<Connected>()) {
+      result.peerVatId = c.connection->baseGetPeerVatId();
+    }
+    result.questions = questions.getStats();
+    result.answers = answers.getStats();
+    result.exports = exports.getStats();
+    result.exports.bytes += hashMapBytes(exportsByCap);
+    result.imports = imports.getStats();
+    result.embargoes = embargoes.getStats();
+    return result;
+  }
+
 private:
   class RpcClient;
   class ImportClient;
@@ -652,6 +908,11 @@ private:
   // means that any time we read an ID from a received message, its type should invert.
   // TODO(cleanup):  Perhaps we could enforce that in a type-safe way?  Hmm...
 
+  struct InstrumentedCall {
+    RpcInstrumentation::Method method;
+    kj::TimePoint sentTime;
+  };
+
   struct Question {
     kj::Array<ExportId> paramExports;
     // List of exports that were sent in the request.  If the response has `releaseParamCaps` these
@@ -675,6 +936,9 @@ private:
     // * Our attempt to send the `Call` threw an exception, therefore the peer never even received
     //   the call in the first place and would not expect a `Finish`.
 
+    kj::Maybe<InstrumentedCall> instrumentedCall;
+    // Set if the call was sent while instrumentation was enabled, so its Return can be reported.
+
     inline bool operator==(decltype(nullptr)) const {
       return !isAwaitingReturn && selfRef == kj::none;
     }
@@ -827,8 +1091,17 @@ private:
 
   kj::Maybe<kj::Function<kj::String(const kj::Exception&)>&> traceEncoder;
 
+  kj::Maybe<RpcInstrumentation&> instrumentation;
+  // Told about calls passing through, if set. Belongs to the RpcSystem.
+
   kj::Own<RpcSystemBrand> brand;
 
+  kj::Own<RpcMethodSizeTable> methodSizes;
+  // Learned Call and Return sizes per method, shared with the rest of the RpcSystem.
+
+  uint methodSizeBudget = RpcMethodSizeTable::MAX_METHODS_PER_CONNECTION;
+  // How many more methods this connection may add to `methodSizes`.
+
   kj::TaskSet tasks;
 
   bool gotReturnForHighQuestionId = false;
@@ -876,6 +1149,20 @@ private:
         embargoes.empty();
   }
 
+  void compactTables() {
+    // Give back table memory after a burst of activity. This moves table entries around, so must
+    // only be called from the message loop, between messages, when nothing holds references into
+    // the tables. (Growing a table can move entries too, so nothing may hold such references
+    // across turns anyway.)
+
+    questions.compact();
+    answers.compact();
+    exports.compact();
+    imports.compact();
+    embargoes.compact();
+    compactHashMap(exportsByCap);
+  }
+
   void checkIfBecameIdle() {
     // Checks if the connection has become idle, and if so, informs the VatNetwork by calling
     // setIdle(true). Generally, this must be called after erasing an entry from any of the
@@ -1022,6 +1309,17 @@ private:
       }
     }
 
+    virtual void replaceFlowController(kj::Own<RpcFlowController> flowController) {
+      // Called by RpcSystem::setStreamFlowController() to make streaming calls on this client use
+      // `flowController` from now on. Calls already sent under the old controller are left to
+      // finish in the background.
+
+      KJ_IF_SOME(f, this->flowController) {
+        connectionState->waitAllAckedInBackground(kj::mv(f));
+      }
+      this->flowController = kj::mv(flowController);
+    }
+
     struct VineToExport {
       kj::Own<ClientHook> vine;
       // Capability to export as the "vine" in the ThirdPartyCapDescriptor.
@@ -1105,7 +1403,7 @@ private:
 
       auto request = kj::heap<RpcRequest>(
           *connectionState, *connectionState->connection.get<Connected>().connection,
-          sizeHint, kj::addRef(*this));
+          sizeHint, kj::addRef(*this), interfaceId, methodId);
       auto callBuilder = request->getCall();
 
       callBuilder.setInterfaceId(interfaceId);
@@ -1356,6 +1654,20 @@ private:
       }
     }
 
+    void replaceFlowController(kj::Own<RpcFlowController> flowController) override {
+      if (isResolved) {
+        // newCall() now goes straight to the resolution, so that's where the controller needs to
+        // be. If we resolved to something other than an RPC capability on this connection,
+        // streaming calls no longer pass through any flow controller of ours, so there is nothing
+        // to replace.
+        KJ_IF_SOME(rpcCap, connectionState->unwrapIfSameConnection(*cap)) {
+          rpcCap.replaceFlowController(kj::mv(flowController));
+        }
+      } else {
+        RpcClient::replaceFlowController(kj::mv(flowController));
+      }
+    }
+
     // implements ClientHook -----------------------------------------
 
     Request<AnyPointer, AnyPointer> newCall(
@@ -2165,6 +2477,9 @@ private:
     void adoptFlowController(kj::Own<RpcFlowController> flowController) override {
       return inner->adoptFlowController(kj::mv(flowController));
     }
+    void replaceFlowController(kj::Own<RpcFlowController> flowController) override {
+      return inner->replaceFlowController(kj::mv(flowController));
+    }
 
     WriteThirdPartyDescriptorResult writeThirdPartyDescriptor(
           VatNetworkBase::Connection& provider,
@@ -2447,13 +2762,18 @@ private:
   class RpcRequest final: public RequestHook {
   public:
     RpcRequest(RpcConnectionState& connectionState, VatNetworkBase::Connection& connection,
-               kj::Maybe<MessageSize> sizeHint, kj::Own<RpcClient>&& target)
+               kj::Maybe<MessageSize> sizeHint, kj::Own<RpcClient>&& target,
+               uint64_t interfaceId, uint16_t methodId)
         : RequestHook(connectionState.brand.get()),
           connectionState(kj::addRef(connectionState)),
           target(kj::mv(target)),
+          learnedSizes(connectionState.methodSizes->findOrAdd(
+              interfaceId, methodId, connectionState.methodSizeBudget)),
           message(connection.newOutgoingMessage(
               firstSegmentSize(sizeHint, messageSizeHint<rpc::Call>() +
-                  sizeInWords<rpc::Payload>() + MESSAGE_TARGET_SIZE_HINT))),
+                  sizeInWords<rpc::Payload>() + MESSAGE_TARGET_SIZE_HINT,
+                  RpcMethodSizeTable::firstSegmentWords(
+                      learnedSizes, &RpcMethodSizeTable::Method::calls)))),
           callBuilder(message->getBody().getAs<rpc::Message>().initCall()),
           paramsBuilder(capTable.imbue(callBuilder.getParams().getContent())) {}
 
@@ -2615,6 +2935,7 @@ private:
     kj::Own<RpcConnectionState> connectionState;
 
     kj::Own<RpcClient> target;
+    kj::Maybe<RpcMethodSizeTable::Method&> learnedSizes;
     kj::Own<OutgoingRpcMessage> message;
     BuilderCapabilityTable capTable;
     rpc::Call::Builder callBuilder;
@@ -2630,12 +2951,21 @@ private:
       Question& question;
     };
 
+    void recordSize() {
+      // Teach the method's size table how big this call turned out to be. The message is
+      // complete apart from fixed-size fields at this point.
+      KJ_IF_SOME(sizes, learnedSizes) {
+        sizes.calls.record(message->sizeInWords());
+      }
+    }
+
     SetupSendResult setupSend(bool isTailCall) {
       // Build the cap table.
       kj::Vector<int> fds;
       auto exports = connectionState->writeDescriptors(
           capTable.getTable(), callBuilder.getParams(), fds);
       message->setFds(fds.releaseAsArray());
+      recordSize();
 
       // Init the question table.  Do this after writing descriptors to avoid interference.
       QuestionId questionId;
@@ -2644,6 +2974,14 @@ private:
       question.paramExports = kj::mv(exports);
       question.isTailCall = isTailCall;
 
+      KJ_IF_SOME(i, connectionState->instrumentation) {
+        RpcInstrumentation::Method method {
+          callBuilder.getInterfaceId(), callBuilder.getMethodId() };
+        i.callSent(method, message->sizeInWords());
+        question.instrumentedCall = InstrumentedCall {
+          method, kj::systemPreciseMonotonicClock().now() };
+      }
+
       // Make the QuestionRef and result promise.
       SendInternalResult result;
       auto paf = kj::newPromiseAndFulfiller<kj::Promise<kj::Own<RpcResponse>>>();
@@ -2702,6 +3040,7 @@ private:
           flow = target->flowController.emplace(
               connectionState->connection.get<Connected>().connection->newStream());
         }
+        message->setPriority(MessagePriority::BULK);
         flowPromise = flow->send(kj::mv(message), setup.promise.ignoreResult());
       })) {
         // We can't safely throw the exception from here since we've already modified the question
@@ -2727,6 +3066,7 @@ private:
       if (exports.size() > 0) {
         connectionState->sentCapabilitiesInPipelineOnlyCall = true;
       }
+      recordSize();
 
       // Init the question table.  Do this after writing descriptors to avoid interference.
       QuestionId questionId;
@@ -2735,6 +3075,11 @@ private:
       question.paramExports = kj::mv(exports);
       question.isTailCall = false;
 
+      KJ_IF_SOME(i, connectionState->instrumentation) {
+        i.callSent({ callBuilder.getInterfaceId(), callBuilder.getMethodId() },
+                   message->sizeInWords());
+      }
+
       // Make the QuestionRef and result promise.
       auto questionRef = kj::refcounted<QuestionRef>(*connectionState, questionId, kj::none);
       question.selfRef = *questionRef;
@@ -2793,47 +3138,10 @@ private:
     }
 
     kj::Own<ClientHook> getPipelinedCap(kj::ArrayPtr<const PipelineOp> ops) override {
-      auto copy = kj::heapArrayBuilder<PipelineOp>(ops.size());
-      for (auto& op: ops) {
-        copy.add(op);
-      }
-      return getPipelinedCap(copy.finish());
-    }
-
-    kj::Own<ClientHook> getPipelinedCap(kj::Array<PipelineOp>&& ops) override {
-      return clientMap.findOrCreate(ops.asPtr(), [&]() {
-        if (state.is<Waiting>()) {
-          // Wrap a PipelineClient in a PromiseClient.
-          auto pipelineClient = kj::refcounted<PipelineClient>(
-              *connectionState, kj::addRef(*state.get<Waiting>()), kj::heapArray(ops.asPtr()));
-
-          KJ_IF_SOME(r, redirectLater) {
-            auto resolutionPromise = r.addBranch().then(
-                [ops = kj::heapArray(ops.asPtr())](kj::Own<RpcResponse>&& response) {
-                  return response->getResults().getPipelinedCap(kj::mv(ops));
-                });
-
-            return kj::HashMap<kj::Array<PipelineOp>, kj::Own<ClientHook>>::Entry {
-              kj::mv(ops),
-              kj::refcounted<PromiseClient>(
-                  *connectionState, kj::mv(pipelineClient), kj::mv(resolutionPromise), kj::none)
-            };
-          } else {
-            // Oh, this pipeline will never get redirected, so just return the PipelineClient.
-            return kj::HashMap<kj::Array<PipelineOp>, kj::Own<ClientHook>>::Entry {
-              kj::mv(ops), kj::mv(pipelineClient)
-            };
-          }
-        } else if (state.is<Resolved>()) {
-          auto pipelineClient = state.get<Resolved>()->getResults().getPipelinedCap(ops);
-          return kj::HashMap<kj::Array<PipelineOp>, kj::Own<ClientHook>>::Entry {
-            kj::mv(ops), kj::mv(pipelineClient)
-          };
-        } else {
-          return kj::HashMap<kj::Array<PipelineOp>, kj::Own<ClientHook>>::Entry {
-            kj::mv(ops), newBrokenCap(state.get<Broken>().clone())
-          };
-        }
+      // Looking up a path that was pipelined on before doesn't allocate, so callers that
+      // pipeline on the same promise over and over only pay for the first time.
+      return clientMap.findOrCreate(ops, [&]() -> ClientMap::Entry {
+        return { PipelinePath(ops), newPipelinedCap(ops) };
       })->addRef();
     }
 
@@ -2846,7 +3154,8 @@ private:
     typedef kj::Exception Broken;
     kj::OneOf<Waiting, Resolved, Broken> state;
 
-    kj::HashMap<kj::Array<PipelineOp>, kj::Own<ClientHook>> clientMap;
+    typedef kj::HashMap<PipelinePath, kj::Own<ClientHook>> ClientMap;
+    ClientMap clientMap;
     // See QueuedPipeline::clientMap in capability.c++ for a discussion of why we must memoize
     // the results of getPipelinedCap(). RpcPipeline has a similar problem when a capability we
     // return is later subject to an embargo. It's important that the embargo is correctly applied
@@ -2856,6 +3165,31 @@ private:
     // ensure the continuation is not still running.
     kj::Promise<void> resolveSelfPromise;
 
+    kj::Own<ClientHook> newPipelinedCap(kj::ArrayPtr<const PipelineOp> ops) {
+      if (state.is<Waiting>()) {
+        // Wrap a PipelineClient in a PromiseClient.
+        auto pipelineClient = kj::refcounted<PipelineClient>(
+            *connectionState, kj::addRef(*state.get<Waiting>()), kj::heapArray(ops));
+
+        KJ_IF_SOME(r, redirectLater) {
+          auto resolutionPromise = r.addBranch().then(
+              [ops = kj::heapArray(ops)](kj::Own<RpcResponse>&& response) {
+                return response->getResults().getPipelinedCap(ops);
+              });
+
+          return kj::refcounted<PromiseClient>(
+              *connectionState, kj::mv(pipelineClient), kj::mv(resolutionPromise), kj::none);
+        } else {
+          // Oh, this pipeline will never get redirected, so just return the PipelineClient.
+          return kj::mv(pipelineClient);
+        }
+      } else if (state.is<Resolved>()) {
+        return state.get<Resolved>()->getResults().getPipelinedCap(ops);
+      } else {
+        return newBrokenCap(state.get<Broken>().clone());
+      }
+    }
+
     void resolve(kj::Own<RpcResponse>&& response) {
       KJ_ASSERT(state.is<Waiting>(), "Already resolved?");
       state.init<Resolved>(kj::mv(response));
@@ -2973,6 +3307,10 @@ private:
       return capTable.getTable().size() > 0;
     }
 
+    size_t sizeInWords() {
+      return message->sizeInWords();
+    }
+
     kj::Maybe<kj::Array<ExportId>> send() {
       // Send the response and return the export list.  Returns kj::none if there were no caps.
       // (Could return a non-null empty array if there were caps but none of them were exports.)
@@ -3159,6 +3497,11 @@ private:
       if (isFirstResponder()) {
         // We haven't sent a return yet, so we must have been canceled.  Send a cancellation return.
         unwindDetector.catchExceptionsIfUnwinding([&]() {
+          size_t returnWords = 0;
+          KJ_DEFER(finishInstrumentation(returnWords,
+              redirectResults ? RpcInstrumentation::Outcome::RESULTS
+                              : RpcInstrumentation::Outcome::CANCELED));
+
           bool shouldFreePipeline = true;
           KJ_DEFER(cleanupAnswerTable(nullptr, shouldFreePipeline));
 
@@ -3189,12 +3532,19 @@ private:
               builder.setCanceled();
             }
 
+            message->setPriority(MessagePriority::URGENT);
+            returnWords = message->sizeInWords();
             message->send();
           }
         });
       }
     }
 
+    void startInstrumentation(RpcInstrumentation& instrumentation) {
+      instrumentation.dispatchStarted({ interfaceId, methodId }, requestSize);
+      dispatchTime = kj::systemPreciseMonotonicClock().now();
+    }
+
     kj::Own<RpcResponse> consumeRedirectedResponse() {
       KJ_ASSERT(redirectResults);
 
@@ -3259,6 +3609,17 @@ private:
           return;
         }
 
+        if (learnedSizes == kj::none && interfaceId != 0) {
+          // Now that the method has returned results, it's one we actually implement, so it's
+          // worth learning about.
+          learnedSizes = connectionState->methodSizes->findOrAdd(
+              interfaceId, methodId, connectionState->methodSizeBudget);
+        }
+        KJ_IF_SOME(sizes, learnedSizes) {
+          sizes.returns.record(responseImpl.sizeInWords());
+        }
+        finishInstrumentation(responseImpl.sizeInWords(), RpcInstrumentation::Outcome::RESULTS);
+
         if (responseImpl.hasCapabilities()) {
           auto& answer = KJ_ASSERT_NONNULL(connectionState->answers.find(answerId));
           // Swap out the `pipeline` in the answer table for one that will return capabilities
@@ -3293,7 +3654,9 @@ private:
           // then we could set `noFinishNeeded`, but optimizing the error case doesn't seem that
           // important.)
 
+          message->setPriority(MessagePriority::URGENT);
           message->send();
+          finishInstrumentation(message->sizeInWords(), RpcInstrumentation::Outcome::EXCEPTION);
         }
       }
     }
@@ -3316,7 +3679,9 @@ private:
         //   redundant after a redirect, but as this case is less common and more complicated I
         //   don't want to fully think through the implications right now.
 
+        message->setPriority(MessagePriority::URGENT);
         message->send();
+        finishInstrumentation(message->sizeInWords(), RpcInstrumentation::Outcome::RESULTS);
       }
     }
 
@@ -3344,11 +3709,19 @@ private:
         if (redirectResults || !connectionState->connection.is<Connected>()) {
           response = kj::refcounted<LocallyRedirectedRpcResponse>(sizeHint);
         } else {
+          if (interfaceId != 0) {
+            // (Pseudo-calls like `Accept` have no method to learn about.) Don't start tracking
+            // the method yet: the peer chose it, and it may not exist. See sendReturn().
+            learnedSizes = connectionState->methodSizes->find(interfaceId, methodId);
+          }
           auto message = connectionState->connection.get<Connected>().connection
               ->newOutgoingMessage(
                   firstSegmentSize(sizeHint, messageSizeHint<rpc::Return>() +
-                                  sizeInWords<rpc::Payload>()));
+                                  sizeInWords<rpc::Payload>(),
+                                  RpcMethodSizeTable::firstSegmentWords(
+                                      learnedSizes, &RpcMethodSizeTable::Method::returns)));
           returnMessage = message->getBody().initAs<rpc::Message>().initReturn();
+          message->setPriority(MessagePriority::URGENT);
           response = kj::heap<RpcServerResponseImpl>(
               *connectionState, kj::mv(message), returnMessage.getResults());
         }
@@ -3397,7 +3770,11 @@ private:
                 builder.setReleaseParamCaps(false);
                 builder.setTakeFromOtherQuestion(tailInfo.questionId);
 
+                // Not URGENT, unlike other returns: it must not overtake the tail call it refers
+                // to, which might be a BULK streaming call.
                 message->send();
+                finishInstrumentation(message->sizeInWords(),
+                                      RpcInstrumentation::Outcome::RESULTS);
               }
             }
             return { kj::mv(tailInfo.promise), kj::mv(tailInfo.pipeline) };
@@ -3443,7 +3820,7 @@ private:
 
     uint64_t interfaceId;
     uint16_t methodId;
-    // For debugging.
+    // For debugging, and for learning message sizes.
 
     // Request ---------------------------------------------
 
@@ -3456,6 +3833,10 @@ private:
 
     kj::Maybe<kj::Own<RpcServerResponse>> response;
     rpc::Return::Builder returnMessage;
+    kj::Maybe<RpcMethodSizeTable::Method&> learnedSizes;
+    // Where to record the size of our Return, if it's sent over the connection.
+    kj::Maybe<kj::TimePoint> dispatchTime;
+    // When the call was dispatched, if instrumentation was enabled at the time.
     bool redirectResults = false;
     bool responseSent = false;
     kj::Maybe<kj::Own<kj::PromiseFulfiller<AnyPointer::Pipeline>>> tailCallPipelineFulfiller;
@@ -3470,6 +3851,16 @@ private:
 
     // -----------------------------------------------------
 
+    void finishInstrumentation(size_t returnWords, RpcInstrumentation::Outcome outcome) {
+      KJ_IF_SOME(start, dispatchTime) {
+        dispatchTime = kj::none;
+        KJ_IF_SOME(i, connectionState->instrumentation) {
+          i.dispatchFinished({ interfaceId, methodId }, returnWords,
+                             kj::systemPreciseMonotonicClock().now() - start, outcome);
+        }
+      }
+    }
+
     bool isFirstResponder() {
       if (responseSent) {
         return false;
@@ -3555,6 +3946,7 @@ private:
 
       KJ_IF_SOME(m, message) {
         handleMessage(kj::mv(m));
+        compactTables();
       } else {
         // Other end disconnected!
 
@@ -3786,6 +4178,7 @@ private:
 
     rpc::Return::Builder ret = response->getBody().getAs<rpc::Message>().initReturn();
     ret.setAnswerId(answerId);
+    response->setPriority(MessagePriority::URGENT);
 
     kj::Own<ClientHook> capHook;
     kj::Array<ExportId> resultExports;
@@ -3879,6 +4272,12 @@ private:
       answer.callContext = *context;
     }
 
+    if (!hints.onlyPromisePipeline) {
+      KJ_IF_SOME(i, instrumentation) {
+        context->startInstrumentation(i);
+      }
+    }
+
     auto promiseAndPipeline = startCall(
         call.getInterfaceId(), call.getMethodId(), kj::mv(capability), context->addRef(), hints);
 
@@ -4027,6 +4426,16 @@ private:
       KJ_REQUIRE(question.isAwaitingReturn, "Duplicate Return.");
       question.isAwaitingReturn = false;
 
+      KJ_IF_SOME(call, question.instrumentedCall) {
+        KJ_IF_SOME(i, instrumentation) {
+          auto outcome = ret.isException() ? RpcInstrumentation::Outcome::EXCEPTION
+                       : ret.isCanceled() ? RpcInstrumentation::Outcome::CANCELED
+                       : RpcInstrumentation::Outcome::RESULTS;
+          i.returnReceived(call.method, message->sizeInWords(),
+                           kj::systemPreciseMonotonicClock().now() - call.sentTime, outcome);
+        }
+      }
+
       if (ret.getReleaseParamCaps()) {
         exportsToRelease = kj::mv(question.paramExports);
       } else {
@@ -4670,6 +5079,34 @@ public:
     traceEncoder = kj::mv(func);
   }
 
+  void setInstrumentation(kj::Maybe<RpcInstrumentation&> newInstrumentation) {
+    instrumentation = newInstrumentation;
+
+    for (auto& conn: connections) {
+      conn.value->setInstrumentation(newInstrumentation);
+    }
+  }
+
+  void setStreamFlowController(Capability::Client cap, kj::Own<RpcFlowController> controller) {
+    auto hook = ClientHook::from(kj::mv(cap));
+    KJ_REQUIRE(hook->isBrand(brand.get()),
+        "setStreamFlowController() requires a capability imported over one of this RpcSystem's "
+        "connections");
+    RpcConnectionState::setStreamFlowController(*hook, kj::mv(controller));
+  }
+
+  kj::Array<RpcMethodMessageSizes> getLearnedMessageSizes() {
+    return methodSizes->getSizes();
+  }
+
+  kj::Array<RpcConnectionStats> getConnectionStats() {
+    auto builder = kj::heapArrayBuilder<RpcConnectionStats>(connections.size());
+    for (auto& conn: connections) {
+      builder.add(conn.value->getStats());
+    }
+    return builder.finish();
+  }
+
   kj::Promise<void> run() { return kj::mv(acceptLoopPromise); }
 
   void dropConnection(VatNetworkBase::Connection& connection, kj::Promise<void> shutdownTask) {
@@ -4681,7 +5118,8 @@ public:
     return *connections.findOrCreate(connection, [&]() -> ConnectionMap::Entry {
       VatNetworkBase::Connection* connectionPtr = connection;
       auto newState = kj::refcounted<RpcConnectionState>(
-          *this, bootstrapFactory, kj::mv(connection), flowLimit, traceEncoder, *brand);
+          *this, bootstrapFactory, kj::mv(connection), flowLimit, traceEncoder, instrumentation,
+          *brand, *methodSizes);
       return {connectionPtr, kj::mv(newState)};
     });
   }
@@ -4692,8 +5130,10 @@ private:
   BootstrapFactoryBase& bootstrapFactory;
   size_t flowLimit = kj::maxValue;
   kj::Maybe<kj::Function<kj::String(const kj::Exception&)>> traceEncoder;
+  kj::Maybe<RpcInstrumentation&> instrumentation;
   kj::Promise<void> acceptLoopPromise = nullptr;
   kj::Own<RpcSystemBrand> brand = kj::refcounted<RpcSystemBrand>();
+  kj::Own<RpcMethodSizeTable> methodSizes = kj::refcounted<RpcMethodSizeTable>();
   kj::TaskSet tasks;
 
   typedef kj::HashMap<VatNetworkBase::Connection*, kj::Own<RpcConnectionState>>
@@ -4749,6 +5189,23 @@ void RpcSystemBase::setTraceEncoder(kj::Function<kj::String(const kj::Exception&
   impl->setTraceEncoder(kj::mv(func));
 }
 
+void RpcSystemBase::setInstrumentation(kj::Maybe<RpcInstrumentation&> instrumentation) {
+  impl->setInstrumentation(instrumentation);
+}
+
+void RpcSystemBase::setStreamFlowController(
+    Capability::Client cap, kj::Own<RpcFlowController> controller) {
+  impl->setStreamFlowController(kj::mv(cap), kj::mv(controller));
+}
+
+kj::Array<RpcMethodMessageSizes> RpcSystemBase::getLearnedMessageSizes() {
+  return impl->getLearnedMessageSizes();
+}
+
+kj::Array<RpcConnectionStats> RpcSystemBase::getConnectionStats() {
+  return impl->getConnectionStats();
+}
+
 kj::Promise<void> RpcSystemBase::run() {
   return impl->run();
 }
@@ -5224,6 +5681,392 @@ private:
   }
 };
 
+// =======================================================================================
+// PacedFlowController
+//
+// A model-based controller in the style of BBR. Where AdaptiveFlowController only sizes a
+// window, this one keeps explicit estimates of the stream's bottleneck bandwidth (a windowed max
+// of delivery-rate samples) and its round-trip time (a windowed min of RTT samples), and uses
+// them for two things: the window is a multiple of the estimated BDP, and sends are *paced* so
+// that bytes leave at a multiple of the estimated bandwidth instead of in a burst each time the
+// window opens. Pacing keeps the queue at the bottleneck short, which keeps the latency of
+// everything else sharing the connection low.
+//
+// Messages must still go out immediately and in order (see RpcFlowController::send()), so pacing
+// is applied by resolving the promise returned by send() at the next message's pacing time,
+// rather than by holding the message itself.
+//
+// The controller moves through the usual BBR modes:
+// - STARTUP: Pacing gain 2/ln(2), which doubles the delivery rate each round, until the
+//   bandwidth estimate has failed to grow by 25% for FULL_BANDWIDTH_ROUNDS rounds.
+// - DRAIN: Pacing gain ln(2)/2, until the queue built during STARTUP has drained, i.e. bytes in
+//   flight have fallen to the estimated BDP.
+// - PROBE_BW: Pacing gain cycles through 5/4 (probe for more bandwidth), 3/4 (drain the queue the
+//   probe created), then 1 for six phases, each lasting one min RTT.
+//
+// BBR's PROBE_RTT mode is omitted: a stream usually shares its connection with other traffic, so
+// briefly cutting this stream's window would not reliably expose the path's propagation delay.
+// Instead the min RTT estimate simply expires after MIN_RTT_EXPIRY and is replaced by the next
+// sample.
+
+class PacedFlowController final: public RpcFlowController, private kj::TaskSet::ErrorHandler {
+public:
+  PacedFlowController(kj::Timer& timer, size_t initialWindowSize)
+      : initialWindow(initialWindowSize), timer(timer),
+        deliveredTime(timer.now()), firstSentTime(deliveredTime), nextSendTime(deliveredTime),
+        readyTime(deliveredTime), cycleStart(deliveredTime), tasks(*this) {
+    state.init<Running>();
+  }
+
+  ~PacedFlowController() noexcept(false) {
+    KJ_IF_SOME(blockedSends, state.tryGet<Running>()) {
+      // See ~AdaptiveFlowController().
+      for (auto& fulfiller: blockedSends) {
+        fulfiller->fulfill();
+      }
+    }
+  }
+
+  kj::Promise<void> send(kj::Own<OutgoingRpcMessage> message, kj::Promise<void> ack) override {
+    auto size = message->sizeInWords() * sizeof(capnp::word);
+    maxMessageSize = kj::max(size, maxMessageSize);
+
+    auto now = timer.now();
+
+    // We are REQUIRED to send the message NOW to maintain correct ordering.
+    message->send();
+
+    if (bytesInFlight == 0) {
+      // Nothing is in flight, so the next delivery-rate sample must not count the idle time
+      // before this send.
+      firstSentTime = now;
+      deliveredTime = now;
+    }
+
+    auto interval = pacingInterval(size);
+    if (now > readyTime && now - readyTime > interval) {
+      // The application sent this message noticeably later than we would have let it. Until
+      // everything in flight now has been acked, delivery-rate samples measure the application,
+      // not the path.
+      appLimitedUntil = kj::max(delivered + bytesInFlight, uint64_t(1));
+    }
+
+    SendSnapshot snapshot {
+      .sentTime = now,
+      .size = size,
+      .deliveredAtSend = delivered,
+      .deliveredTimeAtSend = deliveredTime,
+      .firstSentTimeAtSend = firstSentTime,
+      .appLimited = appLimitedUntil != 0,
+    };
+
+    bytesInFlight += size;
+    nextSendTime = kj::max(now, nextSendTime) + interval;
+
+    tasks.add(ack.then([this, snapshot]() {
+      onAck(snapshot);
+    }));
+
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(blockedSends, Running) {
+        if (isReady()) {
+          readyTime = nextSendTime;
+          return waitUntil(timer, nextSendTime);
+        } else {
+          readyTime = kj::maxValue;  // until an ack releases us
+          // Wait for the window to open, then for our pacing time. Note that the continuation
+          // must not capture `this`, since the controller may be destroyed while it's pending.
+          auto paf = kj::newPromiseAndFulfiller<void>();
+          blockedSends.add(kj::mv(paf.fulfiller));
+          return paf.promise.then([&timer = this->timer, readyAt = nextSendTime]() {
+            return waitUntil(timer, readyAt);
+          });
+        }
+      }
+      KJ_CASE_ONEOF(exception, kj::Exception) {
+        return exception.clone();
+      }
+    }
+    KJ_UNREACHABLE;
+  }
+
+  kj::Promise<void> waitAllAcked() override {
+    KJ_IF_SOME(q, state.tryGet<Running>()) {
+      if (!q.empty()) {
+        auto paf = kj::newPromiseAndFulfiller<kj::Promise<void>>();
+        emptyFulfiller = kj::mv(paf.fulfiller);
+        return kj::mv(paf.promise);
+      }
+    }
+    return tasks.onEmpty();
+  }
+
+private:
+  struct SendSnapshot {
+    // Records the delivery state at the time a message was sent, so that when it is acked we can
+    // compute how fast data was delivered in between.
+
+    kj::TimePoint sentTime;
+    size_t size;
+
+    uint64_t deliveredAtSend;
+    kj::TimePoint deliveredTimeAtSend;
+    // Total bytes acked, and the time of the most recent ack, when this message was sent.
+
+    kj::TimePoint firstSentTimeAtSend;
+    // Send time of the most recently acked message, when this message was sent. The interval
+    // from then until `sentTime` is how long it took us to send the bytes that were delivered
+    // while this message was in flight.
+
+    bool appLimited;
+    // Was the application, rather than the window, limiting the send rate? If so, a low rate
+    // sample says nothing about the path.
+  };
+
+  enum class Mode { STARTUP, DRAIN, PROBE_BW };
+
+  struct BandwidthSample {
+    uint64_t round = 0;
+    double bytesPerSecond = 0;
+  };
+
+  // --- Configuration ---
+  size_t initialWindow;
+  kj::Timer& timer;
+
+  // --- Tracking state ---
+  uint64_t bytesInFlight = 0;
+  size_t maxMessageSize = 0;
+  uint64_t delivered = 0;                  // Total bytes acked so far.
+  kj::TimePoint deliveredTime;             // Time of most recent ack.
+  kj::TimePoint firstSentTime;             // Send time of the most recently acked message.
+  uint64_t appLimitedUntil = 0;            // Nonzero while samples are application-limited.
+  kj::TimePoint nextSendTime;              // Earliest time the next message should be sent.
+  kj::TimePoint readyTime;                 // When the last promise from send() resolves.
+
+  // --- Model ---
+  uint64_t roundCount = 0;                 // Round trips (by delivered bytes) seen so far.
+  uint64_t nextRoundDelivered = 0;         // `delivered` value that ends the current round.
+  BandwidthSample bandwidthSamples[10];    // Per-round maxima, indexed by round mod 10.
+  kj::Duration minRtt = 365 * kj::DAYS;
+  kj::Maybe<kj::TimePoint> minRttStamp;    // When `minRtt` was measured; none until measured.
+
+  // --- Mode state ---
+  Mode mode = Mode::STARTUP;
+  double fullBandwidth = 0;
+  uint fullBandwidthCount = 0;
+  uint cycleIndex = 0;
+  kj::TimePoint cycleStart;
+
+  // --- Blocking/error state ---
+  typedef kj::Vector<kj::Own<kj::PromiseFulfiller<void>>> Running;
+  kj::OneOf<Running, kj::Exception> state;
+
+  kj::Maybe<kj::Own<kj::PromiseFulfiller<kj::Promise<void>>>> emptyFulfiller;
+
+  kj::TaskSet tasks;
+
+  static constexpr size_t MAX_WINDOW = 1024 * 1024 * 1024;
+  static constexpr size_t MIN_WINDOW = 64 * 1024;
+  static constexpr uint FULL_BANDWIDTH_ROUNDS = 3;
+  static constexpr kj::Duration MIN_RTT_EXPIRY = 10 * kj::SECONDS;
+  static constexpr kj::Duration MAX_PACING_INTERVAL = 1 * kj::SECONDS;
+
+  static constexpr double HIGH_GAIN = 2.885;  // 2/ln(2)
+  static constexpr double PROBE_BW_CWND_GAIN = 2;
+  static constexpr double PACING_GAIN_CYCLE[8] = { 1.25, 0.75, 1, 1, 1, 1, 1, 1 };
+
+  static kj::Promise<void> waitUntil(kj::Timer& timer, kj::TimePoint time) {
+    // A timer promise for a time that has already passed would not resolve until the timer next
+    // advances, so only wait if `time` is still in the future.
+    if (time > timer.now()) {
+      return timer.atTime(time);
+    } else {
+      return kj::READY_NOW;
+    }
+  }
+
+  double getBandwidth() {
+    // Max of the per-round samples over the last 10 rounds, in bytes per second.
+    double result = 0;
+    for (auto& sample: bandwidthSamples) {
+      if (sample.round + kj::size(bandwidthSamples) > roundCount) {
+        result = kj::max(result, sample.bytesPerSecond);
+      }
+    }
+    return result;
+  }
+
+  double getPacingGain() {
+    switch (mode) {
+      case Mode::STARTUP: return HIGH_GAIN;
+      case Mode::DRAIN: return 1 / HIGH_GAIN;
+      case Mode::PROBE_BW: return PACING_GAIN_CYCLE[cycleIndex];
+    }
+    KJ_UNREACHABLE;
+  }
+
+  kj::Maybe<uint64_t> getBdp() {
+    // Estimated bandwidth-delay product in bytes, or none if we don't have a model yet.
+    double bandwidth = getBandwidth();
+    if (bandwidth == 0 || minRttStamp == kj::none) return kj::none;
+    return uint64_t(bandwidth * (minRtt / kj::NANOSECONDS) / 1e9);
+  }
+
+  size_t getWindow() {
+    KJ_IF_SOME(bdp, getBdp()) {
+      double gain = mode == Mode::PROBE_BW ? PROBE_BW_CWND_GAIN : HIGH_GAIN;
+      uint64_t window = kj::min(uint64_t(bdp * gain), uint64_t(MAX_WINDOW));
+      if (mode == Mode::STARTUP) {
+        // Early samples are noisy; don't let them shrink the window below where we started.
+        window = kj::max(window, uint64_t(initialWindow));
+      }
+      return kj::max(window, uint64_t(MIN_WINDOW));
+    } else {
+      return initialWindow;
+    }
+  }
+
+  kj::Duration pacingInterval(size_t size) {
+    // How long sending `size` bytes takes at the current pacing rate. Zero (no pacing) until we
+    // have measured an RTT; until we've measured bandwidth, we assume the initial window per RTT.
+    double bandwidth = getBandwidth();
+    if (bandwidth == 0) {
+      if (minRttStamp == kj::none) return 0 * kj::NANOSECONDS;
+      bandwidth = initialWindow * 1e9 / (minRtt / kj::NANOSECONDS);
+    }
+    double seconds = size / (bandwidth * getPacingGain());
+    if (seconds >= 1) return MAX_PACING_INTERVAL;
+    return int64_t(seconds * 1e9) * kj::NANOSECONDS;
+  }
+
+  void onAck(const SendSnapshot& snapshot) {
+    auto now = timer.now();
+
+    delivered += snapshot.size;
+    deliveredTime = now;
+    firstSentTime = snapshot.sentTime;
+    bytesInFlight -= snapshot.size;
+    if (appLimitedUntil != 0 && delivered > appLimitedUntil) {
+      appLimitedUntil = 0;
+    }
+
+    // Update the min RTT, letting an old one expire.
+    auto rtt = now - snapshot.sentTime;
+    bool rttExpired = true;
+    KJ_IF_SOME(stamp, minRttStamp) {
+      rttExpired = now - stamp > MIN_RTT_EXPIRY;
+    }
+    if (rtt <= minRtt || rttExpired) {
+      minRtt = rtt;
+      minRttStamp = now;
+    }
+
+    // A round ends when a message sent after the previous round ended is acked.
+    bool roundStart = false;
+    if (snapshot.deliveredAtSend >= nextRoundDelivered) {
+      nextRoundDelivered = delivered;
+      ++roundCount;
+      roundStart = true;
+    }
+
+    // Take a delivery-rate sample. The interval is the longer of the send and ack intervals, so
+    // that neither a burst of sends nor a burst of (possibly compressed) acks inflates the rate.
+    // Intervals shorter than the min RTT can't be measured reliably and are discarded.
+    auto interval = kj::max(snapshot.sentTime - snapshot.firstSentTimeAtSend,
+                            now - snapshot.deliveredTimeAtSend);
+    if (interval >= minRtt && interval > 0 * kj::NANOSECONDS) {
+      double rate = (delivered - snapshot.deliveredAtSend) * 1e9 / (interval / kj::NANOSECONDS);
+      if (!snapshot.appLimited || rate >= getBandwidth()) {
+        auto& sample = bandwidthSamples[roundCount % kj::size(bandwidthSamples)];
+        if (sample.round != roundCount) {
+          sample = { roundCount, rate };
+        } else {
+          sample.bytesPerSecond = kj::max(sample.bytesPerSecond, rate);
+        }
+      }
+    }
+
+    // Advance the mode.
+    if (mode == Mode::STARTUP && roundStart && !snapshot.appLimited) {
+      double bandwidth = getBandwidth();
+      if (bandwidth >= fullBandwidth * 1.25) {
+        fullBandwidth = bandwidth;
+        fullBandwidthCount = 0;
+      } else if (++fullBandwidthCount >= FULL_BANDWIDTH_ROUNDS) {
+        mode = Mode::DRAIN;
+      }
+    }
+    if (mode == Mode::DRAIN) {
+      KJ_IF_SOME(bdp, getBdp()) {
+        if (bytesInFlight <= bdp) {
+          // Start in one of the gain-1 phases, so we don't immediately probe or drain again.
+          mode = Mode::PROBE_BW;
+          cycleIndex = 2;
+          cycleStart = now;
+        }
+      }
+    }
+    if (mode == Mode::PROBE_BW) {
+      bool advance = now - cycleStart > minRtt;
+      if (PACING_GAIN_CYCLE[cycleIndex] < 1) {
+        // The draining phase can end as soon as the queue is gone.
+        KJ_IF_SOME(bdp, getBdp()) {
+          advance = advance || bytesInFlight <= bdp;
+        }
+      }
+      if (advance) {
+        cycleIndex = (cycleIndex + 1) % kj::size(PACING_GAIN_CYCLE);
+        cycleStart = now;
+      }
+    }
+
+    // Release blocked senders if the window now has room.
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(blockedSends, Running) {
+        if (isReady() && !blockedSends.empty()) {
+          for (auto& fulfiller: blockedSends) {
+            fulfiller->fulfill();
+          }
+          blockedSends.clear();
+          readyTime = kj::max(now, nextSendTime);
+        }
+
+        KJ_IF_SOME(f, emptyFulfiller) {
+          if (bytesInFlight == 0) {
+            f->fulfill(tasks.onEmpty());
+          }
+        }
+      }
+      KJ_CASE_ONEOF(exception, kj::Exception) {
+        // A previous call failed, but this one -- which was already in-flight at the time --
+        // ended up succeeding. Nothing much we can do about it here.
+      }
+    }
+  }
+
+  void taskFailed(kj::Exception&& exception) override {
+    KJ_SWITCH_ONEOF(state) {
+      KJ_CASE_ONEOF(blockedSends, Running) {
+        // Fail out all pending sends.
+        for (auto& fulfiller: blockedSends) {
+          fulfiller->reject(exception.clone());
+        }
+        // Fail out all future sends.
+        state = kj::mv(exception);
+      }
+      KJ_CASE_ONEOF(exception, kj::Exception) {
+        // ignore redundant exception
+      }
+    }
+  }
+
+  bool isReady() {
+    // As in AdaptiveFlowController, allow one max-sized message beyond the window.
+    return bytesInFlight < getWindow() + maxMessageSize;
+  }
+};
+
 }  // namespace
 
 kj::Own<RpcFlowController> RpcFlowController::newFixedWindowController(size_t windowSize) {
@@ -5236,6 +6079,10 @@ kj::Own<RpcFlowController> RpcFlowController::newAdaptiveController(
     size_t initialWindowSize, const kj::MonotonicClock& clock) {
   return kj::heap<AdaptiveFlowController>(initialWindowSize, clock);
 }
+kj::Own<RpcFlowController> RpcFlowController::newPacedController(
+    kj::Timer& timer, size_t initialWindowSize) {
+  return kj::heap<PacedFlowController>(timer, initialWindowSize);
+}
 
 bool IncomingRpcMessage::isShortLivedRpcMessage(AnyPointer::Reader body) {
   switch (body.getAs<rpc::Message>().which()) {
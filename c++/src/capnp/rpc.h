@@ -22,7 +22,7 @@
 #pragma once
 
 #include <capnp/capability.h>
-#include <kj/time.h>
+#include <kj/timer.h>
 #include "rpc-prelude.h"
 
 CAPNP_BEGIN_HEADER
@@ -134,6 +134,47 @@ public:
   // Stack traces can sometimes contain sensitive information, so you should think carefully about
   // what information you are willing to reveal to the remote party.
 
+  // kj::Array<RpcMethodMessageSizes> getLearnedMessageSizes();
+  //
+  // (Inherited from _::RpcSystemBase)
+  //
+  // The RpcSystem remembers how large the Call messages it sends and the Return messages it sends
+  // back tend to be, per interface method and across all connections. When a call is made without
+  // a size hint (or a method fills in its results without one), and experience says the message
+  // will outgrow a default-sized first segment, the first segment is sized from what was learned.
+  // This returns a snapshot of what has been learned, one entry per method seen, for diagnostics.
+  // At most a few thousand methods are tracked.
+
+  // kj::Array<RpcConnectionStats> getConnectionStats();
+  //
+  // (Inherited from _::RpcSystemBase)
+  //
+  // Reports, for each live connection, how many entries each of its tables (questions, answers,
+  // exports, imports, embargoes) holds now, the most it has ever held, and roughly how much memory
+  // the table is using. Tables that grew during a burst of activity shrink again once most of their
+  // entries are released, but live IDs are never renumbered, so one long-lived entry with a high
+  // ID can pin a table's size.
+
+  // void setInstrumentation(kj::Maybe<RpcInstrumentation&> instrumentation);
+  //
+  // (Inherited from _::RpcSystemBase)
+  //
+  // Tells `instrumentation` about every call sent and received from now on: when it is sent,
+  // returns, or is dispatched and finishes, with its method and message sizes. See
+  // rpc-instrumentation.h, which also provides RpcMethodHistograms, an implementation that keeps
+  // latency and size histograms per method. `instrumentation` must outlive the RpcSystem, or be
+  // unset by passing kj::none. With no instrumentation set, the cost is a pointer check per call.
+
+  // void setStreamFlowController(Capability::Client cap, kj::Own<RpcFlowController> controller);
+  //
+  // (Inherited from _::RpcSystemBase)
+  //
+  // Makes streaming calls on `cap` use `controller` instead of the one the VatNetwork's
+  // Connection::newStream() would supply, e.g. RpcFlowController::newPacedController() for a bulk
+  // transfer over a long, fat path. `cap` must have been obtained over one of this RpcSystem's
+  // connections; local capabilities are not flow-controlled. Copies of `cap` share the
+  // controller. Streaming calls already in flight finish under the old controller.
+
   kj::Promise<void> run() { return RpcSystemBase::run(); }
   // Listens for incoming RPC connections and handles them. Never returns normally, but could throw
   // an exception if the system becomes unable to accept new connections (e.g. because the
@@ -187,6 +228,22 @@ RpcSystem<VatId> makeRpcClient(
 // =======================================================================================
 // VatNetwork
 
+enum class MessagePriority: uint8_t {
+  // How urgently an outgoing message should be sent. See OutgoingRpcMessage::setPriority().
+
+  NORMAL,
+  // Delivered in the order sent, relative to all other messages.
+
+  URGENT,
+  // A small, latency-sensitive message which doesn't depend on any BULK message sent before it,
+  // such as a Return. May be sent ahead of BULK messages that are still queued, but never ahead
+  // of NORMAL or other URGENT ones.
+
+  BULK
+  // A message carrying bulk data, such as a call to a streaming method. Like NORMAL, except that
+  // URGENT messages may overtake it.
+};
+
 class OutgoingRpcMessage {
   // A message to be sent by a `VatNetwork`.
 
@@ -199,6 +256,10 @@ public:
   // Set the list of file descriptors to send along with this message, if FD passing is supported.
   // An implementation may ignore this.
 
+  virtual void setPriority(MessagePriority priority) {}
+  // Set the message's priority, before calling send(). The default is NORMAL. An implementation
+  // may ignore this.
+
   virtual void send() = 0;
   // Send the message, or at least put it in a queue to be sent later.  Note that the builder
   // returned by `getBody()` remains valid at least until the `OutgoingRpcMessage` is destroyed.
@@ -307,6 +368,22 @@ public:
   // `initialWindowSize` is used before any bandwidth estimate is available. 256kB is a reasonable
   // default. `clock` is used to measure send/ack timestamps for BDP estimation.
 
+  static kj::Own<RpcFlowController> newPacedController(
+      kj::Timer& timer, size_t initialWindowSize = DEFAULT_WINDOW_SIZE);
+  // Constructs a flow controller modeled on BBR congestion control. Like newAdaptiveController(),
+  // it estimates the stream's bottleneck bandwidth and round-trip time, and keeps about twice the
+  // resulting BDP in flight. Unlike it, it also paces the stream: the promise returned by send()
+  // resolves when, at slightly above or below the estimated bandwidth, the next message is due,
+  // so that the stream flows steadily rather than in a burst each time acks arrive. Every few
+  // round trips it briefly paces 25% faster to find out whether more bandwidth has become
+  // available, then 25% slower to drain the queue that created.
+  //
+  // This suits long-lived bulk streams over paths with a large BDP, where a fixed window either
+  // starves the stream or builds a deep queue. Use RpcSystem::setStreamFlowController() to apply
+  // it to a particular stream. `timer` is used both to measure RTT and to schedule sends, and
+  // must outlive the controller and any promise it returns. `initialWindowSize` bounds the
+  // first round trip, before anything has been measured.
+
   static constexpr size_t DEFAULT_WINDOW_SIZE = 65536;
   // The window size used by the default implementation of Connection::newStream().
 };
@@ -572,6 +572,89 @@ KJ_TEST("large segment counts are rejected -- even UINT_MAX") {
       readMessage(*pipe.in).wait(ws));
 }
 
+KJ_TEST("readMessageStreaming() delivers leading segments early") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  TestMessageBuilder builder(10);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto segments = builder.getSegmentsForOutput();
+  auto flat = messageToFlatArray(builder);
+
+  // Send the segment table and the first segment only.
+  size_t prefixWords = segments.size() / 2 + 1 + segments[0].size();
+  auto pipe = kj::newOneWayPipe();
+  auto writePromise = pipe.out->write(flat.first(prefixWords).asBytes());
+
+  auto reader = readMessageStreaming(*pipe.in).wait(ws);
+  KJ_EXPECT(reader->getSegmentCount() == 10);
+  KJ_EXPECT(reader->getReceivedSegmentCount() == 1);
+  KJ_EXPECT(!reader->isComplete());
+  writePromise.wait(ws);
+
+  // TestMessageBuilder puts only the root pointer in the first segment.
+  KJ_EXPECT_THROW_MESSAGE("message segment has not been received yet",
+      reader->getRoot<TestAllTypes>());
+
+  auto completePromise = reader->whenComplete();
+  auto secondPromise = reader->whenSegmentReceived(1);
+  KJ_EXPECT(!completePromise.poll(ws));
+  KJ_EXPECT(!secondPromise.poll(ws));
+
+  // Send the second segment, which holds the root struct.
+  size_t secondEnd = prefixWords + segments[1].size();
+  pipe.out->write(flat.slice(prefixWords, secondEnd).asBytes()).wait(ws);
+  secondPromise.wait(ws);
+  KJ_EXPECT(!completePromise.poll(ws));
+
+  auto root = reader->getRoot<TestAllTypes>();
+  KJ_EXPECT(root.getInt32Field() == -12345678);
+  KJ_EXPECT_THROW_MESSAGE("message segment has not been received yet",
+      checkTestMessage(root));
+
+  // Send the rest one word at a time.
+  for (auto i: kj::range(secondEnd, flat.size())) {
+    pipe.out->write(flat.slice(i, i + 1).asBytes()).wait(ws);
+  }
+
+  completePromise.wait(ws);
+  KJ_EXPECT(reader->isComplete());
+  checkTestMessage(reader->getRoot<TestAllTypes>());
+}
+
+KJ_TEST("readMessageStreaming() reports premature EOF to waiters") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  TestMessageBuilder builder(4);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto segments = builder.getSegmentsForOutput();
+  auto flat = messageToFlatArray(builder);
+
+  size_t prefixWords = segments.size() / 2 + 1 + segments[0].size();
+  auto pipe = kj::newOneWayPipe();
+  auto writePromise = pipe.out->write(flat.first(prefixWords + 1).asBytes());
+
+  auto reader = readMessageStreaming(*pipe.in).wait(ws);
+  writePromise.wait(ws);
+  auto completePromise = reader->whenComplete();
+  pipe.out = nullptr;
+
+  KJ_EXPECT_THROW_MESSAGE("Premature EOF", completePromise.wait(ws));
+  KJ_EXPECT_THROW_MESSAGE("Premature EOF", reader->whenSegmentReceived(3).wait(ws));
+  KJ_EXPECT(!reader->isComplete());
+}
+
+KJ_TEST("tryReadMessageStreaming() returns none on clean EOF") {
+  kj::EventLoop loop;
+  kj::WaitScope ws(loop);
+
+  auto pipe = kj::newOneWayPipe();
+  pipe.out = nullptr;
+
+  KJ_EXPECT(tryReadMessageStreaming(*pipe.in).wait(ws) == kj::none);
+}
+
 }  // namespace
 }  // namespace _ (private)
 }  // namespace capnp
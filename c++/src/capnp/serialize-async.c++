@@ -239,6 +239,180 @@ kj::Promise<kj::Maybe<MessageReaderAndFds>> tryReadMessage(
   });
 }
 
+// -----------------------------------------------------------------------------
+
+StreamingMessageReader::StreamingMessageReader(ReaderOptions options)
+    : MessageReader(options), firstWord{} {}
+
+StreamingMessageReader::~StreamingMessageReader() noexcept(false) {}
+
+kj::Promise<bool> StreamingMessageReader::readHeader(kj::AsyncInputStream& input) {
+  return input.tryRead(firstWord, sizeof(firstWord), sizeof(firstWord))
+      .then([this,&input](size_t n) -> kj::Promise<bool> {
+    if (n == 0) {
+      return false;
+    } else if (n < sizeof(firstWord)) {
+      // EOF in first word.
+      kj::throwRecoverableException(KJ_EXCEPTION(DISCONNECTED, "Premature EOF."));
+      return false;
+    }
+
+    // Same limit as AsyncMessageReader::readAfterFirstWord().
+    KJ_REQUIRE(firstWord[0].get() < 511, "Message has too many segments.") {
+      return false;  // exception will be propagated
+    }
+
+    kj::Promise<void> promise = kj::READY_NOW;
+    if (segmentCount() > 1) {
+      // Read sizes for all segments except the first.  Include padding if necessary.
+      moreSizes = kj::heapArray<_::WireValue<uint32_t>>(segmentCount() & ~1);
+      promise = input.read(moreSizes.asBytes());
+    }
+
+    return promise.then([this]() {
+      segmentEnds = kj::heapArray<size_t>(segmentCount());
+      size_t totalWords = firstWord[1].get();
+      segmentEnds[0] = totalWords;
+      for (uint i = 1; i < segmentCount(); i++) {
+        totalWords += moreSizes[i - 1].get();
+        segmentEnds[i] = totalWords;
+      }
+
+      KJ_REQUIRE(totalWords <= getOptions().traversalLimitInWords,
+                 "Message is too large.  To increase the limit on the receiving end, see "
+                 "capnp::ReaderOptions.") {
+        return false;  // exception will be propagated
+      }
+
+      space = kj::heapArray<word>(totalWords);
+      return true;
+    });
+  });
+}
+
+void StreamingMessageReader::startReading(kj::AsyncInputStream& input) {
+  advance();
+  if (isComplete()) return;
+
+  readTask = readMore(input).eagerlyEvaluate([this](kj::Exception&& e) {
+    fail(kj::mv(e));
+  });
+}
+
+kj::Promise<void> StreamingMessageReader::readMore(kj::AsyncInputStream& input) {
+  // Wait for at least the rest of the next segment, but take whatever else is available, up to
+  // the end of the message.
+  size_t minBytes = segmentEnds[receivedSegments] * sizeof(word) - bytesReceived;
+  size_t maxBytes = space.asBytes().size() - bytesReceived;
+
+  return input.tryRead(space.asBytes().begin() + bytesReceived, minBytes, maxBytes)
+      .then([this,&input,minBytes](size_t n) -> kj::Promise<void> {
+    bytesReceived += n;
+    if (n < minBytes) {
+      return KJ_EXCEPTION(DISCONNECTED, "Premature EOF.");
+    }
+
+    advance();
+    if (isComplete()) {
+      return kj::READY_NOW;
+    } else {
+      return readMore(input);
+    }
+  });
+}
+
+void StreamingMessageReader::advance() {
+  while (receivedSegments < segmentCount() &&
+         segmentEnds[receivedSegments] * sizeof(word) <= bytesReceived) {
+    ++receivedSegments;
+  }
+
+  if (waiters.empty()) return;
+
+  kj::Vector<Waiter> stillWaiting;
+  for (auto& waiter: waiters) {
+    if (waiter.segmentId < receivedSegments) {
+      waiter.fulfiller->fulfill();
+    } else {
+      stillWaiting.add(kj::mv(waiter));
+    }
+  }
+  waiters = kj::mv(stillWaiting);
+}
+
+void StreamingMessageReader::fail(kj::Exception&& e) {
+  for (auto& waiter: waiters) {
+    waiter.fulfiller->reject(e.clone());
+  }
+  waiters.clear();
+  failure = kj::mv(e);
+}
+
+kj::Promise<void> StreamingMessageReader::whenSegmentReceived(uint id) {
+  KJ_REQUIRE(id < segmentCount(), "segment ID out of range", id, segmentCount());
+
+  if (id < receivedSegments) {
+    return kj::READY_NOW;
+  }
+  KJ_IF_SOME(e, failure) {
+    return e.clone();
+  }
+
+  auto paf = kj::newPromiseAndFulfiller<void>();
+  waiters.add(Waiter { id, kj::mv(paf.fulfiller) });
+  return kj::mv(paf.promise);
+}
+
+kj::Promise<void> StreamingMessageReader::whenComplete() {
+  return whenSegmentReceived(segmentCount() - 1);
+}
+
+kj::ArrayPtr<const word> StreamingMessageReader::getSegment(uint id) {
+  if (id >= segmentCount()) {
+    return nullptr;
+  }
+
+  KJ_REQUIRE(id < receivedSegments,
+      "message segment has not been received yet; wait for whenSegmentReceived()", id) {
+    return nullptr;
+  }
+
+  size_t begin = id == 0 ? 0 : segmentEnds[id - 1];
+  return space.slice(begin, segmentEnds[id]);
+}
+
+kj::Promise<kj::Own<StreamingMessageReader>> readMessageStreaming(
+    kj::AsyncInputStream& input, ReaderOptions options) {
+  return tryReadMessageStreaming(input, options)
+      .then([](kj::Maybe<kj::Own<StreamingMessageReader>> maybeReader)
+            -> kj::Own<StreamingMessageReader> {
+    KJ_IF_SOME(reader, maybeReader) {
+      return kj::mv(reader);
+    } else {
+      kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED, "Premature EOF."));
+    }
+  });
+}
+
+kj::Promise<kj::Maybe<kj::Own<StreamingMessageReader>>> tryReadMessageStreaming(
+    kj::AsyncInputStream& input, ReaderOptions options) {
+  auto reader = kj::heap<StreamingMessageReader>(options);
+  auto promise = reader->readHeader(input);
+  return promise.then([reader = kj::mv(reader),&input](bool success) mutable
+                      -> kj::Promise<kj::Maybe<kj::Own<StreamingMessageReader>>> {
+    if (!success) {
+      return kj::Maybe<kj::Own<StreamingMessageReader>>(kj::none);
+    }
+
+    reader->startReading(input);
+    auto promise = reader->whenSegmentReceived(0);
+    return promise.then([reader = kj::mv(reader)]() mutable
+                        -> kj::Maybe<kj::Own<StreamingMessageReader>> {
+      return kj::mv(reader);
+    });
+  });
+}
+
 // =======================================================================================
 
 namespace {
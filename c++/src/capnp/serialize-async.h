@@ -295,6 +295,88 @@ kj::Promise<void> writeMessages(
     kj::AsyncOutputStream& output, kj::ArrayPtr<kj::Own<MessageBuilder>> builders)
     KJ_WARN_UNUSED_RESULT;
 
+// -----------------------------------------------------------------------------
+// Streaming reads for large messages.
+
+class StreamingMessageReader final: public MessageReader {
+  // A MessageReader which is handed out as soon as the segment table and the first segment have
+  // been received, while later segments continue to arrive in the background. Segments are
+  // delivered in order, each as soon as its last byte is read, so a consumer can start work on a
+  // large message without waiting for all of it. MessageBuilder grows its segments as the message
+  // grows, so a large message normally has many segments, with the root object in the first.
+  //
+  // Following a pointer into a segment that has not arrived yet throws an exception. Call
+  // whenSegmentReceived() or whenComplete() before accessing parts of the message that may live in
+  // later segments. If the stream fails or disconnects before the message is complete, these
+  // promises are rejected.
+  //
+  // The input stream must remain valid until whenComplete() resolves or the reader is destroyed.
+  // Destroying the reader early cancels the remaining reads, leaving the stream in an unspecified
+  // position.
+  //
+  // Use readMessageStreaming() or tryReadMessageStreaming() to construct one.
+
+public:
+  explicit StreamingMessageReader(ReaderOptions options);
+  KJ_DISALLOW_COPY_AND_MOVE(StreamingMessageReader);
+  ~StreamingMessageReader() noexcept(false);
+
+  inline uint getSegmentCount() const { return segmentCount(); }
+  inline uint getReceivedSegmentCount() const { return receivedSegments; }
+  inline bool isComplete() const { return receivedSegments == segmentCount(); }
+
+  kj::Promise<void> whenSegmentReceived(uint id);
+  // Resolves when segment `id` and all segments before it have been received.
+
+  kj::Promise<void> whenComplete();
+  // Resolves when the whole message has been received.
+
+  // implements MessageReader ----------------------------------------
+  kj::ArrayPtr<const word> getSegment(uint id) override;
+
+private:
+  _::WireValue<uint32_t> firstWord[2];
+  kj::Array<_::WireValue<uint32_t>> moreSizes;
+
+  kj::Array<word> space;
+  kj::Array<size_t> segmentEnds;
+  // Offset in `space` just past the end of each segment.
+
+  size_t bytesReceived = 0;
+  uint receivedSegments = 0;
+
+  struct Waiter {
+    uint segmentId;
+    kj::Own<kj::PromiseFulfiller<void>> fulfiller;
+  };
+  kj::Vector<Waiter> waiters;
+
+  kj::Maybe<kj::Exception> failure;
+  kj::Maybe<kj::Promise<void>> readTask;
+
+  inline uint segmentCount() const { return firstWord[0].get() + 1; }
+
+  kj::Promise<void> readMore(kj::AsyncInputStream& input);
+  void advance();
+  void fail(kj::Exception&& e);
+
+  kj::Promise<bool> readHeader(kj::AsyncInputStream& input);
+  void startReading(kj::AsyncInputStream& input);
+
+  friend kj::Promise<kj::Own<StreamingMessageReader>> readMessageStreaming(
+      kj::AsyncInputStream& input, ReaderOptions options);
+  friend kj::Promise<kj::Maybe<kj::Own<StreamingMessageReader>>> tryReadMessageStreaming(
+      kj::AsyncInputStream& input, ReaderOptions options);
+};
+
+kj::Promise<kj::Own<StreamingMessageReader>> readMessageStreaming(
+    kj::AsyncInputStream& input, ReaderOptions options = ReaderOptions());
+
+kj::Promise<kj::Maybe<kj::Own<StreamingMessageReader>>> tryReadMessageStreaming(
+    kj::AsyncInputStream& input, ReaderOptions options = ReaderOptions());
+// Like readMessage() and tryReadMessage(), but resolves once the first segment is available,
+// without waiting for the rest of the message. See StreamingMessageReader.
+
 // =======================================================================================
 // inline implementation details
 
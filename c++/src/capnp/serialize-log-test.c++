@@ -0,0 +1,193 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-log.h"
+#include "message.h"
+#include <kj/mutex.h>
+#include <kj/test.h>
+#include "test-util.h"
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+uint64_t appendMessages(const kj::File& file, uint first, uint count) {
+  // Append `count` messages to `file`, numbered starting from `first`, the way a writer calling
+  // writeMessage() in a loop would. Returns the new file size.
+
+  uint64_t pos = file.stat().size;
+  for (uint i = first; i < first + count; i++) {
+    MallocMessageBuilder builder;
+    auto root = builder.initRoot<TestAllTypes>();
+    root.setUInt32Field(i);
+    // Vary the size, and make some messages multi-segment.
+    root.setTextField(kj::str(kj::repeat('x', i % 7 * 100)));
+    if (i % 5 == 0) {
+      root.initDataField(SUGGESTED_FIRST_SEGMENT_WORDS * sizeof(word));
+    }
+
+    auto words = messageToFlatArray(builder);
+    auto bytes = words.asBytes();
+    file.write(pos, bytes);
+    pos += bytes.size();
+  }
+  return pos;
+}
+
+void checkMessages(const MappedMessageLog& log, uint count) {
+  KJ_ASSERT(log.size() == count);
+  for (uint i = 0; i < count; i++) {
+    auto root = log.get(i)->getRoot<TestAllTypes>();
+    KJ_EXPECT(root.getUInt32Field() == i);
+    KJ_EXPECT(root.getTextField().size() == i % 7 * 100);
+  }
+}
+
+KJ_TEST("MappedMessageLog random access") {
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  uint64_t end = appendMessages(*file, 0, 100);
+
+  MappedMessageLog log(*file);
+  checkMessages(log, 100);
+
+  KJ_EXPECT(log.getByteOffset(0) == 0);
+  KJ_EXPECT(log.getByteOffset(100) == end);
+  for (uint i = 0; i < 100; i++) {
+    KJ_EXPECT(log.getByteOffset(i + 1) - log.getByteOffset(i) ==
+              log.getWords(i).size() * sizeof(word));
+  }
+
+  KJ_EXPECT_THROW_MESSAGE("out of range", log.get(100));
+}
+
+KJ_TEST("MappedMessageLog ignores partial message at end") {
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  uint64_t end = appendMessages(*file, 0, 10);
+
+  MallocMessageBuilder builder;
+  builder.initRoot<TestAllTypes>().setTextField("partial");
+  auto words = messageToFlatArray(builder);
+  auto bytes = words.asBytes();
+  file->write(end, bytes.first(bytes.size() - 12));
+
+  MappedMessageLog log(*file);
+  checkMessages(log, 10);
+  KJ_EXPECT(log.getByteOffset(10) == end);
+}
+
+KJ_TEST("MappedMessageLog empty file") {
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  MappedMessageLog log(*file);
+  KJ_EXPECT(log.size() == 0);
+  KJ_EXPECT(log.getByteOffset(0) == 0);
+}
+
+KJ_TEST("MappedMessageLog saved index") {
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  appendMessages(*file, 0, 50);
+
+  auto index = kj::newInMemoryFile(kj::nullClock());
+  {
+    MappedMessageLog log(*file);
+    log.writeIndex(*index);
+  }
+
+  {
+    MappedMessageLog log(*file, *index);
+    checkMessages(log, 50);
+  }
+
+  // Messages appended after the index was written are picked up.
+  appendMessages(*file, 50, 25);
+  {
+    MappedMessageLog log(*file, *index);
+    checkMessages(log, 75);
+  }
+
+  // An index that refers past the end of a truncated log is discarded.
+  {
+    MappedMessageLog log(*file);
+    log.writeIndex(*index);
+    file->truncate(log.getByteOffset(30));
+  }
+  {
+    MappedMessageLog log(*file, *index);
+    checkMessages(log, 30);
+  }
+
+  // So is an index for a different log, as long as it doesn't line up by chance.
+  appendMessages(*file, 30, 10);
+  auto other = kj::newInMemoryFile(kj::nullClock());
+  appendMessages(*other, 3, 40);
+  {
+    MappedMessageLog log(*other, *index);
+    KJ_ASSERT(log.size() == 40);
+    for (uint i = 0; i < 40; i++) {
+      KJ_EXPECT(log.get(i)->getRoot<TestAllTypes>().getUInt32Field() == i + 3);
+    }
+  }
+
+  // An empty index is the same as none.
+  {
+    MappedMessageLog log(*file, *kj::newInMemoryFile(kj::nullClock()));
+    checkMessages(log, 40);
+  }
+}
+
+KJ_TEST("MappedMessageLog forEach") {
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  appendMessages(*file, 0, 101);
+  MappedMessageLog log(*file);
+
+  for (uint threadCount: {1, 3, 8, 200}) {
+    kj::MutexGuarded<kj::Array<uint>> seen(kj::heapArray<uint>(101));
+    for (auto& n: *seen.lockExclusive()) n = 0;
+
+    log.forEach(threadCount, [&](size_t index, MessageReader& message) {
+      KJ_ASSERT(message.getRoot<TestAllTypes>().getUInt32Field() == index);
+      seen.lockExclusive()->operator[](index)++;
+    });
+
+    for (auto n: *seen.lockExclusive()) {
+      KJ_EXPECT(n == 1, threadCount);
+    }
+  }
+
+  KJ_EXPECT_THROW_MESSAGE("bad message", log.forEach(4, [](size_t index, MessageReader&) {
+    if (index == 77) KJ_FAIL_ASSERT("bad message");
+  }));
+}
+
+KJ_TEST("MappedMessageLog forEach when every thread throws") {
+  // The calling thread's exception must not unwind past workers that are still running or that
+  // will rethrow their own exceptions when joined.
+  auto file = kj::newInMemoryFile(kj::nullClock());
+  appendMessages(*file, 0, 16);
+  MappedMessageLog log(*file);
+
+  KJ_EXPECT_THROW_MESSAGE("bad message", log.forEach(4, [](size_t index, MessageReader&) {
+    KJ_FAIL_ASSERT("bad message", index);
+  }));
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
@@ -0,0 +1,181 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "serialize-log.h"
+#include "message.h"
+#include <kj/debug.h>
+#include <kj/thread.h>
+
+namespace capnp {
+
+namespace {
+
+kj::Array<const byte> mapWholeFile(const kj::ReadableFile& file) {
+  // Only whole words can contain messages, so a trailing partial word is left unmapped.
+  uint64_t size = file.stat().size;
+  size -= size % sizeof(word);
+  if (size == 0) return nullptr;
+  return file.mmap(0, size);
+}
+
+kj::ArrayPtr<const word> asWords(kj::ArrayPtr<const byte> bytes) {
+  return kj::arrayPtr(reinterpret_cast<const word*>(bytes.begin()), bytes.size() / sizeof(word));
+}
+
+}  // namespace
+
+MappedMessageLog::MappedMessageLog(const kj::ReadableFile& file, ReaderOptions options)
+    : options(options), mapping(mapWholeFile(file)), words(asWords(mapping)) {
+  offsets.add(0);
+  scan();
+}
+
+MappedMessageLog::MappedMessageLog(const kj::ReadableFile& file, const kj::ReadableFile& index,
+                                   ReaderOptions options)
+    : options(options), mapping(mapWholeFile(file)), words(asWords(mapping)) {
+  if (!tryLoadIndex(index)) {
+    offsets.clear();
+    offsets.add(0);
+  }
+  scan();
+}
+
+kj::ArrayPtr<const word> MappedMessageLog::getWords(size_t index) const {
+  KJ_REQUIRE(index < size(), "Message index out of range.", index, size());
+  return words.slice(offsets[index], offsets[index + 1]);
+}
+
+kj::Own<MessageReader> MappedMessageLog::get(size_t index) const {
+  return kj::heap<FlatArrayMessageReader>(getWords(index), options);
+}
+
+uint64_t MappedMessageLog::getByteOffset(size_t index) const {
+  KJ_REQUIRE(index <= size(), "Message index out of range.", index, size());
+  return offsets[index] * sizeof(word);
+}
+
+void MappedMessageLog::writeIndex(const kj::File& file) const {
+  // One word for the root pointer, one for the list, with a little slack.
+  MallocMessageBuilder builder(offsets.size() + 4);
+  auto list = builder.getRoot<AnyPointer>().initAs<List<uint64_t>>(offsets.size());
+  for (auto i: kj::indices(offsets)) {
+    list.set(i, offsets[i]);
+  }
+
+  file.truncate(0);
+  file.writeAll(messageToFlatArray(builder).asBytes());
+}
+
+void MappedMessageLog::forEach(
+    uint threadCount, kj::Function<void(size_t index, MessageReader& message)> func) const {
+  KJ_REQUIRE(threadCount > 0, "forEach() needs at least one thread.");
+
+  size_t count = size();
+  auto readRange = [this, &func](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; i++) {
+      FlatArrayMessageReader reader(getWords(i), options);
+      func(i, reader);
+    }
+  };
+
+  kj::Vector<kj::Own<kj::Thread>> threads(threadCount - 1);
+  kj::Maybe<kj::Exception> exception = kj::runCatchingExceptions([&]() {
+    for (uint t = 1; t < threadCount; t++) {
+      size_t begin = count * t / threadCount;
+      size_t end = count * (t + 1) / threadCount;
+      threads.add(kj::heap<kj::Thread>([&readRange, begin, end]() { readRange(begin, end); }));
+    }
+
+    // The calling thread takes the first range itself.
+    readRange(0, count / threadCount);
+  });
+
+  // Join every thread before letting anything escape: the threads still use `readRange`, and a
+  // kj::Thread's destructor rethrows the thread's exception, which would terminate the process if
+  // it happened while unwinding. The first exception wins.
+  for (auto& thread: threads) {
+    KJ_IF_SOME(e, kj::runCatchingExceptions([&]() { thread = nullptr; })) {
+      if (exception == kj::none) {
+        exception = kj::mv(e);
+      }
+    }
+  }
+
+  KJ_IF_SOME(e, exception) {
+    kj::throwFatalException(kj::mv(e));
+  }
+}
+
+bool MappedMessageLog::tryLoadIndex(const kj::ReadableFile& index) {
+  auto indexMapping = mapWholeFile(index);
+  auto indexWords = asWords(indexMapping);
+  if (indexWords.size() == 0) return false;
+
+  // The index is proportional in size to the log, so don't let the traversal limit reject it.
+  ReaderOptions indexOptions;
+  indexOptions.traversalLimitInWords = kj::maxValue;
+  FlatArrayMessageReader reader(indexWords, indexOptions);
+  auto saved = reader.getRoot<AnyPointer>().getAs<List<uint64_t>>();
+
+  if (saved.size() == 0 || saved[0] != 0) return false;
+
+  offsets.reserve(saved.size());
+  offsets.add(0);
+  for (uint i = 1; i < saved.size(); i++) {
+    uint64_t offset = saved[i];
+    if (offset <= offsets.back()) return false;
+    offsets.add(offset);
+  }
+
+  // If the log was truncated or replaced, it is unlikely to still have a message ending exactly
+  // where the index says the last one does.
+  uint64_t end = offsets.back();
+  if (end > words.size()) return false;
+  if (size() > 0) {
+    uint64_t last = offsets[offsets.size() - 2];
+    if (expectedSizeInWordsFromPrefix(words.slice(last, end)) != end - last) return false;
+  }
+
+  return true;
+}
+
+void MappedMessageLog::scan() {
+  uint64_t pos = offsets.back();
+  while (pos < words.size()) {
+    auto rest = words.slice(pos, words.size());
+
+    // Same sanity check FlatArrayMessageReader applies, so that garbage in the middle of the log is
+    // reported where it is rather than silently ending the log early.
+    auto table = reinterpret_cast<const _::WireValue<uint32_t>*>(rest.begin());
+    KJ_REQUIRE(table[0].get() < 511, "Message log is corrupt: message has too many segments.",
+               pos * sizeof(word)) {
+      break;
+    }
+
+    size_t size = expectedSizeInWordsFromPrefix(rest);
+    if (size > rest.size()) break;  // Partial message at the end of the log.
+
+    pos += size;
+    offsets.add(pos);
+  }
+}
+
+}  // namespace capnp
@@ -0,0 +1,106 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Random access to append-only logs of messages in the standard serialization format.
+
+#pragma once
+
+#include "serialize.h"
+#include <kj/filesystem.h>
+#include <kj/function.h>
+#include <kj/vector.h>
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+
+class MappedMessageLog {
+  // Provides random access to a file containing a sequence of messages in the standard
+  // serialization format, i.e. what you get by calling writeMessage() repeatedly on one file.
+  // The file is mmap()ed, and an index of message offsets lets get() return any message in
+  // constant time without copying it.
+  //
+  // Building the index means reading the segment table of every message (but not the contents).
+  // For large logs, save the index to a sidecar file with writeIndex() and pass it back to the
+  // constructor later. A saved index stays useful as the log grows: only messages appended after
+  // it was written are scanned.
+  //
+  // A partial message at the end of the file, e.g. one that is still being appended, is ignored.
+  // Messages are not validated until read, just like with FlatArrayMessageReader.
+  //
+  // The log is a snapshot of the file as it was when the MappedMessageLog was constructed. A
+  // MappedMessageLog is safe to read from multiple threads at once.
+
+public:
+  explicit MappedMessageLog(const kj::ReadableFile& file, ReaderOptions options = ReaderOptions());
+  // Map `file` and build the index by scanning it.
+
+  MappedMessageLog(const kj::ReadableFile& file, const kj::ReadableFile& index,
+                   ReaderOptions options = ReaderOptions());
+  // Map `file`, loading the index from `index` (as written by writeIndex()) and then scanning any
+  // messages appended since. If the index is obviously inconsistent with the log, e.g. because the
+  // log has since been truncated or replaced, it is discarded and the whole log is rescanned.
+  // Subtler inconsistencies aren't detected; the index is trusted otherwise, though reading a
+  // message through a bad index at worst throws an exception. An index file that isn't a valid
+  // message at all throws.
+
+  KJ_DISALLOW_COPY_AND_MOVE(MappedMessageLog);
+
+  inline size_t size() const { return offsets.size() - 1; }
+  // Number of complete messages in the log.
+
+  kj::ArrayPtr<const word> getWords(size_t index) const;
+  // Get the raw bytes of the message, including its segment table, e.g. to construct a
+  // FlatArrayMessageReader in place. The words remain valid as long as the MappedMessageLog.
+
+  kj::Own<MessageReader> get(size_t index) const;
+  // Get a reader for the message at the given index. The reader points directly into the mapped
+  // file and must not outlive the MappedMessageLog.
+
+  uint64_t getByteOffset(size_t index) const;
+  // Where the message at the given index starts in the file. `getByteOffset(size())` returns the
+  // end of the last complete message.
+
+  void writeIndex(const kj::File& file) const;
+  // Save the index to `file`, replacing its contents. The index is itself a Cap'n Proto message.
+
+  void forEach(uint threadCount,
+               kj::Function<void(size_t index, MessageReader& message)> func) const;
+  // Call `func` on every message, splitting the log into `threadCount` contiguous ranges that
+  // are read in parallel, one thread per range. `func` is called concurrently from several
+  // threads and must be thread-safe. Returns once all threads are done; if `func` throws, the
+  // exception is rethrown here.
+
+private:
+  ReaderOptions options;
+  kj::Array<const byte> mapping;
+  kj::ArrayPtr<const word> words;
+
+  kj::Vector<uint64_t> offsets;
+  // Word offsets of each message, plus the end of the last one.
+
+  bool tryLoadIndex(const kj::ReadableFile& index);
+  void scan();
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
@@ -220,6 +220,63 @@ TEST(Packed, SimplePacking) {
       {0xed,8,100,6,1,1,2, 0,2, 0xd4,1,2,3,1});
 }
 
+TEST(Packed, KernelsAgree) {
+  // Every kernel must produce byte-identical packed output and unpack it back to the original,
+  // regardless of how the input happens to be split across buffer boundaries.
+
+  constexpr PackedCodecKernel ALL_KERNELS[] = {
+    PackedCodecKernel::SCALAR,
+    PackedCodecKernel::SSE4_2
+  };
+
+  uint32_t seed = 0x12345678;
+  auto nextRandom = [&]() {
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed;
+  };
+
+  for (uint iteration = 0; iteration < 200; iteration++) {
+    // Vary the fraction of zero bytes so that we hit zero runs, literal runs, and mixed words.
+    uint density = iteration % 11;
+    auto words = kj::heapArray<word>(nextRandom() % 600);
+    auto bytes = words.asBytes();
+    for (auto& b: bytes) {
+      b = nextRandom() % 10 < density ? nextRandom() % 255 + 1 : 0;
+    }
+
+    TestPipe reference;
+    {
+      kj::BufferedOutputStreamWrapper bufferedOut(reference);
+      PackedOutputStream packedOut(bufferedOut, PackedCodecKernel::SCALAR);
+      packedOut.write(bytes);
+    }
+    EXPECT_EQ(words.size(), computeUnpackedSizeInWords(reference.getArray()));
+
+    for (auto kernel: ALL_KERNELS) {
+      if (!isPackedCodecKernelSupported(kernel)) continue;
+
+      TestPipe pipe;
+      {
+        kj::BufferedOutputStreamWrapper bufferedOut(pipe);
+        PackedOutputStream packedOut(bufferedOut, kernel);
+        packedOut.write(bytes);
+      }
+      KJ_ASSERT(pipe.getData() == reference.getData(), (uint)kernel, iteration);
+
+      auto roundTrip = kj::heapArray<byte>(bytes.size());
+      for (size_t blockSize: {size_t(1), size_t(7), size_t(64), size_t(kj::maxValue)}) {
+        pipe.resetRead(blockSize);
+        PackedInputStream packedIn(pipe, kernel);
+        packedIn.InputStream::read(roundTrip);
+        EXPECT_TRUE(pipe.allRead());
+        KJ_ASSERT(roundTrip == bytes, (uint)kernel, iteration, blockSize);
+      }
+    }
+  }
+}
+
 // =======================================================================================
 
 class TestMessageBuilder: public MallocMessageBuilder {
@@ -261,6 +318,7 @@ TEST(Packed, RoundTrip) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -274,6 +332,7 @@ TEST(Packed, RoundTripScratchSpace) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   word scratch[1024];
   PackedMessageReader reader(pipe, ReaderOptions(), kj::ArrayPtr<word>(scratch, 1024));
@@ -288,6 +347,7 @@ TEST(Packed, RoundTripLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -301,6 +361,7 @@ TEST(Packed, RoundTripOddSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -314,6 +375,7 @@ TEST(Packed, RoundTripOddSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -327,6 +389,7 @@ TEST(Packed, RoundTripEvenSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -340,6 +403,7 @@ TEST(Packed, RoundTripEvenSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessage(reader.getRoot<TestAllTypes>());
@@ -380,6 +444,7 @@ TEST(Packed, RoundTripAllZero) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -398,6 +463,7 @@ TEST(Packed, RoundTripAllZeroScratchSpace) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   word scratch[1024];
   PackedMessageReader reader(pipe, ReaderOptions(), kj::ArrayPtr<word>(scratch, 1024));
@@ -412,6 +478,7 @@ TEST(Packed, RoundTripAllZeroLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -425,6 +492,7 @@ TEST(Packed, RoundTripAllZeroOddSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -438,6 +506,7 @@ TEST(Packed, RoundTripAllZeroOddSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -451,6 +520,7 @@ TEST(Packed, RoundTripAllZeroEvenSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -464,6 +534,7 @@ TEST(Packed, RoundTripAllZeroEvenSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   checkTestMessageAllZero(reader.getRoot<TestAllTypes>());
@@ -482,6 +553,7 @@ TEST(Packed, RoundTripHugeString) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
@@ -498,6 +570,7 @@ TEST(Packed, RoundTripHugeStringScratchSpace) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   word scratch[1024];
   PackedMessageReader reader(pipe, ReaderOptions(), kj::ArrayPtr<word>(scratch, 1024));
@@ -515,6 +588,7 @@ TEST(Packed, RoundTripHugeStringLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
@@ -531,6 +605,7 @@ TEST(Packed, RoundTripHugeStringOddSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
@@ -547,6 +622,7 @@ TEST(Packed, RoundTripHugeStringOddSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
@@ -563,6 +639,7 @@ TEST(Packed, RoundTripHugeStringEvenSegmentCount) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
@@ -579,11 +656,96 @@ TEST(Packed, RoundTripHugeStringEvenSegmentCountLazy) {
   writePackedMessage(pipe, builder);
 
   EXPECT_EQ(computeSerializedSizeInWords(builder), computeUnpackedSizeInWords(pipe.getArray()));
+  EXPECT_EQ(pipe.getData().size(), computePackedSizeInBytes(builder));
 
   PackedMessageReader reader(pipe);
   EXPECT_TRUE(reader.getRoot<TestAllTypes>().getTextField() == huge);
 }
 
+TEST(Packed, FlatArray) {
+  for (uint segmentCount: {1u, 2u, 7u}) {
+    TestMessageBuilder builder(segmentCount);
+    initTestMessage(builder.initRoot<TestAllTypes>());
+
+    TestPipe pipe;
+    writePackedMessage(pipe, builder);
+
+    PackedFlatArrayMessageReader reader(pipe.getArray());
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+    EXPECT_EQ(computeSerializedSizeInWords(builder), reader.getUnpackedSizeInWords());
+    EXPECT_FALSE(reader.isUsingScratchSpace());
+    EXPECT_TRUE(reader.getPackedEnd() == pipe.getArray().end());
+  }
+}
+
+TEST(Packed, FlatArrayScratchSpaceReuse) {
+  TestMessageBuilder builder(7);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+
+  TestPipe pipe;
+  writePackedMessage(pipe, builder);
+
+  auto scratch = kj::heapArray<word>(4096);
+  for (uint i = 0; i < 3; i++) {
+    PackedFlatArrayMessageReader reader(pipe.getArray(), ReaderOptions(), scratch);
+    checkTestMessage(reader.getRoot<TestAllTypes>());
+    EXPECT_TRUE(reader.isUsingScratchSpace());
+    EXPECT_EQ(computeSerializedSizeInWords(builder), reader.getUnpackedSizeInWords());
+  }
+
+  // A scratch buffer that's too small still works, and tells us how big it should have been.
+  auto tooSmall = kj::heapArray<word>(4);
+  PackedFlatArrayMessageReader reader(pipe.getArray(), ReaderOptions(), tooSmall);
+  checkTestMessage(reader.getRoot<TestAllTypes>());
+  EXPECT_FALSE(reader.isUsingScratchSpace());
+  EXPECT_EQ(computeSerializedSizeInWords(builder), reader.getUnpackedSizeInWords());
+}
+
+TEST(Packed, FlatArrayConcatenated) {
+  TestMessageBuilder builder1(1);
+  initTestMessage(builder1.initRoot<TestAllTypes>());
+  TestMessageBuilder builder2(3);
+  builder2.initRoot<TestAllTypes>().setTextField("second");
+
+  TestPipe pipe;
+  writePackedMessage(pipe, builder1);
+  writePackedMessage(pipe, builder2);
+
+  auto packed = pipe.getArray();
+  PackedFlatArrayMessageReader reader1(packed);
+  checkTestMessage(reader1.getRoot<TestAllTypes>());
+
+  PackedFlatArrayMessageReader reader2(kj::arrayPtr(reader1.getPackedEnd(), packed.end()));
+  EXPECT_EQ("second", reader2.getRoot<TestAllTypes>().getTextField());
+  EXPECT_TRUE(reader2.getPackedEnd() == packed.end());
+}
+
+TEST(Packed, FlatArrayTruncated) {
+  TestMessageBuilder builder(2);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+
+  TestPipe pipe;
+  writePackedMessage(pipe, builder);
+
+  auto packed = pipe.getArray();
+  for (size_t size: {size_t(0), size_t(1), packed.size() / 2, packed.size() - 1}) {
+    EXPECT_ANY_THROW(PackedFlatArrayMessageReader(packed.first(size)));
+  }
+}
+
+TEST(Packed, FlatArrayTooLarge) {
+  // A single zero run can claim a huge segment; we must reject it before allocating.
+  MallocMessageBuilder builder;
+  builder.initRoot<TestAllTypes>().initDataField(1 << 20);
+
+  TestPipe pipe;
+  writePackedMessage(pipe, builder);
+
+  ReaderOptions options;
+  options.traversalLimitInWords = 1024;
+  EXPECT_ANY_THROW(PackedFlatArrayMessageReader(pipe.getArray(), options));
+}
+
 // TODO(test):  Test error cases.
 
 }  // namespace
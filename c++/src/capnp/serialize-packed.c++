@@ -24,14 +24,167 @@
 #include "layout.h"
 #include <vector>
 
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__) && !defined(CAPNP_NO_SIMD)
+#define CAPNP_PACKED_SIMD 1
+#include <immintrin.h>
+#else
+#define CAPNP_PACKED_SIMD 0
+#endif
+
 namespace capnp {
 
 namespace _ {  // private
 
-PackedInputStream::PackedInputStream(kj::BufferedInputStream& inner): inner(inner) {}
-PackedInputStream::~PackedInputStream() noexcept(false) {}
+namespace {
 
-size_t PackedInputStream::tryRead(kj::ArrayPtr<byte> dstArray, size_t minBytes) {
+// =======================================================================================
+// Kernels
+//
+// A kernel knows how to pack or unpack a single word given enough slack in the input and output
+// buffers. The stream loops below are templates over the kernel so that each one gets its own
+// fully-specialized copy of the loop.
+
+struct ScalarPackedKernel {
+  static inline uint unpackWord(uint8_t tag, const uint8_t* __restrict__ in,
+                                uint8_t* __restrict__ out) {
+    // Expands the nonzero bytes at `in` into the word at `out` according to `tag`. `in` must have
+    // at least 8 readable bytes. Returns the number of input bytes consumed.
+
+    const uint8_t* start = in;
+
+#define HANDLE_BYTE(n) \
+    { \
+       bool isNonzero = (tag & (1u << n)) != 0; \
+       *out++ = *in & (-(int8_t)isNonzero); \
+       in += isNonzero; \
+    }
+
+    HANDLE_BYTE(0);
+    HANDLE_BYTE(1);
+    HANDLE_BYTE(2);
+    HANDLE_BYTE(3);
+    HANDLE_BYTE(4);
+    HANDLE_BYTE(5);
+    HANDLE_BYTE(6);
+    HANDLE_BYTE(7);
+#undef HANDLE_BYTE
+
+    return in - start;
+  }
+
+  static inline uint8_t packWord(const uint8_t* __restrict__ in, uint8_t* __restrict__ out) {
+    // Writes the nonzero bytes of the word at `in` to `out` and returns the tag. `out` must have
+    // room for 8 bytes, though only popCount(tag) of them are meaningful.
+
+#define HANDLE_BYTE(n) \
+    uint8_t bit##n = *in != 0; \
+    *out = *in; \
+    out += bit##n; /* out only advances if the byte was non-zero */ \
+    ++in
+
+    HANDLE_BYTE(0);
+    HANDLE_BYTE(1);
+    HANDLE_BYTE(2);
+    HANDLE_BYTE(3);
+    HANDLE_BYTE(4);
+    HANDLE_BYTE(5);
+    HANDLE_BYTE(6);
+    HANDLE_BYTE(7);
+#undef HANDLE_BYTE
+
+    return (bit0 << 0) | (bit1 << 1) | (bit2 << 2) | (bit3 << 3)
+         | (bit4 << 4) | (bit5 << 5) | (bit6 << 6) | (bit7 << 7);
+  }
+
+  static inline uint countZeroBytes(const uint8_t* in) {
+    uint c = in[0] == 0;
+    c += in[1] == 0;
+    c += in[2] == 0;
+    c += in[3] == 0;
+    c += in[4] == 0;
+    c += in[5] == 0;
+    c += in[6] == 0;
+    c += in[7] == 0;
+    return c;
+  }
+};
+
+#if CAPNP_PACKED_SIMD
+
+struct PackedShuffleTables {
+  // For each tag value, the PSHUFB control masks which expand the packed bytes into a word
+  // (`unpack`) and compress a word's nonzero bytes into packed form (`pack`). An index with the
+  // high bit set tells PSHUFB to produce zero.
+
+  alignas(16) uint8_t unpack[256][16];
+  alignas(16) uint8_t pack[256][16];
+};
+
+constexpr PackedShuffleTables makePackedShuffleTables() {
+  PackedShuffleTables result {};
+  for (uint tag = 0; tag < 256; tag++) {
+    uint8_t count = 0;
+    for (uint i = 0; i < 16; i++) {
+      result.unpack[tag][i] = 0x80;
+      result.pack[tag][i] = 0x80;
+    }
+    for (uint i = 0; i < 8; i++) {
+      if (tag & (1u << i)) {
+        result.unpack[tag][i] = count;
+        result.pack[tag][count] = i;
+        ++count;
+      }
+    }
+  }
+  return result;
+}
+
+constexpr PackedShuffleTables PACKED_SHUFFLE_TABLES = makePackedShuffleTables();
+
+#define CAPNP_PACKED_SSE4_2 __attribute__((target("sse4.2,popcnt")))
+
+struct Sse42PackedKernel {
+  // Same contract as ScalarPackedKernel. Each method is one load, one shuffle, and one store.
+
+  CAPNP_PACKED_SSE4_2
+  static inline uint unpackWord(uint8_t tag, const uint8_t* __restrict__ in,
+                                uint8_t* __restrict__ out) {
+    __m128i packed = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+    __m128i mask = _mm_load_si128(
+        reinterpret_cast<const __m128i*>(PACKED_SHUFFLE_TABLES.unpack[tag]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(packed, mask));
+    return _mm_popcnt_u32(tag);
+  }
+
+  CAPNP_PACKED_SSE4_2
+  static inline uint8_t packWord(const uint8_t* __restrict__ in, uint8_t* __restrict__ out) {
+    __m128i unpacked = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+
+    // The upper half of the register is zero, so only the low 8 bits of the movemask matter.
+    uint8_t tag = ~_mm_movemask_epi8(_mm_cmpeq_epi8(unpacked, _mm_setzero_si128()));
+
+    __m128i mask = _mm_load_si128(
+        reinterpret_cast<const __m128i*>(PACKED_SHUFFLE_TABLES.pack[tag]));
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(out), _mm_shuffle_epi8(unpacked, mask));
+    return tag;
+  }
+
+  CAPNP_PACKED_SSE4_2
+  static inline uint countZeroBytes(const uint8_t* in) {
+    __m128i unpacked = _mm_loadl_epi64(reinterpret_cast<const __m128i*>(in));
+    uint zeros = _mm_movemask_epi8(_mm_cmpeq_epi8(unpacked, _mm_setzero_si128())) & 0xffu;
+    return _mm_popcnt_u32(zeros);
+  }
+};
+
+#endif  // CAPNP_PACKED_SIMD
+
+// =======================================================================================
+// Stream loops
+
+template <typename Kernel>
+size_t packedTryRead(kj::BufferedInputStream& inner, kj::ArrayPtr<byte> dstArray,
+                     size_t minBytes) {
   auto maxBytes = dstArray.size();
   uint8_t* const dst = dstArray.begin();
   if (maxBytes == 0) {
@@ -100,24 +253,10 @@ size_t PackedInputStream::tryRead(kj::ArrayPtr<byte> dstArray, size_t minBytes)
         REFRESH_BUFFER();
       }
     } else {
+      // At least 9 bytes follow the tag, so the kernel is free to load a whole word.
       tag = *in++;
-
-#define HANDLE_BYTE(n) \
-      { \
-         bool isNonzero = (tag & (1u << n)) != 0; \
-         *out++ = *in & (-(int8_t)isNonzero); \
-         in += isNonzero; \
-      }
-
-      HANDLE_BYTE(0);
-      HANDLE_BYTE(1);
-      HANDLE_BYTE(2);
-      HANDLE_BYTE(3);
-      HANDLE_BYTE(4);
-      HANDLE_BYTE(5);
-      HANDLE_BYTE(6);
-      HANDLE_BYTE(7);
-#undef HANDLE_BYTE
+      in += Kernel::unpackWord(tag, in, out);
+      out += sizeof(word);
     }
 
     if (tag == 0) {
@@ -182,6 +321,217 @@ size_t PackedInputStream::tryRead(kj::ArrayPtr<byte> dstArray, size_t minBytes)
 #undef REFRESH_BUFFER
 }
 
+template <typename Kernel>
+void packedWrite(kj::BufferedOutputStream& inner, kj::ArrayPtr<const byte> src) {
+  kj::ArrayPtr<byte> buffer = inner.getWriteBuffer();
+  byte slowBuffer[20]{};
+
+  uint8_t* __restrict__ out = reinterpret_cast<uint8_t*>(buffer.begin());
+
+  const uint8_t* __restrict__ in = src.begin();
+  const uint8_t* const inEnd = src.end();
+
+  while (in < inEnd) {
+    if (reinterpret_cast<uint8_t*>(buffer.end()) - out < 10) {
+      // Oops, we're out of space.  We need at least 10 bytes for the fast path, since we don't
+      // bounds-check on every byte.
+
+      // Write what we have so far.
+      inner.write(buffer.first(out - reinterpret_cast<uint8_t*>(buffer.begin())));
+
+      // Use a slow buffer into which we'll encode 10 to 20 bytes.  This should get us past the
+      // output stream's buffer boundary.
+      buffer = kj::arrayPtr(slowBuffer, sizeof(slowBuffer));
+      out = reinterpret_cast<uint8_t*>(buffer.begin());
+    }
+
+    uint8_t* tagPos = out++;
+    uint8_t tag = Kernel::packWord(in, out);
+    *tagPos = tag;
+    out += kj::popCount(tag);
+    in += sizeof(word);
+
+    if (tag == 0) {
+      // An all-zero word is followed by a count of consecutive zero words (not including the
+      // first one).
+
+      // We can check a whole word at a time. (Here is where we use the assumption that
+      // `src` is word-aligned.)
+      const uint64_t* inWord = reinterpret_cast<const uint64_t*>(in);
+
+      // The count must fit it 1 byte, so limit to 255 words.
+      const uint64_t* limit = reinterpret_cast<const uint64_t*>(inEnd);
+      if (limit - inWord > 255) {
+        limit = inWord + 255;
+      }
+
+      while (inWord < limit && *inWord == 0) {
+        ++inWord;
+      }
+
+      // Write the count.
+      *out++ = inWord - reinterpret_cast<const uint64_t*>(in);
+
+      // Advance input.
+      in = reinterpret_cast<const uint8_t*>(inWord);
+
+    } else if (tag == 0xffu) {
+      // An all-nonzero word is followed by a count of consecutive uncompressed words, followed
+      // by the uncompressed words themselves.
+
+      // Count the number of consecutive words in the input which have no more than a single
+      // zero-byte.  We look for at least two zeros because that's the point where our compression
+      // scheme becomes a net win.
+      // TODO(perf):  Maybe look for three zeros?  Compressing a two-zero word is a loss if the
+      //   following word has no zeros.
+      const uint8_t* runStart = in;
+
+      const uint8_t* limit = inEnd;
+      if ((size_t)(limit - in) > 255 * sizeof(word)) {
+        limit = in + 255 * sizeof(word);
+      }
+
+      while (in < limit && Kernel::countZeroBytes(in) < 2) {
+        in += sizeof(word);
+      }
+
+      // Write the count.
+      uint count = in - runStart;
+      *out++ = count / sizeof(word);
+
+      if (count <= reinterpret_cast<uint8_t*>(buffer.end()) - out) {
+        // There's enough space to memcpy.
+        memcpy(out, runStart, count);
+        out += count;
+      } else {
+        // Input overruns the output buffer.  We'll give it to the output stream in one chunk
+        // and let it decide what to do.
+        inner.write(buffer.first(reinterpret_cast<byte*>(out) - buffer.begin()));
+        inner.write(kj::arrayPtr(runStart, in - runStart));
+        buffer = inner.getWriteBuffer();
+        out = reinterpret_cast<uint8_t*>(buffer.begin());
+      }
+    }
+  }
+
+  // Write whatever is left.
+  inner.write(buffer.first(reinterpret_cast<byte*>(out) - buffer.begin()));
+}
+
+template <typename Kernel>
+size_t packedUnpackArray(kj::ArrayPtr<const byte> input, kj::ArrayPtr<word> output) {
+  // Unpacks exactly `output.size()` words from the start of `input` and returns the number of
+  // input bytes consumed. Unlike packedTryRead(), the whole input is already in memory, so the
+  // only bounds checks needed are against the two array ends.
+
+  const uint8_t* __restrict__ in = input.begin();
+  const uint8_t* const inEnd = input.end();
+  uint8_t* __restrict__ out = output.asBytes().begin();
+  uint8_t* const outEnd = output.asBytes().end();
+
+  while (out < outEnd) {
+    KJ_REQUIRE(in < inEnd, "Premature end of packed input.");
+    uint8_t tag = *in++;
+
+    if (inEnd - in >= sizeof(word)) {
+      in += Kernel::unpackWord(tag, in, out);
+      out += sizeof(word);
+    } else {
+      // Near the end of the input, so the kernel might read past it.
+      for (uint i = 0; i < 8; i++) {
+        if (tag & (1u << i)) {
+          KJ_REQUIRE(in < inEnd, "Premature end of packed input.");
+          *out++ = *in++;
+        } else {
+          *out++ = 0;
+        }
+      }
+    }
+
+    if (tag == 0 || tag == 0xffu) {
+      KJ_REQUIRE(in < inEnd, "Premature end of packed input.");
+      size_t runLength = *in++ * sizeof(word);
+
+      KJ_REQUIRE(runLength <= outEnd - out,
+                 "Packed input did not end cleanly on a segment boundary.");
+
+      if (tag == 0) {
+        memset(out, 0, runLength);
+      } else {
+        KJ_REQUIRE(runLength <= inEnd - in, "Premature end of packed input.");
+        memcpy(out, in, runLength);
+        in += runLength;
+      }
+      out += runLength;
+    }
+  }
+
+  return in - input.begin();
+}
+
+#if CAPNP_PACKED_SIMD
+
+// These entry points are compiled with SSE4.2 enabled. `flatten` pulls the loop template and the
+// kernel into a single function so that the compiler never has to inline code built for a wider
+// target into code built for the baseline one.
+
+CAPNP_PACKED_SSE4_2 __attribute__((flatten))
+size_t packedTryReadSse42(kj::BufferedInputStream& inner, kj::ArrayPtr<byte> dstArray,
+                          size_t minBytes) {
+  return packedTryRead<Sse42PackedKernel>(inner, dstArray, minBytes);
+}
+
+CAPNP_PACKED_SSE4_2 __attribute__((flatten))
+void packedWriteSse42(kj::BufferedOutputStream& inner, kj::ArrayPtr<const byte> src) {
+  packedWrite<Sse42PackedKernel>(inner, src);
+}
+
+CAPNP_PACKED_SSE4_2 __attribute__((flatten))
+size_t packedUnpackArraySse42(kj::ArrayPtr<const byte> input, kj::ArrayPtr<word> output) {
+  return packedUnpackArray<Sse42PackedKernel>(input, output);
+}
+
+#endif  // CAPNP_PACKED_SIMD
+
+}  // namespace
+
+PackedCodecKernel bestPackedCodecKernel() {
+  static const PackedCodecKernel result = isPackedCodecKernelSupported(PackedCodecKernel::SSE4_2)
+      ? PackedCodecKernel::SSE4_2 : PackedCodecKernel::SCALAR;
+  return result;
+}
+
+bool isPackedCodecKernelSupported(PackedCodecKernel kernel) {
+  switch (kernel) {
+    case PackedCodecKernel::SCALAR:
+      return true;
+    case PackedCodecKernel::SSE4_2:
+#if CAPNP_PACKED_SIMD
+      __builtin_cpu_init();
+      return __builtin_cpu_supports("sse4.2") && __builtin_cpu_supports("popcnt");
+#else
+      return false;
+#endif
+  }
+  return false;
+}
+
+PackedInputStream::PackedInputStream(kj::BufferedInputStream& inner, PackedCodecKernel kernel)
+    : inner(inner), kernel(kernel) {
+  KJ_REQUIRE(isPackedCodecKernelSupported(kernel), "packed codec kernel not supported on this CPU",
+             (uint)kernel);
+}
+PackedInputStream::~PackedInputStream() noexcept(false) {}
+
+size_t PackedInputStream::tryRead(kj::ArrayPtr<byte> dstArray, size_t minBytes) {
+#if CAPNP_PACKED_SIMD
+  if (kernel == PackedCodecKernel::SSE4_2) {
+    return packedTryReadSse42(inner, dstArray, minBytes);
+  }
+#endif
+  return packedTryRead<ScalarPackedKernel>(inner, dstArray, minBytes);
+}
+
 void PackedInputStream::skip(size_t bytes) {
   // We can't just read into buffers because buffers must end on block boundaries.
 
@@ -300,134 +650,82 @@ void PackedInputStream::skip(size_t bytes) {
 
 // -------------------------------------------------------------------
 
-PackedOutputStream::PackedOutputStream(kj::BufferedOutputStream& inner)
-    : inner(inner) {}
+PackedOutputStream::PackedOutputStream(kj::BufferedOutputStream& inner, PackedCodecKernel kernel)
+    : inner(inner), kernel(kernel) {
+  KJ_REQUIRE(isPackedCodecKernelSupported(kernel), "packed codec kernel not supported on this CPU",
+             (uint)kernel);
+}
 PackedOutputStream::~PackedOutputStream() noexcept(false) {}
 
 void PackedOutputStream::write(kj::ArrayPtr<const byte> src) {
-  kj::ArrayPtr<byte> buffer = inner.getWriteBuffer();
-  byte slowBuffer[20]{};
-
-  uint8_t* __restrict__ out = reinterpret_cast<uint8_t*>(buffer.begin());
-
-  const uint8_t* __restrict__ in = src.begin();
-  const uint8_t* const inEnd = src.end();
-
-  while (in < inEnd) {
-    if (reinterpret_cast<uint8_t*>(buffer.end()) - out < 10) {
-      // Oops, we're out of space.  We need at least 10 bytes for the fast path, since we don't
-      // bounds-check on every byte.
-
-      // Write what we have so far.
-      inner.write(buffer.first(out - reinterpret_cast<uint8_t*>(buffer.begin())));
-
-      // Use a slow buffer into which we'll encode 10 to 20 bytes.  This should get us past the
-      // output stream's buffer boundary.
-      buffer = kj::arrayPtr(slowBuffer, sizeof(slowBuffer));
-      out = reinterpret_cast<uint8_t*>(buffer.begin());
-    }
-
-    uint8_t* tagPos = out++;
-
-#define HANDLE_BYTE(n) \
-    uint8_t bit##n = *in != 0; \
-    *out = *in; \
-    out += bit##n; /* out only advances if the byte was non-zero */ \
-    ++in
-
-    HANDLE_BYTE(0);
-    HANDLE_BYTE(1);
-    HANDLE_BYTE(2);
-    HANDLE_BYTE(3);
-    HANDLE_BYTE(4);
-    HANDLE_BYTE(5);
-    HANDLE_BYTE(6);
-    HANDLE_BYTE(7);
-#undef HANDLE_BYTE
-
-    uint8_t tag = (bit0 << 0) | (bit1 << 1) | (bit2 << 2) | (bit3 << 3)
-                | (bit4 << 4) | (bit5 << 5) | (bit6 << 6) | (bit7 << 7);
-    *tagPos = tag;
+#if CAPNP_PACKED_SIMD
+  if (kernel == PackedCodecKernel::SSE4_2) {
+    return packedWriteSse42(inner, src);
+  }
+#endif
+  packedWrite<ScalarPackedKernel>(inner, src);
+}
 
-    if (tag == 0) {
-      // An all-zero word is followed by a count of consecutive zero words (not including the
-      // first one).
+// -------------------------------------------------------------------
 
-      // We can check a whole word at a time. (Here is where we use the assumption that
-      // `src` is word-aligned.)
-      const uint64_t* inWord = reinterpret_cast<const uint64_t*>(in);
+namespace {
 
-      // The count must fit it 1 byte, so limit to 255 words.
-      const uint64_t* limit = reinterpret_cast<const uint64_t*>(inEnd);
-      if (limit - inWord > 255) {
-        limit = inWord + 255;
-      }
+size_t unpackArray(kj::ArrayPtr<const byte> input, kj::ArrayPtr<word> output) {
+#if CAPNP_PACKED_SIMD
+  if (bestPackedCodecKernel() == PackedCodecKernel::SSE4_2) {
+    return packedUnpackArraySse42(input, output);
+  }
+#endif
+  return packedUnpackArray<ScalarPackedKernel>(input, output);
+}
 
-      while (inWord < limit && *inWord == 0) {
-        ++inWord;
-      }
+}  // namespace
 
-      // Write the count.
-      *out++ = inWord - reinterpret_cast<const uint64_t*>(in);
+PackedArrayUnpacker::PackedArrayUnpacker(
+    kj::ArrayPtr<const byte> packed, ReaderOptions options, kj::ArrayPtr<word> scratchSpace) {
+  // The segment table is packed separately from the segments, and its first word can never start
+  // a run (a zero first word means one segment, i.e. a one-word table), so we can unpack the
+  // first word alone to learn how big the rest of the table is.
+  word firstWord;
+  size_t consumed = unpackArray(packed, kj::arrayPtr(&firstWord, 1));
 
-      // Advance input.
-      in = reinterpret_cast<const uint8_t*>(inWord);
+  auto firstTable = reinterpret_cast<const WireValue<uint32_t>*>(&firstWord);
 
-    } else if (tag == 0xffu) {
-      // An all-nonzero word is followed by a count of consecutive uncompressed words, followed
-      // by the uncompressed words themselves.
+  // Reject messages with too many segments for security reasons. See InputStreamMessageReader.
+  KJ_REQUIRE(firstTable[0].get() < 511, "Message has too many segments.");
+  uint segmentCount = firstTable[0].get() + 1;
+  size_t tableWords = segmentCount / 2 + 1;
 
-      // Count the number of consecutive words in the input which have no more than a single
-      // zero-byte.  We look for at least two zeros because that's the point where our compression
-      // scheme becomes a net win.
-      // TODO(perf):  Maybe look for three zeros?  Compressing a two-zero word is a loss if the
-      //   following word has no zeros.
-      const uint8_t* runStart = in;
+  KJ_STACK_ARRAY(word, tableSpace, tableWords, 16, 256);
+  memcpy(tableSpace.begin(), &firstWord, sizeof(word));
+  consumed += unpackArray(packed.slice(consumed, packed.size()), tableSpace.slice(1, tableWords));
 
-      const uint8_t* limit = inEnd;
-      if ((size_t)(limit - in) > 255 * sizeof(word)) {
-        limit = in + 255 * sizeof(word);
-      }
+  auto table = reinterpret_cast<const WireValue<uint32_t>*>(tableSpace.begin());
+  size_t segmentWords = 0;
+  for (uint i = 0; i < segmentCount; i++) {
+    segmentWords += table[i + 1].get();
+  }
 
-      while (in < limit) {
-        // Check eight input bytes for zeros.
-        uint c = *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-        c += *in++ == 0;
-
-        if (c >= 2) {
-          // Un-read the word with multiple zeros, since we'll want to compress that one.
-          in -= 8;
-          break;
-        }
-      }
+  // Don't accept a message which the receiver couldn't possibly traverse without hitting the
+  // traversal limit, lest a tiny packed run of zeros make us allocate a huge buffer.
+  KJ_REQUIRE(segmentWords <= options.traversalLimitInWords,
+             "Message is too large.  To increase the limit on the receiving end, see "
+             "capnp::ReaderOptions.");
 
-      // Write the count.
-      uint count = in - runStart;
-      *out++ = count / sizeof(word);
-
-      if (count <= reinterpret_cast<uint8_t*>(buffer.end()) - out) {
-        // There's enough space to memcpy.
-        memcpy(out, runStart, count);
-        out += count;
-      } else {
-        // Input overruns the output buffer.  We'll give it to the output stream in one chunk
-        // and let it decide what to do.
-        inner.write(buffer.first(reinterpret_cast<byte*>(out) - buffer.begin()));
-        inner.write(kj::arrayPtr(runStart, in - runStart));
-        buffer = inner.getWriteBuffer();
-        out = reinterpret_cast<uint8_t*>(buffer.begin());
-      }
-    }
+  size_t totalWords = tableWords + segmentWords;
+  if (scratchSpace.size() < totalWords) {
+    ownedSpace = kj::heapArray<word>(totalWords);
+    scratchSpace = ownedSpace;
   }
 
-  // Write whatever is left.
-  inner.write(buffer.first(reinterpret_cast<byte*>(out) - buffer.begin()));
+  // The segments were packed as separate pieces, but no run crosses a piece boundary, so they can
+  // all be unpacked in one go directly after the table.
+  scratchSpace.first(tableWords).asBytes().copyFrom(tableSpace.asBytes());
+  consumed += unpackArray(packed.slice(consumed, packed.size()),
+                          scratchSpace.slice(tableWords, totalWords));
+
+  unpacked = scratchSpace.first(totalWords);
+  packedEnd = packed.begin() + consumed;
 }
 
 }  // namespace _ (private)
@@ -457,6 +755,13 @@ PackedFdMessageReader::PackedFdMessageReader(
 
 PackedFdMessageReader::~PackedFdMessageReader() noexcept(false) {}
 
+PackedFlatArrayMessageReader::PackedFlatArrayMessageReader(
+    kj::ArrayPtr<const byte> packed, ReaderOptions options, kj::ArrayPtr<word> scratchSpace)
+    : PackedArrayUnpacker(packed, options, scratchSpace),
+      FlatArrayMessageReader(unpacked, options) {}
+
+PackedFlatArrayMessageReader::~PackedFlatArrayMessageReader() noexcept(false) {}
+
 void writePackedMessage(kj::BufferedOutputStream& output,
                         kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
   _::PackedOutputStream packedOutput(output);
@@ -507,4 +812,65 @@ size_t computeUnpackedSizeInWords(kj::ArrayPtr<const byte> packedBytes) {
   return total;
 }
 
+namespace {
+
+inline uint countZeroBytesInWord(uint64_t value) {
+  // Sets the high bit of each byte of `value` which is zero, and clears every other bit.
+  constexpr uint64_t LOW_SEVEN = 0x7f7f7f7f7f7f7f7full;
+  uint64_t zeros = ~(((value & LOW_SEVEN) + LOW_SEVEN) | value | LOW_SEVEN);
+  return kj::popCount(static_cast<uint>(zeros >> 32)) + kj::popCount(static_cast<uint>(zeros));
+}
+
+size_t computePackedPieceSize(kj::ArrayPtr<const byte> unpacked) {
+  // Mirrors the run-length decisions made by packedWrite(), one word at a time.
+
+  KJ_DREQUIRE(unpacked.size() % sizeof(word) == 0, "packed input must be word-aligned");
+
+  const uint64_t* in = reinterpret_cast<const uint64_t*>(unpacked.begin());
+  const uint64_t* const end = in + unpacked.size() / sizeof(word);
+
+  size_t total = 0;
+  while (in < end) {
+    uint zeros = countZeroBytesInWord(*in++);
+    total += 1 + (8 - zeros);
+
+    if (zeros == 8) {
+      const uint64_t* limit = end - in > 255 ? in + 255 : end;
+      while (in < limit && *in == 0) ++in;
+      total += 1;
+    } else if (zeros == 0) {
+      const uint64_t* limit = end - in > 255 ? in + 255 : end;
+      const uint64_t* runStart = in;
+      while (in < limit && countZeroBytesInWord(*in) < 2) ++in;
+      total += 1 + (in - runStart) * sizeof(word);
+    }
+  }
+
+  return total;
+}
+
+}  // namespace
+
+size_t computePackedSizeInBytes(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  // writeMessage() hands the segment table and then each segment to the packer as separate
+  // pieces, and runs never span pieces, so we have to size each piece separately too.
+
+  KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
+
+  KJ_STACK_ARRAY(_::WireValue<uint32_t>, table, (segments.size() + 2) & ~size_t(1), 16, 64);
+  table[0].set(segments.size() - 1);
+  for (uint i = 0; i < segments.size(); i++) {
+    table[i + 1].set(segments[i].size());
+  }
+  if (segments.size() % 2 == 0) {
+    table[segments.size() + 1].set(0);
+  }
+
+  size_t total = computePackedPieceSize(table.asBytes());
+  for (auto& segment: segments) {
+    total += computePackedPieceSize(segment.asBytes());
+  }
+  return total;
+}
+
 }  // namespace capnp
@@ -29,12 +29,34 @@ namespace capnp {
 
 namespace _ {  // private
 
+enum class PackedCodecKernel: uint8_t {
+  // Selects the inner loop used to pack and unpack individual words. All kernels produce
+  // byte-identical output; they differ only in speed and in the CPU features they require.
+
+  SCALAR,
+  // Portable implementation which handles one byte of each word at a time.
+
+  SSE4_2
+  // Expands and compresses each word with a single SSSE3 byte shuffle whose control mask is looked
+  // up by tag byte, and uses POPCNT to advance the input. Requires an x86 CPU with SSE4.2 and
+  // POPCNT, and a GCC-compatible compiler.
+};
+
+PackedCodecKernel bestPackedCodecKernel();
+// Returns the fastest kernel supported by the CPU we're running on. The CPU is only probed on the
+// first call.
+
+bool isPackedCodecKernelSupported(PackedCodecKernel kernel);
+// Returns true if `kernel` can be used on this CPU and was compiled into this build. Mainly useful
+// for tests and benchmarks which want to compare kernels against each other.
+
 class PackedInputStream: public kj::InputStream {
   // An input stream that unpacks packed data with a picky constraint:  The caller must read data
   // in the exact same size and sequence as the data was written to PackedOutputStream.
 
 public:
-  explicit PackedInputStream(kj::BufferedInputStream& inner);
+  explicit PackedInputStream(kj::BufferedInputStream& inner,
+                             PackedCodecKernel kernel = bestPackedCodecKernel());
   KJ_DISALLOW_COPY_AND_MOVE(PackedInputStream);
   ~PackedInputStream() noexcept(false);
 
@@ -44,12 +66,14 @@ public:
 
 private:
   kj::BufferedInputStream& inner;
+  PackedCodecKernel kernel;
 };
 
 class PackedOutputStream: public kj::OutputStream {
   // An output stream that packs data. Buffers passed to `write()` must be word-aligned.
 public:
-  explicit PackedOutputStream(kj::BufferedOutputStream& inner);
+  explicit PackedOutputStream(kj::BufferedOutputStream& inner,
+                              PackedCodecKernel kernel = bestPackedCodecKernel());
   KJ_DISALLOW_COPY_AND_MOVE(PackedOutputStream);
   ~PackedOutputStream() noexcept(false);
 
@@ -58,6 +82,25 @@ public:
 
 private:
   kj::BufferedOutputStream& inner;
+  PackedCodecKernel kernel;
+};
+
+class PackedArrayUnpacker {
+  // Unpacks a whole packed message from a flat byte array. This is a base class of
+  // PackedFlatArrayMessageReader so that the unpacked words exist before FlatArrayMessageReader's
+  // constructor parses them.
+
+protected:
+  PackedArrayUnpacker(kj::ArrayPtr<const byte> packed, ReaderOptions options,
+                      kj::ArrayPtr<word> scratchSpace);
+
+  kj::Array<word> ownedSpace;
+  // Only if scratchSpace wasn't big enough.
+
+  kj::ArrayPtr<const word> unpacked;
+  // The unpacked message, including its segment table.
+
+  const byte* packedEnd;
 };
 
 }  // namespace _ (private)
@@ -88,6 +131,37 @@ public:
   ~PackedFdMessageReader() noexcept(false);
 };
 
+class PackedFlatArrayMessageReader: private _::PackedArrayUnpacker,
+                                    public FlatArrayMessageReader {
+  // Reads a packed message from a flat byte array, such as one received in a datagram or read
+  // whole from a file. Unlike wrapping the array in a kj::ArrayInputStream and using
+  // PackedMessageReader, this unpacks the entire message in one pass straight into
+  // `scratchSpace`, with no intermediate buffering.
+  //
+  // `scratchSpace` is meant to be reused across messages. It must hold the unpacked segment table
+  // as well as the segments; if it is too small, a buffer is allocated instead. Either way,
+  // getUnpackedSizeInWords() reports how many words were needed, so a caller managing a pool of
+  // buffers can grow its next buffer to fit. The scratch space must remain valid, and must not be
+  // reused, until the reader is destroyed.
+
+public:
+  PackedFlatArrayMessageReader(kj::ArrayPtr<const byte> packed,
+                               ReaderOptions options = ReaderOptions(),
+                               kj::ArrayPtr<word> scratchSpace = nullptr);
+  KJ_DISALLOW_COPY_AND_MOVE(PackedFlatArrayMessageReader);
+  ~PackedFlatArrayMessageReader() noexcept(false);
+
+  size_t getUnpackedSizeInWords() const { return unpacked.size(); }
+  // Number of words the message occupies once unpacked, including the segment table.
+
+  bool isUsingScratchSpace() const { return ownedSpace == nullptr; }
+  // False if the scratch space was too small and the reader had to allocate its own buffer.
+
+  const byte* getPackedEnd() const { return packedEnd; }
+  // Get a pointer just past the last packed byte consumed. If several packed messages were
+  // concatenated into one array, this is where the next one begins.
+};
+
 void writePackedMessage(kj::BufferedOutputStream& output, MessageBuilder& builder);
 void writePackedMessage(kj::BufferedOutputStream& output,
                         kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
@@ -108,6 +182,13 @@ size_t computeUnpackedSizeInWords(kj::ArrayPtr<const byte> packedBytes);
 // Computes the number of words to which the given packed bytes will unpack. Not intended for use
 // in performance-sensitive situations.
 
+size_t computePackedSizeInBytes(MessageBuilder& builder);
+size_t computePackedSizeInBytes(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+// Computes the exact number of bytes which writePackedMessage() would write for the given message,
+// including the segment table, without producing any output. This scans each word once and is
+// considerably cheaper than packing into a scratch buffer, so it's suitable for sizing output
+// buffers or framing headers up front.
+
 // =======================================================================================
 // inline stuff
 
@@ -123,6 +204,10 @@ inline void writePackedMessageToFd(int fd, MessageBuilder& builder) {
   writePackedMessageToFd(fd, builder.getSegmentsForOutput());
 }
 
+inline size_t computePackedSizeInBytes(MessageBuilder& builder) {
+  return computePackedSizeInBytes(builder.getSegmentsForOutput());
+}
+
 }  // namespace capnp
 
 CAPNP_END_HEADER
@@ -0,0 +1,195 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if __linux__
+
+#include "serialize-shm.h"
+#include "test-util.h"
+#include <kj/debug.h>
+#include <kj/test.h>
+#include <unistd.h>
+
+namespace capnp {
+namespace _ {  // private
+namespace {
+
+struct StreamPair {
+  kj::Own<SharedMemoryMessageStream> a;
+  kj::Own<SharedMemoryMessageStream> b;
+};
+
+StreamPair connectPair(kj::AsyncIoContext& io, size_t ringBytes, bool shortLived = false) {
+  auto pipe = io.provider->newCapabilityPipe();
+  auto isShortLived = [shortLived](MessageReader&) { return shortLived; };
+  auto promiseA = SharedMemoryMessageStream::connect(
+      *io.lowLevelProvider, kj::mv(pipe.ends[0]), isShortLived, ringBytes);
+  auto promiseB = SharedMemoryMessageStream::connect(
+      *io.lowLevelProvider, kj::mv(pipe.ends[1]), isShortLived, ringBytes);
+  auto a = promiseA.wait(io.waitScope);
+  auto b = promiseB.wait(io.waitScope);
+  return { kj::mv(a), kj::mv(b) };
+}
+
+kj::Promise<void> writeNumbers(MessageStream& stream, uint from, uint to) {
+  if (from == to) return kj::READY_NOW;
+
+  auto builder = kj::heap<MallocMessageBuilder>();
+  auto root = builder->getRoot<TestAllTypes>();
+  root.setUInt32Field(from);
+  root.setTextField(kj::str("message number ", from, ", padded to a few words"));
+  auto promise = stream.writeMessage(*builder);
+  return promise.attach(kj::mv(builder)).then([&stream, from, to]() {
+    return writeNumbers(stream, from + 1, to);
+  });
+}
+
+void expectNumber(MessageStream& stream, uint expected, kj::WaitScope& waitScope) {
+  auto message = stream.readMessage().wait(waitScope);
+  KJ_EXPECT(message->getRoot<TestAllTypes>().getUInt32Field() == expected);
+}
+
+KJ_TEST("SharedMemoryMessageStream round trip") {
+  auto io = kj::setupAsyncIo();
+  auto pair = connectPair(io, SharedMemoryMessageStream::DEFAULT_RING_BYTES);
+
+  KJ_EXPECT(KJ_ASSERT_NONNULL(pair.a->getSendBufferSize()) ==
+            SharedMemoryMessageStream::DEFAULT_RING_BYTES);
+
+  MallocMessageBuilder message(4);  // first segment is small, so there are several
+  initTestMessage(message.getRoot<TestAllTypes>());
+  KJ_ASSERT(message.getSegmentsForOutput().size() > 1);
+
+  // Writes that fit in the ring complete immediately.
+  auto writePromise = pair.a->writeMessage(message);
+  KJ_EXPECT(writePromise.poll(io.waitScope));
+  writePromise.wait(io.waitScope);
+
+  checkTestMessage(pair.b->readMessage().wait(io.waitScope)->getRoot<TestAllTypes>());
+
+  // And the other direction.
+  pair.b->writeMessage(message).wait(io.waitScope);
+  checkTestMessage(pair.a->readMessage().wait(io.waitScope)->getRoot<TestAllTypes>());
+
+  // A read waits until something is written.
+  auto readPromise = pair.b->readMessage();
+  KJ_EXPECT(!readPromise.poll(io.waitScope));
+  pair.a->writeMessage(message).wait(io.waitScope);
+  checkTestMessage(readPromise.wait(io.waitScope)->getRoot<TestAllTypes>());
+}
+
+KJ_TEST("SharedMemoryMessageStream wraps around and waits for space") {
+  auto io = kj::setupAsyncIo();
+
+  for (bool shortLived: { false, true }) {
+    // Use the smallest ring allowed so that the writer fills it many times over.
+    auto pair = connectPair(io, 4096, shortLived);
+
+    constexpr uint COUNT = 500;
+    auto writePromise = writeNumbers(*pair.a, 0, COUNT);
+    KJ_EXPECT(!writePromise.poll(io.waitScope));
+
+    for (auto i: kj::zeroTo(COUNT)) {
+      expectNumber(*pair.b, i, io.waitScope);
+    }
+    writePromise.wait(io.waitScope);
+  }
+}
+
+KJ_TEST("SharedMemoryMessageStream sends large messages and FDs over the socket") {
+  auto io = kj::setupAsyncIo();
+  auto pair = connectPair(io, 4096);
+
+  MallocMessageBuilder big;
+  big.getRoot<TestAllTypes>().initDataField(8192);  // more than half the ring
+
+  int pipeFds[2];
+  KJ_SYSCALL(pipe(pipeFds));
+  kj::OwnFd readEnd(pipeFds[0]);
+  kj::OwnFd writeEnd(pipeFds[1]);
+
+  MallocMessageBuilder withFd;
+  withFd.getRoot<TestAllTypes>().setUInt32Field(123);
+  const int sendFds[1] = { writeEnd };
+
+  auto writePromise = writeNumbers(*pair.a, 0, 1)
+      .then([&]() { return pair.a->writeMessage(big); })
+      .then([&]() { return writeNumbers(*pair.a, 1, 2); })
+      .then([&]() { return pair.a->writeMessage(kj::ArrayPtr<const int>(sendFds), withFd); })
+      .then([&]() { return writeNumbers(*pair.a, 2, 3); });
+
+  // Messages arrive in order, regardless of which path they took.
+  expectNumber(*pair.b, 0, io.waitScope);
+  {
+    auto message = pair.b->readMessage().wait(io.waitScope);
+    KJ_EXPECT(message->getRoot<TestAllTypes>().getDataField().size() == 8192);
+  }
+  expectNumber(*pair.b, 1, io.waitScope);
+  {
+    kj::OwnFd fdSpace[1];
+    auto message = pair.b->readMessage(fdSpace).wait(io.waitScope);
+    KJ_EXPECT(message.reader->getRoot<TestAllTypes>().getUInt32Field() == 123);
+    KJ_ASSERT(message.fds.size() == 1);
+
+    // The received FD refers to the write end of our pipe.
+    KJ_SYSCALL(write(message.fds[0], "x", 1));
+    char c;
+    KJ_SYSCALL(read(readEnd, &c, 1));
+    KJ_EXPECT(c == 'x');
+  }
+  expectNumber(*pair.b, 2, io.waitScope);
+
+  writePromise.wait(io.waitScope);
+}
+
+KJ_TEST("SharedMemoryMessageStream end() and disconnect") {
+  auto io = kj::setupAsyncIo();
+
+  {
+    auto pair = connectPair(io, 4096);
+
+    // Messages written before end() are still delivered.
+    writeNumbers(*pair.a, 0, 3).wait(io.waitScope);
+    auto eofPromise = pair.a->end();
+    eofPromise.wait(io.waitScope);
+
+    for (auto i: kj::zeroTo(3u)) {
+      expectNumber(*pair.b, i, io.waitScope);
+    }
+    KJ_EXPECT(pair.b->MessageStream::tryReadMessage().wait(io.waitScope) == kj::none);
+  }
+
+  {
+    auto pair = connectPair(io, 4096);
+
+    // A reader waiting on a peer that goes away without calling end() gets an error rather than
+    // hanging.
+    auto readPromise = pair.b->readMessage();
+    KJ_EXPECT(!readPromise.poll(io.waitScope));
+    pair.a = nullptr;
+    KJ_EXPECT_THROW(DISCONNECTED, readPromise.wait(io.waitScope));
+  }
+}
+
+}  // namespace
+}  // namespace _ (private)
+}  // namespace capnp
+
+#endif  // __linux__
@@ -0,0 +1,494 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if __linux__
+
+#include "serialize-shm.h"
+#include "serialize.h"
+#include "layout.h"
+#include <kj/debug.h>
+#include <kj/one-of.h>
+#include <errno.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace capnp {
+
+namespace {
+
+constexpr size_t HEADER_BYTES = 4096;
+// Space at the start of each ring's mapping reserved for the RingHeader.
+
+constexpr size_t MIN_RING_WORDS = 512;
+constexpr size_t MAX_RING_WORDS = 1u << 24;
+
+constexpr uint32_t WRAP_MARKER = 0xffffffffu;
+// In place of a segment count: the rest of the ring up to its end is unused, and the next entry
+// starts at the beginning of the ring.
+
+constexpr uint32_t SOCKET_MARKER = 0xfffffffeu;
+// In place of a segment count: the next message was sent over the socket instead.
+
+constexpr uint64_t HELLO_MAGIC = 0x6d68732d70616e63ull;  // "cnap-shm", little-endian
+
+struct Hello {
+  // Sent by each side over the socket during connect(), along with the FDs of the ring it
+  // writes to: the memfd, the data-ready eventfd, and the space-ready eventfd.
+
+  uint64_t magic;
+  uint64_t ringWords;
+};
+
+struct RingHeader {
+  // Lives at the start of a ring's shared mapping. `head` and `tail` count words since the ring
+  // was created, so `head - tail` is the number of words in use. They're on separate cache lines
+  // because the two processes write them concurrently.
+
+  alignas(64) uint64_t head;
+  // Words ever published by the writer.
+
+  alignas(64) uint64_t tail;
+  // Words ever released by the reader.
+
+  alignas(64) uint32_t readerSleeping;
+  uint32_t writerSleeping;
+  // Set by a side before it waits on the eventfd, so that the other side knows to write to it.
+
+  uint32_t closed;
+  // Set by the writer in end().
+};
+
+static_assert(sizeof(RingHeader) <= HEADER_BYTES);
+
+inline uint32_t firstHalf(const word* ptr) {
+  return reinterpret_cast<const _::WireValue<uint32_t>*>(ptr)->get();
+}
+
+inline void setMarker(word* ptr, uint32_t marker) {
+  auto halves = reinterpret_cast<_::WireValue<uint32_t>*>(ptr);
+  halves[0].set(marker);
+  halves[1].set(0);
+}
+
+void signal(int eventFd) {
+  uint64_t one = 1;
+  KJ_SYSCALL(::write(eventFd, &one, sizeof(one)));
+}
+
+}  // namespace
+
+class SharedMemoryMessageStream::Ring {
+  // A mapping of one ring. The process that writes to the ring uses the "writer" methods, and the
+  // other process uses the "reader" methods.
+
+public:
+  Ring(int memfd, size_t capacity, kj::OwnFd dataEvent, kj::OwnFd spaceEvent)
+      : capacity(capacity), dataEvent(kj::mv(dataEvent)), spaceEvent(kj::mv(spaceEvent)),
+        mappingSize(HEADER_BYTES + capacity * sizeof(word)) {
+    void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+    if (mapping == MAP_FAILED) {
+      KJ_FAIL_SYSCALL("mmap(ring)", errno, mappingSize);
+    }
+    header = reinterpret_cast<RingHeader*>(mapping);
+    data = reinterpret_cast<word*>(reinterpret_cast<byte*>(mapping) + HEADER_BYTES);
+  }
+
+  ~Ring() noexcept(false) {
+    KJ_SYSCALL(munmap(header, mappingSize)) { break; }
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(Ring);
+
+  const size_t capacity;
+  // In words.
+
+  kj::OwnFd dataEvent;
+  kj::OwnFd spaceEvent;
+  // Written by the writer when it publishes data while the reader is sleeping, and by the reader
+  // when it releases space while the writer is sleeping, respectively.
+
+  // -------------------------------------------------------------------
+  // Writer
+
+  kj::Maybe<word*> tryReserve(size_t words) {
+    // Returns a pointer to `words` contiguous words, or none if the ring is too full. The words
+    // become visible to the reader on the next publish(). `words` must be no more than half the
+    // capacity.
+
+    KJ_DASSERT(words <= capacity / 2);
+
+    size_t pos = head % capacity;
+    if (!hasSpaceFor(words)) return kj::none;
+
+    size_t toEnd = capacity - pos;
+    if (words > toEnd) {
+      setMarker(data + pos, WRAP_MARKER);
+      head += toEnd;
+      pos = 0;
+    }
+    head += words;
+    return data + pos;
+  }
+
+  void publish() {
+    __atomic_store_n(&header->head, head, __ATOMIC_RELEASE);
+    wake(header->readerSleeping, dataEvent);
+  }
+
+  bool prepareToWaitForSpace(size_t words) {
+    // Returns false if the space showed up in the meantime, in which case the caller must not
+    // wait.
+
+    __atomic_store_n(&header->writerSleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (hasSpaceFor(words)) {
+      __atomic_store_n(&header->writerSleeping, 0, __ATOMIC_RELAXED);
+      return false;
+    }
+    return true;
+  }
+
+  bool hasSpaceFor(size_t words) {
+    size_t toEnd = capacity - head % capacity;
+    size_t needed = words <= toEnd ? words : toEnd + words;
+    return head + needed - __atomic_load_n(&header->tail, __ATOMIC_ACQUIRE) <= capacity;
+  }
+
+  void close() {
+    __atomic_store_n(&header->closed, 1, __ATOMIC_RELEASE);
+    wake(header->readerSleeping, dataEvent);
+  }
+
+  // -------------------------------------------------------------------
+  // Reader
+
+  kj::ArrayPtr<const word> readable() {
+    // Returns the published words from the read position up to the end of the ring, skipping
+    // any wrap marker. Empty if there's nothing to read.
+
+    for (;;) {
+      uint64_t published = __atomic_load_n(&header->head, __ATOMIC_ACQUIRE);
+      KJ_REQUIRE(published - tail <= capacity, "shared memory ring is corrupt");
+      if (published == tail) return nullptr;
+
+      size_t pos = tail % capacity;
+      if (firstHalf(data + pos) == WRAP_MARKER) {
+        release(capacity - pos);
+        continue;
+      }
+      return kj::arrayPtr(data + pos, kj::min(published - tail, capacity - pos));
+    }
+  }
+
+  void release(size_t words) {
+    tail += words;
+    __atomic_store_n(&header->tail, tail, __ATOMIC_RELEASE);
+    wake(header->writerSleeping, spaceEvent);
+  }
+
+  bool prepareToWaitForData() {
+    // Returns false if data showed up (or the writer closed the ring) in the meantime, in which
+    // case the caller must not wait.
+
+    __atomic_store_n(&header->readerSleeping, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&header->head, __ATOMIC_ACQUIRE) != tail || isClosed()) {
+      __atomic_store_n(&header->readerSleeping, 0, __ATOMIC_RELAXED);
+      return false;
+    }
+    return true;
+  }
+
+  bool isClosed() {
+    return __atomic_load_n(&header->closed, __ATOMIC_ACQUIRE);
+  }
+
+private:
+  size_t mappingSize;
+  RingHeader* header;
+  word* data;
+
+  uint64_t head = 0;
+  uint64_t tail = 0;
+  // Our own copy of the index we're responsible for, depending on which side we are.
+
+  static void wake(uint32_t& sleeping, kj::OwnFd& event) {
+    // The fence pairs with the one in prepareToWait*(): either the sleeper sees our update, or we
+    // see its flag. If the flag is still set afterwards, the peer may have cleared it and
+    // signaled spuriously -- that's harmless, since waiters always recheck the ring.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&sleeping, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&sleeping, 0, __ATOMIC_RELAXED)) {
+      signal(event);
+    }
+  }
+};
+
+// =======================================================================================
+
+class SharedMemoryMessageStream::MessageReaderImpl final: public FlatArrayMessageReader {
+public:
+  MessageReaderImpl(SharedMemoryMessageStream& parent, kj::ArrayPtr<const word> data,
+                    ReaderOptions options)
+      : FlatArrayMessageReader(data, options), state(&parent), ringWords(data.size()) {
+    KJ_DASSERT(!parent.hasOutstandingShortLivedMessage);
+    parent.hasOutstandingShortLivedMessage = true;
+  }
+  MessageReaderImpl(kj::Array<word>&& ownBuffer, ReaderOptions options)
+      : FlatArrayMessageReader(ownBuffer, options), state(kj::mv(ownBuffer)) {}
+  MessageReaderImpl(kj::ArrayPtr<word> scratchBuffer, ReaderOptions options)
+      : FlatArrayMessageReader(scratchBuffer, options) {}
+
+  ~MessageReaderImpl() noexcept(false) {
+    KJ_IF_SOME(parent, state.tryGet<SharedMemoryMessageStream*>()) {
+      parent->hasOutstandingShortLivedMessage = false;
+      parent->rx->release(ringWords);
+    }
+  }
+
+private:
+  kj::OneOf<SharedMemoryMessageStream*, kj::Array<word>> state;
+  // * SharedMemoryMessageStream* if this reader aliases the ring.
+  // * kj::Array<word> if this reader owns its own backing buffer.
+
+  size_t ringWords = 0;
+  // Words to release from the ring when done, if aliasing it.
+};
+
+// =======================================================================================
+
+kj::Promise<kj::Own<SharedMemoryMessageStream>> SharedMemoryMessageStream::connect(
+    kj::LowLevelAsyncIoProvider& provider, kj::Own<kj::AsyncCapabilityStream> socket,
+    IsShortLivedCallback isShortLivedCallback, size_t ringBytes) {
+  size_t capacity = (ringBytes + sizeof(word) - 1) / sizeof(word);
+  KJ_REQUIRE(capacity >= MIN_RING_WORDS && capacity <= MAX_RING_WORDS,
+      "shared memory ring size out of range", ringBytes);
+
+  kj::OwnFd memfd = KJ_SYSCALL_FD(memfd_create("capnp-shm-ring", MFD_CLOEXEC));
+  KJ_SYSCALL(ftruncate(memfd, HEADER_BYTES + capacity * sizeof(word)));
+  kj::OwnFd dataEvent = KJ_SYSCALL_FD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  kj::OwnFd spaceEvent = KJ_SYSCALL_FD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  const int fds[3] = { memfd, dataEvent, spaceEvent };
+
+  auto tx = kj::heap<Ring>(memfd, capacity, kj::mv(dataEvent), kj::mv(spaceEvent));
+
+  Hello hello { HELLO_MAGIC, capacity };
+  co_await socket->writeWithFds(kj::arrayPtr(&hello, 1).asBytes(), nullptr,
+                                kj::ArrayPtr<const int>(fds));
+
+  Hello peerHello;
+  kj::OwnFd peerFds[3];
+  auto result = co_await socket->tryReadWithFds(
+      &peerHello, sizeof(peerHello), sizeof(peerHello), peerFds, kj::size(peerFds));
+  if (result.byteCount < sizeof(peerHello)) {
+    kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED,
+        "peer disconnected during shared memory handshake"));
+  }
+  KJ_REQUIRE(peerHello.magic == HELLO_MAGIC, "peer is not a SharedMemoryMessageStream");
+  KJ_REQUIRE(result.capCount == kj::size(peerFds),
+      "shared memory handshake is missing FDs", result.capCount);
+  KJ_REQUIRE(peerHello.ringWords >= MIN_RING_WORDS && peerHello.ringWords <= MAX_RING_WORDS,
+      "peer's shared memory ring size out of range", peerHello.ringWords);
+
+  struct stat stats;
+  KJ_SYSCALL(fstat(peerFds[0], &stats));
+  KJ_REQUIRE(static_cast<uint64_t>(stats.st_size) >=
+             HEADER_BYTES + peerHello.ringWords * sizeof(word),
+      "peer's shared memory ring is smaller than advertised", stats.st_size);
+
+  auto rx = kj::heap<Ring>(peerFds[0], peerHello.ringWords,
+                           kj::mv(peerFds[1]), kj::mv(peerFds[2]));
+
+  co_return kj::heap<SharedMemoryMessageStream>(
+      provider, kj::mv(socket), kj::mv(isShortLivedCallback), kj::mv(tx), kj::mv(rx));
+}
+
+SharedMemoryMessageStream::SharedMemoryMessageStream(
+    kj::LowLevelAsyncIoProvider& provider, kj::Own<kj::AsyncCapabilityStream> socket,
+    IsShortLivedCallback isShortLivedCallback, kj::Own<Ring> tx, kj::Own<Ring> rx)
+    : socket(kj::mv(socket)), isShortLivedCallback(kj::mv(isShortLivedCallback)),
+      tx(kj::mv(tx)), rx(kj::mv(rx)),
+      txSpaceEvent(provider.wrapInputFd(this->tx->spaceEvent.get(),
+          kj::LowLevelAsyncIoProvider::ALREADY_CLOEXEC |
+          kj::LowLevelAsyncIoProvider::ALREADY_NONBLOCK)),
+      rxDataEvent(provider.wrapInputFd(this->rx->dataEvent.get(),
+          kj::LowLevelAsyncIoProvider::ALREADY_CLOEXEC |
+          kj::LowLevelAsyncIoProvider::ALREADY_NONBLOCK)) {}
+
+SharedMemoryMessageStream::~SharedMemoryMessageStream() noexcept(false) {}
+
+kj::Promise<kj::Maybe<MessageReaderAndFds>> SharedMemoryMessageStream::tryReadMessage(
+    kj::ArrayPtr<kj::OwnFd> fdSpace, ReaderOptions options, kj::ArrayPtr<word> scratchSpace) {
+  KJ_REQUIRE(!hasOutstandingShortLivedMessage,
+      "can't read another message while the previous short-lived message still exists");
+
+  // Check `closed` first: it's set after the last message is published.
+  bool closed = rx->isClosed();
+  auto available = rx->readable();
+
+  if (available.size() == 0) {
+    if (closed) {
+      return kj::Maybe<MessageReaderAndFds>(kj::none);
+    }
+    return waitForData().then([this, fdSpace, options, scratchSpace]() mutable {
+      return tryReadMessage(fdSpace, options, scratchSpace);
+    });
+  }
+
+  if (firstHalf(available.begin()) == SOCKET_MARKER) {
+    rx->release(1);
+    return capnp::readMessage(*socket, fdSpace, options, scratchSpace)
+        .then([](MessageReaderAndFds&& result) -> kj::Maybe<MessageReaderAndFds> {
+      return kj::mv(result);
+    });
+  }
+
+  size_t expected = expectedSizeInWordsFromPrefix(available);
+  KJ_REQUIRE(expected <= available.size(), "shared memory ring contains a truncated message");
+
+  auto msgData = available.first(expected);
+  kj::Own<MessageReader> reader = kj::heap<MessageReaderImpl>(*this, msgData, options);
+  if (!isShortLivedCallback(*reader)) {
+    // This message is long-lived, so we must copy it out of the ring. Replacing `reader` then
+    // releases its space.
+    if (msgData.size() <= scratchSpace.size()) {
+      memcpy(scratchSpace.begin(), msgData.begin(), msgData.asBytes().size());
+      reader = kj::heap<MessageReaderImpl>(scratchSpace, options);
+    } else {
+      reader = kj::heap<MessageReaderImpl>(kj::heapArray<word>(msgData), options);
+    }
+  }
+
+  return kj::Maybe<MessageReaderAndFds>(MessageReaderAndFds { kj::mv(reader), nullptr });
+}
+
+kj::Promise<void> SharedMemoryMessageStream::writeMessage(
+    kj::ArrayPtr<const int> fds,
+    kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_IF_SOME(promise, tryWrite(fds, segments)) {
+    return kj::mv(promise);
+  } else {
+    return kj::READY_NOW;
+  }
+}
+
+kj::Promise<void> SharedMemoryMessageStream::writeMessages(
+    kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) {
+  for (auto i: kj::indices(messages)) {
+    KJ_IF_SOME(promise, tryWrite(nullptr, messages[i])) {
+      return promise.then([this, rest = messages.slice(i + 1, messages.size())]() mutable {
+        return writeMessages(rest);
+      });
+    }
+  }
+  return kj::READY_NOW;
+}
+
+kj::Maybe<kj::Promise<void>> SharedMemoryMessageStream::tryWrite(
+    kj::ArrayPtr<const int> fds, kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_REQUIRE(!ended, "can't write a message after end()");
+  KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
+
+  size_t tableWords = segments.size() / 2 + 1;
+  size_t totalWords = tableWords;
+  for (auto& segment: segments) {
+    totalWords += segment.size();
+  }
+
+  if (fds.size() > 0 || totalWords > tx->capacity / 2) {
+    // Can't go through the ring. Leave a marker so the reader knows to read the socket.
+    KJ_IF_SOME(slot, tx->tryReserve(1)) {
+      setMarker(slot, SOCKET_MARKER);
+      tx->publish();
+      return capnp::writeMessage(*socket, fds, segments);
+    } else {
+      return waitForSpace(1).then([this, fds, segments]() {
+        return writeMessage(fds, segments);
+      });
+    }
+  }
+
+  KJ_IF_SOME(slot, tx->tryReserve(totalWords)) {
+    auto table = reinterpret_cast<_::WireValue<uint32_t>*>(slot);
+    table[0].set(segments.size() - 1);
+    for (auto i: kj::indices(segments)) {
+      table[i + 1].set(segments[i].size());
+    }
+    if (segments.size() % 2 == 0) {
+      // Set padding byte.
+      table[segments.size() + 1].set(0);
+    }
+
+    word* pos = slot + tableWords;
+    for (auto& segment: segments) {
+      memcpy(pos, segment.begin(), segment.asBytes().size());
+      pos += segment.size();
+    }
+
+    tx->publish();
+    return kj::none;
+  } else {
+    return waitForSpace(totalWords).then([this, fds, segments]() {
+      return writeMessage(fds, segments);
+    });
+  }
+}
+
+kj::Maybe<int> SharedMemoryMessageStream::getSendBufferSize() {
+  return static_cast<int>(tx->capacity * sizeof(word));
+}
+
+kj::Promise<void> SharedMemoryMessageStream::end() {
+  ended = true;
+  tx->close();
+  socket->shutdownWrite();
+  return kj::READY_NOW;
+}
+
+kj::Promise<void> SharedMemoryMessageStream::waitForSpace(size_t words) {
+  if (!tx->prepareToWaitForSpace(words)) co_return;
+
+  uint64_t count;
+  bool disconnected = co_await txSpaceEvent->tryRead(&count, sizeof(count), sizeof(count))
+      .then([](size_t) { return false; })
+      .exclusiveJoin(socket->whenWriteDisconnected().then([]() { return true; }));
+  if (disconnected && !tx->hasSpaceFor(words)) {
+    kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED, "shared memory peer disconnected"));
+  }
+}
+
+kj::Promise<void> SharedMemoryMessageStream::waitForData() {
+  if (!rx->prepareToWaitForData()) co_return;
+
+  uint64_t count;
+  bool disconnected = co_await rxDataEvent->tryRead(&count, sizeof(count), sizeof(count))
+      .then([](size_t) { return false; })
+      .exclusiveJoin(socket->whenWriteDisconnected().then([]() { return true; }));
+  if (disconnected && !rx->isClosed() && rx->readable().size() == 0) {
+    kj::throwFatalException(KJ_EXCEPTION(DISCONNECTED, "shared memory peer disconnected"));
+  }
+}
+
+}  // namespace capnp
+
+#endif  // __linux__
@@ -0,0 +1,139 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// A MessageStream between two processes on the same Linux host, which passes messages through
+// shared memory instead of a socket.
+//
+// SharedMemoryMessageStream is only implemented on Linux. On other platforms this header is
+// installed like any other but declares nothing.
+
+#pragma once
+
+#include "serialize-async.h"
+#include <kj/async-io.h>
+#include <kj/function.h>
+
+CAPNP_BEGIN_HEADER
+
+#if __linux__
+
+namespace capnp {
+
+class SharedMemoryMessageStream final: public MessageStream {
+  // A MessageStream for two co-located processes (e.g. a server and its sidecar) connected by a
+  // Unix socket. Each direction has a single-producer, single-consumer ring buffer in a memfd
+  // mapped by both processes. Writing a message copies its segments straight into the ring, and
+  // reading one returns a FlatArrayMessageReader pointing into the ring, so a message crosses
+  // with one copy and, while both sides are busy, no system calls at all. When a side runs out of
+  // work it sleeps on an eventfd, registered with the event loop like any other FD; its peer only
+  // writes to the eventfd if it sees that the other side is asleep.
+  //
+  // The socket is used to set up the rings and then only for messages that can't go through the
+  // ring: those with FDs attached, and those bigger than half the ring. The ring carries a marker
+  // in their place, so message order is preserved.
+  //
+  // The peer can modify the ring while we read it, so use this only between processes that trust
+  // each other.
+  //
+  // To run RPC over it, pass the stream to the TwoPartyVatNetwork constructor that takes a
+  // MessageStream:
+  //
+  //     auto stream = co_await SharedMemoryMessageStream::connect(
+  //         lowLevelProvider, kj::mv(socket), IncomingRpcMessage::getShortLivedCallback());
+  //     TwoPartyVatNetwork network(*stream, maxFds, rpc::twoparty::Side::CLIENT);
+  //
+  // Like with other MessageStreams, at most one read and one write may be in progress at a time.
+
+public:
+  using IsShortLivedCallback = kj::Function<bool(MessageReader&)>;
+  // As for BufferedMessageStream. Short-lived messages are read in place from the ring. Other
+  // messages are copied out, so that the space can be reused right away.
+
+  static constexpr size_t DEFAULT_RING_BYTES = 1u << 20;
+
+  static kj::Promise<kj::Own<SharedMemoryMessageStream>> connect(
+      kj::LowLevelAsyncIoProvider& provider, kj::Own<kj::AsyncCapabilityStream> socket,
+      IsShortLivedCallback isShortLivedCallback, size_t ringBytes = DEFAULT_RING_BYTES);
+  // Both processes call this on their ends of the socket. Each side allocates the ring that it
+  // writes to, `ringBytes` in size (rounded up to a whole number of words), and sends it to the
+  // other side.
+
+  ~SharedMemoryMessageStream() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(SharedMemoryMessageStream);
+
+  // Implements MessageStream
+  kj::Promise<kj::Maybe<MessageReaderAndFds>> tryReadMessage(
+      kj::ArrayPtr<kj::OwnFd> fdSpace,
+      ReaderOptions options = ReaderOptions(), kj::ArrayPtr<word> scratchSpace = nullptr) override;
+  kj::Promise<void> writeMessage(
+      kj::ArrayPtr<const int> fds,
+      kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) override;
+  kj::Promise<void> writeMessages(
+      kj::ArrayPtr<kj::ArrayPtr<const kj::ArrayPtr<const word>>> messages) override;
+  kj::Maybe<int> getSendBufferSize() override;
+  kj::Promise<void> end() override;
+
+  // Make sure the overridden virtual methods don't hide the non-virtual methods.
+  using MessageStream::tryReadMessage;
+  using MessageStream::writeMessage;
+
+  class Ring;
+  // One direction's ring buffer. Public only so that connect() can construct the stream.
+
+  SharedMemoryMessageStream(kj::LowLevelAsyncIoProvider& provider,
+                            kj::Own<kj::AsyncCapabilityStream> socket,
+                            IsShortLivedCallback isShortLivedCallback,
+                            kj::Own<Ring> tx, kj::Own<Ring> rx);
+  // Use connect() instead.
+
+private:
+  kj::Own<kj::AsyncCapabilityStream> socket;
+  IsShortLivedCallback isShortLivedCallback;
+
+  kj::Own<Ring> tx;
+  kj::Own<Ring> rx;
+  // The ring we write to, and the one the peer writes to.
+
+  kj::Own<kj::AsyncInputStream> txSpaceEvent;
+  kj::Own<kj::AsyncInputStream> rxDataEvent;
+  // Eventfds we wait on when `tx` is full or `rx` is empty.
+
+  bool ended = false;
+  bool hasOutstandingShortLivedMessage = false;
+
+  kj::Maybe<kj::Promise<void>> tryWrite(
+      kj::ArrayPtr<const int> fds, kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+  // Writes the message if possible without waiting. Otherwise, returns a promise for the rest of
+  // the write.
+
+  kj::Promise<void> waitForSpace(size_t words);
+  kj::Promise<void> waitForData();
+  // Called when `tx` is full or `rx` is empty. Resolves when that may have changed. Throws if
+  // the peer went away without calling end().
+
+  class MessageReaderImpl;
+};
+
+}  // namespace capnp
+
+#endif  // __linux__
+
+CAPNP_END_HEADER
@@ -197,6 +197,39 @@ TEST(Serialize, FlatArrayOddSegmentCount) {
   }
 }
 
+TEST(Serialize, CompactToFlatArray) {
+  TestMessageBuilder builder(7);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  ASSERT_GT(builder.getSegmentsForOutput().size(), 1u);
+
+  kj::Array<word> serialized = compactToFlatArray(builder);
+
+  FlatArrayMessageReader reader(serialized.asPtr());
+  checkTestMessage(reader.getRoot<TestAllTypes>());
+  EXPECT_EQ(serialized.end(), reader.getEnd());
+
+  // One segment, and no bigger than the builder's own serialization.
+  EXPECT_EQ(0u, reinterpret_cast<const WireValue<uint32_t>*>(serialized.begin())[0].get());
+  EXPECT_LT(serialized.size(), messageToFlatArray(builder).size());
+}
+
+TEST(Serialize, CompactToFlatArrayEmpty) {
+  MallocMessageBuilder builder;
+
+  kj::Array<word> serialized = compactToFlatArray(builder);
+  ASSERT_EQ(2u, serialized.size());
+
+  FlatArrayMessageReader reader(serialized.asPtr());
+  EXPECT_TRUE(reader.getRoot<AnyPointer>().isNull());
+  EXPECT_EQ(serialized.end(), reader.getEnd());
+
+  // The builder is still usable afterwards.
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  kj::Array<word> serialized2 = compactToFlatArray(builder);
+  FlatArrayMessageReader reader2(serialized2.asPtr());
+  checkTestMessage(reader2.getRoot<TestAllTypes>());
+}
+
 TEST(Serialize, FlatArrayEvenSegmentCount) {
   TestMessageBuilder builder(10);
   initTestMessage(builder.initRoot<TestAllTypes>());
@@ -412,6 +445,162 @@ TEST(Serialize, WriteMessageEvenSegmentCount) {
   EXPECT_TRUE(output.dataEquals(serialized.asPtr()));
 }
 
+class GatherCountingOutputStream: public kj::OutputStream {
+  // Records everything written, and how it was written.
+
+public:
+  void write(kj::ArrayPtr<const byte> data) override {
+    this->data.append(data.asChars().begin(), data.size());
+    ++writeCount;
+  }
+
+  void write(kj::ArrayPtr<const kj::ArrayPtr<const byte>> pieces) override {
+    for (auto& piece: pieces) {
+      data.append(piece.asChars().begin(), piece.size());
+    }
+    ++writeCount;
+    maxPieces = kj::max(maxPieces, pieces.size());
+  }
+
+  std::string data;
+  uint writeCount = 0;
+  size_t maxPieces = 0;
+};
+
+std::string flatArrayString(MessageBuilder& builder) {
+  auto words = messageToFlatArray(builder);
+  return std::string(words.asChars().begin(), words.asChars().size());
+}
+
+TEST(Serialize, BatchedMessageWriter) {
+  TestMessageBuilder builder1(1);
+  initTestMessage(builder1.initRoot<TestAllTypes>());
+  TestMessageBuilder builder2(7);
+  initTestMessage(builder2.initRoot<TestAllTypes>());
+  TestMessageBuilder builder3(10);
+  initTestMessage(builder3.initRoot<TestAllTypes>());
+
+  GatherCountingOutputStream output;
+
+  {
+    BatchedMessageWriter writer(output);
+    writer.write(builder1);
+    writer.write(builder2);
+    writer.write(builder3);
+    EXPECT_EQ(3u, writer.getQueuedMessageCount());
+    EXPECT_EQ(0u, output.writeCount);
+
+    writer.flush();
+    EXPECT_EQ(0u, writer.getQueuedMessageCount());
+    EXPECT_EQ(0u, writer.getQueuedBytes());
+    EXPECT_EQ(1u, output.writeCount);
+    EXPECT_EQ(3u + 1 + 7 + 10, output.maxPieces);
+
+    writer.write(builder1);
+  }
+
+  // The destructor flushed the last message.
+  EXPECT_EQ(2u, output.writeCount);
+  EXPECT_TRUE(output.data == flatArrayString(builder1) + flatArrayString(builder2) +
+                             flatArrayString(builder3) + flatArrayString(builder1));
+}
+
+TEST(Serialize, BatchedMessageWriterHighWaterMark) {
+  TestMessageBuilder builder(1);
+  initTestMessage(builder.initRoot<TestAllTypes>());
+  auto expected = flatArrayString(builder);
+
+  GatherCountingOutputStream output;
+  BatchedMessageWriter writer(output, expected.size() * 2);
+
+  writer.write(builder);
+  EXPECT_EQ(0u, output.writeCount);
+  EXPECT_EQ(expected.size(), writer.getQueuedBytes());
+  writer.write(builder);
+  EXPECT_EQ(1u, output.writeCount);
+  EXPECT_EQ(0u, writer.getQueuedBytes());
+
+  EXPECT_TRUE(output.data == expected + expected);
+}
+
+TEST(Serialize, BatchedMessageWriterOwnedBuilders) {
+  GatherCountingOutputStream output;
+  std::string expected;
+
+  {
+    BatchedMessageWriter writer(output);
+    for (uint i = 0; i < 10; i++) {
+      auto builder = kj::heap<MallocMessageBuilder>();
+      builder->initRoot<TestAllTypes>().setUInt32Field(i);
+      expected += flatArrayString(*builder);
+      writer.write(kj::mv(builder));
+    }
+    EXPECT_EQ(0u, output.writeCount);
+  }
+
+  EXPECT_EQ(1u, output.writeCount);
+  EXPECT_TRUE(output.data == expected);
+}
+
+TEST(Serialize, BatchedMessageWriterPieceLimit) {
+  // Write enough messages that the batch fills up on piece count before reaching the high water
+  // mark.
+  TestMessageBuilder builder(1);
+  builder.initRoot<TestAllTypes>().setUInt32Field(123);
+
+  GatherCountingOutputStream output;
+  std::string expected;
+
+  {
+    BatchedMessageWriter writer(output, kj::maxValue);
+    for (uint i = 0; i < 2000; i++) {
+      writer.write(builder);
+      expected += flatArrayString(builder);
+    }
+  }
+
+  EXPECT_GT(output.writeCount, 1u);
+  EXPECT_TRUE(output.data == expected);
+
+  kj::ArrayInputStream input(kj::arrayPtr(
+      reinterpret_cast<const byte*>(output.data.data()), output.data.size()));
+  for (uint i = 0; i < 2000; i++) {
+    InputStreamMessageReader reader(input);
+    EXPECT_EQ(123u, reader.getRoot<TestAllTypes>().getUInt32Field());
+  }
+}
+
+TEST(Serialize, BatchedMessageWriterTooManySegmentsForBatch) {
+  // A message with more segments than fit in one batch is written on its own, in order.
+  auto words = kj::heapArray<word>(4096);
+  memset(words.begin(), 0, words.asBytes().size());
+  auto segments = kj::heapArray<kj::ArrayPtr<const word>>(words.size());
+  for (uint i = 0; i < words.size(); i++) {
+    segments[i] = words.slice(i, i + 1);
+  }
+  kj::ArrayPtr<const kj::ArrayPtr<const word>> hugeSegments = segments;
+
+  TestMessageBuilder builder(1);
+  builder.initRoot<TestAllTypes>().setUInt32Field(123);
+
+  GatherCountingOutputStream output;
+  std::string expected;
+
+  {
+    BatchedMessageWriter writer(output);
+    writer.write(builder);
+    writer.write(hugeSegments);
+    EXPECT_EQ(0u, writer.getQueuedMessageCount());
+    writer.write(builder);
+  }
+
+  auto hugeFlat = messageToFlatArray(hugeSegments);
+  expected = flatArrayString(builder) +
+      std::string(hugeFlat.asChars().begin(), hugeFlat.asChars().size()) +
+      flatArrayString(builder);
+  EXPECT_TRUE(output.data == expected);
+}
+
 #if _WIN32
 int mkstemp(char *tpl) {
   char* end = tpl + strlen(tpl);
@@ -22,6 +22,7 @@
 #include "serialize.h"
 #include "layout.h"
 #include <kj/debug.h>
+#include <kj/miniposix.h>
 #include <exception>
 #ifdef _WIN32
 #include <io.h>
@@ -185,6 +186,27 @@ kj::Array<word> messageToFlatArray(kj::ArrayPtr<const kj::ArrayPtr<const word>>
   return kj::mv(result);
 }
 
+kj::Array<word> compactToFlatArray(MessageBuilder& builder) {
+  // One word of segment table, then the compacted segment.  As in MessageBuilder::compact(), the
+  // builder's total size is an upper bound on the compacted size -- except that a builder with
+  // nothing allocated yet has no size, but still compacts to a one-word null root pointer -- so
+  // compact into a scratch buffer of that size and copy out the used prefix if it came up short.
+  size_t bound = builder.getSegmentsForOutput().size() == 0 ? 1 : builder.sizeInWords();
+  kj::Array<word> buffer = kj::heapArray<word>(bound + 1);
+  auto segment = builder.compactInto(buffer.slice(1, buffer.size()));
+
+  _::WireValue<uint32_t>* table = reinterpret_cast<_::WireValue<uint32_t>*>(buffer.begin());
+  table[0].set(0);
+  table[1].set(segment.size());
+
+  auto used = buffer.first(segment.size() + 1);
+  if (used.size() == buffer.size()) {
+    return buffer;
+  } else {
+    return kj::heapArray<word>(used);
+  }
+}
+
 size_t computeSerializedSizeInWords(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
   KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
 
@@ -356,6 +378,101 @@ void writeMessage(kj::OutputStream& output, kj::ArrayPtr<const kj::ArrayPtr<cons
   output.write(pieces);
 }
 
+// -------------------------------------------------------------------
+
+namespace {
+
+#if _WIN32
+// Windows has no writev(), so kj::FdOutputStream issues one write per piece anyway. Any cap
+// will do.
+static constexpr size_t MAX_BATCH_PIECES = 1024;
+#else
+static constexpr size_t MAX_BATCH_PIECES = kj::miniposix::iovMax();
+#endif
+
+}  // namespace
+
+BatchedMessageWriter::BatchedMessageWriter(kj::OutputStream& output, size_t highWaterMarkBytes)
+    : output(output), highWaterMark(highWaterMarkBytes),
+      pieces(kj::heapArray<kj::ArrayPtr<const byte>>(MAX_BATCH_PIECES)),
+      tables(kj::heapArray<word>(MAX_BATCH_PIECES)) {}
+
+BatchedMessageWriter::~BatchedMessageWriter() noexcept(false) {
+  unwindDetector.catchExceptionsIfUnwinding([&]() {
+    flush();
+  });
+}
+
+void BatchedMessageWriter::write(MessageBuilder& builder) {
+  write(builder.getSegmentsForOutput());
+}
+
+void BatchedMessageWriter::write(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments) {
+  KJ_REQUIRE(segments.size() > 0, "Tried to serialize uninitialized message.");
+
+  size_t pieceNeeded = segments.size() + 1;
+  if (pieceNeeded > pieces.size()) {
+    // This message alone wouldn't fit in a batch. Write out what we have to preserve ordering,
+    // then write it the usual way.
+    flush();
+    writeMessage(output, segments);
+    return;
+  }
+
+  if (pieceCount + pieceNeeded > pieces.size()) {
+    flush();
+  }
+
+  // Same layout as in writeMessage().
+  size_t tableSize = segments.size() / 2 + 1;
+  auto tableSpace = tables.slice(tableWords, tableWords + tableSize);
+  auto table = reinterpret_cast<_::WireValue<uint32_t>*>(tableSpace.begin());
+  table[0].set(segments.size() - 1);
+  for (uint i = 0; i < segments.size(); i++) {
+    table[i + 1].set(segments[i].size());
+  }
+  if (segments.size() % 2 == 0) {
+    // Set padding byte.
+    table[segments.size() + 1].set(0);
+  }
+  tableWords += tableSize;
+
+  pieces[pieceCount++] = tableSpace.asBytes();
+  queuedBytes += tableSpace.asBytes().size();
+  for (auto& segment: segments) {
+    pieces[pieceCount++] = segment.asBytes();
+    queuedBytes += segment.asBytes().size();
+  }
+  ++queuedMessages;
+
+  if (queuedBytes >= highWaterMark) {
+    flush();
+  }
+}
+
+void BatchedMessageWriter::write(kj::Own<MessageBuilder> builder) {
+  write(*builder);
+  if (queuedMessages > 0) {
+    // Still queued, so hold on to the builder until the next flush.
+    ownedBuilders.add(kj::mv(builder));
+  }
+}
+
+void BatchedMessageWriter::flush() {
+  if (pieceCount == 0) return;
+
+  // If the write fails, drop the batch rather than risk writing part of it twice.
+  KJ_DEFER({
+    pieceCount = 0;
+    tableWords = 0;
+    queuedBytes = 0;
+    queuedMessages = 0;
+    ownedBuilders.clear();
+  });
+
+  output.write(pieces.first(pieceCount));
+}
+
 // =======================================================================================
 
 StreamFdMessageReader::~StreamFdMessageReader() noexcept(false) {}
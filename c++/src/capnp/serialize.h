@@ -109,6 +109,12 @@ kj::Array<word> messageToFlatArray(MessageBuilder& builder);
 kj::Array<word> messageToFlatArray(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
 // Version of messageToFlatArray that takes a raw segment array.
 
+kj::Array<word> compactToFlatArray(MessageBuilder& builder);
+// Like messageToFlatArray(), but rewrites the message as a single segment on the way, using
+// MessageBuilder::compactInto().  Far pointers and orphaned space are dropped, which makes the
+// result smaller and faster to read when the builder has accumulated several segments.
+// Capability indexes are preserved.
+
 size_t computeSerializedSizeInWords(MessageBuilder& builder);
 // Returns the size, in words, that will be needed to serialize the message, including the header.
 
@@ -179,6 +185,65 @@ void writeMessage(kj::OutputStream& output, MessageBuilder& builder);
 void writeMessage(kj::OutputStream& output, kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
 // Write the segment array to the given output stream.
 
+class BatchedMessageWriter {
+  // Writes many messages to an OutputStream in the same format as writeMessage(), but with as few
+  // writes as possible. Segment tables and pointers to segment contents of queued messages are
+  // gathered into one array of pieces, which is passed to a single `output.write(pieces)` call.
+  // With kj::FdOutputStream, that is a single writev() (the pieces array is capped at IOV_MAX).
+  // Use this when writing lots of small messages to a file or socket, where calling
+  // writeMessage() for each one would mean one system call per message.
+  //
+  // Segment contents are not copied. A message's segments must remain valid and unmodified until
+  // the next flush, which happens when flush() is called explicitly, when the writer is destroyed,
+  // or automatically during write() when the batch fills up. To avoid having to think about that,
+  // pass ownership of the builder with `write(kj::Own<MessageBuilder>)`.
+
+public:
+  static constexpr size_t DEFAULT_HIGH_WATER_MARK = 64 * 1024;
+
+  explicit BatchedMessageWriter(kj::OutputStream& output,
+                                size_t highWaterMarkBytes = DEFAULT_HIGH_WATER_MARK);
+  // Once at least `highWaterMarkBytes` bytes are queued, write() flushes automatically. A larger
+  // value means fewer system calls but more data held back from the output.
+
+  KJ_DISALLOW_COPY_AND_MOVE(BatchedMessageWriter);
+  ~BatchedMessageWriter() noexcept(false);
+  // Flushes any queued messages, unless the destructor is running due to an exception.
+
+  void write(MessageBuilder& builder);
+  void write(kj::ArrayPtr<const kj::ArrayPtr<const word>> segments);
+  // Queue a message, which must remain valid until the next flush (see above).
+
+  void write(kj::Own<MessageBuilder> builder);
+  // Queue a message, keeping the builder alive until it has been written.
+
+  void flush();
+  // Write all queued messages to the output stream.
+
+  inline size_t getQueuedBytes() const { return queuedBytes; }
+  inline size_t getQueuedMessageCount() const { return queuedMessages; }
+
+private:
+  kj::OutputStream& output;
+  size_t highWaterMark;
+
+  kj::Array<kj::ArrayPtr<const byte>> pieces;
+  size_t pieceCount = 0;
+  // One piece for each segment table and each segment. Capped at IOV_MAX.
+
+  kj::Array<word> tables;
+  size_t tableWords = 0;
+  // Segment tables of queued messages, back to back. A message's table never needs more words
+  // than the message has pieces, so `tables` is allocated as large as `pieces` and never moves.
+
+  kj::Vector<kj::Own<MessageBuilder>> ownedBuilders;
+
+  size_t queuedBytes = 0;
+  size_t queuedMessages = 0;
+
+  kj::UnwindDetector unwindDetector;
+};
+
 // =======================================================================================
 // Specializations for reading from / writing to file descriptors.
 
@@ -0,0 +1,89 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Benchmarks for ShardedServerPool.
+
+#include <benchmark/benchmark.h>
+
+#include "sharded.h"
+#include <capnp/test.capnp.h>
+#include <kj/debug.h>
+#include <kj/vector.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+namespace test = capnproto_test::capnp::test;
+
+class BusyImpl final: public test::TestInterface::Server {
+  // foo() spins for `i` rounds of an LCG, standing in for a CPU-heavy method.
+
+protected:
+  kj::Promise<void> foo(FooContext context) override {
+    uint64_t x = 1;
+    for (auto i KJ_UNUSED: kj::zeroTo(context.getParams().getI())) {
+      x = x * 6364136223846793005ull + 1442695040888963407ull;
+    }
+    context.initResults().setX(kj::str(x));
+    return kj::READY_NOW;
+  }
+};
+
+static void bm_Sharded_Batch(benchmark::State& state) {
+  // Benchmark 64 CPU-heavy calls in flight at once on a capability served by a ShardedServerPool
+  // with N workers, or, for N = 0, on a plain local capability. With enough work per call, the
+  // throughput should grow with the number of workers up to the number of cores.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  uint workerCount = state.range(0);
+  kj::Maybe<kj::Own<ShardedServerPool>> pool;
+  test::TestInterface::Client client = nullptr;
+  if (workerCount == 0) {
+    client = kj::heap<BusyImpl>();
+  } else {
+    auto& p = *pool.emplace(kj::heap<ShardedServerPool>(workerCount));
+    client = p.newClient<test::TestInterface>([]() { return kj::heap<BusyImpl>(); },
+                                              ShardedServerPool::Affinity::ROUND_ROBIN);
+  }
+
+  for (auto _: state) {
+    kj::Vector<kj::Promise<void>> calls(64);
+    for (auto i KJ_UNUSED: kj::zeroTo(64)) {
+      auto req = client.fooRequest();
+      req.setI(state.range(1));
+      calls.add(req.send().ignoreResult());
+    }
+    kj::joinPromises(calls.releaseAsArray()).wait(waitScope);
+  }
+  state.SetItemsProcessed(state.iterations() * 64);
+}
+
+BENCHMARK(bm_Sharded_Batch)
+    ->ArgsProduct({{0, 1, 2, 4, 8}, {0, 100000}})
+    ->UseRealTime();
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
+
+BENCHMARK_MAIN();
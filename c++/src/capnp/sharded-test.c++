@@ -0,0 +1,191 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sharded.h"
+#include "test-util.h"
+#include <kj/debug.h>
+#include <kj/map.h>
+#include <kj/test.h>
+
+namespace capnp {
+namespace _ {
+namespace {
+
+kj::String currentThreadName() {
+  return kj::str(reinterpret_cast<uintptr_t>(&kj::getCurrentThreadExecutor()));
+}
+
+class ThreadReportingImpl final: public test::TestInterface::Server {
+  // foo() reports which thread ran it, bar() never returns, and baz() fails.
+
+protected:
+  kj::Promise<void> foo(FooContext context) override {
+    auto params = context.getParams();
+    context.initResults().setX(kj::str(params.getI(), ' ', currentThreadName()));
+    return kj::READY_NOW;
+  }
+
+  kj::Promise<void> bar(BarContext context) override {
+    return kj::NEVER_DONE;
+  }
+
+  kj::Promise<void> baz(BazContext context) override {
+    KJ_FAIL_REQUIRE("baz failed", context.getParams().getS().getInt32Field());
+  }
+};
+
+kj::Vector<kj::String> callFoo(test::TestInterface::Client& client, uint count,
+                               kj::WaitScope& waitScope) {
+  // Makes `count` calls at once and returns the thread that ran each.
+  kj::Vector<RemotePromise<test::TestInterface::FooResults>> promises;
+  for (auto i: kj::zeroTo(count)) {
+    auto req = client.fooRequest();
+    req.setI(i);
+    promises.add(req.send());
+  }
+
+  kj::Vector<kj::String> threads;
+  for (auto i: kj::zeroTo(count)) {
+    auto response = promises[i].wait(waitScope);
+    auto text = response.getX();
+    auto expectedPrefix = kj::str(i, ' ');
+    KJ_ASSERT(text.startsWith(expectedPrefix), text);
+    threads.add(kj::str(text.slice(expectedPrefix.size())));
+  }
+  return threads;
+}
+
+size_t countDistinct(kj::ArrayPtr<const kj::String> strings) {
+  kj::HashSet<kj::StringPtr> set;
+  for (auto& s: strings) {
+    if (set.find(s) == kj::none) set.insert(s);
+  }
+  return set.size();
+}
+
+KJ_TEST("ShardedServerPool runs calls on worker threads") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  ShardedServerPool pool(3);
+  auto factory = []() { return kj::heap<ThreadReportingImpl>(); };
+
+  {
+    // Each PER_OBJECT capability stays on one worker, and consecutive capabilities land on
+    // different workers.
+    auto client1 = pool.newClient<test::TestInterface>(factory);
+    auto client2 = pool.newClient<test::TestInterface>(factory);
+    auto threads1 = callFoo(client1, 6, waitScope);
+    auto threads2 = callFoo(client2, 6, waitScope);
+    KJ_EXPECT(countDistinct(threads1) == 1);
+    KJ_EXPECT(countDistinct(threads2) == 1);
+    KJ_EXPECT(threads1[0] != threads2[0]);
+    KJ_EXPECT(threads1[0] != currentThreadName());
+  }
+
+  {
+    auto client = pool.newClient<test::TestInterface>(
+        factory, ShardedServerPool::Affinity::ROUND_ROBIN);
+    auto threads = callFoo(client, 6, waitScope);
+    KJ_EXPECT(countDistinct(threads) == 3);
+    KJ_EXPECT(threads[0] == threads[3]);
+  }
+
+  {
+    // The first worker chosen is stuck on a call that never returns, so the next calls should
+    // avoid it.
+    auto client = pool.newClient<test::TestInterface>(
+        factory, ShardedServerPool::Affinity::LEAST_LOADED);
+    auto stuck = client.barRequest().send();
+    auto threads = callFoo(client, 4, waitScope);
+    KJ_EXPECT(countDistinct(threads) >= 2);
+    for (auto& thread: threads) {
+      KJ_EXPECT(thread != currentThreadName());
+    }
+    KJ_EXPECT(!stuck.poll(waitScope));
+  }
+}
+
+KJ_TEST("ShardedServerPool PER_OBJECT affinity preserves call order") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  ShardedServerPool pool(2);
+  auto client = pool.newClient<test::TestCallOrder>([]() {
+    return kj::heap<TestCallOrderImpl>();
+  });
+
+  kj::Vector<RemotePromise<test::TestCallOrder::GetCallSequenceResults>> promises;
+  for (auto i: kj::zeroTo(10u)) {
+    auto req = client.getCallSequenceRequest();
+    req.setExpected(i);
+    promises.add(req.send());
+  }
+  for (auto i: kj::zeroTo(10u)) {
+    KJ_EXPECT(promises[i].wait(waitScope).getN() == i);
+  }
+}
+
+KJ_TEST("ShardedServerPool errors") {
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+
+  kj::Maybe<kj::Promise<void>> stuck;
+  test::TestInterface::Client client = nullptr;
+
+  {
+    ShardedServerPool pool(2);
+    client = pool.newClient<test::TestInterface>([]() { return kj::heap<ThreadReportingImpl>(); });
+
+    // Exceptions thrown on the worker come back to the caller.
+    {
+      auto req = client.bazRequest();
+      req.initS().setInt32Field(123);
+      KJ_EXPECT_THROW_MESSAGE("baz failed", req.send().wait(waitScope));
+    }
+
+    // Capabilities can't cross threads.
+    {
+      int callCount = 0;
+      auto moreStuff = pool.newClient<test::TestMoreStuff>([]() -> test::TestMoreStuff::Client {
+        KJ_FAIL_ASSERT("factory shouldn't be called");
+      });
+      auto callFooReq = moreStuff.callFooRequest();
+      callFooReq.setCap(kj::heap<TestInterfaceImpl>(callCount));
+      KJ_EXPECT_THROW_MESSAGE("capabilities can't be passed",
+          callFooReq.send().wait(waitScope));
+    }
+
+    stuck = client.barRequest().send().ignoreResult();
+    KJ_EXPECT(!KJ_ASSERT_NONNULL(stuck).poll(waitScope));
+  }
+
+  // Calls that were running when the pool was destroyed fail, as do calls made afterwards.
+  KJ_EXPECT_THROW_MESSAGE("ShardedServerPool was destroyed",
+      KJ_ASSERT_NONNULL(stuck).wait(waitScope));
+  KJ_EXPECT_THROW_MESSAGE("ShardedServerPool was destroyed",
+      client.fooRequest().send().wait(waitScope));
+}
+
+}  // namespace
+}  // namespace _
+}  // namespace capnp
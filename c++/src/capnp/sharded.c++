@@ -0,0 +1,463 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#include "sharded.h"
+#include "message.h"
+#include <kj/async-io.h>
+#include <kj/debug.h>
+#include <kj/map.h>
+#include <kj/thread.h>
+
+namespace capnp {
+
+namespace {
+
+class ShardedObject final: public kj::AtomicRefcounted {
+  // What a capability returned by newClient() is sharing with the workers.
+
+public:
+  ShardedObject(kj::ConstFunction<Capability::Client()> factory,
+                ShardedServerPool::Affinity affinity, uint homeWorker)
+      : factory(kj::mv(factory)), affinity(affinity), homeWorker(homeWorker) {}
+
+  kj::ConstFunction<Capability::Client()> factory;
+  ShardedServerPool::Affinity affinity;
+  uint homeWorker;  // Only meaningful for PER_OBJECT.
+};
+
+struct Job {
+  // A unit of work passed from the dispatching thread to a worker, and for calls, back again.
+  // Jobs are allocated with `new`, and each is owned by whichever thread last popped it from a
+  // JobQueue.
+
+  enum Type {
+    CALL,
+    DROP,
+    // Drop the worker's instance of `object`.
+
+    STOP
+    // Exit the worker's event loop.
+  };
+
+  Job(Type type, kj::Own<const ShardedObject> object): type(type), object(kj::mv(object)) {}
+
+  Type type;
+  Job* next = nullptr;
+  // Link in a JobQueue.
+
+  kj::Own<const ShardedObject> object;
+
+  // For CALL:
+  uint workerIndex = 0;
+  uint64_t interfaceId = 0;
+  uint16_t methodId = 0;
+  kj::Own<MallocMessageBuilder> params;
+  kj::Own<MallocMessageBuilder> results;
+  kj::Maybe<kj::Exception> exception;
+  // Set by the worker when the call finishes. If neither is set, the call was canceled by the
+  // pool shutting down.
+  kj::Own<kj::PromiseFulfiller<kj::Own<MallocMessageBuilder>>> fulfiller;
+  // Belongs to the dispatching thread; the worker never touches it.
+};
+
+class JobQueue {
+  // Multi-producer, single-consumer queue of Jobs that never takes a lock.
+  //
+  // Producers push onto a lock-free stack. The consumer takes the whole stack at once and
+  // reverses it, so it never pops single entries and there's no ABA problem. When the queue is
+  // empty, the consumer publishes a cross-thread fulfiller and sleeps on its promise; a producer
+  // that makes the queue non-empty claims and fulfills it. Only that wakeup involves a lock
+  // (inside the event loop's executor), and only when the consumer was actually idle.
+
+public:
+  ~JobQueue() noexcept(false) {
+    KJ_ASSERT(head == nullptr, "JobQueue destroyed while non-empty") { break; }
+  }
+
+  void push(Job* job) {
+    // May be called from any thread.
+    Job* oldHead = __atomic_load_n(&head, __ATOMIC_RELAXED);
+    do {
+      job->next = oldHead;
+    } while (!__atomic_compare_exchange_n(
+        &head, &oldHead, job, true, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+
+    if (oldHead == nullptr && __atomic_load_n(&sleeper, __ATOMIC_SEQ_CST) != nullptr) {
+      // The consumer may be asleep. Claim its fulfiller so that only one producer wakes it.
+      auto fulfiller = __atomic_exchange_n(&sleeper, nullptr, __ATOMIC_SEQ_CST);
+      if (fulfiller != nullptr) fulfiller->fulfill();
+    }
+  }
+
+  Job* takeAll() {
+    // Consumer only. Returns everything pushed so far as a list in FIFO order.
+    Job* list = __atomic_exchange_n(&head, nullptr, __ATOMIC_ACQUIRE);
+    Job* result = nullptr;
+    while (list != nullptr) {
+      Job* next = list->next;
+      list->next = result;
+      result = list;
+      list = next;
+    }
+    return result;
+  }
+
+  kj::Promise<void> whenNonEmpty() {
+    // Consumer only. Must not be canceled while producers may still push.
+    if (__atomic_load_n(&head, __ATOMIC_ACQUIRE) != nullptr) return kj::READY_NOW;
+
+    auto paf = kj::newPromiseAndCrossThreadFulfiller<void>();
+    __atomic_store_n(&sleeper, paf.fulfiller.get(), __ATOMIC_SEQ_CST);
+
+    // Check again now that we've published the fulfiller. Either a producer sees the fulfiller,
+    // or we see its job here (the seq_cst operations on `sleeper` and `head` can't both miss).
+    if (__atomic_load_n(&head, __ATOMIC_SEQ_CST) != nullptr &&
+        __atomic_exchange_n(&sleeper, nullptr, __ATOMIC_SEQ_CST) != nullptr) {
+      return kj::READY_NOW;
+    }
+
+    // Either we're asleep, or a producer claimed the fulfiller and is about to fulfill it.
+    return paf.promise.attach(kj::mv(paf.fulfiller), kj::defer([this]() {
+      __atomic_store_n(&sleeper, nullptr, __ATOMIC_RELAXED);
+    }));
+  }
+
+private:
+  Job* head = nullptr;
+  const kj::CrossThreadPromiseFulfiller<void>* sleeper = nullptr;
+};
+
+}  // namespace
+
+// =======================================================================================
+
+class ShardedServerPool::Impl final: public kj::Refcounted {
+  // Refcounted so that capabilities which outlive the ShardedServerPool can still find out that
+  // it's gone.
+
+public:
+  Impl(uint workerCount);
+
+  void shutdown();
+
+  uint getWorkerCount() { return workers.size(); }
+
+  Capability::Client newClient(kj::ConstFunction<Capability::Client()> factory,
+                               Affinity affinity) {
+    uint home = nextHome++ % workers.size();
+    return kj::heap<Server>(kj::addRef(*this),
+        kj::atomicRefcounted<ShardedObject>(kj::mv(factory), affinity, home));
+  }
+
+private:
+  class Worker;
+
+  class Server final: public Capability::Server {
+    // Lives on the dispatching thread and forwards calls to the workers.
+
+  public:
+    Server(kj::Own<Impl> pool, kj::Own<const ShardedObject> object)
+        : pool(kj::mv(pool)), object(kj::mv(object)) {}
+
+    ~Server() noexcept(false) {
+      // Tell every worker that may have created an instance to drop it. (If the pool has shut
+      // down, the workers are gone and so are their instances.)
+      if (pool->workers == nullptr) return;
+      unwindDetector.catchExceptionsIfUnwinding([&]() {
+        if (object->affinity == Affinity::PER_OBJECT) {
+          pool->drop(object->homeWorker, *object);
+        } else {
+          for (auto i: kj::indices(pool->workers)) {
+            pool->drop(i, *object);
+          }
+        }
+      });
+    }
+
+    DispatchCallResult dispatchCall(uint64_t interfaceId, uint16_t methodId,
+                                    CallContext<AnyPointer, AnyPointer> context) override {
+      if (pool->workers == nullptr) {
+        return { KJ_EXCEPTION(DISCONNECTED, "ShardedServerPool was destroyed"), false, true };
+      }
+
+      auto params = context.getParams();
+      auto size = params.targetSize();
+      KJ_REQUIRE(size.capCount == 0,
+          "capabilities can't be passed to an object served by a ShardedServerPool",
+          interfaceId, methodId);
+
+      auto paramsCopy = kj::heap<MallocMessageBuilder>(size.wordCount + 1);
+      paramsCopy->getRoot<AnyPointer>().set(params);
+      context.releaseParams();
+
+      auto paf = kj::newPromiseAndFulfiller<kj::Own<MallocMessageBuilder>>();
+      auto job = new Job(Job::CALL, kj::atomicAddRef(*object));
+      job->interfaceId = interfaceId;
+      job->methodId = methodId;
+      job->params = kj::mv(paramsCopy);
+      job->fulfiller = kj::mv(paf.fulfiller);
+      pool->dispatch(job);
+
+      auto promise = paf.promise.then([context](kj::Own<MallocMessageBuilder> results) mutable {
+        auto reader = results->getRoot<AnyPointer>().asReader();
+        context.getResults(reader.targetSize()).set(reader);
+      });
+      return { kj::mv(promise), false, true };
+    }
+
+  private:
+    kj::Own<Impl> pool;
+    kj::Own<const ShardedObject> object;
+    kj::UnwindDetector unwindDetector;
+  };
+
+  kj::Array<kj::Own<Worker>> workers;
+  // Empty after shutdown().
+
+  JobQueue replies;
+  // Finished calls, coming back from the workers.
+
+  uint nextHome = 0;
+  uint nextWorker = 0;
+
+  kj::Maybe<kj::Promise<void>> replyLoop;
+
+  void dispatch(Job* job);
+  void drop(uint workerIndex, const ShardedObject& object);
+  kj::Promise<void> receiveReplies();
+  void complete(Job* job);
+};
+
+class ShardedServerPool::Impl::Worker final: private kj::TaskSet::ErrorHandler {
+public:
+  Worker(Impl& pool): pool(pool), thread([this]() { run(); }) {}
+
+  ~Worker() noexcept(false) {
+    queue.push(new Job(Job::STOP, kj::Own<const ShardedObject>()));
+    // `thread` is destroyed first and joins.
+  }
+
+  JobQueue queue;
+  // Jobs for this worker. Declared before `thread` so that it outlives it.
+
+  uint callsInFlight = 0;
+  // Maintained by the dispatching thread; the worker never touches it.
+
+private:
+  Impl& pool;
+
+  // Worker thread only:
+  kj::HashMap<const ShardedObject*, Capability::Client> instances;
+
+  kj::Thread thread;
+
+  void run() {
+    auto io = kj::setupAsyncIo();
+
+    // Capabilities must be destroyed on the thread that created them.
+    KJ_DEFER(instances.clear());
+
+    // Destroying `tasks` cancels whatever calls are still running, which sends them back to the
+    // dispatching thread to fail.
+    kj::TaskSet tasks(*this);
+
+    receiveJobs(tasks).wait(io.waitScope);
+  }
+
+  kj::Promise<void> receiveJobs(kj::TaskSet& tasks) {
+    for (;;) {
+      co_await queue.whenNonEmpty();
+
+      bool stop = false;
+      Job* job = queue.takeAll();
+      while (job != nullptr) {
+        Job* next = job->next;
+        switch (job->type) {
+          case Job::CALL:
+            tasks.add(runCall(*job));
+            break;
+          case Job::DROP:
+            instances.erase(job->object.get());
+            delete job;
+            break;
+          case Job::STOP:
+            stop = true;
+            delete job;
+            break;
+        }
+        job = next;
+      }
+
+      if (stop) co_return;
+    }
+  }
+
+  kj::Promise<void> runCall(Job& job) {
+    // Whether the call finishes or is canceled by shutdown, the job goes back to the
+    // dispatching thread.
+    return kj::evalNow([&]() { return callInstance(job); })
+        .then([&job](kj::Own<MallocMessageBuilder>&& results) {
+      job.results = kj::mv(results);
+    }, [&job](kj::Exception&& exception) {
+      job.exception = kj::mv(exception);
+    }).attach(kj::defer([this, &job]() {
+      pool.replies.push(&job);
+    }));
+  }
+
+  kj::Promise<kj::Own<MallocMessageBuilder>> callInstance(Job& job) {
+    auto& instance = instances.findOrCreate(job.object.get(),
+        [&]() -> decltype(instances)::Entry {
+      return { job.object.get(), job.object->factory() };
+    });
+
+    auto params = job.params->getRoot<AnyPointer>().asReader();
+    auto request = instance.typelessRequest(
+        job.interfaceId, job.methodId, params.targetSize(), {});
+    request.set(params);
+    job.params = nullptr;
+
+    return request.send().then([](Response<AnyPointer>&& response) {
+      AnyPointer::Reader reader = response;
+      auto size = reader.targetSize();
+      KJ_REQUIRE(size.capCount == 0,
+          "an object served by a ShardedServerPool can't return capabilities");
+      auto results = kj::heap<MallocMessageBuilder>(size.wordCount + 1);
+      results->getRoot<AnyPointer>().set(reader);
+      return results;
+    });
+  }
+
+  void taskFailed(kj::Exception&& exception) override {
+    // runCall() catches everything, so this shouldn't happen.
+    KJ_LOG(ERROR, "ShardedServerPool worker task failed", exception);
+  }
+};
+
+ShardedServerPool::Impl::Impl(uint workerCount) {
+  KJ_REQUIRE(workerCount > 0, "ShardedServerPool needs at least one worker");
+
+  auto builder = kj::heapArrayBuilder<kj::Own<Worker>>(workerCount);
+  for (auto i KJ_UNUSED: kj::zeroTo(workerCount)) {
+    builder.add(kj::heap<Worker>(*this));
+  }
+  workers = builder.finish();
+
+  replyLoop = receiveReplies().eagerlyEvaluate([](kj::Exception&& e) {
+    KJ_LOG(ERROR, "ShardedServerPool reply loop failed", e);
+  });
+}
+
+void ShardedServerPool::Impl::shutdown() {
+  // Stop and join the workers. After this nothing pushes to `replies` any more, so it's safe to
+  // stop waiting on it and fail whatever came back.
+  workers = nullptr;
+  replyLoop = kj::none;
+
+  Job* job = replies.takeAll();
+  while (job != nullptr) {
+    Job* next = job->next;
+    complete(job);
+    job = next;
+  }
+}
+
+void ShardedServerPool::Impl::dispatch(Job* job) {
+  uint index = 0;
+  switch (job->object->affinity) {
+    case Affinity::PER_OBJECT:
+      index = job->object->homeWorker;
+      break;
+    case Affinity::ROUND_ROBIN:
+      index = nextWorker++ % workers.size();
+      break;
+    case Affinity::LEAST_LOADED: {
+      // Start the search where the last one ended so that ties are spread around.
+      uint start = nextWorker++ % workers.size();
+      index = start;
+      for (auto i: kj::zeroTo(workers.size())) {
+        uint candidate = (start + i) % workers.size();
+        if (workers[candidate]->callsInFlight < workers[index]->callsInFlight) {
+          index = candidate;
+        }
+      }
+      break;
+    }
+  }
+
+  job->workerIndex = index;
+  ++workers[index]->callsInFlight;
+  workers[index]->queue.push(job);
+}
+
+void ShardedServerPool::Impl::drop(uint workerIndex, const ShardedObject& object) {
+  workers[workerIndex]->queue.push(new Job(Job::DROP, kj::atomicAddRef(object)));
+}
+
+kj::Promise<void> ShardedServerPool::Impl::receiveReplies() {
+  for (;;) {
+    co_await replies.whenNonEmpty();
+
+    Job* job = replies.takeAll();
+    while (job != nullptr) {
+      Job* next = job->next;
+      complete(job);
+      job = next;
+    }
+  }
+}
+
+void ShardedServerPool::Impl::complete(Job* job) {
+  KJ_DEFER(delete job);
+
+  if (workers != nullptr) {
+    --workers[job->workerIndex]->callsInFlight;
+  }
+
+  KJ_IF_SOME(e, job->exception) {
+    job->fulfiller->reject(kj::mv(e));
+  } else if (job->results.get() == nullptr) {
+    job->fulfiller->reject(KJ_EXCEPTION(DISCONNECTED,
+        "ShardedServerPool was destroyed while the call was running"));
+  } else {
+    job->fulfiller->fulfill(kj::mv(job->results));
+  }
+}
+
+// =======================================================================================
+
+ShardedServerPool::ShardedServerPool(uint workerCount)
+    : impl(kj::refcounted<Impl>(workerCount)) {}
+ShardedServerPool::~ShardedServerPool() noexcept(false) {
+  impl->shutdown();
+}
+
+uint ShardedServerPool::getWorkerCount() {
+  return impl->getWorkerCount();
+}
+
+Capability::Client ShardedServerPool::newClient(
+    kj::ConstFunction<Capability::Client()> factory, Affinity affinity) {
+  return impl->newClient(kj::mv(factory), affinity);
+}
+
+}  // namespace capnp
@@ -0,0 +1,101 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+#pragma once
+
+#include <capnp/capability.h>
+#include <kj/function.h>
+
+CAPNP_BEGIN_HEADER
+
+namespace capnp {
+
+class ShardedServerPool {
+  // Runs capability implementations on a pool of worker threads, each with its own event loop,
+  // and hands out capabilities that forward calls to them. An RpcSystem is bound to a single
+  // thread; wrapping its CPU-heavy objects with a ShardedServerPool lets it serve them with more
+  // than one core without running a thread per connection.
+  //
+  // Calls travel to the workers, and results travel back, through lock-free queues. A thread only
+  // takes a lock when the other side is asleep and needs to be woken, which doesn't happen while
+  // the pool is busy.
+  //
+  // Params and results are copied between threads. Capabilities cannot be passed in either
+  // direction -- such calls fail -- since a capability is bound to the thread that created it.
+  // A call canceled by its caller still runs to completion on its worker; only the result is
+  // discarded.
+  //
+  // The pool, and the capabilities it hands out, may only be used from the thread that created
+  // the pool, which must have an event loop. Capabilities that outlive the pool throw
+  // DISCONNECTED.
+
+public:
+  enum class Affinity {
+    PER_OBJECT,
+    // All calls to a capability are run by one worker, chosen round-robin when the capability is
+    // created. The worker creates one instance of the object, which may keep state between calls.
+    // Calls are delivered in the order they were made.
+
+    ROUND_ROBIN,
+    // Each call goes to the next worker in turn. Every worker that receives a call creates its
+    // own instance of the object, so the object should be stateless. Calls may complete in any
+    // order.
+
+    LEAST_LOADED
+    // Like ROUND_ROBIN, but each call goes to the worker with the fewest calls in flight.
+  };
+
+  explicit ShardedServerPool(uint workerCount);
+  // Starts `workerCount` worker threads.
+
+  ~ShardedServerPool() noexcept(false);
+  // Stops and joins the workers. Calls still in flight fail with DISCONNECTED.
+
+  KJ_DISALLOW_COPY_AND_MOVE(ShardedServerPool);
+
+  uint getWorkerCount();
+
+  Capability::Client newClient(kj::ConstFunction<Capability::Client()> factory,
+                               Affinity affinity = Affinity::PER_OBJECT);
+  // Returns a capability whose calls are run by the workers. Each worker that receives a call
+  // for it invokes `factory` -- on the worker's own thread, possibly on several workers at once,
+  // so it must be thread-safe -- and calls the capability that it returns. The workers' instances
+  // are dropped when the returned capability is.
+
+  template <typename T, typename Factory>
+  typename T::Client newClient(Factory&& factory, Affinity affinity = Affinity::PER_OBJECT) {
+    // Typed version of newClient(). `T` is the interface type and `factory()` returns a
+    // `T::Client` or anything convertible to one (such as a `kj::Own<T::Server>`).
+    return newClient(kj::ConstFunction<Capability::Client()>(
+        [factory = kj::fwd<Factory>(factory)]() -> Capability::Client {
+      return typename T::Client(factory());
+    }), affinity).template castAs<T>();
+  }
+
+private:
+  class Impl;
+  kj::Own<Impl> impl;
+};
+
+}  // namespace capnp
+
+CAPNP_END_HEADER
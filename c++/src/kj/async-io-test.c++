@@ -43,6 +43,7 @@
 #define inet_pton InetPtonA
 #define inet_ntop InetNtopA
 #else
+#include "async-unix.h"
 #include <netdb.h>
 #include <unistd.h>
 #include <fcntl.h>
@@ -3241,6 +3242,47 @@ KJ_TEST("AggregateConnectionReceiver empty") {
   KJ_EXPECT_THROW_MESSAGE("receivers.size() > 0", aggregate->getsockopt(0, 0, &value, &length));
 }
 
+#if KJ_USE_IO_URING
+KJ_TEST("OS handle canceled tryRead() with io_uring loses no data") {
+  // With IoUringOptions::streamIo, the kernel reads into a buffer on the stream's behalf. If the
+  // read is canceled after the kernel has done so, the data must go to whatever reads next,
+  // including a pump.
+  UnixEventPort::IoUringOptions options;
+  options.streamIo = true;
+  UnixEventPort port(options);
+  EventLoop loop(port);
+  WaitScope ws(loop);
+  auto lowLevel = newLowLevelAsyncIoProvider(port);
+  auto provider = newAsyncIoProvider(*lowLevel);
+
+  auto pipe1 = provider->newTwoWayPipe();
+  auto pipe2 = provider->newTwoWayPipe();
+  int fd = KJ_ASSERT_NONNULL(pipe1.ends[0]->getFd());
+
+  char buffer[16]{};
+  {
+    auto promise = pipe1.ends[1]->tryRead(buffer, 1, sizeof(buffer));
+    KJ_EXPECT(!promise.poll(ws));
+
+    // Write directly, so that the event loop doesn't run before the read is canceled.
+    KJ_SYSCALL(::write(fd, "foo", 3));
+  }
+  KJ_SYSCALL(::write(fd, "bar", 3));
+
+  auto pump = pipe1.ends[1]->pumpTo(*pipe2.ends[0], 6);
+  expectRead(*pipe2.ends[1], "foobar").wait(ws);
+  KJ_EXPECT(pump.wait(ws) == 6);
+
+  {
+    auto promise = pipe1.ends[1]->tryRead(buffer, 1, sizeof(buffer));
+    KJ_EXPECT(!promise.poll(ws));
+    KJ_SYSCALL(::write(fd, "baz", 3));
+  }
+  KJ_SYSCALL(::write(fd, "qux", 3));
+  expectRead(*pipe1.ends[1], "bazqux").wait(ws);
+}
+#endif
+
 // =======================================================================================
 // Tests for optimized pumpTo() between OS handles. Note that this is only even optimized on
 // some OSes (only Linux as of this writing), but the behavior should still be the same on all
@@ -182,6 +182,12 @@ public:
   }
 
   Promise<void> write(ArrayPtr<const byte> buffer) override {
+#if KJ_USE_IO_URING
+    if (observer.hasPendingWrite()) {
+      return ringWrite(buffer, nullptr);
+    }
+#endif
+
     ssize_t n;
     KJ_NONBLOCKING_SYSCALL(n = ::write(fd, buffer.begin(), buffer.size())) {
       // Error.
@@ -198,6 +204,12 @@ public:
     }
 
     if (n < 0) {
+#if KJ_USE_IO_URING
+      if (observer.prefersRingIo()) {
+        // EAGAIN -- have the event port write it once there's room.
+        return ringWrite(buffer, nullptr);
+      }
+#endif
       // EAGAIN -- need to wait for writability and try again.
       return observer.whenBecomesWritable().then([buffer, this]() {
         return write(buffer);
@@ -241,6 +253,13 @@ public:
 
   Maybe<Promise<uint64_t>> tryPumpFrom(
       AsyncInputStream& input, uint64_t amount = kj::maxValue) override {
+#if KJ_USE_IO_URING
+    if (observer.hasPendingWrite()) {
+      // A canceled write is still in flight, and splice() or sendfile() would overtake it.
+      return kj::none;
+    }
+#endif
+
 #if __linux__ && !__ANDROID__
     KJ_IF_SOME(sock, kj::dynamicDowncastIfAvailable<AsyncStreamFd>(input)) {
       return pumpFromOther(sock, amount);
@@ -312,6 +331,13 @@ private:
   Maybe<Promise<uint64_t>> pumpFromOther(AsyncStreamFd& input, uint64_t amount) {
     // The input is another AsyncStreamFd, so perhaps we can do an optimized pump with splice().
 
+#if KJ_USE_IO_URING
+    if (input.observer.hasPendingRead()) {
+      // A canceled read left data that must come first, which only input.tryRead() can see.
+      return kj::none;
+    }
+#endif
+
     // Before we resort to a bunch of syscalls, let's try to see if the pump is small and able to
     // be fully satisfied immediately. This optimizes for the case of small streams, e.g. a short
     // HTTP body.
@@ -562,6 +588,13 @@ private:
     // maxBytes, and buffer have already been adjusted to account for them, but this count must
     // be included in the final return value.
 
+#if KJ_USE_IO_URING
+    if (observer.hasPendingRead()) {
+      // A canceled read is still in flight or left data behind, which has to come first.
+      return ringRead(buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead);
+    }
+#endif
+
     ssize_t n;
     if (maxFds == 0 && ancillaryMsgCallback == kj::none) {
       KJ_NONBLOCKING_SYSCALL(n = ::read(fd, buffer, maxBytes)) {
@@ -713,6 +746,11 @@ private:
 
     if (n < 0) {
       // Read would block.
+#if KJ_USE_IO_URING
+      if (maxFds == 0 && ancillaryMsgCallback == kj::none && observer.prefersRingIo()) {
+        return ringRead(buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead);
+      }
+#endif
       return observer.whenBecomesReadable().then(
           [this, buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead]() {
               return tryReadInternal(buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead);
@@ -746,6 +784,48 @@ private:
     }
   }
 
+#if KJ_USE_IO_URING
+  Promise<ReadResult> ringRead(void* buffer, size_t minBytes, size_t maxBytes,
+                               OwnFd* fdBuffer, size_t maxFds, ReadResult alreadyRead) {
+    // Have the event port read for us, rather than wait for readability and then read.
+
+    return observer.read(kj::arrayPtr(reinterpret_cast<byte*>(buffer), maxBytes)).then(
+        [this, buffer, minBytes, maxBytes, fdBuffer, maxFds, alreadyRead](size_t n) mutable
+        -> Promise<ReadResult> {
+      alreadyRead.byteCount += n;
+      if (n == 0 || n >= minBytes) {
+        // EOF, or we read enough to stop here.
+        return alreadyRead;
+      } else {
+        return tryReadInternal(reinterpret_cast<byte*>(buffer) + n, minBytes - n, maxBytes - n,
+                               fdBuffer, maxFds, alreadyRead);
+      }
+    });
+  }
+
+  Promise<void> ringWrite(ArrayPtr<const byte> firstPiece,
+                          ArrayPtr<const ArrayPtr<const byte>> morePieces) {
+    // Have the event port write for us, rather than wait for writability and then write. It
+    // copies what it will write before returning, so `pieces` can live on the stack.
+
+    KJ_STACK_ARRAY(ArrayPtr<const byte>, pieces, 1 + morePieces.size(), 16, 128);
+    pieces[0] = firstPiece;
+    for (auto i: kj::indices(morePieces)) {
+      pieces[i + 1] = morePieces[i];
+    }
+
+    return observer.write(pieces).then([this, firstPiece, morePieces](size_t n) mutable {
+      // Discard what was written, then carry on as if write() had been short.
+      while (n > firstPiece.size()) {
+        n -= firstPiece.size();
+        firstPiece = morePieces[0];
+        morePieces = morePieces.slice(1, morePieces.size());
+      }
+      return writeInternal(firstPiece.slice(n, firstPiece.size()), morePieces, nullptr);
+    });
+  }
+#endif
+
   Promise<void> writeInternal(ArrayPtr<const byte> firstPiece,
                               ArrayPtr<const ArrayPtr<const byte>> morePieces,
                               ArrayPtr<const int> fds) {
@@ -770,6 +850,12 @@ private:
       return kj::READY_NOW;
     }
 
+#if KJ_USE_IO_URING
+    if (fds.size() == 0 && observer.hasPendingWrite()) {
+      return ringWrite(firstPiece, morePieces);
+    }
+#endif
+
     ssize_t n;
     if (fds.size() == 0) {
       KJ_NONBLOCKING_SYSCALL(n = ::writev(fd, iov.begin(), iov.size()), iovTotal, iov.size()) {
@@ -826,6 +912,11 @@ private:
 
     if (n < 0) {
       // Got EAGAIN. Nothing was written.
+#if KJ_USE_IO_URING
+      if (fds.size() == 0 && observer.prefersRingIo()) {
+        return ringWrite(firstPiece, morePieces);
+      }
+#endif
       return observer.whenBecomesWritable().then([firstPiece, morePieces, fds, this]() {
         return writeInternal(firstPiece, morePieces, fds);
       });
@@ -1438,6 +1529,10 @@ public:
     *length = socklen;
   }
 
+  kj::Maybe<int> getFd() const override {
+    return fd;
+  }
+
 public:
   LowLevelAsyncIoProvider& lowLevel;
   UnixEventPort& eventPort;
@@ -2046,17 +2141,22 @@ Own<LowLevelAsyncIoProvider> newLowLevelAsyncIoProvider(UnixEventPort& eventPort
 }
 
 AsyncIoContext setupAsyncIo(kj::Maybe<EventLoopObserver&> observer) {
+  return setupAsyncIo(TimerImpl::Queue::ORDERED, observer);
+}
+
+AsyncIoContext setupAsyncIo(TimerImpl::Queue timerQueue, kj::Maybe<EventLoopObserver&> observer) {
   struct BasicContext {
     UnixEventPort eventPort;
     EventLoop eventLoop;
     WaitScope waitScope;
 
-    BasicContext(kj::Maybe<EventLoopObserver&> observer)
-      : eventLoop(eventPort, observer),
+    BasicContext(TimerImpl::Queue timerQueue, kj::Maybe<EventLoopObserver&> observer)
+      : eventPort(UnixEventPort::Options { timerQueue }),
+        eventLoop(eventPort, observer),
         waitScope(eventLoop) {}
   };
 
-  auto basicContext = heap<BasicContext>(observer);
+  auto basicContext = heap<BasicContext>(timerQueue, observer);
   auto lowLevel = heap<LowLevelAsyncIoProviderImpl>(basicContext->eventPort);
   auto ioProvider = kj::heap<AsyncIoProviderImpl>(*lowLevel);
   auto& waitScope = basicContext->waitScope;
@@ -493,6 +493,10 @@ public:
   virtual void setsockopt(int level, int option, const void* value, uint length);
   virtual void getsockname(struct sockaddr* addr, uint* length);
   // Same as the methods of AsyncIoStream.
+
+  virtual kj::Maybe<int> getFd() const { return kj::none; }
+  // Get the underlying Unix file descriptor of the listen socket, if any. Returns kj::none if this
+  // object actually isn't wrapping a file descriptor.
 };
 
 Own<ConnectionReceiver> newAggregateConnectionReceiver(Array<Own<ConnectionReceiver>> receivers);
@@ -1006,6 +1010,13 @@ AsyncIoContext setupAsyncIo(kj::Maybe<EventLoopObserver&> observer = kj::none);
 //   note that this means that server processes which daemonize themselves at startup must wait
 //   until after daemonization to create an AsyncIoContext.
 
+#if !_WIN32
+AsyncIoContext setupAsyncIo(TimerImpl::Queue timerQueue,
+                            kj::Maybe<EventLoopObserver&> observer = kj::none);
+// Like setupAsyncIo(), but chooses the data structure behind the provider's Timer. See
+// TimerImpl::Queue.
+#endif
+
 // =======================================================================================
 // Convenience adapters.
 
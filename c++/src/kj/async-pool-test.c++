@@ -0,0 +1,239 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#if _WIN32
+#include "win32-api-version.h"
+#endif
+
+#include "async-pool.h"
+#include "debug.h"
+#include "mutex.h"
+#include "vector.h"
+#include <kj/test.h>
+#include <algorithm>
+
+#if _WIN32
+#include <windows.h>
+#include "windows-sanity.h"
+inline void delay() { Sleep(1); }
+#else
+#include <sys/socket.h>
+#include <unistd.h>
+inline void delay() { usleep(1000); }
+#endif
+
+namespace kj {
+namespace {
+
+KJ_TEST("EventLoopPool runs a function on each loop") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(4);
+  KJ_EXPECT(pool.size() == 4);
+
+  const Executor* mainExecutor = &getCurrentThreadExecutor();
+  MutexGuarded<Vector<uint>> seen;
+  MutexGuarded<Vector<const Executor*>> executors;
+
+  pool.runOnEach([&](EventLoopPool::Loop& loop) -> Promise<void> {
+    seen.lockExclusive()->add(loop.index);
+    executors.lockExclusive()->add(&getCurrentThreadExecutor());
+
+    // The loop's own I/O works.
+    return loop.provider.getTimer().afterDelay(1 * MILLISECONDS);
+  }).wait(io.waitScope);
+
+  auto indices = seen.lockExclusive();
+  std::sort(indices->begin(), indices->end());
+  KJ_EXPECT(*indices == kj::arr(0u, 1u, 2u, 3u));
+
+  auto lockedExecutors = executors.lockExclusive();
+  for (auto i: kj::indices(*lockedExecutors)) {
+    KJ_EXPECT((*lockedExecutors)[i] != mainExecutor);
+    for (auto j: kj::zeroTo(i)) {
+      KJ_EXPECT((*lockedExecutors)[i] != (*lockedExecutors)[j]);
+    }
+  }
+}
+
+KJ_TEST("EventLoopPool runOnEach() propagates exceptions") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(2);
+
+  KJ_EXPECT_THROW_MESSAGE("loop failed", pool.runOnEach([](EventLoopPool::Loop& loop) {
+    if (loop.index == 1) {
+      KJ_FAIL_ASSERT("loop failed");
+    }
+    return NEVER_DONE;
+  }).wait(io.waitScope));
+}
+
+KJ_TEST("EventLoopPool evalLater() returns results across threads") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(2);
+
+  KJ_EXPECT(pool.evalLater([]() { return 123; }).wait(io.waitScope) == 123);
+
+  auto str = pool.evalLater([]() -> Promise<String> {
+    co_await yield();
+    co_return kj::str("foo");
+  }).wait(io.waitScope);
+  KJ_EXPECT(str == "foo");
+
+  pool.evalLater([]() {}).wait(io.waitScope);
+
+  KJ_EXPECT_THROW_MESSAGE("task failed", pool.evalLater([]() -> int {
+    KJ_FAIL_ASSERT("task failed");
+  }).wait(io.waitScope));
+}
+
+KJ_TEST("EventLoopPool idle loops steal tasks") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(4);
+
+  constexpr uint TASK_COUNT = 200;
+  MutexGuarded<Vector<const Executor*>> ranOn;
+
+  // Queue all the tasks from loop 0, so that they all land in its queue.
+  pool.runOnEach([&](EventLoopPool::Loop& loop) -> Promise<void> {
+    if (loop.index != 0) return READY_NOW;
+
+    auto promises = heapArrayBuilder<Promise<void>>(TASK_COUNT);
+    for (auto i KJ_UNUSED: kj::zeroTo(TASK_COUNT)) {
+      promises.add(pool.evalLater([&]() {
+        ranOn.lockExclusive()->add(&getCurrentThreadExecutor());
+        delay();
+      }));
+    }
+    return joinPromisesFailFast(promises.finish());
+  }).wait(io.waitScope);
+
+  auto executors = ranOn.lockExclusive();
+  KJ_EXPECT(executors->size() == TASK_COUNT);
+  KJ_EXPECT(std::count(executors->begin(), executors->end(), (*executors)[0]) < TASK_COUNT,
+            "all tasks ran on one loop");
+
+  uint64_t run = 0;
+  uint64_t stolen = 0;
+  for (auto i: kj::zeroTo(pool.size())) {
+    auto stats = pool.getLoopStats(i);
+    run += stats.tasksRun;
+    stolen += stats.tasksStolen;
+    KJ_EXPECT(stats.tasksQueued == 0);
+  }
+  KJ_EXPECT(run == TASK_COUNT);
+  KJ_EXPECT(stolen > 0);
+  KJ_EXPECT(pool.getLoopStats(0).tasksStolen == 0);
+}
+
+#if !_WIN32
+KJ_TEST("EventLoopPool shares a listen socket among loops") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(4);
+
+  auto addr = io.provider->getNetwork().parseAddress("127.0.0.1", 0).wait(io.waitScope);
+  auto listener = addr->listen();
+
+  // Every loop's socket must be listening before we connect, or the early connections all land
+  // on the loops that got there first.
+  MutexGuarded<uint> loopsListening(0);
+
+  EventLoopPool::ListenOptions options;
+  options.reusePort = true;
+  auto serving = pool.listen(*listener, options,
+      [&loopsListening](EventLoopPool::Loop& loop, ConnectionReceiver& receiver)
+          -> Promise<void> {
+    ++*loopsListening.lockExclusive();
+    for (;;) {
+      auto stream = co_await receiver.accept();
+      byte index = loop.index;
+      co_await stream->write(arrayPtr(&index, 1));
+    }
+  }).eagerlyEvaluate(nullptr);
+
+  loopsListening.when([&](uint n) { return n == pool.size(); }, [](uint) {});
+
+  constexpr uint CONNECTION_COUNT = 32;
+  auto connectAddr = io.provider->getNetwork()
+      .parseAddress("127.0.0.1", listener->getPort()).wait(io.waitScope);
+  for (auto i KJ_UNUSED: kj::zeroTo(CONNECTION_COUNT)) {
+    auto stream = connectAddr->connect().wait(io.waitScope);
+    byte index;
+    stream->read(arrayPtr(&index, 1), 1).wait(io.waitScope);
+    KJ_EXPECT(index < pool.size());
+  }
+
+  uint64_t accepted = 0;
+  uint loopsAccepting = 0;
+  for (auto i: kj::zeroTo(pool.size())) {
+    auto count = pool.getLoopStats(i).connectionsAccepted;
+    accepted += count;
+    if (count > 0) ++loopsAccepting;
+  }
+  KJ_EXPECT(accepted == CONNECTION_COUNT);
+
+#if __linux__
+  // Each loop has its own SO_REUSEPORT socket, and the kernel spreads connections across them
+  // by hash, so it's vanishingly unlikely that they all land on one loop.
+  KJ_EXPECT(loopsAccepting > 1, loopsAccepting);
+#else
+  (void)loopsAccepting;
+#endif
+}
+
+#if __linux__
+KJ_TEST("EventLoopPool::listen() leaves SO_REUSEPORT alone by default") {
+  auto io = setupAsyncIo();
+  EventLoopPool pool(2);
+
+  auto addr = io.provider->getNetwork().parseAddress("127.0.0.1", 0).wait(io.waitScope);
+  auto listener = addr->listen();
+
+  MutexGuarded<uint> loopsListening(0);
+  auto serving = pool.listen(*listener,
+      [&loopsListening](EventLoopPool::Loop&, ConnectionReceiver& receiver) -> Promise<void> {
+    ++*loopsListening.lockExclusive();
+    return receiver.accept().ignoreResult();
+  }).eagerlyEvaluate(nullptr);
+  loopsListening.when([&](uint n) { return n == pool.size(); }, [](uint) {});
+
+  int value = 1;
+  socklen_t length = sizeof(value);
+  KJ_SYSCALL(getsockopt(KJ_ASSERT_NONNULL(listener->getFd()), SOL_SOCKET, SO_REUSEPORT,
+                        &value, &length));
+  KJ_EXPECT(value == 0);
+
+  // Another socket can't take over the port.
+  int fd;
+  KJ_SYSCALL(fd = socket(AF_INET, SOCK_STREAM, 0));
+  KJ_DEFER(close(fd));
+  value = 1;
+  KJ_SYSCALL(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &value, sizeof(value)));
+  struct sockaddr_storage sockaddr;
+  length = sizeof(sockaddr);
+  KJ_SYSCALL(getsockname(KJ_ASSERT_NONNULL(listener->getFd()),
+                         reinterpret_cast<struct sockaddr*>(&sockaddr), &length));
+  KJ_EXPECT(bind(fd, reinterpret_cast<struct sockaddr*>(&sockaddr), length) < 0);
+}
+#endif
+#endif
+
+}  // namespace
+}  // namespace kj
@@ -0,0 +1,574 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "async-pool.h"
+#include "debug.h"
+#include "io.h"
+#include "list.h"
+#include "mutex.h"
+#include "thread.h"
+
+#if !_WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#endif
+
+namespace kj {
+
+namespace {
+
+struct PoolTask {
+  // Work queued by EventLoopPool::evalLater(). Allocated with `new`, and owned by the queue it's
+  // in until a loop takes it.
+
+  explicit PoolTask(Function<Promise<void>()> func): func(kj::mv(func)) {}
+
+  Function<Promise<void>()> func;
+  ListLink<PoolTask> link;
+};
+
+using PoolTaskList = List<PoolTask, &PoolTask::link>;
+
+#if __linux__
+bool enableReusePort(int fd) {
+  // Sets SO_REUSEPORT on the TCP listen socket `fd`, so that sockets opened by
+  // openReusePortSocket() can join it. Returns false if `fd` isn't a TCP socket.
+
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  KJ_SYSCALL(getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addrlen));
+  if (addr.ss_family != AF_INET && addr.ss_family != AF_INET6) return false;
+
+  int optval = 1;
+  return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) == 0;
+}
+
+Maybe<OwnFd> openReusePortSocket(int fd) {
+  // Opens a new listen socket bound to the same address as `fd`, which must have been passed to
+  // enableReusePort(). The kernel spreads incoming connections across all sockets bound this way,
+  // each with its own accept queue. Returns none if the kernel won't let the new socket join.
+
+  struct sockaddr_storage addr;
+  socklen_t addrlen = sizeof(addr);
+  KJ_SYSCALL(getsockname(fd, reinterpret_cast<struct sockaddr*>(&addr), &addrlen));
+
+  int newFd;
+  KJ_SYSCALL(newFd = socket(addr.ss_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+  OwnFd result(newFd);
+
+  int optval = 1;
+  KJ_SYSCALL(setsockopt(newFd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval)));
+  KJ_SYSCALL(setsockopt(newFd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)));
+  if (addr.ss_family == AF_INET6) {
+    // Match the original socket, which may also be accepting IPv4 connections.
+    socklen_t optlen = sizeof(optval);
+    KJ_SYSCALL(getsockopt(fd, IPPROTO_IPV6, IPV6_V6ONLY, &optval, &optlen));
+    KJ_SYSCALL(setsockopt(newFd, IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval)));
+  }
+
+  KJ_SYSCALL_HANDLE_ERRORS(bind(newFd, reinterpret_cast<struct sockaddr*>(&addr), addrlen)) {
+    case EADDRINUSE:
+      // The original socket was bound by another user, or with options that rule out sharing.
+      return kj::none;
+    default:
+      KJ_FAIL_SYSCALL("bind()", error);
+  }
+  KJ_SYSCALL(::listen(newFd, SOMAXCONN));
+  return kj::mv(result);
+}
+#elif !_WIN32
+bool enableReusePort(int) {
+  // Elsewhere, SO_REUSEPORT doesn't spread connections across the sockets that share a port (or
+  // is spelled differently, like FreeBSD's SO_REUSEPORT_LB), so the loops share one socket.
+  return false;
+}
+
+Maybe<OwnFd> openReusePortSocket(int) {
+  KJ_UNREACHABLE;
+}
+#endif
+
+class CountingConnectionReceiver final: public ConnectionReceiver {
+  // Wraps a loop's ConnectionReceiver to count the connections it accepts.
+
+public:
+  CountingConnectionReceiver(Own<ConnectionReceiver> inner, uint64_t& counter)
+      : inner(kj::mv(inner)), counter(counter) {}
+
+  Promise<Own<AsyncIoStream>> accept() override {
+    return inner->accept().then([this](Own<AsyncIoStream>&& stream) {
+      __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+      return kj::mv(stream);
+    });
+  }
+
+  Promise<AuthenticatedStream> acceptAuthenticated() override {
+    return inner->acceptAuthenticated().then([this](AuthenticatedStream&& stream) {
+      __atomic_add_fetch(&counter, 1, __ATOMIC_RELAXED);
+      return kj::mv(stream);
+    });
+  }
+
+  uint getPort() override {
+    return inner->getPort();
+  }
+  void getsockopt(int level, int option, void* value, uint* length) override {
+    inner->getsockopt(level, option, value, length);
+  }
+  void setsockopt(int level, int option, const void* value, uint length) override {
+    inner->setsockopt(level, option, value, length);
+  }
+  void getsockname(struct sockaddr* addr, uint* length) override {
+    inner->getsockname(addr, length);
+  }
+  Maybe<int> getFd() const override {
+    return inner->getFd();
+  }
+
+private:
+  Own<ConnectionReceiver> inner;
+  uint64_t& counter;
+};
+
+}  // namespace
+
+// =======================================================================================
+
+class EventLoopPool::Impl {
+public:
+  explicit Impl(uint threadCount);
+  ~Impl() noexcept(false);
+
+  class Worker;
+  Array<Own<Worker>> workers;
+
+  void submit(PoolTask& task) const;
+
+  Maybe<PoolTask&> take(uint index) const;
+  // Take the next task for loop `index`: from its own queue if possible, otherwise stolen from
+  // another loop's.
+
+  bool anyQueued() const;
+
+private:
+  mutable uint nextLoop = 0;
+  // Round-robin counter for tasks submitted from outside the pool. Atomic.
+
+  mutable uint idleCount = 0;
+  // Number of loops waiting for tasks. Atomic.
+
+  static thread_local const Impl* current;
+  static thread_local uint currentIndex;
+  // The pool and loop running on this thread, if any.
+
+  void wakeIdle(uint except) const;
+};
+
+thread_local const EventLoopPool::Impl* EventLoopPool::Impl::current = nullptr;
+thread_local uint EventLoopPool::Impl::currentIndex = 0;
+
+class EventLoopPool::Impl::Worker final: private TaskSet::ErrorHandler {
+public:
+  Worker(Impl& pool, uint index): pool(pool), index(index) {
+    thread.emplace([this]() { run(); });
+  }
+
+  KJ_DISALLOW_COPY_AND_MOVE(Worker);
+
+  void waitUntilReady() {
+    auto lock = state.lockExclusive();
+    lock.wait([](const State& s) { return s.executor != kj::none || s.exited; });
+    KJ_IF_SOME(e, lock->executor) {
+      executor = kj::mv(e);
+    } else {
+      KJ_FAIL_REQUIRE("EventLoopPool thread failed to start");
+    }
+  }
+
+  void start() {
+    state.lockExclusive()->started = true;
+  }
+
+  void stop() {
+    Maybe<Own<CrossThreadPromiseFulfiller<void>>> fulfiller;
+    {
+      auto lock = state.lockExclusive();
+      lock->stopped = true;
+      fulfiller = kj::mv(lock->stop);
+    }
+    KJ_IF_SOME(f, fulfiller) {
+      f->fulfill();
+    }
+  }
+
+  void join() {
+    thread = kj::none;
+  }
+
+  const Executor& getExecutor() const {
+    // Only valid after waitUntilReady().
+    return *executor;
+  }
+
+  Loop& getLoop() const {
+    // Only called on the loop's own thread.
+    return KJ_ASSERT_NONNULL(loop);
+  }
+
+  bool push(PoolTask& task) const;
+  // Queue `task`, and wake the loop if it's idle. Returns true if it was.
+
+  Maybe<PoolTask&> pop() const;
+
+  bool isQueued() const {
+    return __atomic_load_n(&queued, __ATOMIC_SEQ_CST) > 0;
+  }
+
+  bool wakeIfIdle() const;
+
+  void dropQueued();
+  // Delete all queued tasks, rejecting the promises their submitters hold. Only called after all
+  // loops have exited.
+
+  LoopStats getStats() const;
+
+  mutable uint64_t tasksStolen = 0;
+  mutable uint64_t connectionsAccepted = 0;
+  // Atomic.
+
+private:
+  Impl& pool;
+  uint index;
+
+  struct State {
+    PoolTaskList queue;
+
+    Maybe<Own<CrossThreadPromiseFulfiller<void>>> wake;
+    // Set while the loop is waiting for tasks.
+
+    Maybe<Own<const Executor>> executor;
+    Maybe<Own<CrossThreadPromiseFulfiller<void>>> stop;
+    // Set by the loop once it's ready to run.
+
+    bool started = false;
+    bool stopped = false;
+    bool exited = false;
+  };
+  MutexGuarded<State> state;
+
+  mutable uint queued = 0;
+  mutable uint64_t tasksRun = 0;
+  // Atomic.
+
+  Own<const Executor> executor;
+
+  Maybe<Loop&> loop;
+  // Loop thread only.
+
+  Maybe<Thread> thread;
+
+  void run();
+  Promise<void> runTasks(TaskSet& tasks);
+  Promise<void> sleep();
+
+  void taskFailed(Exception&& exception) override {
+    // Tasks deliver their exceptions to whoever submitted them, so this shouldn't happen.
+    KJ_LOG(ERROR, "EventLoopPool task failed", exception);
+  }
+};
+
+void EventLoopPool::Impl::Worker::run() {
+  KJ_DEFER(state.lockExclusive()->exited = true);
+
+  auto io = setupAsyncIo();
+  Loop loopInfo { index, *io.provider, *io.lowLevelProvider };
+  loop = loopInfo;
+  current = &pool;
+  currentIndex = index;
+
+  auto stopPaf = newPromiseAndCrossThreadFulfiller<void>();
+  {
+    auto lock = state.lockExclusive();
+    lock->executor = getCurrentThreadExecutor().addRef();
+    lock->stop = kj::mv(stopPaf.fulfiller);
+
+    // Don't look at other loops' queues until the pool has finished starting all of them.
+    lock.wait([](const State& s) { return s.started || s.stopped; });
+    if (lock->stopped) return;
+  }
+
+  TaskSet tasks(*this);
+  stopPaf.promise.exclusiveJoin(runTasks(tasks)).wait(io.waitScope);
+}
+
+Promise<void> EventLoopPool::Impl::Worker::runTasks(TaskSet& tasks) {
+  for (;;) {
+    KJ_IF_SOME(task, pool.take(index)) {
+      __atomic_add_fetch(&tasksRun, 1, __ATOMIC_RELAXED);
+      KJ_DEFER(delete &task);
+      tasks.add(task.func());
+    } else {
+      co_await sleep();
+      continue;
+    }
+
+    // Let the loop's own events run before the next task.
+    co_await kj::yield();
+  }
+}
+
+Promise<void> EventLoopPool::Impl::Worker::sleep() {
+  auto paf = newPromiseAndCrossThreadFulfiller<void>();
+  {
+    auto lock = state.lockExclusive();
+    if (!lock->queue.empty()) co_return;
+    lock->wake = kj::mv(paf.fulfiller);
+  }
+
+  __atomic_add_fetch(&pool.idleCount, 1, __ATOMIC_SEQ_CST);
+  KJ_DEFER({
+    __atomic_sub_fetch(&pool.idleCount, 1, __ATOMIC_SEQ_CST);
+    state.lockExclusive()->wake = kj::none;
+  });
+
+  // A task may have been queued on another loop after take() looked there but before we counted
+  // ourselves as idle, in which case its submitter didn't see us to wake us.
+  if (pool.anyQueued()) co_return;
+
+  co_await paf.promise;
+}
+
+bool EventLoopPool::Impl::Worker::push(PoolTask& task) const {
+  Maybe<Own<CrossThreadPromiseFulfiller<void>>> wakeFulfiller;
+  {
+    auto lock = state.lockExclusive();
+    lock->queue.add(task);
+    __atomic_add_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+    wakeFulfiller = kj::mv(lock->wake);
+  }
+
+  KJ_IF_SOME(f, wakeFulfiller) {
+    f->fulfill();
+    return true;
+  }
+  return false;
+}
+
+Maybe<PoolTask&> EventLoopPool::Impl::Worker::pop() const {
+  // Check without locking first, since idle loops looking for work to steal call this a lot.
+  if (!isQueued()) return kj::none;
+
+  auto lock = state.lockExclusive();
+  if (lock->queue.empty()) return kj::none;
+  auto& task = lock->queue.front();
+  lock->queue.remove(task);
+  __atomic_sub_fetch(&queued, 1, __ATOMIC_SEQ_CST);
+  return task;
+}
+
+bool EventLoopPool::Impl::Worker::wakeIfIdle() const {
+  Maybe<Own<CrossThreadPromiseFulfiller<void>>> wakeFulfiller = kj::mv(state.lockExclusive()->wake);
+  KJ_IF_SOME(f, wakeFulfiller) {
+    f->fulfill();
+    return true;
+  }
+  return false;
+}
+
+void EventLoopPool::Impl::Worker::dropQueued() {
+  auto lock = state.lockExclusive();
+  while (!lock->queue.empty()) {
+    auto& task = lock->queue.front();
+    lock->queue.remove(task);
+    delete &task;
+  }
+  __atomic_store_n(&queued, 0, __ATOMIC_SEQ_CST);
+}
+
+EventLoopPool::LoopStats EventLoopPool::Impl::Worker::getStats() const {
+  LoopStats result;
+  result.tasksRun = __atomic_load_n(&tasksRun, __ATOMIC_RELAXED);
+  result.tasksStolen = __atomic_load_n(&tasksStolen, __ATOMIC_RELAXED);
+  result.tasksQueued = __atomic_load_n(&queued, __ATOMIC_RELAXED);
+  result.connectionsAccepted = __atomic_load_n(&connectionsAccepted, __ATOMIC_RELAXED);
+#if !__APPLE__
+  result.cpuTime = KJ_ASSERT_NONNULL(thread).getCpuTime();
+#endif
+  return result;
+}
+
+// -------------------------------------------------------------------
+
+EventLoopPool::Impl::Impl(uint threadCount) {
+  KJ_REQUIRE(threadCount > 0, "EventLoopPool needs at least one thread");
+
+  auto builder = heapArrayBuilder<Own<Worker>>(threadCount);
+  KJ_ON_SCOPE_FAILURE({
+    for (auto& worker: builder) worker->stop();
+  });
+  for (auto i: kj::zeroTo(threadCount)) {
+    builder.add(heap<Worker>(*this, i));
+  }
+  for (auto& worker: builder) {
+    worker->waitUntilReady();
+  }
+  workers = builder.finish();
+
+  for (auto& worker: workers) {
+    worker->start();
+  }
+}
+
+EventLoopPool::Impl::~Impl() noexcept(false) {
+  // Every loop must have exited before any of them is destroyed, since they steal from each
+  // other's queues.
+  for (auto& worker: workers) {
+    worker->stop();
+  }
+  for (auto& worker: workers) {
+    worker->join();
+  }
+  for (auto& worker: workers) {
+    worker->dropQueued();
+  }
+}
+
+void EventLoopPool::Impl::submit(PoolTask& task) const {
+  uint target;
+  if (current == this) {
+    // Keep work on the loop that created it, where its data is likely still in cache. Idle loops
+    // will steal it if this one is too busy.
+    target = currentIndex;
+  } else {
+    target = __atomic_fetch_add(&nextLoop, 1, __ATOMIC_RELAXED) % workers.size();
+  }
+
+  if (!workers[target]->push(task) && __atomic_load_n(&idleCount, __ATOMIC_SEQ_CST) > 0) {
+    wakeIdle(target);
+  }
+}
+
+Maybe<PoolTask&> EventLoopPool::Impl::take(uint index) const {
+  KJ_IF_SOME(task, workers[index]->pop()) {
+    return task;
+  }
+
+  for (auto i: kj::range(1u, workers.size())) {
+    KJ_IF_SOME(task, workers[(index + i) % workers.size()]->pop()) {
+      __atomic_add_fetch(&workers[index]->tasksStolen, 1, __ATOMIC_RELAXED);
+      return task;
+    }
+  }
+
+  return kj::none;
+}
+
+bool EventLoopPool::Impl::anyQueued() const {
+  for (auto& worker: workers) {
+    if (worker->isQueued()) return true;
+  }
+  return false;
+}
+
+void EventLoopPool::Impl::wakeIdle(uint except) const {
+  // Wake one idle loop so that it can steal the task just queued on the busy loop `except`.
+  for (auto i: kj::range(1u, workers.size())) {
+    if (workers[(except + i) % workers.size()]->wakeIfIdle()) return;
+  }
+}
+
+// =======================================================================================
+
+EventLoopPool::EventLoopPool(uint threadCount): impl(heap<Impl>(threadCount)) {}
+EventLoopPool::~EventLoopPool() noexcept(false) {}
+
+uint EventLoopPool::size() const {
+  return impl->workers.size();
+}
+
+Promise<void> EventLoopPool::runOnEach(ConstFunction<Promise<void>(Loop&)> func) const {
+  auto ownFunc = heap(kj::mv(func));
+  auto& f = *ownFunc;
+
+  auto promises = KJ_MAP(worker, impl->workers) {
+    auto& w = *worker;
+    return w.getExecutor().executeAsync([&f, &w]() { return f(w.getLoop()); });
+  };
+
+  return joinPromisesFailFast(kj::mv(promises)).attach(kj::mv(ownFunc));
+}
+
+Promise<void> EventLoopPool::listen(
+    ConnectionReceiver& receiver,
+    ConstFunction<Promise<void>(Loop&, ConnectionReceiver&)> func) const {
+  return listen(receiver, ListenOptions(), kj::mv(func));
+}
+
+Promise<void> EventLoopPool::listen(
+    ConnectionReceiver& receiver, ListenOptions options,
+    ConstFunction<Promise<void>(Loop&, ConnectionReceiver&)> func) const {
+#if _WIN32
+  KJ_UNIMPLEMENTED("EventLoopPool::listen() is not supported on Windows");
+#else
+  int fd = KJ_REQUIRE_NONNULL(receiver.getFd(),
+      "EventLoopPool::listen() needs a ConnectionReceiver that wraps a socket");
+
+  // Loops that merely share `fd` are all woken for every incoming connection, only for one of
+  // them to win the accept(). If asked to, and the kernel supports it, give every loop but the
+  // first a listen socket of its own in the same SO_REUSEPORT group, so that each connection wakes
+  // only the loop whose socket it was queued on. The first loop keeps serving `fd` itself, which
+  // remains part of the group.
+  bool reusePort = options.reusePort && enableReusePort(fd);
+
+  return runOnEach([&impl = *impl, fd, reusePort, func = kj::mv(func)](Loop& loop) {
+    OwnFd ownFd;
+    if (reusePort && loop.index > 0) {
+      KJ_IF_SOME(socket, openReusePortSocket(fd)) {
+        ownFd = kj::mv(socket);
+      }
+    }
+    if (ownFd == nullptr) {
+      int newFd;
+      KJ_SYSCALL(newFd = fcntl(fd, F_DUPFD_CLOEXEC, 0));
+      ownFd = OwnFd(newFd);
+    }
+
+    auto loopReceiver = heap<CountingConnectionReceiver>(
+        loop.lowLevelProvider.wrapListenSocketFd(
+            kj::mv(ownFd), LowLevelAsyncIoProvider::ALREADY_CLOEXEC),
+        impl.workers[loop.index]->connectionsAccepted);
+    return func(loop, *loopReceiver).attach(kj::mv(loopReceiver));
+  });
+#endif
+}
+
+EventLoopPool::LoopStats EventLoopPool::getLoopStats(uint index) const {
+  KJ_REQUIRE(index < impl->workers.size(), "no such loop", index);
+  return impl->workers[index]->getStats();
+}
+
+void EventLoopPool::submit(Function<Promise<void>()> func) const {
+  impl->submit(*new PoolTask(kj::mv(func)));
+}
+
+}  // namespace kj
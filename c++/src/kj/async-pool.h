@@ -0,0 +1,177 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include "async-io.h"
+#include <kj/function.h>
+
+KJ_BEGIN_HEADER
+
+namespace kj {
+
+class EventLoopPool {
+  // Runs a fixed number of threads, each with its own event loop and AsyncIoProvider, so that a
+  // server can use more than one core without each caller hand-rolling threads and sharding work
+  // between them through `kj::Executor`.
+  //
+  // Most work is bound to the loop it started on: promises, streams, and the like can't move
+  // between threads. The pool offers two ways to spread it out anyway:
+  // * listen() lets all the loops accept connections on a listen socket, so that each accepted
+  //   connection is served entirely by whichever loop accepted it.
+  // * evalLater() queues self-contained work which may run on any loop. Each loop runs the work
+  //   queued to it, and a loop that runs out of work of its own steals from the others.
+  //
+  // The pool may be used from any thread that has an event loop, including the pool's own loops.
+
+public:
+  struct Loop {
+    // One of the pool's event loops, as seen by code running on its thread.
+
+    uint index;
+    // Which loop this is, from 0 to size() - 1.
+
+    AsyncIoProvider& provider;
+    LowLevelAsyncIoProvider& lowLevelProvider;
+    // The loop's I/O, as returned by setupAsyncIo().
+  };
+
+  explicit EventLoopPool(uint threadCount);
+  // Starts `threadCount` threads, each running an event loop, and waits for them to be ready.
+
+  ~EventLoopPool() noexcept(false);
+  // Stops and joins all threads. Work still queued by evalLater() or running on the loops is
+  // canceled, rejecting the corresponding promises.
+
+  KJ_DISALLOW_COPY_AND_MOVE(EventLoopPool);
+
+  uint size() const;
+
+  Promise<void> runOnEach(ConstFunction<Promise<void>(Loop&)> func) const;
+  // Calls `func` on every loop, concurrently, on the loops' own threads, and returns a promise
+  // that resolves when all of the promises it returned have resolved, or rejects as soon as one of
+  // them rejects. Canceling the returned promise cancels the work on all loops.
+
+  struct ListenOptions {
+    bool reusePort = false;
+    // On Linux, when the receiver is a TCP socket, set SO_REUSEPORT on it and give every loop but
+    // the first a listen socket of its own bound to the same address. The kernel then spreads
+    // incoming connections evenly across the loops by hash, and only the loop whose socket a
+    // connection arrives on is woken for it, rather than every loop waiting on one socket.
+    //
+    // This is off by default because it changes the socket for everyone: once SO_REUSEPORT is
+    // set, any other process running as the same user can bind the same port and take a share of
+    // the connections. Also, connections still queued on a loop's socket when the returned
+    // promise is canceled are reset, rather than left for `receiver`. Ignored on other platforms,
+    // where SO_REUSEPORT doesn't balance connections.
+  };
+
+  Promise<void> listen(ConnectionReceiver& receiver,
+                       ConstFunction<Promise<void>(Loop&, ConnectionReceiver&)> func) const;
+  Promise<void> listen(ConnectionReceiver& receiver, ListenOptions options,
+                       ConstFunction<Promise<void>(Loop&, ConnectionReceiver&)> func) const;
+  // Lets all loops accept connections from `receiver`'s listen socket. `func` is called on every
+  // loop with a ConnectionReceiver of the loop's own, which accepts from the same socket; pass it
+  // to e.g. `HttpServer::listenHttp()`. Otherwise behaves like runOnEach(). By the time `func` is
+  // called, the loop's receiver is accepting connections.
+  //
+  // By default, all loops wait on `receiver`'s socket itself; see ListenOptions::reusePort for the
+  // alternative. `receiver` must wrap a Unix socket (see `ConnectionReceiver::getFd()`), and must
+  // stay open for as long as the returned promise runs. The loops don't apply `receiver`'s
+  // NetworkFilter, if it has one.
+
+  template <typename Func>
+  PromiseForResult<Func, void> evalLater(Func&& func) const;
+  // Like `kj::evalLater()`, but `func` may be run on any of the pool's loops: the loop this is
+  // called from, if it is one of the pool's, and otherwise the next loop in round-robin order, or
+  // whichever loop steals it. The returned promise belongs to the calling thread.
+  //
+  // `func` therefore must not touch anything bound to the calling thread, and whatever it returns
+  // is passed back across threads. Work queued on a loop runs in order, between the loop's other
+  // events, but there is no ordering between loops. If the returned promise is canceled, `func`
+  // still runs, and only its result is discarded.
+
+  struct LoopStats {
+    uint64_t tasksRun;
+    // evalLater() tasks this loop has started, including stolen ones.
+
+    uint64_t tasksStolen;
+    // evalLater() tasks this loop took from other loops' queues.
+
+    uint tasksQueued;
+    // evalLater() tasks currently waiting in this loop's queue.
+
+    uint64_t connectionsAccepted;
+    // Connections accepted by receivers that listen() gave to this loop.
+
+    Maybe<Duration> cpuTime;
+    // CPU time used by the loop's thread so far, or none where the platform can't tell (macOS).
+    // Its rate of change over wall time is the loop's utilization, from 0 (idle) to 1 (saturated).
+  };
+
+  LoopStats getLoopStats(uint index) const;
+  // Counters for one of the loops, for monitoring how evenly work is spread. May be called from
+  // any thread.
+
+private:
+  class Impl;
+  Own<Impl> impl;
+
+  void submit(Function<Promise<void>()> task) const;
+};
+
+// =======================================================================================
+// inline implementation details
+
+namespace _ {  // private
+
+template <typename T>
+Promise<void> forwardToCrossThreadFulfiller(
+    Promise<T>&& promise, Own<CrossThreadPromiseFulfiller<T>> fulfiller) {
+  auto& f = *fulfiller;
+  return promise.then([&f](T&& value) { f.fulfill(kj::mv(value)); },
+                      [&f](Exception&& e) { f.reject(kj::mv(e)); })
+      .attach(kj::mv(fulfiller));
+}
+
+inline Promise<void> forwardToCrossThreadFulfiller(
+    Promise<void>&& promise, Own<CrossThreadPromiseFulfiller<void>> fulfiller) {
+  auto& f = *fulfiller;
+  return promise.then([&f]() { f.fulfill(); },
+                      [&f](Exception&& e) { f.reject(kj::mv(e)); })
+      .attach(kj::mv(fulfiller));
+}
+
+}  // namespace _ (private)
+
+template <typename Func>
+PromiseForResult<Func, void> EventLoopPool::evalLater(Func&& func) const {
+  using T = _::UnwrapPromise<PromiseForResult<Func, void>>;
+  auto paf = newPromiseAndCrossThreadFulfiller<T>();
+  submit([func = kj::fwd<Func>(func), fulfiller = kj::mv(paf.fulfiller)]() mutable {
+    return _::forwardToCrossThreadFulfiller(kj::evalNow(kj::mv(func)), kj::mv(fulfiller));
+  });
+  return kj::mv(paf.promise);
+}
+
+}  // namespace kj
+
+KJ_END_HEADER
@@ -0,0 +1,143 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmarks for UnixEventPort. Build with and without `-DKJ_USE_IO_URING=1` to compare
+// the epoll and io_uring backends. With io_uring, the stream benchmarks also run with
+// IoUringOptions::streamIo, under the "stream_io" suffix.
+
+#include <benchmark/benchmark.h>
+
+#include <kj/async-io.h>
+#include <kj/async-unix.h>
+#include <kj/debug.h>
+#include <unistd.h>
+
+static void bm_UnixEventPort_Poll(benchmark::State &state) {
+  // Benchmark polling the event port when nothing is ready.
+  kj::UnixEventPort port;
+  kj::EventLoop loop(port);
+  kj::WaitScope waitScope(loop);
+
+  for (auto _ : state) {
+    waitScope.poll();
+  }
+}
+
+BENCHMARK(bm_UnixEventPort_Poll);
+
+static void bm_UnixEventPort_ObserverChurn(benchmark::State &state) {
+  // Benchmark creating and destroying an FdObserver, as happens for every accepted connection.
+  kj::UnixEventPort port;
+  kj::EventLoop loop(port);
+  kj::WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+
+  for (auto _ : state) {
+    for (auto i KJ_UNUSED: kj::zeroTo(state.range(0))) {
+      kj::UnixEventPort::FdObserver observer(
+          port, infd, kj::UnixEventPort::FdObserver::OBSERVE_READ);
+    }
+    waitScope.poll();
+  }
+}
+
+BENCHMARK(bm_UnixEventPort_ObserverChurn)->Arg(1)->Arg(64);
+
+struct StreamBenchIo {
+  // Like kj::setupAsyncIo(), but lets the benchmark choose IoUringOptions::streamIo.
+
+  kj::Own<kj::UnixEventPort> port;
+  kj::EventLoop loop;
+  kj::WaitScope waitScope;
+  kj::Own<kj::LowLevelAsyncIoProvider> lowLevel;
+  kj::Own<kj::AsyncIoProvider> provider;
+
+  explicit StreamBenchIo(bool streamIo)
+      : port(newPort(streamIo)), loop(*port), waitScope(loop),
+        lowLevel(kj::newLowLevelAsyncIoProvider(*port)),
+        provider(kj::newAsyncIoProvider(*lowLevel)) {}
+
+  static kj::Own<kj::UnixEventPort> newPort(bool streamIo) {
+#if KJ_USE_IO_URING
+    kj::UnixEventPort::IoUringOptions options;
+    options.streamIo = streamIo;
+    return kj::heap<kj::UnixEventPort>(options);
+#else
+    return kj::heap<kj::UnixEventPort>();
+#endif
+  }
+};
+
+static void bm_UnixEventPort_PingPong(benchmark::State &state, bool streamIo) {
+  // Benchmark a one-byte round trip over a socketpair, with both ends on one event loop, so that
+  // each read has to wait for readiness.
+  StreamBenchIo io(streamIo);
+  auto pipe = io.provider->newTwoWayPipe();
+
+  kj::byte buffer = 'x';
+  for (auto _ : state) {
+    auto ping = pipe.ends[1]->read(kj::arrayPtr(&buffer, 1), 1);
+    pipe.ends[0]->write(kj::arrayPtr(&buffer, 1)).wait(io.waitScope);
+    ping.wait(io.waitScope);
+
+    auto pong = pipe.ends[0]->read(kj::arrayPtr(&buffer, 1), 1);
+    pipe.ends[1]->write(kj::arrayPtr(&buffer, 1)).wait(io.waitScope);
+    pong.wait(io.waitScope);
+  }
+}
+
+BENCHMARK_CAPTURE(bm_UnixEventPort_PingPong, poll, false);
+#if KJ_USE_IO_URING
+BENCHMARK_CAPTURE(bm_UnixEventPort_PingPong, stream_io, true);
+#endif
+
+static kj::Promise<void> roundTrip(kj::TwoWayPipe& pipe, kj::byte& buffer) {
+  co_await pipe.ends[0]->write(kj::arrayPtr(&buffer, 1));
+  co_await pipe.ends[1]->read(kj::arrayPtr(&buffer, 1), 1);
+  co_await pipe.ends[1]->write(kj::arrayPtr(&buffer, 1));
+  co_await pipe.ends[0]->read(kj::arrayPtr(&buffer, 1), 1);
+}
+
+static void bm_UnixEventPort_PingPong_Concurrent(benchmark::State &state, bool streamIo) {
+  // Benchmark N socketpairs doing round trips at once, so that each wait returns many events.
+  StreamBenchIo io(streamIo);
+  auto pipes = KJ_MAP(i KJ_UNUSED, kj::zeroTo(state.range(0))) {
+    return io.provider->newTwoWayPipe();
+  };
+  auto buffers = kj::heapArray<kj::byte>(pipes.size());
+
+  for (auto _ : state) {
+    auto trips = KJ_MAP(i, kj::indices(pipes)) {
+      return roundTrip(pipes[i], buffers[i]);
+    };
+    kj::joinPromises(kj::mv(trips)).wait(io.waitScope);
+  }
+}
+
+BENCHMARK_CAPTURE(bm_UnixEventPort_PingPong_Concurrent, poll, false)->Arg(16)->Arg(256);
+#if KJ_USE_IO_URING
+BENCHMARK_CAPTURE(bm_UnixEventPort_PingPong_Concurrent, stream_io, true)->Arg(16)->Arg(256);
+#endif
+
+BENCHMARK_MAIN();
@@ -697,9 +697,9 @@ TEST(AsyncUnixTest, UrgentObserver) {
 }
 #endif
 
-TEST(AsyncUnixTest, SteadyTimers) {
+void testSteadyTimers(UnixEventPort::Options options) {
   captureSignals();
-  UnixEventPort port;
+  UnixEventPort port(options);
   EventLoop loop(port);
   WaitScope waitScope(loop);
 
@@ -732,6 +732,14 @@ TEST(AsyncUnixTest, SteadyTimers) {
   }
 }
 
+TEST(AsyncUnixTest, SteadyTimers) {
+  testSteadyTimers({});
+}
+
+TEST(AsyncUnixTest, SteadyTimersWheel) {
+  testSteadyTimers({ TimerImpl::Queue::WHEEL });
+}
+
 bool dummySignalHandlerCalled = false;
 void dummySignalHandler(int) {
   dummySignalHandlerCalled = true;
@@ -1292,6 +1300,233 @@ KJ_TEST("m:n threads:EventLoops") {
 }
 #endif
 
+#if KJ_USE_IO_URING
+KJ_TEST("UnixEventPort io_uring observer churn") {
+  // Create and destroy more observers in one turn than fit in the submission queue, and make sure
+  // that observers still work afterwards.
+  UnixEventPort::IoUringOptions options;
+  options.entries = 4;
+  UnixEventPort port(options);
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+
+  for (auto i KJ_UNUSED: kj::zeroTo(64)) {
+    UnixEventPort::FdObserver observer(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+  }
+  waitScope.poll();
+
+  UnixEventPort::FdObserver observer(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+  auto promise = observer.whenBecomesReadable();
+  KJ_EXPECT(!promise.poll(waitScope));
+
+  KJ_SYSCALL(write(outfd, "foo", 3));
+  promise.wait(waitScope);
+}
+
+KJ_TEST("UnixEventPort io_uring observer created and destroyed in one turn lets go of the fd") {
+  // Removing a poll request in the same submission that adds it can fail with EALREADY if the
+  // fd is already ready. The port has to try again, or the ring keeps the file open.
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int fds[2]{};
+  KJ_SYSCALL(socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+  kj::OwnFd fd0(fds[0]), fd1(fds[1]);
+  setNonblocking(fd1);
+
+  UnixEventPort::FdObserver observer(port, fd1, UnixEventPort::FdObserver::OBSERVE_READ);
+  waitScope.poll();
+
+  {
+    UnixEventPort::FdObserver doomed(port, fd0, UnixEventPort::FdObserver::OBSERVE_READ_WRITE);
+  }
+  fd0 = nullptr;
+
+  port.getTimer().timeoutAfter(10 * SECONDS, observer.whenBecomesReadable()).wait(waitScope);
+  char c;
+  ssize_t n;
+  KJ_SYSCALL(n = read(fd1, &c, 1));
+  KJ_EXPECT(n == 0);
+}
+
+KJ_TEST("UnixEventPort io_uring SQPOLL") {
+  UnixEventPort::IoUringOptions options;
+  options.sqpoll = true;
+  options.sqpollIdleMillis = 10;
+  UnixEventPort port(options);
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+
+  UnixEventPort::FdObserver observer(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+
+  // Let the kernel thread go to sleep, so that the next wait has to wake it.
+  port.getTimer().afterDelay(50 * MILLISECONDS).wait(waitScope);
+
+  KJ_SYSCALL(write(outfd, "foo", 3));
+  observer.whenBecomesReadable().wait(waitScope);
+}
+
+KJ_TEST("UnixEventPort io_uring read() and write()") {
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+  setNonblocking(outfd);
+  setNonblocking(infd);
+
+  UnixEventPort::FdObserver reader(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+  UnixEventPort::FdObserver writer(port, outfd, UnixEventPort::FdObserver::OBSERVE_WRITE);
+
+  byte buffer[4096]{};
+  auto readPromise = reader.read(buffer);
+  KJ_EXPECT(!readPromise.poll(waitScope));
+
+  KJ_SYSCALL(write(outfd, "foo", 3));
+  KJ_EXPECT(readPromise.wait(waitScope) == 3);
+  KJ_EXPECT(kj::arrayPtr(buffer).first(3) == "foo"_kjb);
+
+  // Fill the pipe, so that a write has to wait.
+  ssize_t n;
+  do {
+    KJ_NONBLOCKING_SYSCALL(n = write(outfd, buffer, sizeof(buffer)));
+  } while (n >= 0);
+
+  kj::ArrayPtr<const byte> pieces[] = { "bar"_kjb, "baz"_kjb };
+  auto writePromise = writer.write(pieces);
+  KJ_EXPECT(!writePromise.poll(waitScope));
+
+  do {
+    KJ_NONBLOCKING_SYSCALL(n = read(infd, buffer, sizeof(buffer)));
+  } while (n > 0);
+  KJ_EXPECT(writePromise.wait(waitScope) == 6);
+}
+
+KJ_TEST("UnixEventPort io_uring canceled read() loses no data") {
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+  setNonblocking(infd);
+
+  UnixEventPort::FdObserver observer(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+
+  byte buffer[16]{};
+  {
+    // Cancel a read that has nothing to read yet.
+    auto promise = observer.read(buffer);
+    KJ_EXPECT(!promise.poll(waitScope));
+  }
+  {
+    // Cancel a read that, most likely, has already completed in the kernel but hasn't been
+    // delivered yet.
+    auto promise = observer.read(buffer);
+    KJ_EXPECT(!promise.poll(waitScope));
+    KJ_SYSCALL(write(outfd, "foo", 3));
+  }
+  KJ_SYSCALL(write(outfd, "bar", 3));
+
+  size_t total = 0;
+  while (total < 6) {
+    size_t n = observer.read(kj::arrayPtr(buffer).slice(total)).wait(waitScope);
+    KJ_ASSERT(n > 0);
+    total += n;
+  }
+  KJ_EXPECT(kj::arrayPtr(buffer).first(total) == "foobar"_kjb);
+  KJ_EXPECT(!observer.hasPendingRead());
+}
+
+KJ_TEST("UnixEventPort io_uring canceled write() keeps order") {
+  UnixEventPort port;
+  EventLoop loop(port);
+  WaitScope waitScope(loop);
+
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+  setNonblocking(outfd);
+  setNonblocking(infd);
+
+  UnixEventPort::FdObserver observer(port, outfd, UnixEventPort::FdObserver::OBSERVE_WRITE);
+
+  byte buffer[4096]{};
+  ssize_t n;
+  do {
+    KJ_NONBLOCKING_SYSCALL(n = write(outfd, buffer, sizeof(buffer)));
+  } while (n >= 0);
+
+  {
+    kj::ArrayPtr<const byte> pieces[] = { "foo"_kjb };
+    auto promise = observer.write(pieces);
+    KJ_EXPECT(!promise.poll(waitScope));
+  }
+
+  // The canceled request may or may not have written "foo" by the time the kernel processes the
+  // cancellation, but either way "bar" must come after it.
+  kj::ArrayPtr<const byte> pieces[] = { "bar"_kjb };
+  auto promise = observer.write(pieces);
+
+  kj::Vector<byte> received;
+  auto drain = [&]() {
+    do {
+      KJ_NONBLOCKING_SYSCALL(n = read(infd, buffer, sizeof(buffer)));
+      if (n > 0) received.addAll(kj::arrayPtr(buffer).first(n));
+    } while (n > 0);
+  };
+  while (!promise.poll(waitScope)) drain();
+  KJ_EXPECT(promise.wait(waitScope) == 3);
+  drain();
+
+  // Everything before "bar" is filler, possibly followed by "foo".
+  auto data = received.asPtr();
+  KJ_ASSERT(data.size() >= 3);
+  KJ_EXPECT(data.slice(data.size() - 3) == "bar"_kjb);
+  auto before = data.first(data.size() - 3);
+  if (before.size() >= 3 && before.slice(before.size() - 3) == "foo"_kjb) {
+    before = before.first(before.size() - 3);
+  }
+  for (byte b: before) KJ_EXPECT(b == 0);
+}
+
+KJ_TEST("UnixEventPort io_uring read in flight when observer and port are destroyed") {
+  int pipefds[2]{};
+  KJ_SYSCALL(pipe(pipefds));
+  kj::OwnFd infd(pipefds[0]), outfd(pipefds[1]);
+  setNonblocking(infd);
+
+  byte buffer[16]{};
+  {
+    UnixEventPort port;
+    EventLoop loop(port);
+    WaitScope waitScope(loop);
+
+    UnixEventPort::FdObserver observer(port, infd, UnixEventPort::FdObserver::OBSERVE_READ);
+    auto promise = observer.read(buffer);
+    KJ_EXPECT(!promise.poll(waitScope));
+  }
+
+  // The read was canceled rather than left to consume data.
+  KJ_SYSCALL(write(outfd, "foo", 3));
+  ssize_t n;
+  KJ_SYSCALL(n = read(infd, buffer, sizeof(buffer)));
+  KJ_EXPECT(n == 3);
+}
+#endif
+
 KJ_TEST("yieldUntilWouldSleep") {
   UnixEventPort port;
   EventLoop loop(port);
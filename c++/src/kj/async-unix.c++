@@ -39,6 +39,13 @@
 #include <sys/epoll.h>
 #include <sys/eventfd.h>
 #include <sys/timerfd.h>
+#elif KJ_USE_IO_URING
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
 #elif KJ_USE_KQUEUE
 #include <sys/event.h>
 #include <fcntl.h>
@@ -69,13 +76,13 @@ bool threadClaimedChildExits = false;
 
 }  // namespace
 
-#if KJ_USE_EPOLL
+#if KJ_USE_EPOLL || KJ_USE_IO_URING
 
 namespace {
 
 thread_local UnixEventPort* threadEventPort = nullptr;
-// This is set to the current UnixEventPort just before epoll_pwait(), then back to null after it
-// returns.
+// This is set to the current UnixEventPort just before epoll_pwait() (or io_uring_enter()), then
+// back to null after it returns.
 
 }  // namespace
 
@@ -178,7 +185,7 @@ void UnixEventPort::signalHandler(int, siginfo_t* siginfo, void*) noexcept {
   }
 }
 
-#endif  // !KJ_USE_EPOLL && !KJ_USE_KQUEUE
+#endif  // !KJ_USE_EPOLL && !KJ_USE_IO_URING && !KJ_USE_KQUEUE
 
 void UnixEventPort::registerSignalHandler(int signum) {
   KJ_REQUIRE(signum != SIGBUS && signum != SIGFPE && signum != SIGILL && signum != SIGSEGV,
@@ -211,7 +218,7 @@ void UnixEventPort::registerSignalHandler(int signum) {
   KJ_SYSCALL(sigaction(signum, &action, nullptr));
 }
 
-#if !KJ_USE_EPOLL && !KJ_USE_KQUEUE && !KJ_USE_PIPE_FOR_WAKEUP
+#if !KJ_USE_EPOLL && !KJ_USE_IO_URING && !KJ_USE_KQUEUE && !KJ_USE_PIPE_FOR_WAKEUP
 void UnixEventPort::registerReservedSignal() {
   registerSignalHandler(reservedSignal);
 }
@@ -407,13 +414,112 @@ void UnixEventPort::gotSignal(const siginfo_t& siginfo) {
 
 #endif  // !KJ_USE_KQUEUE
 
+#if KJ_USE_EPOLL || KJ_USE_IO_URING
+// =======================================================================================
+// Signal code common to epoll and io_uring
+
+#ifdef KJ_DEBUG
+static void verifySignalMask(const sigset_t& originalMask) {
+  // In debug mode, verify the current signal mask matches the original.
+  sigset_t currentMask = {};
+  KJ_SYSCALL(sigprocmask(0, nullptr, &currentMask));
+  if (kj::asBytes(currentMask) != kj::asBytes(originalMask)) {
+    kj::Vector<kj::String> changes;
+    for (int i = 0; i <= SIGRTMAX; i++) {
+      if (sigismember(&currentMask, i) && !sigismember(&originalMask, i)) {
+        changes.add(kj::str("signal #", i, " (", strsignal(i), ") was added"));
+      } else if (!sigismember(&currentMask, i) && sigismember(&originalMask, i)) {
+        changes.add(kj::str("signal #", i, " (", strsignal(i), ") was removed"));
+      }
+    }
+
+    KJ_FAIL_REQUIRE(
+        "Signal mask has changed since UnixEventPort was constructed. You are required to "
+        "ensure that whenever control returns to the event loop, the signal mask is the same "
+        "as it was when UnixEventPort was created. In non-debug builds, this check is skipped, "
+        "and this situation may instead lead to unexpected results. In particular, while the "
+        "system is waiting for I/O events, the signal mask may be reverted to what it was at "
+        "construction time, ignoring your subsequent changes.", changes);
+  }
+}
+#endif
+
+sigset_t UnixEventPort::getWaitMask() {
+  // Compute the signal mask to use while waiting: the original mask, with the signals we care
+  // about unblocked.
+  sigset_t waitMask = originalMask;
+
+  auto ptr = signalHead;
+  while (ptr != nullptr) {
+    KJ_SYSCALL(sigdelset(&waitMask, ptr->signum));
+    ptr = ptr->next;
+  }
+  if (childSet != kj::none) {
+    KJ_SYSCALL(sigdelset(&waitMask, SIGCHLD));
+  }
+
+  return waitMask;
+}
+
+void UnixEventPort::pollSignals() {
+  // Unfortunately, epoll_pwait() (and io_uring_enter() with a signal mask) with a timeout of zero
+  // will never actually deliver any pending signals. Therefore, we need a completely different
+  // approach to poll for signals.
+
+  if (signalHead != nullptr || childSet != kj::none) {
+    // Use sigtimedwait() to poll for signals.
+
+    // Construct a sigset of all signals we are interested in.
+    sigset_t sigset;
+    KJ_SYSCALL(sigemptyset(&sigset));
+    uint count = 0;
+
+    {
+      auto ptr = signalHead;
+      while (ptr != nullptr) {
+        KJ_SYSCALL(sigaddset(&sigset, ptr->signum));
+        ++count;
+        ptr = ptr->next;
+      }
+      if (childSet != kj::none) {
+        KJ_SYSCALL(sigaddset(&sigset, SIGCHLD));
+        ++count;
+      }
+    }
+
+    // While that set is non-empty, poll for signals.
+    while (count > 0) {
+      struct timespec timeout;
+      timeout.tv_sec = 0;
+      timeout.tv_nsec = 0;
+
+      siginfo_t siginfo;
+      int n;
+      KJ_NONBLOCKING_SYSCALL(n = sigtimedwait(&sigset, &siginfo, &timeout));
+      if (n < 0) break;  // EAGAIN: no signals in set are raised
+
+      KJ_ASSERT(n == siginfo.si_signo);
+      gotSignal(siginfo);
+
+      // Remove that signal from the set so we don't receive it again, but keep checking for others
+      // if there are any.
+      KJ_SYSCALL(sigdelset(&sigset, n));
+      --count;
+    }
+  }
+}
+
+#endif  // KJ_USE_EPOLL || KJ_USE_IO_URING
+
 #if KJ_USE_EPOLL
 // =======================================================================================
 // epoll FdObserver implementation
 
-UnixEventPort::UnixEventPort()
+UnixEventPort::UnixEventPort(): UnixEventPort(Options()) {}
+
+UnixEventPort::UnixEventPort(Options options)
     : clock(systemPreciseMonotonicClock()),
-      timerImpl(clock.now()) {
+      timerImpl(clock.now(), options.timerQueue) {
   ignoreSigpipe();
 
   epollFd = KJ_SYSCALL_FD(epoll_create1(EPOLL_CLOEXEC));
@@ -541,29 +647,7 @@ bool UnixEventPort::wait() {
   sleeping = false;
 
 #ifdef KJ_DEBUG
-  // In debug mode, verify the current signal mask matches the original.
-  {
-    sigset_t currentMask = {};
-    KJ_SYSCALL(sigprocmask(0, nullptr, &currentMask));
-    if (kj::asBytes(currentMask) != kj::asBytes(originalMask)) {
-      kj::Vector<kj::String> changes;
-      for (int i = 0; i <= SIGRTMAX; i++) {
-        if (sigismember(&currentMask, i) && !sigismember(&originalMask, i)) {
-          changes.add(kj::str("signal #", i, " (", strsignal(i), ") was added"));
-        } else if (!sigismember(&currentMask, i) && sigismember(&originalMask, i)) {
-          changes.add(kj::str("signal #", i, " (", strsignal(i), ") was removed"));
-        }
-      }
-
-      KJ_FAIL_REQUIRE(
-          "Signal mask has changed since UnixEventPort was constructed. You are required to "
-          "ensure that whenever control returns to the event loop, the signal mask is the same "
-          "as it was when UnixEventPort was created. In non-debug builds, this check is skipped, "
-          "and this situation may instead lead to unexpected results. In particular, while the "
-          "system is waiting for I/O events, the signal mask may be reverted to what it was at "
-          "construction time, ignoring your subsequent changes.", changes);
-    }
-  }
+  verifySignalMask(originalMask);
 #endif
 
   int timeout = timerImpl.timeoutToNextEvent(clock.now(), MILLISECONDS, int(maxValue))
@@ -593,19 +677,7 @@ bool UnixEventPort::wait() {
     //   the parent process exit while the child thread lives on. In this case, if a UnixEventPort
     //   had been created before daemonizing, signal handling would be forever broken in the child.
 
-    sigset_t waitMask = originalMask;
-
-    // Unblock the signals we care about.
-    {
-      auto ptr = signalHead;
-      while (ptr != nullptr) {
-        KJ_SYSCALL(sigdelset(&waitMask, ptr->signum));
-        ptr = ptr->next;
-      }
-      if (childSet != kj::none) {
-        KJ_SYSCALL(sigdelset(&waitMask, SIGCHLD));
-      }
-    }
+    sigset_t waitMask = getWaitMask();
 
     threadEventPort = this;
     n = epoll_pwait(epollFd, events, kj::size(events), timeout, &waitMask);
@@ -669,53 +741,13 @@ bool UnixEventPort::processEpollEvents(struct epoll_event events[], int n) {
 }
 
 bool UnixEventPort::poll() {
-  // Unfortunately, epoll_pwait() with a timeout of zero will never deliver actually deliver any
-  // pending signals. Therefore, we need a completely different approach to poll for signals. We
-  // might as well use regular epoll_wait() in this case, too, to save the kernel some effort.
+  // Signals are polled separately by pollSignals(), since epoll_pwait() with a timeout of zero
+  // will never deliver them. We might as well use regular epoll_wait() in this case, too, to save
+  // the kernel some effort.
 
   sleeping = false;
 
-  if (signalHead != nullptr || childSet != kj::none) {
-    // Use sigtimedwait() to poll for signals.
-
-    // Construct a sigset of all signals we are interested in.
-    sigset_t sigset;
-    KJ_SYSCALL(sigemptyset(&sigset));
-    uint count = 0;
-
-    {
-      auto ptr = signalHead;
-      while (ptr != nullptr) {
-        KJ_SYSCALL(sigaddset(&sigset, ptr->signum));
-        ++count;
-        ptr = ptr->next;
-      }
-      if (childSet != kj::none) {
-        KJ_SYSCALL(sigaddset(&sigset, SIGCHLD));
-        ++count;
-      }
-    }
-
-    // While that set is non-empty, poll for signals.
-    while (count > 0) {
-      struct timespec timeout;
-      timeout.tv_sec = 0;
-      timeout.tv_nsec = 0;
-
-      siginfo_t siginfo;
-      int n;
-      KJ_NONBLOCKING_SYSCALL(n = sigtimedwait(&sigset, &siginfo, &timeout));
-      if (n < 0) break;  // EAGAIN: no signals in set are raised
-
-      KJ_ASSERT(n == siginfo.si_signo);
-      gotSignal(siginfo);
-
-      // Remove that signal from the set so we don't receive it again, but keep checking for others
-      // if there are any.
-      KJ_SYSCALL(sigdelset(&sigset, n));
-      --count;
-    }
-  }
+  pollSignals();
 
   struct epoll_event events[16];
   int n;
@@ -801,13 +833,977 @@ kj::TimePoint UnixEventPort::getTimeWhileSleeping() {
   return clock.now();
 }
 
+#elif KJ_USE_IO_URING
+// =======================================================================================
+// io_uring FdObserver implementation
+//
+// FdObservers are implemented as multishot IORING_OP_POLL_ADD requests. These are
+// edge-triggered, just like our epoll registrations, so FdObserver behaves exactly as it does
+// with epoll. What we gain is fewer syscalls: creating an observer only queues a request in the
+// submission ring, to be submitted by the same io_uring_enter() that waits for events, and events
+// are read straight out of the completion ring, so poll() needs no syscall at all unless requests
+// are queued. Timer events use io_uring_enter()'s timeout argument rather than timeout requests,
+// since there is only ever one timeout of interest and it changes on every wait.
+//
+// FdObserver::read() and write() go further and submit the I/O itself, as IORING_OP_READ and
+// IORING_OP_WRITE requests, so that a stream that has to wait gets its data in one completion
+// instead of a readiness event followed by another syscall. Since the kernel may touch a
+// request's buffer until the request completes -- even after it has been canceled -- the buffer
+// belongs to the request, not the caller, and the request outlives its promise (and its
+// observer) until its completion arrives, just like a poll request outlives its observer.
+
+namespace {
+
+constexpr uint64_t WAKE_USER_DATA = 0;
+// user_data of the poll request on `eventFd`.
+
+constexpr uint64_t IGNORED_USER_DATA = 1;
+// user_data of requests whose completions we don't care about, i.e. IORING_OP_POLL_REMOVE and
+// IORING_OP_ASYNC_CANCEL.
+
+constexpr uint64_t IO_USER_DATA_TAG = 2;
+// Set in the user_data of a read or write request, which is otherwise a pointer to its IoUringIo.
+//
+// Any other user_data is a pointer to an IoUringPoll.
+
+constexpr size_t IO_BUFFER_SIZE = 65536;
+// Most that FdObserver::read() or write() transfers in one request. Bigger requests would tie up
+// more memory per idle stream (a read's buffer is allocated when the read is submitted, not when
+// data arrives) for little gain, since socket buffers are rarely bigger than this anyway.
+
+int ioUringSetup(uint entries, struct io_uring_params* params) {
+  return syscall(__NR_io_uring_setup, entries, params);
+}
+
+int ioUringEnter(int fd, uint toSubmit, uint minComplete, uint flags,
+                 const struct io_uring_getevents_arg* arg) {
+  if (arg == nullptr) {
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0);
+  } else {
+    return syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags | IORING_ENTER_EXT_ARG,
+                   arg, sizeof(*arg));
+  }
+}
+
+class RingMmapDisposer final: public ArrayDisposer {
+protected:
+  void disposeImpl(void* firstElement, size_t elementSize, size_t elementCount,
+                   size_t capacity, void (*destroyElement)(void*)) const override {
+    KJ_SYSCALL(munmap(firstElement, elementSize * elementCount)) { break; }
+  }
+};
+
+constexpr RingMmapDisposer ringMmapDisposer = RingMmapDisposer();
+
+Array<byte> mmapRing(int fd, size_t size, off_t offset) {
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+  if (ptr == MAP_FAILED) {
+    KJ_FAIL_SYSCALL("mmap(io_uring)", errno);
+  }
+  return Array<byte>(reinterpret_cast<byte*>(ptr), size, ringMmapDisposer);
+}
+
+template <typename T>
+T* ringField(ArrayPtr<byte> ring, uint32_t offset) {
+  return reinterpret_cast<T*>(ring.begin() + offset);
+}
+
+}  // namespace
+
+struct UnixEventPort::IoUringPoll {
+  // A multishot poll request on behalf of an FdObserver. Its address is the request's user_data.
+
+  FdObserver* observer;
+  // Null once the observer has been destroyed. The request then lingers until the kernel has
+  // delivered its final completion, since until then completions carrying our address may arrive.
+
+  int fd;
+  uint32_t events;
+
+  bool armed = false;
+  // True while the request is queued or active in the kernel. Multishot polls can end on their
+  // own (e.g. if the completion queue overflows), in which case we re-arm them.
+
+  IoUringPoll* next = nullptr;
+  IoUringPoll** prev = nullptr;
+  // Linked list of requests whose observer is gone, so that any still awaiting their final
+  // completion when the port is destroyed can be freed.
+};
+
+struct UnixEventPort::IoUringIo {
+  // A read or write request on behalf of FdObserver::read() or write(). Its address, tagged with
+  // IO_USER_DATA_TAG, is the request's user_data.
+
+  FdObserver* observer;
+  // Null once the observer has been destroyed.
+
+  int fd;
+  bool isWrite;
+
+  Array<byte> buffer;
+  // What the kernel reads into or writes from.
+
+  ArrayPtr<byte> target;
+  // For a read, where the caller wants the data.
+
+  IoUringIoAdapter* adapter = nullptr;
+  // Null once the promise has been canceled.
+
+  IoUringIo* next = nullptr;
+  IoUringIo** prev = nullptr;
+  // Linked list of requests in flight, so that the port can wait for them when destroyed.
+};
+
+class UnixEventPort::IoUring {
+public:
+  explicit IoUring(const IoUringOptions& options);
+  ~IoUring() noexcept(false);
+  KJ_DISALLOW_COPY_AND_MOVE(IoUring);
+
+  void addPoll(int fd, uint32_t events, uint64_t userData);
+  // Queue a multishot poll request.
+
+  void detach(IoUringPoll* poll);
+  // `poll`'s observer is being destroyed. Cancel the request, and free `poll` once the kernel is
+  // done with it.
+
+  void removePoll(IoUringPoll* poll);
+  // Queue an IORING_OP_POLL_REMOVE for `poll`.
+
+  void release(IoUringPoll* poll);
+  // The final completion for detached `poll` has arrived. Free it.
+
+  Promise<int> startIo(IoUringIo* io);
+  // Queue `io`'s read or write request, taking ownership of `io`. The promise resolves to the
+  // request's result, i.e. a byte count or a negated errno value.
+
+  void cancelIo(IoUringIo* io);
+  // Queue a request to cancel `io`. `io` still completes in the usual way, with ECANCELED or
+  // with whatever result it had already reached.
+
+  void releaseIo(IoUringIo* io);
+  // `io` has completed. Free it.
+
+  void submit();
+  // Submit all queued requests, without waiting for completions.
+
+  int enter(const struct io_uring_getevents_arg& arg);
+  // Submit all queued requests and wait for at least one completion, subject to the timeout and
+  // signal mask in `arg`. Returns 0 or an errno value; EINTR and ETIME are to be expected.
+
+  bool nextCompletion(uint64_t& userData, int& res, uint& flags);
+  // Pop one completion off the completion ring, if there are any. Never makes a syscall.
+  // Completions reaped by nextSqe() come first.
+
+private:
+  OwnFd fd;
+  bool sqpoll;
+
+  Array<byte> ring;
+  Array<byte> sqeMemory;
+
+  uint32_t* sqHead;
+  uint32_t* sqTail;
+  uint32_t* sqFlags;
+  uint32_t sqMask;
+  uint32_t sqEntries;
+  ArrayPtr<struct io_uring_sqe> sqes;
+
+  uint32_t* cqHead;
+  uint32_t* cqTail;
+  uint32_t cqMask;
+  struct io_uring_cqe* cqes;
+
+  uint32_t localSqTail;
+  // Our copy of `*sqTail`, which only we write.
+
+  IoUringPoll* detachedHead = nullptr;
+  IoUringIo* ioHead = nullptr;
+
+  struct Completion {
+    uint64_t userData;
+    int res;
+    uint flags;
+  };
+  Vector<Completion> reaped;
+  size_t reapedPos = 0;
+  // Completions that nextSqe() moved out of the ring to make room, not yet returned by
+  // nextCompletion().
+
+  struct io_uring_sqe& nextSqe();
+  bool reapCompletions();
+  void commitSqe();
+  uint32_t unsubmitted();
+};
+
+UnixEventPort::IoUring::IoUring(const IoUringOptions& options): sqpoll(options.sqpoll) {
+  struct io_uring_params params;
+  memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CLAMP;
+  if (options.sqpoll) {
+    params.flags |= IORING_SETUP_SQPOLL;
+    params.sq_thread_idle = options.sqpollIdleMillis;
+  }
+
+  fd = KJ_SYSCALL_FD(ioUringSetup(options.entries, &params));
+
+  // Multishot polls need Linux 5.13. There's no feature flag for them specifically, so we check
+  // for IORING_FEAT_RSRC_TAGS, which arrived in the same release.
+  constexpr uint32_t REQUIRED_FEATURES = IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP |
+      IORING_FEAT_EXT_ARG | IORING_FEAT_RSRC_TAGS;
+  KJ_REQUIRE((params.features & REQUIRED_FEATURES) == REQUIRED_FEATURES,
+      "KJ_USE_IO_URING requires Linux 5.13 or newer", params.features);
+
+  // With IORING_FEAT_SINGLE_MMAP, the submission and completion rings share one mapping.
+  ring = mmapRing(fd, kj::max(params.sq_off.array + params.sq_entries * sizeof(uint32_t),
+                              params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe)),
+                  IORING_OFF_SQ_RING);
+  sqeMemory = mmapRing(fd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES);
+
+  sqHead = ringField<uint32_t>(ring, params.sq_off.head);
+  sqTail = ringField<uint32_t>(ring, params.sq_off.tail);
+  sqFlags = ringField<uint32_t>(ring, params.sq_off.flags);
+  sqMask = *ringField<uint32_t>(ring, params.sq_off.ring_mask);
+  sqEntries = params.sq_entries;
+  sqes = kj::arrayPtr(reinterpret_cast<io_uring_sqe*>(sqeMemory.begin()), sqEntries);
+
+  cqHead = ringField<uint32_t>(ring, params.cq_off.head);
+  cqTail = ringField<uint32_t>(ring, params.cq_off.tail);
+  cqMask = *ringField<uint32_t>(ring, params.cq_off.ring_mask);
+  cqes = ringField<io_uring_cqe>(ring, params.cq_off.cqes);
+
+  // We always fill SQEs in ring order, so the indirection array can be the identity mapping.
+  uint32_t* sqArray = ringField<uint32_t>(ring, params.sq_off.array);
+  for (uint32_t i: kj::zeroTo(sqEntries)) {
+    sqArray[i] = i;
+  }
+
+  localSqTail = *sqTail;
+}
+
+UnixEventPort::IoUring::~IoUring() noexcept(false) {
+  if (ioHead != nullptr) {
+    // Read and write requests may still be using their buffers, so we can't free them until the
+    // kernel says it's done, and closing the ring doesn't wait for that. Cancel them all and wait.
+    KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+      for (IoUringIo* io = ioHead; io != nullptr; io = io->next) {
+        cancelIo(io);
+      }
+
+      while (ioHead != nullptr) {
+        submit();
+        KJ_SYSCALL_HANDLE_ERRORS(ioUringEnter(fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr)) {
+          case EINTR:
+            break;
+          default:
+            KJ_FAIL_SYSCALL("io_uring_enter()", error);
+        }
+
+        uint64_t userData;
+        int res;
+        uint flags;
+        while (nextCompletion(userData, res, flags)) {
+          if (userData != IGNORED_USER_DATA && (userData & IO_USER_DATA_TAG)) {
+            releaseIo(reinterpret_cast<IoUringIo*>(userData & ~IO_USER_DATA_TAG));
+          }
+        }
+      }
+    })) {
+      // Leak the requests rather than risk the kernel writing to freed memory.
+      KJ_LOG(ERROR, "failed to cancel io_uring reads and writes", exception);
+    }
+  }
+
+  // Closing the ring cancels whatever poll requests are left, so we won't hear about these again.
+  while (detachedHead != nullptr) {
+    IoUringPoll* poll = detachedHead;
+    detachedHead = poll->next;
+    delete poll;
+  }
+}
+
+void UnixEventPort::IoUring::addPoll(int pollFd, uint32_t events, uint64_t userData) {
+  auto& sqe = nextSqe();
+  sqe.opcode = IORING_OP_POLL_ADD;
+  sqe.fd = pollFd;
+  sqe.poll32_events = events;
+  sqe.len = IORING_POLL_ADD_MULTI;
+  sqe.user_data = userData;
+  commitSqe();
+}
+
+void UnixEventPort::IoUring::detach(IoUringPoll* poll) {
+  poll->observer = nullptr;
+
+  if (!poll->armed) {
+    // The kernel is already done with this one.
+    delete poll;
+    return;
+  }
+
+  poll->next = detachedHead;
+  poll->prev = &detachedHead;
+  if (detachedHead != nullptr) {
+    detachedHead->prev = &poll->next;
+  }
+  detachedHead = poll;
+
+  // We're called from ~FdObserver(), so we must not throw. If the request can't be canceled, it
+  // stays in the kernel, and its completions are ignored, until the ring is destroyed.
+  KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() {
+    removePoll(poll);
+
+    // Submit right away: the caller is likely to close the fd next, and an active poll holds a
+    // reference to the file, which would otherwise delay e.g. sending a FIN until the next turn
+    // of the event loop.
+    submit();
+  })) {
+    KJ_LOG(ERROR, "failed to cancel io_uring poll", exception);
+  }
+}
+
+void UnixEventPort::IoUring::removePoll(IoUringPoll* poll) {
+  auto& sqe = nextSqe();
+  sqe.opcode = IORING_OP_POLL_REMOVE;
+  sqe.fd = -1;
+  sqe.addr = reinterpret_cast<uintptr_t>(poll);
+  sqe.user_data = IGNORED_USER_DATA;
+  commitSqe();
+}
+
+void UnixEventPort::IoUring::release(IoUringPoll* poll) {
+  *poll->prev = poll->next;
+  if (poll->next != nullptr) {
+    poll->next->prev = poll->prev;
+  }
+  delete poll;
+}
+
+class UnixEventPort::IoUringIoAdapter {
+public:
+  IoUringIoAdapter(PromiseFulfiller<int>& fulfiller, IoUring& ring, IoUringIo* io)
+      : fulfiller(fulfiller), ring(ring), io(io) {
+    io->adapter = this;
+  }
+
+  ~IoUringIoAdapter() {
+    if (io != nullptr) {
+      // The promise was canceled before the request completed. The request keeps its buffer until
+      // the kernel is done with it; see processCompletions().
+      io->adapter = nullptr;
+      KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { ring.cancelIo(io); })) {
+        KJ_LOG(ERROR, "failed to cancel io_uring request", exception);
+      }
+    }
+  }
+
+  void complete(int res) {
+    if (!io->isWrite && res > 0) {
+      io->target.first(res).copyFrom(io->buffer.first(res));
+    }
+    io = nullptr;
+    fulfiller.fulfill(kj::cp(res));
+  }
+
+private:
+  PromiseFulfiller<int>& fulfiller;
+  IoUring& ring;
+  IoUringIo* io;
+};
+
+Promise<int> UnixEventPort::IoUring::startIo(IoUringIo* io) {
+  {
+    KJ_ON_SCOPE_FAILURE(delete io);
+
+    auto& sqe = nextSqe();
+    sqe.opcode = io->isWrite ? IORING_OP_WRITE : IORING_OP_READ;
+    sqe.fd = io->fd;
+    sqe.off = -1;  // Use the file position, like read() and write() do.
+    sqe.addr = reinterpret_cast<uintptr_t>(io->buffer.begin());
+    sqe.len = io->buffer.size();
+    sqe.user_data = reinterpret_cast<uintptr_t>(io) | IO_USER_DATA_TAG;
+    commitSqe();
+  }
+
+  io->next = ioHead;
+  io->prev = &ioHead;
+  if (ioHead != nullptr) {
+    ioHead->prev = &io->next;
+  }
+  ioHead = io;
+
+  return newAdaptedPromise<int, IoUringIoAdapter>(*this, io);
+}
+
+void UnixEventPort::IoUring::cancelIo(IoUringIo* io) {
+  auto& sqe = nextSqe();
+  sqe.opcode = IORING_OP_ASYNC_CANCEL;
+  sqe.fd = -1;
+  sqe.addr = reinterpret_cast<uintptr_t>(io) | IO_USER_DATA_TAG;
+  sqe.user_data = IGNORED_USER_DATA;
+  commitSqe();
+}
+
+void UnixEventPort::IoUring::releaseIo(IoUringIo* io) {
+  *io->prev = io->next;
+  if (io->next != nullptr) {
+    io->next->prev = io->prev;
+  }
+  delete io;
+}
+
+struct io_uring_sqe& UnixEventPort::IoUring::nextSqe() {
+  if (localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+    // The submission queue is full. Submit what we have to make room.
+    submit();
+    while (localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) >= sqEntries) {
+      if (sqpoll) {
+        // The kernel thread takes entries off the queue asynchronously.
+        KJ_SYSCALL(ioUringEnter(fd, 0, 0, IORING_ENTER_SQ_WAIT, nullptr));
+      } else {
+        // submit() got EAGAIN or EBUSY because the completion queue is backed up. We can't
+        // dispatch completions here -- we may be in the middle of constructing or destroying an
+        // FdObserver -- so set them aside for nextCompletion(), then try again. submit() asks the
+        // kernel to flush any overflowed completions into the space this frees.
+        KJ_ASSERT(reapCompletions() || (__atomic_load_n(sqFlags, __ATOMIC_ACQUIRE) &
+                                        IORING_SQ_CQ_OVERFLOW),
+            "io_uring did not accept submissions, but has no completions to reap");
+        submit();
+      }
+    }
+  }
+
+  auto& sqe = sqes[localSqTail & sqMask];
+  memset(&sqe, 0, sizeof(sqe));
+  return sqe;
+}
+
+void UnixEventPort::IoUring::commitSqe() {
+  ++localSqTail;
+  __atomic_store_n(sqTail, localSqTail, __ATOMIC_RELEASE);
+}
+
+uint32_t UnixEventPort::IoUring::unsubmitted() {
+  return localSqTail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+}
+
+void UnixEventPort::IoUring::submit() {
+  uint flags = 0;
+
+  if (__atomic_load_n(sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_CQ_OVERFLOW) {
+    // Completions overflowed the ring and are waiting in the kernel. Ask for them to be flushed
+    // into the ring now that we've made room.
+    flags |= IORING_ENTER_GETEVENTS;
+  }
+
+  uint32_t count = unsubmitted();
+  if (count > 0 && sqpoll) {
+    // The kernel thread picks up submissions itself, unless it has gone to sleep.
+    count = 0;
+    if (__atomic_load_n(sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+  }
+
+  if (count == 0 && flags == 0) return;
+
+  KJ_SYSCALL_HANDLE_ERRORS(ioUringEnter(fd, count, 0, flags, nullptr)) {
+    case EAGAIN:
+    case EBUSY:
+      // The kernel can't take more right now because the completion queue is backed up. Whatever
+      // wasn't submitted stays queued for next time, after we've reaped completions.
+      break;
+    default:
+      KJ_FAIL_SYSCALL("io_uring_enter()", error);
+  }
+}
+
+int UnixEventPort::IoUring::enter(const struct io_uring_getevents_arg& arg) {
+  uint flags = IORING_ENTER_GETEVENTS;
+  uint count = unsubmitted();
+  if (sqpoll) {
+    count = 0;
+    if (__atomic_load_n(sqFlags, __ATOMIC_ACQUIRE) & IORING_SQ_NEED_WAKEUP) {
+      flags |= IORING_ENTER_SQ_WAKEUP;
+    }
+  }
+
+  if (ioUringEnter(fd, count, 1, flags, &arg) < 0) {
+    return errno;
+  } else {
+    return 0;
+  }
+}
+
+bool UnixEventPort::IoUring::reapCompletions() {
+  // Move every completion in the ring to `reaped`. Returns false if there were none.
+
+  uint32_t head = *cqHead;
+  uint32_t tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+  if (head == tail) return false;
+
+  for (; head != tail; ++head) {
+    auto& cqe = cqes[head & cqMask];
+    reaped.add(Completion { cqe.user_data, cqe.res, cqe.flags });
+  }
+  __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool UnixEventPort::IoUring::nextCompletion(uint64_t& userData, int& res, uint& flags) {
+  if (reapedPos < reaped.size()) {
+    auto& completion = reaped[reapedPos++];
+    userData = completion.userData;
+    res = completion.res;
+    flags = completion.flags;
+    if (reapedPos == reaped.size()) {
+      reaped.clear();
+      reapedPos = 0;
+    }
+    return true;
+  }
+
+  // Only we write the head, so a plain read suffices for it.
+  uint32_t head = *cqHead;
+  if (head == __atomic_load_n(cqTail, __ATOMIC_ACQUIRE)) {
+    return false;
+  }
+
+  auto& cqe = cqes[head & cqMask];
+  userData = cqe.user_data;
+  res = cqe.res;
+  flags = cqe.flags;
+
+  // Hand the slot back to the kernel.
+  __atomic_store_n(cqHead, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+// -------------------------------------------------------------------
+
+UnixEventPort::UnixEventPort(): UnixEventPort(IoUringOptions()) {}
+
+UnixEventPort::UnixEventPort(Options options): UnixEventPort(IoUringOptions(), options) {}
+
+UnixEventPort::UnixEventPort(IoUringOptions ioUringOptions)
+    : UnixEventPort(ioUringOptions, Options()) {}
+
+UnixEventPort::UnixEventPort(IoUringOptions ioUringOptions, Options options)
+    : clock(systemPreciseMonotonicClock()),
+      timerImpl(clock.now(), options.timerQueue),
+      streamIo(ioUringOptions.streamIo) {
+  ignoreSigpipe();
+
+  ring = kj::heap<IoUring>(ioUringOptions);
+  eventFd = KJ_SYSCALL_FD(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+  ring->addPoll(eventFd, POLLIN, WAKE_USER_DATA);
+
+  // Get the current signal mask, from which we'll compute the appropriate mask to pass to
+  // io_uring_enter() on each loop. (We explicitly memset to 0 first to make sure we can compare
+  // this against another mask with memcmp() for debug purposes.)
+  originalMask = {};
+  KJ_SYSCALL(sigprocmask(0, nullptr, &originalMask));
+}
+
+UnixEventPort::~UnixEventPort() noexcept(false) {
+  if (childSet != kj::none) {
+    // We had claimed the exclusive right to call onChildExit(). Release that right.
+    threadClaimedChildExits = false;
+  }
+}
+
+UnixEventPort::FdObserver::FdObserver(UnixEventPort& eventPort, int fd, uint flags)
+    : eventPort(eventPort), fd(fd), flags(flags) {
+  uint32_t events = 0;
+
+  if (flags & OBSERVE_READ) {
+    events |= POLLIN | POLLRDHUP;
+  }
+  if (flags & OBSERVE_WRITE) {
+    events |= POLLOUT;
+  }
+  if (flags & OBSERVE_URGENT) {
+    events |= POLLPRI;
+  }
+
+  ringPoll = new IoUringPoll { this, fd, events, true };
+  eventPort.ring->addPoll(fd, events, reinterpret_cast<uintptr_t>(ringPoll));
+}
+
+UnixEventPort::FdObserver::~FdObserver() noexcept(false) {
+  // Cancel any read or write still in flight. The cancellations are submitted along with the
+  // poll removal below.
+  for (IoUringIo* io: { readRequest, writeRequest }) {
+    if (io != nullptr) {
+      io->observer = nullptr;
+      KJ_IF_SOME(exception, kj::runCatchingExceptions([&]() { eventPort.ring->cancelIo(io); })) {
+        KJ_LOG(ERROR, "failed to cancel io_uring request", exception);
+      }
+    }
+  }
+
+  eventPort.ring->detach(ringPoll);
+}
+
+void UnixEventPort::FdObserver::fire(short events) {
+  if (events & (POLLIN | POLLHUP | POLLRDHUP | POLLERR)) {
+    if (events & (POLLHUP | POLLRDHUP)) {
+      atEnd = true;
+    } else {
+      // Since we didn't receive POLLRDHUP, we know that we're not at the end.
+      atEnd = false;
+    }
+
+    KJ_IF_SOME(f, readFulfiller) {
+      f->fulfill();
+      readFulfiller = kj::none;
+    }
+  }
+
+  if (events & (POLLOUT | POLLHUP | POLLERR)) {
+    KJ_IF_SOME(f, writeFulfiller) {
+      f->fulfill();
+      writeFulfiller = kj::none;
+    }
+  }
+
+  if (events & (POLLHUP | POLLERR)) {
+    KJ_IF_SOME(f, hupFulfiller) {
+      f->fulfill();
+      hupFulfiller = kj::none;
+    }
+  }
+
+  if (events & POLLPRI) {
+    KJ_IF_SOME(f, urgentFulfiller) {
+      f->fulfill();
+      urgentFulfiller = kj::none;
+    }
+  }
+}
+
+Promise<void> UnixEventPort::FdObserver::whenBecomesReadable() {
+  KJ_REQUIRE(flags & OBSERVE_READ, "FdObserver was not set to observe reads.");
+
+  auto paf = newPromiseAndFulfiller<void>();
+  readFulfiller = kj::mv(paf.fulfiller);
+  return kj::mv(paf.promise);
+}
+
+Promise<void> UnixEventPort::FdObserver::whenBecomesWritable() {
+  KJ_REQUIRE(flags & OBSERVE_WRITE, "FdObserver was not set to observe writes.");
+
+  auto paf = newPromiseAndFulfiller<void>();
+  writeFulfiller = kj::mv(paf.fulfiller);
+  return kj::mv(paf.promise);
+}
+
+Promise<void> UnixEventPort::FdObserver::whenUrgentDataAvailable() {
+  KJ_REQUIRE(flags & OBSERVE_URGENT,
+      "FdObserver was not set to observe availability of urgent data.");
+
+  auto paf = newPromiseAndFulfiller<void>();
+  urgentFulfiller = kj::mv(paf.fulfiller);
+  return kj::mv(paf.promise);
+}
+
+Promise<void> UnixEventPort::FdObserver::whenWriteDisconnected() {
+  auto paf = newPromiseAndFulfiller<void>();
+  hupFulfiller = kj::mv(paf.fulfiller);
+  return kj::mv(paf.promise);
+}
+
+Promise<size_t> UnixEventPort::FdObserver::read(ArrayPtr<byte> buffer) {
+  KJ_REQUIRE(flags & OBSERVE_READ, "FdObserver was not set to observe reads.");
+
+  if (leftover.size() > 0) {
+    size_t n = kj::min(buffer.size(), leftover.size());
+    buffer.first(n).copyFrom(leftover.first(n));
+    leftover = leftover.slice(n);
+    if (leftover.size() == 0) {
+      leftoverBuffer = nullptr;
+    }
+    return n;
+  }
+
+  if (readRequest != nullptr) {
+    // A canceled read is still in flight. Wait for it, since any data it gets comes first.
+    auto paf = newPromiseAndFulfiller<void>();
+    readSettled = kj::mv(paf.fulfiller);
+    return paf.promise.then([this, buffer]() mutable { return read(buffer); });
+  }
+
+  if (buffer.size() == 0) {
+    return size_t(0);
+  }
+
+  if (ringIoRefused) {
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = ::read(fd, buffer.begin(), buffer.size()));
+    if (n >= 0) {
+      return size_t(n);
+    }
+    return whenBecomesReadable().then([this, buffer]() mutable { return read(buffer); });
+  }
+
+  auto io = new IoUringIo {
+    this, fd, false, heapArray<byte>(kj::min(buffer.size(), IO_BUFFER_SIZE)), buffer
+  };
+  auto promise = eventPort.ring->startIo(io);
+  readRequest = io;
+
+  return promise.then([this, buffer](int res) mutable -> Promise<size_t> {
+    if (res >= 0) {
+      return size_t(res);
+    } else if (res == -EAGAIN) {
+      // This kernel doesn't wait on O_NONBLOCK files. Wait for readiness instead from now on.
+      ringIoRefused = true;
+      return read(buffer);
+    } else if (res == -EINTR) {
+      return read(buffer);
+    } else {
+      KJ_FAIL_SYSCALL("io_uring read()", -res);
+    }
+  });
+}
+
+bool UnixEventPort::FdObserver::prefersRingIo() const {
+  return eventPort.streamIo;
+}
+
+bool UnixEventPort::FdObserver::hasPendingRead() const {
+  return readRequest != nullptr || leftover.size() > 0;
+}
+
+Promise<size_t> UnixEventPort::FdObserver::write(ArrayPtr<const ArrayPtr<const byte>> pieces) {
+  KJ_REQUIRE(flags & OBSERVE_WRITE, "FdObserver was not set to observe writes.");
+
+  size_t size = 0;
+  for (auto& piece: pieces) {
+    size += piece.size();
+  }
+
+  auto buffer = heapArray<byte>(kj::min(size, IO_BUFFER_SIZE));
+  auto pos = buffer.asPtr();
+  for (auto& piece: pieces) {
+    size_t n = kj::min(piece.size(), pos.size());
+    pos.first(n).copyFrom(piece.first(n));
+    pos = pos.slice(n);
+  }
+
+  return writeBuffer(kj::mv(buffer));
+}
+
+Promise<size_t> UnixEventPort::FdObserver::writeBuffer(Array<byte> buffer) {
+  if (writeRequest != nullptr) {
+    // A canceled write is still in flight. Wait for it, so that our data goes after its.
+    auto paf = newPromiseAndFulfiller<void>();
+    writeSettled = kj::mv(paf.fulfiller);
+    return paf.promise.then([this, buffer = kj::mv(buffer)]() mutable {
+      return writeBuffer(kj::mv(buffer));
+    });
+  }
+
+  if (buffer.size() == 0) {
+    return size_t(0);
+  }
+
+  if (ringIoRefused) {
+    ssize_t n;
+    KJ_NONBLOCKING_SYSCALL(n = ::write(fd, buffer.begin(), buffer.size()));
+    if (n >= 0) {
+      return size_t(n);
+    }
+    return whenBecomesWritable().then([this, buffer = kj::mv(buffer)]() mutable {
+      return writeBuffer(kj::mv(buffer));
+    });
+  }
+
+  auto io = new IoUringIo { this, fd, true, kj::mv(buffer), nullptr };
+  auto promise = eventPort.ring->startIo(io);
+  writeRequest = io;
+
+  return promise.then([this](int res) -> size_t {
+    if (res >= 0) {
+      return res;
+    } else if (res == -EAGAIN || res == -EINTR) {
+      // Nothing was written, and the request has given the buffer back to the kernel, so let the
+      // caller try again. On EAGAIN, this kernel doesn't wait on O_NONBLOCK files, so wait for
+      // readiness instead from now on.
+      if (res == -EAGAIN) ringIoRefused = true;
+      return 0;
+    } else {
+      KJ_FAIL_SYSCALL("io_uring write()", -res);
+    }
+  });
+}
+
+bool UnixEventPort::FdObserver::hasPendingWrite() const {
+  return writeRequest != nullptr;
+}
+
+void UnixEventPort::wake() const {
+  uint64_t one = 1;
+  ssize_t n;
+  KJ_NONBLOCKING_SYSCALL(n = write(eventFd, &one, sizeof(one)));
+  KJ_ASSERT(n < 0 || n == sizeof(one));
+}
+
+bool UnixEventPort::wait() {
+#ifdef KJ_DEBUG
+  verifySignalMask(originalMask);
+#endif
+
+  struct io_uring_getevents_arg arg = {};
+
+  struct __kernel_timespec timeout = {};
+  KJ_IF_SOME(t, timerImpl.timeoutToNextEvent(clock.now(), NANOSECONDS, maxValue)) {
+    timeout.tv_sec = t / 1000000000;
+    timeout.tv_nsec = t % 1000000000;
+    arg.ts = reinterpret_cast<uintptr_t>(&timeout);
+  }
+
+  sigset_t waitMask;
+  if (signalHead != nullptr || childSet != kj::none) {
+    // We are interested in some signals. Like epoll_pwait(), io_uring_enter() can atomically
+    // unblock them for the duration of the wait. (See the epoll implementation for why we don't
+    // use signalfd.)
+    waitMask = getWaitMask();
+    arg.sigmask = reinterpret_cast<uintptr_t>(&waitMask);
+    arg.sigmask_sz = _NSIG / 8;
+
+    threadEventPort = this;
+  }
+
+  int error = ring->enter(arg);
+  threadEventPort = nullptr;
+
+  switch (error) {
+    case 0:
+    case ETIME:
+      // Completions are ready, or the timer is due.
+    case EINTR:
+      // We received a signal. As with epoll, we pretend no events arrived, so that the event loop
+      // spins once and recomputes the timeout.
+    case EAGAIN:
+    case EBUSY:
+      // The kernel couldn't take our submissions because the completion queue is backed up.
+      // Reaping completions will fix that.
+      break;
+    default:
+      KJ_FAIL_SYSCALL("io_uring_enter()", error);
+  }
+
+  return processCompletions();
+}
+
+bool UnixEventPort::processCompletions() {
+  bool woken = false;
+
+  uint64_t userData;
+  int res;
+  uint flags;
+  while (ring->nextCompletion(userData, res, flags)) {
+    bool more = flags & IORING_CQE_F_MORE;
+
+    if (userData == WAKE_USER_DATA) {
+      // Someone called wake() from another thread. Consume the event.
+      uint64_t value;
+      ssize_t n;
+      KJ_NONBLOCKING_SYSCALL(n = read(eventFd, &value, sizeof(value)));
+      KJ_ASSERT(n < 0 || n == sizeof(value));
+
+      // We were woken. Need to return true.
+      woken = true;
+
+      if (!more) {
+        KJ_ASSERT(res >= 0, "io_uring poll on eventfd failed", strerror(-res));
+        ring->addPoll(eventFd, POLLIN, WAKE_USER_DATA);
+      }
+    } else if (userData == IGNORED_USER_DATA) {
+      // Nothing to do.
+    } else if (userData & IO_USER_DATA_TAG) {
+      IoUringIo* io = reinterpret_cast<IoUringIo*>(userData & ~IO_USER_DATA_TAG);
+
+      if (io->observer != nullptr) {
+        FdObserver& observer = *io->observer;
+        auto& settled = io->isWrite ? observer.writeSettled : observer.readSettled;
+        (io->isWrite ? observer.writeRequest : observer.readRequest) = nullptr;
+
+        if (io->adapter == nullptr && !io->isWrite && res > 0) {
+          // The read() was canceled, but the kernel read the data anyway. Save it for the next
+          // read(), rather than lose it.
+          observer.leftoverBuffer = kj::mv(io->buffer);
+          observer.leftover = observer.leftoverBuffer.first(res);
+        }
+
+        KJ_IF_SOME(f, settled) {
+          f->fulfill();
+          settled = kj::none;
+        }
+      }
+
+      if (io->adapter != nullptr) {
+        io->adapter->complete(res);
+      }
+
+      ring->releaseIo(io);
+    } else {
+      IoUringPoll* poll = reinterpret_cast<IoUringPoll*>(userData);
+      if (!more) poll->armed = false;
+
+      if (poll->observer == nullptr) {
+        if (more) {
+          // The request is still active, so the removal queued by detach() must have failed with
+          // EALREADY, which happens if the request was busy posting this very event at the time
+          // (e.g. when it was added and removed in the same submission). Try again, or else the
+          // request will hold the file open until the ring is destroyed.
+          ring->removePoll(poll);
+        } else {
+          ring->release(poll);
+        }
+      } else if (res >= 0) {
+        poll->observer->fire(static_cast<short>(res));
+
+        if (!more) {
+          // The multishot poll ended early, probably because the completion queue overflowed.
+          poll->armed = true;
+          ring->addPoll(poll->fd, poll->events, userData);
+        }
+      } else {
+        // The kernel refused to poll this fd. Wake everyone up so that they discover the problem
+        // when they try to perform I/O.
+        poll->observer->fire(POLLERR);
+      }
+    }
+  }
+
+  timerImpl.advanceTo(clock.now());
+
+  return woken;
+}
+
+bool UnixEventPort::poll() {
+  // Signals are polled separately by pollSignals(), since io_uring_enter() with a signal mask
+  // won't deliver them without waiting.
+  pollSignals();
+
+  // Submit anything queued this turn. Completions are already sitting in the ring, so there's
+  // no need to ask the kernel for them.
+  ring->submit();
+
+  return processCompletions();
+}
+
 #elif KJ_USE_KQUEUE
 // =======================================================================================
 // kqueue FdObserver implementation
 
-UnixEventPort::UnixEventPort()
+UnixEventPort::UnixEventPort(): UnixEventPort(Options()) {}
+
+UnixEventPort::UnixEventPort(Options options)
     : clock(systemPreciseMonotonicClock()),
-      timerImpl(clock.now()) {
+      timerImpl(clock.now(), options.timerQueue) {
   ignoreSigpipe();
 
   kqueueFd = KJ_SYSCALL_FD(kqueue());
@@ -1229,7 +2225,7 @@ bool UnixEventPort::poll() {
   return doKqueueWait(&timeout);
 }
 
-#else  // KJ_USE_EPOLL, else KJ_USE_KQUEUE
+#else  // KJ_USE_EPOLL, else KJ_USE_IO_URING, else KJ_USE_KQUEUE
 // =======================================================================================
 // Traditional poll() FdObserver implementation.
 
@@ -1237,9 +2233,11 @@ bool UnixEventPort::poll() {
 #define POLLRDHUP 0
 #endif
 
-UnixEventPort::UnixEventPort()
+UnixEventPort::UnixEventPort(): UnixEventPort(Options()) {}
+
+UnixEventPort::UnixEventPort(Options options)
     : clock(systemPreciseMonotonicClock()),
-      timerImpl(clock.now()) {
+      timerImpl(clock.now(), options.timerQueue) {
 #if KJ_USE_PIPE_FOR_WAKEUP
   // Allocate a pipe to which we'll write a byte in order to wake this thread.
   int fds[2];
@@ -1663,7 +2661,7 @@ void UnixEventPort::wake() const {
 #endif
 }
 
-#endif  // KJ_USE_EPOLL, else KJ_USE_KQUEUE, else
+#endif  // KJ_USE_EPOLL, else KJ_USE_IO_URING, else KJ_USE_KQUEUE, else
 
 #if !KJ_USE_EPOLL
 void UnixEventPort::updateNextTimerEvent(kj::Maybe<TimePoint> time) {
@@ -33,7 +33,9 @@
 KJ_BEGIN_HEADER
 
 #if !defined(KJ_USE_EPOLL) && !defined(KJ_USE_KQUEUE)
-#if __linux__
+#if __linux__ && KJ_USE_IO_URING
+// io_uring was requested explicitly (with `-DKJ_USE_IO_URING=1`); it replaces epoll.
+#elif __linux__
 // Default to epoll on Linux.
 #define KJ_USE_EPOLL 1
 #elif __APPLE__ || __FreeBSD__ || __NetBSD__ || __DragonFly__
@@ -47,6 +49,10 @@ KJ_BEGIN_HEADER
 #error "Both KJ_USE_EPOLL and KJ_USE_KQUEUE are set. Please choose only one of these."
 #endif
 
+#if KJ_USE_IO_URING && (KJ_USE_EPOLL || KJ_USE_KQUEUE || !__linux__)
+#error "KJ_USE_IO_URING is only supported on Linux and cannot be combined with KJ_USE_EPOLL."
+#endif
+
 #if __CYGWIN__ && !defined(KJ_USE_PIPE_FOR_WAKEUP)
 // Cygwin has serious issues with the intersection of signals and threads, reported here:
 //     https://cygwin.com/ml/cygwin/2019-07/msg00052.html
@@ -68,7 +74,8 @@ class UnixEventPort final: public EventPort, private TimerImpl::SleepHooks {
   // An EventPort implementation which can wait for events on file descriptors as well as signals.
   // This API only makes sense on Unix.
   //
-  // The implementation uses `poll()` or possibly a platform-specific API (e.g. epoll, kqueue).
+  // The implementation uses `poll()` or possibly a platform-specific API (e.g. epoll, kqueue,
+  // io_uring).
   // To also wait on signals without race conditions, the implementation may block signals until
   // just before `poll()` while using a signal handler which `siglongjmp()`s back to just before
   // the signal was unblocked, or it may use a nicer platform-specific API.
@@ -91,6 +98,41 @@ class UnixEventPort final: public EventPort, private TimerImpl::SleepHooks {
 public:
   UnixEventPort();
 
+  struct Options {
+    TimerImpl::Queue timerQueue = TimerImpl::Queue::ORDERED;
+    // The data structure that holds getTimer()'s pending events. WHEEL suits ports with many
+    // timeouts that are mostly canceled before they fire. See TimerImpl::Queue.
+  };
+
+  explicit UnixEventPort(Options options);
+
+#if KJ_USE_IO_URING
+  struct IoUringOptions {
+    uint entries = 256;
+    // Size of the submission queue. The completion queue is twice this size. Submissions are
+    // flushed early if the queue fills up within one turn of the event loop, so this only needs
+    // to be large enough to hold the FdObservers typically created or destroyed in one turn.
+
+    bool sqpoll = false;
+    // Use IORING_SETUP_SQPOLL, in which a kernel thread polls the submission queue so that
+    // submitting requires no syscall at all while the thread is awake. This trades a
+    // mostly-busy kernel thread per UnixEventPort for lower latency, and usually requires
+    // privileges on older kernels.
+
+    uint sqpollIdleMillis = 1000;
+    // With `sqpoll`, how long the kernel thread spins without work before going to sleep.
+
+    bool streamIo = false;
+    // Have AsyncStreamFd submit a read or write that would block to the ring itself, using
+    // FdObserver::read() and write(), rather than wait for readiness and then retry the syscall.
+    // The data passes through a buffer owned by the event port, and in benchmarks so far the
+    // extra allocation and copy cost more than the syscall saved, so this is off by default.
+  };
+
+  explicit UnixEventPort(IoUringOptions ioUringOptions);
+  UnixEventPort(IoUringOptions ioUringOptions, Options options);
+#endif
+
   ~UnixEventPort() noexcept(false);
 
   class FdObserver;
@@ -256,6 +298,11 @@ private:
   void gotSignal(const siginfo_t& siginfo);
 #endif
 
+#if KJ_USE_EPOLL || KJ_USE_IO_URING
+  sigset_t getWaitMask();
+  void pollSignals();
+#endif
+
   friend class TimerPromiseAdapter;
 
 #if KJ_USE_EPOLL
@@ -269,6 +316,20 @@ private:
   bool timerfdIsArmed = false;
 
   bool processEpollEvents(struct epoll_event events[], int n);
+#elif KJ_USE_IO_URING
+  class IoUring;
+  struct IoUringPoll;
+  struct IoUringIo;
+  class IoUringIoAdapter;
+  // The ring and its mmap()ed queues, a multishot poll request registered on it, and a read or
+  // write request submitted by FdObserver::read() or write(). Defined in async-unix.c++.
+
+  sigset_t originalMask;
+  Own<IoUring> ring;
+  OwnFd eventFd;   // Used for cross-thread wakeups.
+  bool streamIo;   // IoUringOptions::streamIo.
+
+  bool processCompletions();
 #elif KJ_USE_KQUEUE
   OwnFd kqueueFd;
 
@@ -294,7 +355,7 @@ private:
 
   static void signalHandler(int, siginfo_t* siginfo, void*) noexcept;
   static void registerSignalHandler(int signum);
-#if !KJ_USE_EPOLL && !KJ_USE_KQUEUE && !KJ_USE_PIPE_FOR_WAKEUP
+#if !KJ_USE_EPOLL && !KJ_USE_IO_URING && !KJ_USE_KQUEUE && !KJ_USE_PIPE_FOR_WAKEUP
   static void registerReservedSignal();
 #endif
   static void ignoreSigpipe();
@@ -409,6 +470,44 @@ public:
   Promise<void> whenWriteDisconnected();
   // Resolves when poll() on the file descriptor reports POLLHUP or POLLERR.
 
+#if KJ_USE_IO_URING
+  Promise<size_t> read(ArrayPtr<byte> buffer);
+  // Reads up to `buffer.size()` bytes, resolving to the number read, or zero at EOF. Call this
+  // after a non-blocking read() fails with EAGAIN, in place of `whenBecomesReadable()`: the read
+  // itself is submitted to the io_uring, so it completes with the data rather than with a
+  // readiness event that then costs another syscall.
+  //
+  // The kernel reads into a buffer owned by the event port, which is copied into `buffer` when
+  // the request completes, so `buffer` need only stay valid for as long as the promise does.
+  // Canceling the promise submits IORING_OP_ASYNC_CANCEL; if the request had already read some
+  // data, the next read() returns it, so nothing is lost.
+  //
+  // Only one read() may be outstanding at a time, and the caller must not read the fd directly
+  // while `hasPendingRead()` is true, or data would be reordered. Requires OBSERVE_READ.
+
+  bool hasPendingRead() const;
+  // True if a canceled read() left its request in flight or left data behind.
+
+  Promise<size_t> write(ArrayPtr<const ArrayPtr<const byte>> pieces);
+  // Writes a prefix of the concatenation of `pieces`, resolving to its length. Call this after a
+  // non-blocking write() fails with EAGAIN, in place of `whenBecomesWritable()`. The prefix may be
+  // empty, e.g. if interrupted by a signal, in which case the caller should simply try again.
+  //
+  // At most 64 KiB is copied into a buffer owned by the event port before write() returns, so
+  // `pieces` need not outlive the call. Canceling the promise submits IORING_OP_ASYNC_CANCEL; as
+  // with any canceled write, some of the data may have been written anyway.
+  //
+  // Only one write() may be outstanding at a time, and the caller must not write the fd directly
+  // while `hasPendingWrite()` is true. Requires OBSERVE_WRITE.
+
+  bool hasPendingWrite() const;
+  // True if a canceled write() left its request in flight.
+
+  bool prefersRingIo() const;
+  // True if the event port was created with IoUringOptions::streamIo, meaning that streams should
+  // use read() and write() instead of waiting for readiness.
+#endif
+
 private:
   UnixEventPort& eventPort;
   int fd;
@@ -429,7 +528,33 @@ private:
   void fire(short events);
 #endif
 
-#if !KJ_USE_EPOLL && !KJ_USE_KQUEUE
+#if KJ_USE_IO_URING
+  Promise<size_t> writeBuffer(Array<byte> buffer);
+  // write(), once the data is copied.
+
+  IoUringPoll* ringPoll;
+  // This observer's multishot poll request. It outlives the observer until the kernel confirms
+  // that the request is gone.
+
+  IoUringIo* readRequest = nullptr;
+  IoUringIo* writeRequest = nullptr;
+  // The request submitted by the last read() or write(), until it completes. Like `ringPoll`, a
+  // request outlives its promise and the observer until the kernel is done with its buffer.
+
+  kj::Maybe<Own<PromiseFulfiller<void>>> readSettled;
+  kj::Maybe<Own<PromiseFulfiller<void>>> writeSettled;
+  // Fulfilled when a canceled request completes, for the read() or write() waiting on it.
+
+  Array<byte> leftoverBuffer;
+  ArrayPtr<byte> leftover;
+  // Data read by a request whose read() was canceled, to be returned by the next read().
+
+  bool ringIoRefused = false;
+  // Set if the kernel failed a request with EAGAIN, as some kernels do for O_NONBLOCK files.
+  // read() and write() then wait for readiness instead.
+#endif
+
+#if !KJ_USE_EPOLL && !KJ_USE_IO_URING && !KJ_USE_KQUEUE
   FdObserver* next;
   FdObserver** prev;
   // Linked list of observers which currently have a non-null readFulfiller or writeFulfiller.
@@ -23,11 +23,13 @@
 #include <capnp/compat/http-over-capnp.h>
 #include <capnp/rpc-twoparty.h>
 #include <kj/async-io.h>
+#include <kj/async-pool.h>
 #include <kj/compat/http.h>
 #include <kj/debug.h>
 #include <kj/main.h>
 
 #if __linux__ || __APPLE__
+#include <kj/async-unix.h>
 #include <unistd.h>
 #endif
 
@@ -50,6 +52,19 @@ private:
   HttpHeaders responseHeaders;
 };
 
+struct LoopHttpServer {
+  // Everything one of an EventLoopPool's loops needs to serve HTTP on its own. None of it is
+  // thread-safe, so every loop gets a copy.
+
+  LoopHttpServer(HttpHeaderTable &table)
+      : timer(kj::origin<kj::TimePoint>()), service(table),
+        server(timer, table, service) {}
+
+  kj::TimerImpl timer;
+  OkService service;
+  HttpServer server;
+};
+
 class HttpBenchMain {
 public:
   HttpBenchMain(kj::ProcessContext &context) : context(context) {}
@@ -70,6 +85,28 @@ public:
     return true;
   }
 
+  kj::MainBuilder::Validity setThreads(kj::StringPtr threadsStr) {
+    KJ_IF_SOME(n, threadsStr.tryParseAs<uint>()) {
+      if (n > 0) {
+        threads = n;
+        return true;
+      }
+    }
+    return "must be a positive integer";
+  }
+
+  kj::MainBuilder::Validity setReusePort() {
+    reusePort = true;
+    return true;
+  }
+
+#if KJ_USE_IO_URING
+  kj::MainBuilder::Validity setStreamIo() {
+    streamIo = true;
+    return true;
+  }
+#endif
+
   kj::MainFunc getMain() {
     return kj::MainBuilder(context, "http-bench", "KJ HTTP stack benchmark")
         .addSubCommand("http-server", KJ_BIND_METHOD(*this, getHttpServer),
@@ -88,6 +125,18 @@ public:
     return kj::MainBuilder(context, "http-server", "Run an HTTP server.")
         .addOptionWithArg({'s', "server"}, KJ_BIND_METHOD(*this, setServer),
                           "<address>", "Server address to listen on.")
+        .addOptionWithArg({'t', "threads"}, KJ_BIND_METHOD(*this, setThreads),
+                          "<count>",
+                          "Serve connections on <count> threads, each with its own "
+                          "event loop. Defaults to 1.")
+        .addOption({"reuse-port"}, KJ_BIND_METHOD(*this, setReusePort),
+                   "With --threads, give each thread its own SO_REUSEPORT listen socket, "
+                   "rather than having them all wait on one.")
+#if KJ_USE_IO_URING
+        .addOption({"stream-io"}, KJ_BIND_METHOD(*this, setStreamIo),
+                   "Have the io_uring read and write for connections, rather than only "
+                   "poll them (UnixEventPort::IoUringOptions::streamIo). Single-threaded only.")
+#endif
         .callAfterParsing(KJ_BIND_METHOD(*this, runHttpServer))
         .build();
   }
@@ -95,10 +144,34 @@ public:
   kj::MainBuilder::Validity runHttpServer() {
     KJ_REQUIRE(server != nullptr, "Must specify --server");
 
+#if KJ_USE_IO_URING
+    if (streamIo) {
+      KJ_REQUIRE(threads == 1, "--stream-io can't be combined with --threads");
+
+      kj::UnixEventPort::IoUringOptions options;
+      options.streamIo = true;
+      kj::UnixEventPort port(options);
+      kj::EventLoop loop(port);
+      kj::WaitScope waitScope(loop);
+      auto lowLevel = kj::newLowLevelAsyncIoProvider(port);
+      auto provider = kj::newAsyncIoProvider(*lowLevel);
+      kj::AsyncIoContext io { kj::mv(lowLevel), kj::mv(provider), waitScope, port };
+      return serveHttp(io);
+    }
+#endif
+
     auto io = kj::setupAsyncIo();
+    return serveHttp(io);
+  }
 
+  kj::MainBuilder::Validity serveHttp(kj::AsyncIoContext &io) {
     HttpHeaderTable::Builder tableBuilder;
     auto headerTable = tableBuilder.build();
+
+    if (threads > 1) {
+      return runPooledHttpServer(io, *headerTable);
+    }
+
     OkService service(*headerTable);
 
     kj::TimerImpl timer(kj::origin<kj::TimePoint>());
@@ -116,6 +189,69 @@ public:
     return true;
   }
 
+  kj::MainBuilder::Validity runPooledHttpServer(kj::AsyncIoContext &io,
+                                                HttpHeaderTable &headerTable) {
+    // Serve the same listen socket from every loop of an EventLoopPool. Each connection is
+    // handled entirely by the loop that accepted it, so throughput should scale with the number of
+    // threads until the cores (or the client) run out.
+
+    kj::EventLoopPool pool(threads);
+
+    auto addr =
+        io.provider->getNetwork().parseAddress(this->server).wait(io.waitScope);
+    auto listener = addr->listen();
+
+    KJ_LOG(WARNING, "Http server listening", this->server, threads);
+
+    kj::EventLoopPool::ListenOptions options;
+    options.reusePort = reusePort;
+
+    auto listenPromise =
+        pool.listen(*listener, options, [&headerTable](kj::EventLoopPool::Loop &,
+                                                       kj::ConnectionReceiver &receiver) {
+          auto server = kj::heap<LoopHttpServer>(headerTable);
+          auto promise = server->server.listenHttp(receiver);
+          return promise.attach(kj::mv(server));
+        });
+
+    listenPromise.exclusiveJoin(reportLoad(io.provider->getTimer(), pool))
+        .wait(io.waitScope);
+
+    return true;
+  }
+
+  static kj::Promise<void> reportLoad(kj::Timer &timer,
+                                      kj::EventLoopPool &pool) {
+    // Periodically log how busy each loop is, to show whether load is spread evenly.
+
+    constexpr kj::Duration INTERVAL = 10 * kj::SECONDS;
+    auto lastCpuTime = kj::heapArray<kj::Duration>(pool.size());
+    auto lastAccepted = kj::heapArray<uint64_t>(pool.size());
+    for (auto i : kj::zeroTo(pool.size())) {
+      auto stats = pool.getLoopStats(i);
+      lastCpuTime[i] = stats.cpuTime.orDefault(0 * kj::SECONDS);
+      lastAccepted[i] = stats.connectionsAccepted;
+    }
+
+    for (;;) {
+      co_await timer.afterDelay(INTERVAL);
+
+      for (auto i : kj::zeroTo(pool.size())) {
+        auto stats = pool.getLoopStats(i);
+        auto accepted = stats.connectionsAccepted - lastAccepted[i];
+        lastAccepted[i] = stats.connectionsAccepted;
+
+        KJ_IF_SOME(cpuTime, stats.cpuTime) {
+          auto percent = (cpuTime - lastCpuTime[i]) * 100 / INTERVAL;
+          lastCpuTime[i] = cpuTime;
+          KJ_LOG(WARNING, "loop load", i, accepted, percent);
+        } else {
+          KJ_LOG(WARNING, "loop load", i, accepted);
+        }
+      }
+    }
+  }
+
   kj::MainFunc getCapnpServer() {
     return kj::MainBuilder(context, "capnp-server",
                            "Run an HTTP-over-Cap'n-Proto server.")
@@ -250,6 +386,11 @@ private:
   kj::ProcessContext &context;
   kj::StringPtr server;
   kj::StringPtr client;
+  uint threads = 1;
+  bool reusePort = false;
+#if KJ_USE_IO_URING
+  bool streamIo = false;
+#endif
 };
 
 } // namespace kj
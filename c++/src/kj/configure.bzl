@@ -28,6 +28,11 @@ def kj_configure():
         build_setting_default = False,
     )
 
+    bool_flag(
+        name = "io_uring",
+        build_setting_default = False,
+    )
+
     bool_flag(
         name = "deprecate_kj_if_maybe",
         build_setting_default = True,
@@ -70,6 +75,11 @@ def kj_configure():
         flag_values = {"libdl": "True"},
     )
 
+    native.config_setting(
+        name = "use_io_uring",
+        flag_values = {"io_uring": "True"},
+    )
+
     native.config_setting(
         name = "use_deprecate_kj_if_maybe",
         flag_values = {"deprecate_kj_if_maybe": "True"},
@@ -103,6 +113,9 @@ def kj_configure():
         }) + select({
             "//src/kj:use_libdl": ["KJ_HAS_LIBDL"],
             "//conditions:default": [],
+        }) + select({
+            "//src/kj:use_io_uring": ["KJ_USE_IO_URING=1"],
+            "//conditions:default": [],
         }) + select({
             "//src/kj:use_deprecate_kj_if_maybe": ["KJ_DEPRECATE_KJ_IF_MAYBE=1"],
             "//conditions:default": ["KJ_DEPRECATE_KJ_IF_MAYBE=0"],
@@ -0,0 +1,97 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+// Micro-benchmarks for TimerImpl's timer queues.
+
+#include <benchmark/benchmark.h>
+
+#include <kj/async.h>
+#include <kj/timer.h>
+#include <kj/vector.h>
+
+static constexpr size_t OUTSTANDING = 1 << 20;
+static constexpr kj::Duration WINDOW = 60 * kj::SECONDS;
+// Keep a million timers pending, spread evenly over the next minute, like a server with a
+// million connections each with an idle timeout.
+
+static kj::TimerImpl::Queue queueArg(benchmark::State& state) {
+  return state.range(0) == 0 ? kj::TimerImpl::Queue::ORDERED : kj::TimerImpl::Queue::WHEEL;
+}
+
+static kj::Vector<kj::Promise<void>> fill(kj::TimerImpl& timer) {
+  kj::Vector<kj::Promise<void>> timers(OUTSTANDING);
+  for (size_t i = 0; i < OUTSTANDING; i++) {
+    timers.add(timer.afterDelay(WINDOW * int64_t(i) / int64_t(OUTSTANDING)));
+  }
+  return timers;
+}
+
+struct NullSleepHooks final: public kj::TimerImpl::SleepHooks {
+  void updateNextTimerEvent(kj::Maybe<kj::TimePoint> time) override {
+    benchmark::DoNotOptimize(time);
+  }
+  kj::TimePoint getTimeWhileSleeping() override { return kj::origin<kj::TimePoint>(); }
+};
+
+static void bm_Timer_InsertCancel(benchmark::State& state) {
+  // Replace pending timers with new ones in the same window without ever firing any, as happens
+  // when timeouts are reset on every request. With `sleeping`, the timer has sleep hooks, as when
+  // the event loop is driven by another one (see UnixEventPort::preparePollableFdForSleep()), so
+  // it must keep them told of the next event.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>(), queueArg(state));
+  auto timers = fill(timer);
+
+  NullSleepHooks hooks;
+  if (state.range(1)) timer.setSleeping(hooks);
+
+  size_t i = 0;
+  for (auto _ : state) {
+    size_t k = i++ % OUTSTANDING;
+    timers[k] = timer.afterDelay(WINDOW * int64_t(k) / int64_t(OUTSTANDING));
+  }
+}
+
+BENCHMARK(bm_Timer_InsertCancel)->ArgNames({"wheel", "sleeping"})->ArgsProduct({{0, 1}, {0, 1}});
+
+static void bm_Timer_Churn(benchmark::State& state) {
+  // Advance time so that about one timer fires per iteration, and replace one timer with a new
+  // one at the end of the window, keeping the number pending constant.
+  kj::EventLoop loop;
+  kj::WaitScope waitScope(loop);
+  kj::TimerImpl timer(kj::origin<kj::TimePoint>(), queueArg(state));
+  auto timers = fill(timer);
+
+  const kj::Duration STEP = WINDOW / int64_t(OUTSTANDING);
+  kj::TimePoint now = kj::origin<kj::TimePoint>();
+  size_t i = 0;
+  for (auto _ : state) {
+    now = now + STEP;
+    timer.advanceTo(now);
+    loop.run();
+    timers[i++ % OUTSTANDING] = timer.afterDelay(WINDOW);
+  }
+}
+
+BENCHMARK(bm_Timer_Churn)->ArgName("wheel")->Arg(0)->Arg(1);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,236 @@
+// Copyright (c) 2026 Cloudflare, Inc. and contributors
+// Licensed under the MIT License:
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#include "timer.h"
+#include "async.h"
+#include "vector.h"
+#include <kj/test.h>
+
+namespace kj {
+namespace {
+
+// Each test runs against both queue implementations, which must behave identically apart from
+// nextEvent() being allowed to report an earlier time with Queue::WHEEL.
+
+constexpr TimerImpl::Queue QUEUES[] = { TimerImpl::Queue::ORDERED, TimerImpl::Queue::WHEEL };
+
+KJ_TEST("TimerImpl fires timers in order") {
+  for (auto queue: QUEUES) {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    TimerImpl timer(origin<TimePoint>(), queue);
+
+    Vector<uint> fired;
+    Vector<Promise<void>> promises;
+    auto add = [&](Duration delay, uint id) {
+      promises.add(timer.afterDelay(delay).then([&fired, id]() { fired.add(id); })
+          .eagerlyEvaluate(nullptr));
+    };
+
+    add(30 * MILLISECONDS, 0);
+    add(10 * MILLISECONDS, 1);
+    add(30 * MILLISECONDS, 2);
+    add(1500 * MICROSECONDS, 3);
+    add(-10 * MILLISECONDS, 4);
+    add(1 * SECONDS, 5);
+    add(30 * MILLISECONDS, 6);
+    add(1300 * MICROSECONDS, 7);
+
+    timer.advanceTo(origin<TimePoint>());
+    loop.run();
+    KJ_EXPECT(fired == kj::arr(4u));
+
+    timer.advanceTo(origin<TimePoint>() + 1400 * MICROSECONDS);
+    loop.run();
+    KJ_EXPECT(fired == kj::arr(4u, 7u));
+
+    timer.advanceTo(origin<TimePoint>() + 30 * MILLISECONDS);
+    loop.run();
+    KJ_EXPECT(fired == kj::arr(4u, 7u, 3u, 1u, 0u, 2u, 6u));
+
+    timer.advanceTo(origin<TimePoint>() + 999 * MILLISECONDS);
+    loop.run();
+    KJ_EXPECT(fired.size() == 7);
+
+    timer.advanceTo(origin<TimePoint>() + 2 * SECONDS);
+    loop.run();
+    KJ_EXPECT(fired == kj::arr(4u, 7u, 3u, 1u, 0u, 2u, 6u, 5u));
+    KJ_EXPECT(timer.nextEvent() == kj::none);
+  }
+}
+
+KJ_TEST("TimerImpl cancels timers") {
+  for (auto queue: QUEUES) {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    TimerImpl timer(origin<TimePoint>(), queue);
+
+    auto early = timer.afterDelay(5 * MILLISECONDS);
+    auto late = timer.afterDelay(10 * MINUTES);
+    auto kept = timer.afterDelay(20 * MILLISECONDS);
+
+    early = nullptr;
+    late = nullptr;
+    KJ_EXPECT(KJ_ASSERT_NONNULL(timer.nextEvent()) <= origin<TimePoint>() + 20 * MILLISECONDS);
+
+    timer.advanceTo(origin<TimePoint>() + 10 * MILLISECONDS);
+    KJ_EXPECT(!kept.poll(waitScope));
+
+    timer.advanceTo(origin<TimePoint>() + 20 * MILLISECONDS);
+    KJ_EXPECT(kept.poll(waitScope));
+    KJ_EXPECT(timer.nextEvent() == kj::none);
+  }
+}
+
+KJ_TEST("TimerImpl handles timers far apart") {
+  // Spread timers over every scale from microseconds to years, so that with Queue::WHEEL they
+  // land in every level and have to cascade all the way down before firing.
+
+  for (auto queue: QUEUES) {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    TimePoint start = origin<TimePoint>() + 12345 * SECONDS;
+    TimerImpl timer(start, queue);
+
+    Vector<Duration> delays;
+    for (Duration d = 1 * MICROSECONDS; d < 1000 * DAYS; d = d * 3 + 7 * MICROSECONDS) {
+      delays.add(d);
+    }
+
+    Vector<TimePoint> fired;
+    Vector<Promise<void>> promises;
+    for (auto i: kj::indices(delays)) {
+      // Schedule in reverse to make sure insertion order doesn't matter.
+      auto time = start + delays[delays.size() - i - 1];
+      promises.add(timer.atTime(time).then([&fired, time]() { fired.add(time); })
+          .eagerlyEvaluate(nullptr));
+    }
+
+    // Follow nextEvent() the way an event loop would, and check that we never fire a timer early
+    // or skip past one.
+    uint wakeups = 0;
+    while (fired.size() < delays.size()) {
+      auto next = KJ_ASSERT_NONNULL(timer.nextEvent());
+      KJ_ASSERT(next >= timer.now());
+      KJ_ASSERT(next <= start + delays[fired.size()]);
+      timer.advanceTo(next);
+      loop.run();
+      for (auto time: fired) {
+        KJ_ASSERT(time <= timer.now());
+      }
+      ++wakeups;
+    }
+
+    for (auto i: kj::indices(delays)) {
+      KJ_EXPECT(fired[i] == start + delays[i]);
+    }
+
+    if (queue == TimerImpl::Queue::ORDERED) {
+      KJ_EXPECT(wakeups == delays.size());
+    } else {
+      // At most one early wakeup per level of the wheel, per timer.
+      KJ_EXPECT(wakeups <= delays.size() * 8);
+    }
+  }
+}
+
+KJ_TEST("TimerImpl keeps sleep hooks up to date") {
+  struct Hooks final: public TimerImpl::SleepHooks {
+    Maybe<TimePoint> next;
+    void updateNextTimerEvent(Maybe<TimePoint> time) override { next = time; }
+    TimePoint getTimeWhileSleeping() override { return origin<TimePoint>(); }
+  };
+
+  for (auto queue: QUEUES) {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    TimerImpl timer(origin<TimePoint>(), queue);
+
+    Hooks hooks;
+    hooks.next = timer.nextEvent();
+    timer.setSleeping(hooks);
+
+    // Add and cancel timers in a scrambled order, mostly within the wheel's first 64ms, where
+    // nextEvent() is exact, and sometimes much further out.
+    struct Pending {
+      TimePoint time;
+      Promise<void> promise;
+    };
+    Vector<Pending> pending;
+    uint64_t state = 12345;
+    for (uint i = 0; i < 2000; i++) {
+      state = state * 6364136223846793005ull + 1442695040888963407ull;
+      uint r = state >> 33;
+
+      if (pending.size() < 20 && (r & 1 || pending.empty())) {
+        Duration delay = (r >> 1) % 64 * MILLISECONDS + (r >> 8) % 1000 * MICROSECONDS;
+        if (r % 5 == 0) delay = delay * 1000;
+        auto time = origin<TimePoint>() + delay;
+        pending.add(Pending { time, timer.atTime(time) });
+      } else {
+        auto index = (r >> 1) % pending.size();
+        pending[index] = kj::mv(pending.back());
+        pending.removeLast();
+      }
+
+      KJ_ASSERT(hooks.next == timer.nextEvent());
+      if (pending.empty()) {
+        KJ_ASSERT(hooks.next == kj::none);
+      } else {
+        TimePoint earliest = pending[0].time;
+        for (auto& p: pending) earliest = kj::min(earliest, p.time);
+        auto next = KJ_ASSERT_NONNULL(hooks.next);
+        KJ_ASSERT(next <= earliest);
+        if (queue == TimerImpl::Queue::ORDERED ||
+            earliest < origin<TimePoint>() + 64 * MILLISECONDS) {
+          KJ_ASSERT(next == earliest);
+        }
+      }
+    }
+  }
+}
+
+Promise<void> tickForever(Timer& timer, uint& count) {
+  return timer.afterDelay(1 * SECONDS).then([&timer, &count]() {
+    ++count;
+    return tickForever(timer, count);
+  });
+}
+
+KJ_TEST("TimerImpl schedules timers from callbacks") {
+  for (auto queue: QUEUES) {
+    EventLoop loop;
+    WaitScope waitScope(loop);
+    TimerImpl timer(origin<TimePoint>(), queue);
+
+    uint count = 0;
+    auto promise = tickForever(timer, count);
+
+    for (uint i = 1; i <= 100; i++) {
+      timer.advanceTo(origin<TimePoint>() + i * SECONDS);
+      loop.run();
+      KJ_EXPECT(count == i);
+    }
+  }
+}
+
+}  // namespace
+}  // namespace kj
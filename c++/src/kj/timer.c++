@@ -22,8 +22,15 @@
 
 #include "timer.h"
 #include "debug.h"
+#include "list.h"
+#include "vector.h"
+#include <algorithm>
 #include <set>
 
+#if _MSC_VER && !defined(__clang__)
+#include <intrin.h>
+#endif
+
 namespace kj {
 
 kj::Exception Timer::makeTimeoutException() {
@@ -36,54 +43,338 @@ struct TimerImpl::Impl {
   };
   using Timers = std::multiset<TimerPromiseAdapter*, TimerBefore>;
   Timers timers;
+  // Pending timers, with Queue::ORDERED.
+
+  Maybe<Own<Wheel>> wheel;
+  // Pending timers, with Queue::WHEEL.
+
+  Vector<TimerPromiseAdapter*> due;
+  // Scratch space for advanceTo() with Queue::WHEEL.
 };
 
 class TimerImpl::TimerPromiseAdapter {
 public:
-  TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time)
-      : time(time), fulfiller(fulfiller), parent(parent) {
-    pos = parent.impl->timers.insert(this);
+  TimerPromiseAdapter(PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time);
+  ~TimerPromiseAdapter();
+
+  void fulfill();
+
+  const TimePoint time;
+
+  uint64_t sequence = 0;
+  // With Queue::WHEEL, the order in which timers were scheduled, to break ties between timers
+  // with the same time the same way Queue::ORDERED does.
+
+private:
+  PromiseFulfiller<void>& fulfiller;
+  TimerImpl& parent;
+
+  Impl::Timers::const_iterator pos;
+  // With Queue::ORDERED, our position in `parent.impl->timers`.
+
+  ListLink<TimerPromiseAdapter> link;
+  uint8_t level = 0;
+  uint8_t slot = 0;
+  // With Queue::WHEEL, our slot in the wheel. `link` is linked while we are in the wheel.
+
+  friend class Wheel;
+};
+
+static inline uint lg(uint64_t value) {
+  // Compute floor(log2(value)).
+  //
+  // Undefined for value = 0.
+#if _MSC_VER && !defined(__clang__)
+  unsigned long i;
+  auto found = _BitScanReverse64(&i, value);
+  KJ_DASSERT(found);  // !found means value = 0
+  return i;
+#else
+  return sizeof(uint64_t) * 8 - 1 - __builtin_clzll(value);
+#endif
+}
+
+static inline uint lowestBit(uint64_t value) {
+  // Compute the index of the lowest set bit.
+  //
+  // Undefined for value = 0.
+#if _MSC_VER && !defined(__clang__)
+  unsigned long i;
+  auto found = _BitScanForward64(&i, value);
+  KJ_DASSERT(found);  // !found means value = 0
+  return i;
+#else
+  return __builtin_ctzll(value);
+#endif
+}
+
+class TimerImpl::Wheel {
+  // A hierarchical timing wheel, after Varghese and Lauck, "Hashed and Hierarchical Timing
+  // Wheels" (1987).
+  //
+  // Time is divided into 1ms ticks. Level 0 has a slot for each tick in the current span of 64
+  // ticks; each level above has 64 slots, each as wide as the entire level below, covering the
+  // current span of the level above that. A timer goes in the lowest level whose current span
+  // contains it, which is just a matter of finding the highest bit in which its tick differs from
+  // the current tick, so adding and removing timers is O(1). As time advances, the slots which
+  // come due at each level are emptied out, their timers either firing or moving down to a lower
+  // level. Each timer therefore moves at most once per level.
+  //
+  // Eight levels of 64 slots cover 2^48 ticks, which is more than the entire range of TimePoint,
+  // so there is no need for an overflow list.
+
+public:
+  explicit Wheel(TimePoint startTime): currentTick(toTick(startTime)) {}
+
+  KJ_DISALLOW_COPY_AND_MOVE(Wheel);
+
+  void add(TimerPromiseAdapter& timer) {
+    timer.sequence = nextSequence++;
+    place(timer);
+
+    if (nextEventKnown) {
+      KJ_IF_SOME(next, nextEventTime) {
+        if (timer.time < next) nextEventTime = timer.time;
+      } else {
+        nextEventTime = timer.time;
+      }
+    }
+  }
+
+  bool remove(TimerPromiseAdapter& timer) {
+    // Returns true if nextEvent() may have changed.
+
+    auto& bucket = buckets[timer.level][timer.slot];
+    bucket.remove(timer);
+    bool emptied = bucket.empty();
+    if (emptied) {
+      occupied[timer.level] &= ~(uint64_t(1) << timer.slot);
+    }
+
+    if (nextEventKnown) {
+      KJ_IF_SOME(next, nextEventTime) {
+        // Only the earliest timer, or the last timer in the slot whose start time we reported,
+        // can have determined nextEvent().
+        if (timer.time > next &&
+            !(emptied && timer.level > 0 && slotTime(timer.level, timer.slot) == next)) {
+          return false;
+        }
+      }
+      nextEventKnown = false;
+    }
+    return true;
+  }
+
+  Maybe<TimePoint> nextEvent();
+  // Returns a time no later than that of the earliest timer. This is exact if the earliest timer
+  // is due within the current span of level 0. Otherwise it's the time at which the slot holding
+  // the earliest timer comes due: rather than search what may be a very large slot, we let the
+  // event loop wake up and spread the slot out over the lower levels. This costs at most one
+  // extra wakeup per level.
+  //
+  // The result is cached until advanceTo(), or until remove() takes away the timer it came from,
+  // so that the sleep hooks can be kept up to date without searching the wheel on every add()
+  // and remove().
+
+  void advanceTo(TimePoint time, Vector<TimerPromiseAdapter*>& due);
+  // Remove all timers at or before `time` from the wheel and add them to `due`, in no particular
+  // order.
+
+private:
+  static constexpr uint SLOT_BITS = 6;
+  static constexpr uint SLOTS = 1u << SLOT_BITS;
+  static constexpr uint LEVELS = 8;
+  static constexpr Duration TICK = 1 * MILLISECONDS;
+
+  using Bucket = List<TimerPromiseAdapter, &TimerPromiseAdapter::link>;
+  Bucket buckets[LEVELS][SLOTS];
+
+  uint64_t occupied[LEVELS] = {};
+  // Bit i of `occupied[level]` is set if `buckets[level][i]` is non-empty.
+
+  uint64_t currentTick;
+  uint64_t nextSequence = 0;
+
+  bool nextEventKnown = false;
+  Maybe<TimePoint> nextEventTime;
+  // The cached result of nextEvent(), if `nextEventKnown`.
+
+  Vector<TimerPromiseAdapter*> moving;
+  // Scratch space for advanceTo().
+
+  static uint64_t toTick(TimePoint time) {
+    Duration sinceOrigin = time - origin<TimePoint>();
+    return sinceOrigin <= 0 * NANOSECONDS ? 0 : sinceOrigin / TICK;
+  }
+
+  TimePoint slotTime(uint level, uint slot) {
+    // The time at which `buckets[level][slot]` comes due.
+    uint shift = level * SLOT_BITS;
+    uint64_t span = (currentTick >> shift) & ~uint64_t(SLOTS - 1);
+    return origin<TimePoint>() + int64_t((span | slot) << shift) * TICK;
+  }
+
+  void place(TimerPromiseAdapter& timer);
+  Maybe<TimePoint> findNextEvent();
+};
+
+void TimerImpl::Wheel::place(TimerPromiseAdapter& timer) {
+  // Timers that are already due go in the current slot of level 0.
+  uint64_t tick = kj::max(toTick(timer.time), currentTick);
+
+  uint level = tick == currentTick ? 0 : lg(tick ^ currentTick) / SLOT_BITS;
+  uint slot = (tick >> (level * SLOT_BITS)) & (SLOTS - 1);
+
+  buckets[level][slot].add(timer);
+  occupied[level] |= uint64_t(1) << slot;
+  timer.level = level;
+  timer.slot = slot;
+}
+
+Maybe<TimePoint> TimerImpl::Wheel::nextEvent() {
+  if (!nextEventKnown) {
+    nextEventTime = findNextEvent();
+    nextEventKnown = true;
+  }
+  return nextEventTime;
+}
+
+Maybe<TimePoint> TimerImpl::Wheel::findNextEvent() {
+  // All timers in a level come before all timers in the levels above it, and a level's slots
+  // are in time order starting from the current one, so the earliest timer is in the first
+  // occupied slot of the lowest occupied level.
+  for (uint level = 0; level < LEVELS; level++) {
+    if (occupied[level] == 0) continue;
+
+    uint slot = lowestBit(occupied[level]);
+    if (level == 0) {
+      auto& bucket = buckets[0][slot];
+      TimePoint earliest = bucket.front().time;
+      for (auto& timer: bucket) {
+        earliest = kj::min(earliest, timer.time);
+      }
+      return earliest;
+    } else {
+      return slotTime(level, slot);
+    }
+  }
+
+  return kj::none;
+}
+
+void TimerImpl::Wheel::advanceTo(TimePoint time, Vector<TimerPromiseAdapter*>& due) {
+  uint64_t newTick = kj::max(toTick(time), currentTick);
+
+  // At each level, empty out the slots that we passed over. At level 0 that includes the current
+  // slot, whose timers may not all have been due last time.
+  for (uint level = 0; level < LEVELS; level++) {
+    uint shift = level * SLOT_BITS;
+    uint64_t first = (currentTick >> shift) + (level > 0);
+    uint64_t last = newTick >> shift;
+    if (first > last) {
+      // We're still in the same slot at this level, and thus at all higher levels.
+      break;
+    }
+
+    uint64_t slots;
+    if (last - first >= SLOTS - 1) {
+      slots = ~uint64_t(0);
+    } else {
+      uint64_t run = (uint64_t(2) << (last - first)) - 1;
+      uint rotation = first & (SLOTS - 1);
+      slots = (run << rotation) | (run >> ((SLOTS - rotation) & (SLOTS - 1)));
+    }
+
+    for (uint64_t pending = occupied[level] & slots; pending != 0; pending &= pending - 1) {
+      auto& bucket = buckets[level][lowestBit(pending)];
+      while (!bucket.empty()) {
+        auto& timer = bucket.front();
+        bucket.remove(timer);
+        moving.add(&timer);
+      }
+    }
+    occupied[level] &= ~slots;
+  }
+
+  currentTick = newTick;
+  nextEventKnown = false;
 
+  for (auto timer: moving) {
+    if (timer->time <= time) {
+      due.add(timer);
+    } else {
+      place(*timer);
+    }
+  }
+  moving.clear();
+}
+
+// -------------------------------------------------------------------
+
+TimerImpl::TimerPromiseAdapter::TimerPromiseAdapter(
+    PromiseFulfiller<void>& fulfiller, TimerImpl& parent, TimePoint time)
+    : time(time), fulfiller(fulfiller), parent(parent) {
+  KJ_IF_SOME(wheel, parent.impl->wheel) {
     KJ_IF_SOME(h, parent.sleepHooks) {
-      if (pos == parent.impl->timers.begin()) {
+      auto before = wheel->nextEvent();
+      wheel->add(*this);
+      KJ_IF_SOME(b, before) {
+        if (time < b) h.updateNextTimerEvent(time);
+      } else {
         h.updateNextTimerEvent(time);
       }
+    } else {
+      wheel->add(*this);
     }
+    return;
   }
 
-  ~TimerPromiseAdapter() {
-    if (pos != parent.impl->timers.end()) {
+  pos = parent.impl->timers.insert(this);
+
+  KJ_IF_SOME(h, parent.sleepHooks) {
+    if (pos == parent.impl->timers.begin()) {
+      h.updateNextTimerEvent(time);
+    }
+  }
+}
+
+TimerImpl::TimerPromiseAdapter::~TimerPromiseAdapter() {
+  KJ_IF_SOME(wheel, parent.impl->wheel) {
+    if (link.isLinked() && wheel->remove(*this)) {
       KJ_IF_SOME(h, parent.sleepHooks) {
-        bool isFirst = pos == parent.impl->timers.begin();
+        h.updateNextTimerEvent(wheel->nextEvent());
+      }
+    }
+    return;
+  }
 
-        parent.impl->timers.erase(pos);
+  if (pos != parent.impl->timers.end()) {
+    KJ_IF_SOME(h, parent.sleepHooks) {
+      bool isFirst = pos == parent.impl->timers.begin();
 
-        if (isFirst) {
-          if (parent.impl->timers.empty()) {
-            h.updateNextTimerEvent(kj::none);
-          } else {
-            h.updateNextTimerEvent((*parent.impl->timers.begin())->time);
-          }
+      parent.impl->timers.erase(pos);
+
+      if (isFirst) {
+        if (parent.impl->timers.empty()) {
+          h.updateNextTimerEvent(kj::none);
+        } else {
+          h.updateNextTimerEvent((*parent.impl->timers.begin())->time);
         }
-      } else {
-        parent.impl->timers.erase(pos);
       }
+    } else {
+      parent.impl->timers.erase(pos);
     }
   }
+}
 
-  void fulfill() {
-    fulfiller.fulfill();
+void TimerImpl::TimerPromiseAdapter::fulfill() {
+  fulfiller.fulfill();
+  if (parent.impl->wheel == kj::none) {
     parent.impl->timers.erase(pos);
     pos = parent.impl->timers.end();
   }
-
-  const TimePoint time;
-
-private:
-  PromiseFulfiller<void>& fulfiller;
-  TimerImpl& parent;
-  Impl::Timers::const_iterator pos;
-};
+  // With Queue::WHEEL, the wheel already removed us before handing us to advanceTo().
+}
 
 inline bool TimerImpl::Impl::TimerBefore::operator()(
     TimerPromiseAdapter* lhs, TimerPromiseAdapter* rhs) const {
@@ -107,12 +398,20 @@ Promise<void> TimerImpl::afterDelay(Duration delay) {
   return newAdaptedPromise<void, TimerPromiseAdapter>(*this, now() + delay);
 }
 
-TimerImpl::TimerImpl(TimePoint startTime)
-    : time(startTime), impl(heap<Impl>()) {}
+TimerImpl::TimerImpl(TimePoint startTime, Queue queue)
+    : time(startTime), impl(heap<Impl>()) {
+  if (queue == Queue::WHEEL) {
+    impl->wheel = heap<Wheel>(startTime);
+  }
+}
 
 TimerImpl::~TimerImpl() noexcept(false) {}
 
 Maybe<TimePoint> TimerImpl::nextEvent() {
+  KJ_IF_SOME(wheel, impl->wheel) {
+    return wheel->nextEvent();
+  }
+
   auto iter = impl->timers.begin();
   if (iter == impl->timers.end()) {
     return kj::none;
@@ -148,6 +447,21 @@ void TimerImpl::advanceTo(TimePoint newTime) {
   // - on linux: https://github.com/capnproto/capnproto/issues/2261
   time = kj::max(time, newTime);
 
+  KJ_IF_SOME(wheel, impl->wheel) {
+    auto& due = impl->due;
+    wheel->advanceTo(time, due);
+
+    // Fire in the same order as Queue::ORDERED would.
+    std::sort(due.begin(), due.end(), [](TimerPromiseAdapter* a, TimerPromiseAdapter* b) {
+      return a->time < b->time || (a->time == b->time && a->sequence < b->sequence);
+    });
+    for (auto timer: due) {
+      timer->fulfill();
+    }
+    due.clear();
+    return;
+  }
+
   for (;;) {
     auto front = impl->timers.begin();
     if (front == impl->timers.end() || (*front)->time > time) {
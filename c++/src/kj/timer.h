@@ -82,7 +82,23 @@ class TimerImpl final: public Timer {
   // implementation -- to tell it when time has advanced.
 
 public:
-  TimerImpl(TimePoint startTime);
+  enum class Queue {
+    // How pending timers are kept.
+
+    ORDERED,
+    // A balanced tree ordered by time. Scheduling or cancelling a timer costs O(log n) plus a
+    // heap allocation for the tree node.
+
+    WHEEL
+    // A hierarchical timing wheel with 1ms slots. Scheduling or cancelling a timer is O(1) and
+    // allocates nothing, which pays off when many timers are outstanding and most are cancelled
+    // before they fire, as is typical of timeouts. Timers still fire at their exact time and in
+    // the same order as with ORDERED, but nextEvent() may return an earlier time when the next
+    // timer is more than a few tens of milliseconds away, costing the event loop a few extra
+    // wakeups.
+  };
+
+  TimerImpl(TimePoint startTime, Queue queue = Queue::ORDERED);
   ~TimerImpl() noexcept(false);
 
   Maybe<TimePoint> nextEvent();
@@ -134,6 +150,7 @@ public:
 
 private:
   struct Impl;
+  class Wheel;
   class TimerPromiseAdapter;
   TimePoint time;
   Own<Impl> impl;